@@ -0,0 +1,117 @@
+#include <slim/StringView.hpp>
+#include <slim/types/String.hpp>
+#include <slim/types/Array.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <string>
+
+namespace
+{
+    /**Generate text of roughly the given size from a vocabulary of English words, with
+     * sentence punctuation and line breaks, similar to log excerpts and article bodies.
+     */
+    std::string make_text(size_t size)
+    {
+        static const char *WORDS[] = {
+            "the", "of", "and", "to", "in", "is", "that", "for", "it", "as", "was", "with",
+            "on", "be", "at", "by", "this", "had", "not", "are", "but", "from", "or", "have",
+            "request", "response", "server", "template", "render", "value", "error", "warning",
+            "article", "content", "section", "paragraph", "performance", "customer", "order"
+        };
+        const size_t WORD_COUNT = sizeof(WORDS) / sizeof(WORDS[0]);
+        std::mt19937 rng(1234);
+        std::string text;
+        text.reserve(size + 32);
+        size_t line = 0;
+        while (text.size() < size)
+        {
+            text += WORDS[rng() % WORD_COUNT];
+            auto r = rng() % 16;
+            if (r == 0) text += ". ";
+            else if (r == 1) text += ", ";
+            else text += ' ';
+            if (text.size() - line > 80)
+            {
+                text += '\n';
+                line = text.size();
+            }
+        }
+        text.resize(size);
+        return text;
+    }
+
+    /**Run f repeatedly for at least a short time, and print the throughput.*/
+    void bench(const char *name, size_t bytes, const std::function<size_t()> &f)
+    {
+        typedef std::chrono::steady_clock Clock;
+        size_t iterations = 0, sink = 0;
+        auto start = Clock::now();
+        std::chrono::duration<double> elapsed;
+        do
+        {
+            sink += f();
+            ++iterations;
+            elapsed = Clock::now() - start;
+        }
+        while (elapsed.count() < 0.2);
+        auto mb_per_s = (double)bytes * iterations / elapsed.count() / (1024 * 1024);
+        std::printf("  %-28s %10.1f MB/s  (%zu)\n", name, mb_per_s, sink % 10);
+    }
+}
+
+int main()
+{
+    std::printf("String search benchmark, filter: %s\n", slim::search::filter_name());
+    const std::string needles[] = {
+        //short, common prefix letters
+        "perform",
+        //medium, absent
+        "xylophone orchestra",
+        //long, shares words with the text, absent
+        "the request to render the template had an error in the section of the article that"
+    };
+    for (size_t size : {1024, 10 * 1024, 100 * 1024, 1024 * 1024, 10 * 1024 * 1024})
+    {
+        auto text = make_text(size);
+        std::printf("%zu bytes\n", size);
+        for (auto &needle : needles)
+        {
+            std::printf(" needle length %zu\n", needle.size());
+            //count every occurrence, so the whole text is searched
+            bench("StringView::find", size, [&]() {
+                size_t count = 0;
+                slim::StringView view(text);
+                for (size_t p = 0; (p = view.find(needle, p)) != slim::StringView::npos; ++count)
+                    p += needle.size();
+                return count;
+            });
+            bench("std::string::find", size, [&]() {
+                size_t count = 0;
+                for (size_t p = 0; (p = text.find(needle, p)) != std::string::npos; ++count)
+                    p += needle.size();
+                return count;
+            });
+            bench("std::search", size, [&]() {
+                size_t count = 0;
+                for (auto p = text.begin(); (p = std::search(p, text.end(), needle.begin(), needle.end())) != text.end(); ++count)
+                    p += needle.size();
+                return count;
+            });
+            bench("StringView::rfind", size, [&]() {
+                return slim::StringView(text).rfind(needle);
+            });
+            bench("std::string::rfind", size, [&]() {
+                return text.rfind(needle);
+            });
+        }
+        auto str = slim::make_value(text);
+        auto sep = slim::make_value(", ");
+        bench("String#split(\", \")", size, [&]() {
+            return str->split({sep})->get_value().size();
+        });
+    }
+    return 0;
+}
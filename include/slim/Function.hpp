@@ -1,7 +1,6 @@
 #pragma once
 #include <functional>
 #include <vector>
-#include <unordered_map>
 #include <memory>
 #include <cassert>
 #include "Error.hpp"
@@ -308,7 +307,7 @@ namespace slim
     class MethodTable
     {
     public:
-        typedef std::unordered_map<SymPtr, Method, ObjHash, ObjEquals> Map;
+        typedef OrderedMap<SymPtr, Method, SymHash, SymEquals> Map;
 
         /**Constructs an empty method table.*/
         MethodTable() : map() {}
@@ -26,7 +26,8 @@ namespace slim
         auto str = dynamic_cast<String*>(arg.get());
         if (str)
         {
-            *out = str->get_value();
+            auto s = str->view();
+            out->assign(s.data(), s.size());
             return true;
         }
         else return false;
@@ -0,0 +1,33 @@
+#pragma once
+#include <cstddef>
+namespace slim
+{
+    /**Loops over packed numbers used by Array, see PackedNumbers.
+     *
+     * The double versions use SSE2 or AVX2 when enabled for the build, else scalar loops. Each
+     * gives the same result in every build, sum keeps four partial sums (element i is added to
+     * sum i % 4) however many lanes are actually used.
+     */
+    namespace kernels
+    {
+        static const size_t NOT_FOUND = (size_t)-1;
+
+        /**Sum of n values.*/
+        double sum(const double *values, size_t n);
+        /**Sum of n values into out, returning false if the sum overflows.*/
+        bool sum(const long long *values, size_t n, long long *out);
+
+        /**Set min and max, returning false if any value is NaN. n must not be 0.*/
+        bool min_max(const double *values, size_t n, double *min, double *max);
+        /**Set min and max. n must not be 0.*/
+        void min_max(const long long *values, size_t n, long long *min, long long *max);
+
+        /**Index of the first value equal to x, or NOT_FOUND.*/
+        size_t find(const double *values, size_t n, double x);
+        /**Index of the first value equal to x, or NOT_FOUND.*/
+        size_t find(const long long *values, size_t n, long long x);
+
+        /**Name of the implementation in use, "avx2", "sse2" or "scalar".*/
+        const char *simd_name();
+    }
+}
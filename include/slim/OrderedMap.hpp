@@ -0,0 +1,304 @@
+#pragma once
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <utility>
+#include <vector>
+namespace slim
+{
+    /**Insertion ordered hash map using open addressing.
+     *
+     * The entries are kept in a dense array in insertion order, with a separate power of two
+     * sized array of 32bit entry positions that is probed linearly, similar to the Ruby st_table
+     * and the CPython compact dict. Compared to std::unordered_map this avoids an allocation per
+     * entry, iterates in insertion order, and uses around half the memory.
+     *
+     * Keys are first compared by identity (==) before KeyEqual, so lookups for the same Symbol
+     * or other shared instance avoid the virtual eq call.
+     *
+     * Erased entries leave a null key in the entry array and a tombstone in the index until the
+     * next rebuild, so Key must be a nullable pointer type such as std::shared_ptr, and null keys
+     * may not be inserted.
+     *
+     * Inserting may invalidate all iterators and references. Erasing only invalidates those to
+     * the erased entry, the space is reclaimed when the table is next rebuilt.
+     */
+    template<class Key, class Value, class Hash, class KeyEqual>
+    class OrderedMap
+    {
+        struct Entry;
+    public:
+        typedef Key key_type;
+        typedef Value mapped_type;
+        typedef std::pair<Key, Value> value_type;
+
+        template<class EntryT, class ValueT>
+        class Iterator
+        {
+        public:
+            typedef std::forward_iterator_tag iterator_category;
+            typedef ValueT value_type;
+            typedef std::ptrdiff_t difference_type;
+            typedef ValueT *pointer;
+            typedef ValueT &reference;
+
+            Iterator() : p(nullptr), end(nullptr) {}
+            Iterator(EntryT *p, EntryT *end) : p(p), end(end)
+            {
+                skip();
+            }
+            /**Allow iterator to const_iterator conversion.*/
+            template<class EntryT2, class ValueT2>
+            Iterator(const Iterator<EntryT2, ValueT2> &it) : p(it.p), end(it.end) {}
+
+            ValueT &operator *()const { return p->kv; }
+            ValueT *operator ->()const { return &p->kv; }
+            Iterator& operator ++()
+            {
+                ++p;
+                skip();
+                return *this;
+            }
+            Iterator operator ++(int)
+            {
+                auto tmp = *this;
+                ++*this;
+                return tmp;
+            }
+            template<class EntryT2, class ValueT2>
+            bool operator == (const Iterator<EntryT2, ValueT2> &rhs)const { return p == rhs.p; }
+            template<class EntryT2, class ValueT2>
+            bool operator != (const Iterator<EntryT2, ValueT2> &rhs)const { return p != rhs.p; }
+        private:
+            template<class, class> friend class Iterator;
+            friend class OrderedMap;
+            EntryT *p, *end;
+
+            /**Skip erased entries.*/
+            void skip()
+            {
+                while (p != end && !p->kv.first) ++p;
+            }
+        };
+        typedef Iterator<Entry, value_type> iterator;
+        typedef Iterator<const Entry, const value_type> const_iterator;
+
+        OrderedMap() : entries(), index(), live(0) {}
+
+        iterator begin() { return make_iterator(entries.data()); }
+        iterator end() { return make_iterator(entries.data() + entries.size()); }
+        const_iterator begin()const { return make_iterator(entries.data()); }
+        const_iterator end()const { return make_iterator(entries.data() + entries.size()); }
+
+        size_t size()const { return live; }
+        bool empty()const { return live == 0; }
+        /**Number of slots in the index, like std::unordered_map::bucket_count.*/
+        size_t bucket_count()const { return index.size(); }
+        void clear()
+        {
+            entries.clear();
+            index.clear();
+            live = 0;
+        }
+        /**Ensure at least n entries can be stored without rebuilding the table.*/
+        void reserve(size_t n)
+        {
+            if (n > usable()) rebuild(n);
+        }
+
+        iterator find(const Key &key)
+        {
+            auto i = find_entry(key, mix(Hash()(key)));
+            return i == NONE ? end() : make_iterator(entries.data() + i);
+        }
+        const_iterator find(const Key &key)const
+        {
+            auto i = find_entry(key, mix(Hash()(key)));
+            return i == NONE ? end() : make_iterator(entries.data() + i);
+        }
+        size_t count(const Key &key)const
+        {
+            return find_entry(key, mix(Hash()(key))) == NONE ? 0 : 1;
+        }
+
+        /**Inserts key and value if key is not already present.
+         * Returns an iterator to the entry for key, and true if it was inserted.
+         */
+        template<class K, class V>
+        std::pair<iterator, bool> emplace(K &&key, V &&value)
+        {
+            assert(key);
+            auto h = mix(Hash()(key));
+            auto i = find_entry(key, h);
+            if (i != NONE) return { make_iterator(entries.data() + i), false };
+            i = add_entry(h, std::forward<K>(key), std::forward<V>(value));
+            return { make_iterator(entries.data() + i), true };
+        }
+        std::pair<iterator, bool> insert(const value_type &kv)
+        {
+            return emplace(kv.first, kv.second);
+        }
+        /**Gets the value for key, inserting a default constructed value if not present.*/
+        Value &operator[](const Key &key)
+        {
+            assert(key);
+            auto h = mix(Hash()(key));
+            auto i = find_entry(key, h);
+            if (i == NONE) i = add_entry(h, key, Value());
+            return entries[i].kv.second;
+        }
+
+        /**Erase the entry for key, returning the number of entries erased (0 or 1).*/
+        size_t erase(const Key &key)
+        {
+            auto h = mix(Hash()(key));
+            auto slot = find_slot(key, h);
+            if (slot == NONE) return 0;
+            erase_slot(slot);
+            return 1;
+        }
+        /**Erase the entry at it, returning the iterator following it.*/
+        iterator erase(const_iterator it)
+        {
+            auto slot = find_slot(it->first, it.p->hash);
+            assert(slot != NONE);
+            auto pos = index[slot];
+            erase_slot(slot);
+            return make_iterator(entries.data() + pos);
+        }
+    private:
+        struct Entry
+        {
+            template<class K, class V>
+            Entry(size_t hash, K &&key, V &&value)
+                : kv(std::forward<K>(key), std::forward<V>(value)), hash(hash)
+            {}
+            value_type kv;
+            size_t hash;
+        };
+        typedef uint32_t Index;
+        enum : Index
+        {
+            EMPTY = 0xFFFFFFFF,
+            DELETED = 0xFFFFFFFE
+        };
+        enum : size_t
+        {
+            NONE = (size_t)-1,
+            MIN_CAPACITY = 8
+        };
+
+        /**Entries in insertion order. Erased entries have a null key.*/
+        std::vector<Entry> entries;
+        /**Open addressed index into entries. Size is zero or a power of two.*/
+        std::vector<Index> index;
+        /**Number of entries with a non-null key.*/
+        size_t live;
+
+        iterator make_iterator(Entry *p)
+        {
+            return iterator(p, entries.data() + entries.size());
+        }
+        const_iterator make_iterator(const Entry *p)const
+        {
+            return const_iterator(p, entries.data() + entries.size());
+        }
+
+        /**Pointer based hashes (such as Symbol) have zero low bits and the index is masked, so mix
+         * the high bits down. Both steps are reversible, so distinct hashes stay distinct.
+         */
+        static size_t mix(size_t h)
+        {
+            h ^= h >> (sizeof(size_t) * 4);
+            h *= (size_t)0x9E3779B97F4A7C15ull;
+            return h ^ (h >> (sizeof(size_t) * 4));
+        }
+        /**Max entries (including erased ones) before rebuilding, keeping the load below 2/3.
+         * Since erased entries are not reused, entries.size() is also a bound on the number of
+         * non-empty index slots.
+         */
+        size_t usable()const
+        {
+            return index.size() * 2 / 3;
+        }
+        bool matches(const Entry &e, const Key &key, size_t h)const
+        {
+            return e.hash == h && (e.kv.first == key || KeyEqual()(e.kv.first, key));
+        }
+
+        /**Index slot referencing the entry for key, or NONE.*/
+        size_t find_slot(const Key &key, size_t h)const
+        {
+            if (index.empty()) return NONE;
+            auto mask = index.size() - 1;
+            for (auto slot = h & mask;; slot = (slot + 1) & mask)
+            {
+                auto i = index[slot];
+                if (i == EMPTY) return NONE;
+                if (i != DELETED && matches(entries[i], key, h)) return slot;
+            }
+        }
+        /**Position in entries for key, or NONE.*/
+        size_t find_entry(const Key &key, size_t h)const
+        {
+            auto slot = find_slot(key, h);
+            return slot == NONE ? NONE : index[slot];
+        }
+
+        /**Appends a new entry, which must not already exist. Returns the position in entries.*/
+        template<class K, class V>
+        size_t add_entry(size_t h, K &&key, V &&value)
+        {
+            //room for half as many again, so erase and insert near a resize point do not
+            //rebuild every time
+            if (entries.size() + 1 > usable()) rebuild(live + 1 + live / 2);
+            auto pos = entries.size();
+            entries.emplace_back(h, std::forward<K>(key), std::forward<V>(value));
+            index[free_slot(h)] = (Index)pos;
+            ++live;
+            return pos;
+        }
+        /**First empty or deleted index slot for h.*/
+        size_t free_slot(size_t h)const
+        {
+            auto mask = index.size() - 1;
+            auto slot = h & mask;
+            while (index[slot] != EMPTY && index[slot] != DELETED) slot = (slot + 1) & mask;
+            return slot;
+        }
+        void erase_slot(size_t slot)
+        {
+            auto &e = entries[index[slot]];
+            e.kv.first = Key();
+            e.kv.second = Value();
+            index[slot] = DELETED;
+            --live;
+        }
+        /**Removes erased entries and resizes the index to hold at least n entries.*/
+        void rebuild(size_t n)
+        {
+            size_t capacity = MIN_CAPACITY;
+            while (capacity * 2 / 3 < n) capacity *= 2;
+            assert(capacity <= DELETED);
+
+            if (live != entries.size())
+            {
+                std::vector<Entry> compact;
+                compact.reserve(n);
+                for (auto &e : entries)
+                {
+                    if (e.kv.first) compact.push_back(std::move(e));
+                }
+                entries.swap(compact);
+            }
+            else entries.reserve(n);
+
+            index.assign(capacity, EMPTY);
+            for (size_t i = 0; i < entries.size(); ++i)
+            {
+                index[free_slot(entries[i].hash)] = (Index)i;
+            }
+        }
+    };
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <cstddef>
+namespace slim
+{
+    /**Substring search used by StringView, and so by the String methods.
+     *
+     * Candidate positions are filtered by comparing the two needle bytes least likely to occur
+     * in text against a block of positions at once with SSE2 or AVX2 (when enabled for the
+     * build, else a memchr based scalar loop), and the whole needle is compared only where both
+     * match. If too many candidates pass the filter for a long needle, find switches to the
+     * Two-Way algorithm, which is linear time in the worst case and needs no allocation.
+     */
+    namespace search
+    {
+        static const size_t NOT_FOUND = (size_t)-1;
+        /**Needles at least this long may switch to Two-Way in find.*/
+        static const size_t TWO_WAY_MIN_NEEDLE = 32;
+
+        /**Find the first occurrence of needle in haystack, or NOT_FOUND.*/
+        size_t find(const char *haystack, size_t haystack_len, const char *needle, size_t needle_len);
+        /**Find the last occurrence of needle in haystack, or NOT_FOUND.*/
+        size_t rfind(const char *haystack, size_t haystack_len, const char *needle, size_t needle_len);
+
+        /**Name of the block filter implementation in use, "avx2", "sse2" or "scalar".*/
+        const char *filter_name();
+    }
+}
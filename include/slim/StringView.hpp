@@ -0,0 +1,111 @@
+#pragma once
+#include "StringSearch.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <string>
+namespace slim
+{
+    /**Non-owning reference to a range of bytes.
+     *
+     * A subset of the C++17 std::string_view, which is not available to all the supported
+     * compilers. Used to work with String slices without copying, the referenced bytes must
+     * outlive the view.
+     */
+    class StringView
+    {
+    public:
+        enum : size_t { npos = (size_t)-1 };
+
+        StringView() : p(nullptr), n(0) {}
+        StringView(const char *p, size_t n) : p(p), n(n) {}
+        StringView(const char *str) : p(str), n(std::strlen(str)) {}
+        StringView(const std::string &str) : p(str.data()), n(str.size()) {}
+
+        const char *data()const { return p; }
+        size_t size()const { return n; }
+        bool empty()const { return n == 0; }
+        const char *begin()const { return p; }
+        const char *end()const { return p + n; }
+        char operator[](size_t i)const { return p[i]; }
+        char front()const { return p[0]; }
+        char back()const { return p[n - 1]; }
+
+        std::string str()const { return n ? std::string(p, n) : std::string(); }
+
+        StringView substr(size_t pos, size_t count = npos)const
+        {
+            assert(pos <= n);
+            return StringView(p + pos, std::min(count, n - pos));
+        }
+
+        int compare(StringView rhs)const
+        {
+            auto len = std::min(n, rhs.n);
+            auto r = len ? std::memcmp(p, rhs.p, len) : 0;
+            if (r) return r;
+            return n < rhs.n ? -1 : n > rhs.n ? 1 : 0;
+        }
+        bool operator == (StringView rhs)const
+        {
+            return n == rhs.n && (n == 0 || std::memcmp(p, rhs.p, n) == 0);
+        }
+        bool operator != (StringView rhs)const { return !(*this == rhs); }
+
+        bool starts_with(StringView prefix)const
+        {
+            return n >= prefix.n && std::memcmp(p, prefix.p, prefix.n) == 0;
+        }
+        bool ends_with(StringView suffix)const
+        {
+            return n >= suffix.n && std::memcmp(p + n - suffix.n, suffix.p, suffix.n) == 0;
+        }
+
+        size_t find(char c, size_t pos = 0)const
+        {
+            if (pos >= n) return npos;
+            auto found = (const char*)std::memchr(p + pos, c, n - pos);
+            return found ? (size_t)(found - p) : npos;
+        }
+        size_t find(StringView needle, size_t pos = 0)const
+        {
+            if (pos > n) return npos;
+            auto found = search::find(p + pos, n - pos, needle.p, needle.n);
+            return found == search::NOT_FOUND ? npos : found + pos;
+        }
+        size_t rfind(StringView needle, size_t pos = npos)const
+        {
+            if (needle.n > n) return npos;
+            auto found = search::rfind(p, std::min(pos, n - needle.n) + needle.n, needle.p, needle.n);
+            return found == search::NOT_FOUND ? npos : found;
+        }
+        size_t find_first_of(StringView chars, size_t pos = 0)const
+        {
+            for (; pos < n; ++pos) if (chars.contains(p[pos])) return pos;
+            return npos;
+        }
+        size_t find_first_not_of(StringView chars, size_t pos = 0)const
+        {
+            for (; pos < n; ++pos) if (!chars.contains(p[pos])) return pos;
+            return npos;
+        }
+        size_t find_last_not_of(StringView chars, size_t pos = npos)const
+        {
+            if (n == 0) return npos;
+            for (auto i = std::min(pos, n - 1) + 1; i-- > 0;)
+            {
+                if (!chars.contains(p[i])) return i;
+            }
+            return npos;
+        }
+    private:
+        const char *p;
+        size_t n;
+
+        bool contains(char c)const
+        {
+            return n && std::memchr(p, c, n) != nullptr;
+        }
+    };
+}
@@ -1,7 +1,11 @@
 #pragma once
 #include "template/Template.hpp"
+#include "template/IncrementalRender.hpp"
 #include "expression/Scope.hpp"
+#include "Error.hpp"
 #include "Function.hpp"
+#include <chrono>
+#include <map>
 
 namespace slim
 {
@@ -13,4 +17,26 @@ namespace slim
     Template parse_template(const std::string &source, const std::vector<std::string> &local_vars);
     /**Parses a template from a source file.*/
     Template parse_template_file(const std::string &path);
+
+    /**The result of parse_template_directory.*/
+    struct TemplateDirectory
+    {
+        /**The templates that parsed, by path relative to the directory with '/' separators.*/
+        std::map<std::string, Template> templates;
+        /**The errors for the files that failed to parse, ordered by path.
+         * Both TemplateSyntaxError and script SyntaxError are stored as SyntaxError.
+         */
+        std::vector<SyntaxError> errors;
+        /**The time taken to read and parse each file, including those with errors.*/
+        std::map<std::string, std::chrono::microseconds> parse_times;
+    };
+    /**Parses all the files in a directory and its sub directories with names matching pattern.
+     * Files are memory mapped, and parsed concurrently by a pool of worker threads.
+     * A syntax error in one file does not stop the others being parsed, see
+     * TemplateDirectory::errors. Any other error, such as failing to read a file, is thrown
+     * once all the workers are done.
+     * @param pattern File name pattern, where '*' matches any characters and '?' any one.
+     * @param threads The number of threads to use, or 0 for the number of CPU cores.
+     */
+    TemplateDirectory parse_template_directory(const std::string &path, const std::string &pattern = "*.slim", unsigned threads = 0);
 }
@@ -21,5 +21,11 @@ namespace slim
     {
         return html_escape(obj.get());
     }
+    /**html_escape, appending the result to out rather than creating a new string.*/
+    void html_escape_append(std::string &out, const char *str, size_t len);
+    /**html_escape, appending the result to out rather than creating a new string.
+     * String values are read in place without a copy.
+     */
+    void html_escape_append(std::string &out, const Object *obj);
 }
 
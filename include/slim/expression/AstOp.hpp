@@ -2,6 +2,8 @@
 #include "Ast.hpp"
 #include "../CachedMethod.hpp"
 #include "../Function.hpp"
+#include <atomic>
+#include <cstdint>
 namespace slim
 {
     namespace tpl
@@ -128,17 +130,26 @@ namespace slim
             virtual std::string to_string()const override;
             virtual ObjectPtr eval(Scope &scope)const override;
         };
-        /**[] operator */
+        /**[] operator
+         *
+         * If the argument is a symbol literal, such as "row[:name]", the slot for the last seen
+         * HashShape is cached, so that lookups on hashes with the same keys are just an index.
+         */
         class ElementRefOp : public FuncCall
         {
         public:
-            ElementRefOp(ExpressionNodePtr &&lhs, Args &&args)
-                : FuncCall(std::move(args)), lhs(std::move(lhs))
-            {}
+            ElementRefOp(ExpressionNodePtr &&lhs, Args &&args);
             virtual std::string to_string()const override;
             virtual ObjectPtr eval(Scope &scope)const override;
 
             ExpressionNodePtr lhs;
+        private:
+            /**The symbol if the argument is a symbol literal, else nullptr.*/
+            SymPtr sym_key;
+            /**HashShape::id() in the high 32 bits, and the slot of sym_key in the low 32 bits.
+             * A single atomic so that concurrent renders never see a mismatched pair.
+             */
+            mutable std::atomic<uint64_t> shape_slot;
         };
 
         /**[...] array literal. Each argument becomes an array element.*/
@@ -238,13 +249,15 @@ namespace slim
             };
             typedef std::vector<Node> Nodes;
 
-            InterpolatedString(Nodes &&nodes) : nodes(std::move(nodes)) {}
+            InterpolatedString(Nodes &&nodes);
             virtual std::string to_string()const override;
             virtual ObjectPtr eval(Scope &scope)const override;
         private:
             Nodes nodes;
+            /**Total length of the literal parts, to size the result.*/
+            size_t literal_size;
         };
-        /**Regex literal using an InterpolatedString.*/
+        /**Regex literal using an InterpolatedString, compiled through RegexpCache.*/
         class InterpolatedRegex : public ExpressionNode
         {
         public:
@@ -6,6 +6,7 @@
 #include <vector>
 namespace slim
 {
+    class Number;
     namespace expr
     {
         class Lexer;
@@ -46,6 +47,14 @@ namespace slim
             /**Gets the last token read from lexer.*/
             const Token& get_last_token()const { return current_token; }
             const LocalVarNames& get_var_names()const { return vars; }
+            /**Names of all the variables assigned, in order.
+             * Used by the template parser to check blocks which must not have side effects.
+             */
+            const std::vector<std::string>& get_assigned_vars()const { return assigned_vars; }
+            /**Names of all the methods called, in order. See get_assigned_vars.*/
+            const std::vector<std::string>& get_called_methods()const { return called_methods; }
+            /**Number of calls to "yield" without arguments, which output the main content of a layout.*/
+            size_t get_main_yield_count()const { return main_yield_count; }
         private:
             //State
             Lexer &lexer;
@@ -54,6 +63,9 @@ namespace slim
              * blocks have own scope, so block() updates and reverts this internally.
              */
             LocalVarNames vars;
+            std::vector<std::string> assigned_vars;
+            std::vector<std::string> called_methods;
+            size_t main_yield_count;
 
             /**Advance to the next token.*/
             void next();
@@ -160,8 +172,8 @@ namespace slim
 
             /**Throw syntax error at current position.*/
             [[noreturn]] void error(const std::string &msg)const;
-            /**Parse current token as a number.*/
-            double parse_num()const;
+            /**Parse current token as a number, an Integer if it is a whole number.*/
+            std::shared_ptr<Number> parse_num()const;
         };
     }
 }
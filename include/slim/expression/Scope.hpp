@@ -6,7 +6,6 @@
 #include "../types/ViewModel.hpp"
 #include "../Function.hpp"
 #include <string>
-#include <unordered_map>
 
 namespace slim { namespace expr
 {
@@ -14,7 +13,7 @@ namespace slim { namespace expr
     class Scope
     {
     public:
-        typedef std::unordered_map<SymPtr, ObjectPtr, ObjHash, ObjEquals> Map;
+        typedef OrderedMap<SymPtr, ObjectPtr, SymHash, SymEquals> Map;
 
         /**Constructs the root scope, with no variables except "self".*/
         explicit Scope(ViewModelPtr self)
@@ -0,0 +1,87 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+namespace slim
+{
+    namespace expr
+    {
+        class Scope;
+    }
+    class Symbol;
+    typedef std::shared_ptr<Symbol> SymPtr;
+    class Template;
+    class ViewModel;
+    typedef std::shared_ptr<ViewModel> ViewModelPtr;
+
+    /**@brief Repeatedly renders a Template with a ViewModel, only re-rendering the parts that
+     * depend on attributes or constants set since the previous render.
+     *
+     * The template is split into fragments: each output expression, attribute, loop, and whole
+     * if/elsif/else block outside of any other block, and the static text between them. While a
+     * fragment renders, the view model records the attributes and constants it reads (see
+     * ViewModel::record_reads). A later render reuses the previous output of every fragment
+     * where none of those have been set since (see ViewModel::get_version).
+     *
+     * Local variables are kept between renders. Anything read by a fragment containing code
+     * lines, which might assign a local, is also treated as read by every later fragment.
+     *
+     * This assumes the output only depends on the attributes, constants, and local variables.
+     * Helper methods on the view model are not tracked, and "yield" is not supported.
+     */
+    class IncrementalRender
+    {
+    public:
+        /**A fragment whose output changed.*/
+        struct Change
+        {
+            /**The index of the fragment, which stays the same for the life of this object.*/
+            size_t id;
+            /**The new output of the fragment.*/
+            std::string html;
+        };
+
+        /**The template and model must outlive this object.*/
+        IncrementalRender(const Template &tpl, ViewModelPtr model, bool doctype = true);
+        IncrementalRender(const IncrementalRender &) = delete;
+        IncrementalRender& operator = (const IncrementalRender &) = delete;
+        ~IncrementalRender();
+
+        /**Re-render the changed fragments, and return the whole output.*/
+        std::string render();
+        /**Re-render the changed fragments, and return the fragments whose output is now
+         * different. The first call returns every fragment with any output.
+         */
+        std::vector<Change> render_changes();
+
+        /**The number of fragments.*/
+        size_t size()const { return fragments.size(); }
+        /**The output of fragment id from the last render.*/
+        const std::string &get_fragment(size_t id)const { return fragments[id].output; }
+    private:
+        struct Fragment
+        {
+            /**The op range of the fragment.*/
+            size_t begin, end;
+            /**The fragment is only static text, so never needs rendering.*/
+            bool text;
+            /**The fragment contains an EVAL op, so may assign locals.*/
+            bool code;
+            /**The fragment has output from a successful render.*/
+            bool rendered;
+            /**The model version at the start of the last render.*/
+            uint64_t version;
+            /**The attributes and constants read during the last render.*/
+            std::vector<SymPtr> reads;
+            std::string output;
+        };
+        const Template &tpl;
+        ViewModelPtr model;
+        std::unique_ptr<expr::Scope> scope;
+        std::vector<Fragment> fragments;
+
+        bool changed(const Fragment &fragment, const std::vector<SymPtr> &inherited)const;
+        void render(Fragment &fragment);
+    };
+}
@@ -12,6 +12,7 @@ namespace slim
     namespace expr
     {
         class ExpressionNode;
+        class Parser;
     }
     namespace tpl
     {
@@ -49,6 +50,14 @@ namespace slim
              * internally by parse_control_code().
              */
             expr::LocalVarNames local_vars;
+            /**All variable assignments in script expressions parsed so far.
+             * Used to check parallel_each blocks, see check_parallel_block.
+             */
+            std::vector<std::string> assigned_vars;
+            /**All method calls in script expressions parsed so far.*/
+            std::vector<std::string> called_methods;
+            /**Calls to "yield" without arguments in script expressions parsed so far.*/
+            size_t main_yield_count;
 
             int current_indent();
 
@@ -95,6 +104,16 @@ namespace slim
 
             void parse_code_block(int base_indent, OutputFrame &output);
 
+            /**Add the names from a finished expression parse to assigned_vars and called_methods,
+             * and its count of main yields to main_yield_count.
+             */
+            void add_names(const expr::Parser &expr_parser);
+            /**Raise an error if the expressions since the given assigned_vars and called_methods
+             * positions assign a variable in outer_vars, or call content_for, as a parallel_each
+             * block renders its elements concurrently and in separate scopes.
+             */
+            void check_parallel_block(const expr::LocalVarNames &outer_vars, size_t assigned_start, size_t called_start);
+
             /**Throw syntax error at current position.*/
             [[noreturn]] void error(const std::string &msg);
         };
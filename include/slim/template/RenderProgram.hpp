@@ -0,0 +1,120 @@
+#pragma once
+#include "../expression/Expression.hpp"
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+namespace slim
+{
+    class SegmentedOutput;
+    namespace tpl
+    {
+        class TemplatePart;
+
+        /**A single instruction of a RenderProgram.*/
+        struct RenderOp
+        {
+            enum Code : uint8_t
+            {
+                /**Append the static text from offset a, of length b.*/
+                EMIT_STATIC,
+                /**Evaluate expr and append the HTML escaped result.*/
+                EVAL_ESCAPED,
+                /**Evaluate expr, ignoring the result.*/
+                EVAL,
+                /**Render a TemplateTagAttr part.*/
+                ATTR,
+                /**Render any other part with TemplatePart::render.*/
+                PART,
+                /**Continue at op a if expr is false, else at the next op.*/
+                IF,
+                /**Continue at op a.*/
+                JUMP,
+                /**Run the ops up to the FOR_END at op a for each element of a TemplateForExpr
+                 * part, then continue after the FOR_END.
+                 */
+                FOR_BEGIN,
+                /**The end of a FOR_BEGIN body.*/
+                FOR_END
+            };
+            Code code;
+            uint32_t a, b;
+            const Expression *expr;
+            const TemplatePart *part;
+        };
+
+        /**@brief A TemplatePart tree flattened into a linear sequence of RenderOp.
+         *
+         * All the static text is kept in a single string, and adjacent text is merged into a
+         * single EMIT_STATIC op. Control flow uses jumps within the sequence, so rendering is a
+         * loop over a single vector rather than a virtual call for every part.
+         *
+         * The ops reference the parts and expressions of the tree they were created from, so
+         * that must outlive the program.
+         */
+        class RenderProgram
+        {
+        public:
+            RenderProgram();
+            /**Compile the tree starting at root, see TemplatePart::compile.*/
+            explicit RenderProgram(const TemplatePart &root);
+
+            /**Run the program, appending to buffer.*/
+            void render(std::string &buffer, expr::Scope &scope)const;
+            /**Run the program, appending to out.
+             * Static text and HtmlSafeString output long enough are referenced rather than copied.
+             */
+            void render(SegmentedOutput &out, expr::Scope &scope)const;
+            /**Run the ops from begin up to but not including end.
+             * The range must not start or end within an IF or FOR.
+             */
+            void render(std::string &buffer, expr::Scope &scope, size_t begin, size_t end)const;
+            void render(SegmentedOutput &out, expr::Scope &scope, size_t begin, size_t end)const;
+
+            /**Find the op for a main "yield" (without arguments) that is not within an IF or FOR,
+             * so is always run exactly once, for splitting a layout around the main content.
+             * @return The op index, or ops.size() if there is not exactly one such op.
+             */
+            size_t find_main_yield()const;
+            /**The end of the op range starting at begin, which must not be within an IF or FOR.
+             * For an IF or FOR_BEGIN this is after the end of the whole block (including any
+             * elsif and else), otherwise it is begin + 1.
+             */
+            size_t block_end(size_t begin)const;
+            /**True if ops from begin up to but not including end are all EMIT_STATIC.*/
+            bool is_static(size_t begin, size_t end)const;
+
+            const std::vector<RenderOp> &get_ops()const { return ops; }
+            /**All the static text, which is also a lower bound on the output size.*/
+            const std::string &get_text()const { return text; }
+            /**The space to reserve for the output of a render, based on previous renders.*/
+            size_t get_expected_size()const;
+            /**Update the moving average output size with the size of a completed render.*/
+            void record_size(size_t size)const;
+
+            /**Append static text, merged into the previous op where possible.*/
+            void add_text(const std::string &str);
+            /**Append an op, returning its index.*/
+            size_t add(RenderOp::Code code, const Expression *expr, const TemplatePart *part = nullptr);
+            /**The index of the next op, for use as a jump target.*/
+            size_t label();
+            /**Set the target for the IF, JUMP or FOR_BEGIN op at index op.*/
+            void set_target(size_t op, size_t target);
+        private:
+            std::string text;
+            std::vector<RenderOp> ops;
+            /**add_text does not merge into ops before this index, because it is a jump target.*/
+            size_t merge_start;
+            /**Exponentially weighted average of the output sizes given to record_size.
+             * Updates from concurrent renders may be lost, which is harmless for an estimate.
+             */
+            mutable std::atomic<size_t> expected_size;
+
+            /**Run ops from begin up to but not including end.
+             * If out is not null, buffer is its buffer.
+             */
+            void run(size_t begin, size_t end, std::string &buffer, SegmentedOutput *out, expr::Scope &scope)const;
+            void run_for(size_t begin, std::string &buffer, SegmentedOutput *out, expr::Scope &scope)const;
+        };
+    }
+}
@@ -0,0 +1,98 @@
+#pragma once
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+namespace slim
+{
+    class Object;
+    typedef std::shared_ptr<Object> ObjectPtr;
+
+    /**@brief Render output as a list of segments, for scatter/gather writes (e.g. writev).
+     *
+     * Static template text is not copied, its segments point directly into the Template the
+     * output was rendered from, so that Template must outlive this output. Large HtmlSafeString
+     * values (such as the main content for a layout "yield") are also referenced rather than
+     * copied, and are kept alive by this object.
+     *
+     * Everything else, and any static text shorter than the minimum segment size, is copied into
+     * an internal buffer, so that small pieces of text are collapsed into larger segments.
+     */
+    class SegmentedOutput
+    {
+    public:
+        /**A range of bytes in the output.*/
+        struct Segment
+        {
+            const char *data;
+            size_t size;
+        };
+        /**Default for the minimum size of a referenced segment.*/
+        static const size_t DEFAULT_MIN_SEGMENT = 256;
+
+        explicit SegmentedOutput(size_t min_segment = DEFAULT_MIN_SEGMENT);
+        SegmentedOutput(SegmentedOutput &&);
+        SegmentedOutput& operator = (SegmentedOutput &&);
+        SegmentedOutput(const SegmentedOutput &) = delete;
+        SegmentedOutput& operator = (const SegmentedOutput &) = delete;
+        ~SegmentedOutput();
+
+        /**Text shorter than this is copied rather than referenced.*/
+        size_t get_min_segment()const { return min_segment; }
+        /**The buffer for copied text. Anything appended is part of the output, after any
+         * previously added segments.
+         */
+        std::string &get_buffer() { return *buffer; }
+        /**Add a segment referencing data which will outlive this object, or copy it if small.*/
+        void add_static(const char *data, size_t size);
+        /**Add a segment referencing data owned by obj, or copy it if small.
+         * obj is kept alive, and the data must not be modified.
+         */
+        void add_object(ObjectPtr obj, const char *data, size_t size);
+        /**Add all the segments of other, without copying the text. other is left empty.*/
+        void append(SegmentedOutput &&other);
+
+        /**The output segments in order. There are no empty segments.*/
+        const std::vector<Segment> &get_segments();
+        /**The total output size in bytes.*/
+        size_t size();
+        /**Copy the output into a single string.*/
+        std::string to_string();
+        /**Call write for each segment in order.*/
+        void write(const std::function<void(const char *data, size_t size)> &write);
+        /**Append an iovec style struct with iov_base and iov_len for each segment in order.*/
+        template<class IoVec> void get_iovecs(std::vector<IoVec> &out)
+        {
+            for (auto &segment : get_segments())
+            {
+                IoVec vec;
+                vec.iov_base = (void*)segment.data;
+                vec.iov_len = segment.size;
+                out.push_back(vec);
+            }
+        }
+    private:
+        /**A segment, where data is null for a range of buffer starting at offset.*/
+        struct Pending
+        {
+            const char *data;
+            size_t offset;
+            size_t size;
+        };
+        size_t min_segment;
+        /**Heap allocated, so segments stay valid when this is moved.*/
+        std::unique_ptr<std::string> buffer;
+        std::vector<Pending> pending;
+        /**The start of the buffer text not yet in pending.*/
+        size_t buffer_start;
+        std::vector<ObjectPtr> retained;
+        /**Buffers of appended outputs, which segments reference.*/
+        std::vector<std::unique_ptr<std::string>> retained_buffers;
+        std::vector<Segment> segments;
+        /**pending.size() when segments was last resolved.*/
+        size_t resolved;
+
+        void add(const char *data, size_t size);
+        void flush_buffer();
+    };
+}
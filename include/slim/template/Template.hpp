@@ -1,4 +1,5 @@
 #pragma once
+#include "SegmentedOutput.hpp"
 #include <memory>
 #include <string>
 #include <vector>
@@ -12,16 +13,50 @@ namespace slim
     }
     namespace tpl
     {
+        class RenderProgram;
         class TemplatePart;
     }
     class ViewModel;
     typedef std::shared_ptr<ViewModel> ViewModelPtr;
 
-    /**@brief A parsed template, ready to be rendered using variables in a ViewModel.*/
+    /**@brief A per-thread free list of render output buffers.
+     *
+     * Template::render takes its output string from here. Once the caller is done with the
+     * output (e.g. after writing it to a socket), giving it back with release lets the next
+     * render on the same thread reuse the capacity, rather than growing a new string by repeated
+     * reallocation.
+     */
+    class RenderBufferPool
+    {
+    public:
+        /**Get an empty buffer with at least the requested capacity.*/
+        static std::string acquire(size_t capacity);
+        /**Give a buffer back to the pool of the current thread.
+         * Very large buffers, and buffers beyond the pool size, are simply freed.
+         */
+        static void release(std::string &&buffer);
+        /**Free all the buffers held by the current thread.*/
+        static void clear();
+        /**The number of buffers held by the current thread.*/
+        static size_t size();
+    };
+
+    /**@brief A parsed template, ready to be rendered using variables in a ViewModel.
+     *
+     * The TemplatePart tree is compiled into a tpl::RenderProgram when the template is created,
+     * and rendering runs that program.
+     *
+     * The program keeps a moving average of its output size, which is reserved up front by
+     * each render, so that large pages are not built by repeated reallocation and copying.
+     */
     class Template
     {
     public:
-        Template(std::unique_ptr<tpl::TemplatePart> &&root);
+        /**@param main_yields The number of "yield" calls without arguments anywhere in root,
+         * including within expressions, as counted by the parser. The layout split is only
+         * used if this is exactly one, so a tree built some other way is never split.
+         */
+        Template(std::unique_ptr<tpl::TemplatePart> &&root, size_t main_yields = 0);
         Template(Template &&);
         Template& operator = (Template &&);
         Template(const Template &) = delete;
@@ -34,6 +69,10 @@ namespace slim
          * @param doctype If true, prefix the HTML5 doctype.
          */
         std::string render(ViewModelPtr model, bool doctype = true)const;
+        /**Render this template, appending the output to buffer.
+         * Allows a server to reuse its own buffers between requests.
+         */
+        void render_into(std::string &buffer, ViewModelPtr model, bool doctype = true)const;
         /**Render this template with an existing variable scope.
          * Used for partials (the "locals" hash param).
          */
@@ -41,8 +80,26 @@ namespace slim
         /**Render this template with a layout template.
          * This template will be rendered first, and its output, and any "content_for" blocks will
          * then be used for the layouts "yield" output.
+         *
+         * If the layout has a single main "yield" outside any condition or loop, it is split
+         * there when parsed. The main content is then rendered directly between the layout
+         * prefix and suffix, rather than stored in the view model and copied by "yield".
          */
         std::string render_layout(Template &layout, ViewModelPtr model, bool doctype = true)const;
+        /**render_layout, appending the output to buffer.*/
+        void render_layout_into(std::string &buffer, Template &layout, ViewModelPtr model, bool doctype = true)const;
+        /**Render this template as a list of segments, see SegmentedOutput.
+         * The output references the static text of this template, so must not outlive it.
+         * @param min_segment Static text shorter than this is copied, to avoid many tiny segments.
+         */
+        SegmentedOutput render_segments(ViewModelPtr model, bool doctype = true,
+            size_t min_segment = SegmentedOutput::DEFAULT_MIN_SEGMENT)const;
+        /**render_layout as a list of segments, see render_segments.
+         * The output references the static text of layout, and the main content is referenced
+         * rather than copied into the layout output.
+         */
+        SegmentedOutput render_layout_segments(Template &layout, ViewModelPtr model, bool doctype = true,
+            size_t min_segment = SegmentedOutput::DEFAULT_MIN_SEGMENT)const;
 
         /**Converts the template part into a string representation, mainly for debugging.
          * Because the origenal template structure has all ready been lost, as it was converted
@@ -51,7 +108,19 @@ namespace slim
          */
         std::string to_string()const;
     private:
+        friend class IncrementalRender;
+
         /**The root TemplatePart part. Most likely a TemplatePartsList, but this is not garunteed.*/
         std::unique_ptr<tpl::TemplatePart> root;
+        /**root compiled for rendering.*/
+        std::unique_ptr<tpl::RenderProgram> program;
+        /**The op index of the main "yield" when used as a layout, or the op count if the layout
+         * can not be split. See tpl::RenderProgram::find_main_yield.
+         */
+        size_t layout_split;
+        /**True if all the ops before layout_split are static text, so the layout prefix does not
+         * depend on anything the main content might set, such as "content_for" blocks.
+         */
+        bool layout_static_prefix;
     };
 }
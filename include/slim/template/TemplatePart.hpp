@@ -8,6 +8,7 @@ namespace slim
     }
     namespace tpl
     {
+        class RenderProgram;
         /**@brief A part of a template.
          * This is essentially an abstract syntax tree with all the adjacent plain text nodes merged.
          */
@@ -20,6 +21,10 @@ namespace slim
             virtual std::string to_string()const = 0;
             /**Renders this part to the buffer, using the specified variable scope.*/
             virtual void render(std::string &buffer, expr::Scope &scope)const = 0;
+            /**Append the ops to render this part to program.
+             * The default adds a RenderOp::PART op that calls render.
+             */
+            virtual void compile(RenderProgram &program)const;
         };
     }
 }
@@ -1,9 +1,14 @@
 #pragma once
 #include "TemplatePart.hpp"
+#include "RenderProgram.hpp"
 #include "../expression/Expression.hpp"
 namespace slim
 {
     class Symbol;
+    namespace expr
+    {
+        class MemberFuncCall;
+    }
     namespace tpl
     {
         /**List of parts within a single block for sequential evaluation. */
@@ -24,6 +29,7 @@ namespace slim
                 for (auto &part : parts)
                     part->render(buffer, scope);
             }
+            virtual void compile(RenderProgram &program)const override;
         private:
             std::vector<std::unique_ptr<TemplatePart>> parts;
         };
@@ -38,6 +44,7 @@ namespace slim
             {
                 buffer += text;
             }
+            virtual void compile(RenderProgram &program)const override;
         private:
             std::string text;
         };
@@ -50,6 +57,7 @@ namespace slim
 
             virtual std::string to_string()const override;
             virtual void render(std::string &buffer, expr::Scope &scope)const override;
+            virtual void compile(RenderProgram &program)const override;
         protected:
             std::unique_ptr<Expression> expression;
         };
@@ -62,6 +70,7 @@ namespace slim
 
             virtual std::string to_string()const override;
             virtual void render(std::string &buffer, expr::Scope &scope)const override;
+            virtual void compile(RenderProgram &program)const override;
         protected:
             std::unique_ptr<Expression> expression;
         };
@@ -76,10 +85,16 @@ namespace slim
             virtual void render(std::string &buffer, expr::Scope &scope)const override;
         protected:
             std::unique_ptr<Expression> expression;
+            /**expression if it is a "receiver.method(args)" call, else null.*/
+            const expr::MemberFuncCall *member_call;
+
+            /**Call member_call on self, rendering the block into buffer.*/
+            void render_call(std::string &buffer, expr::Scope &scope, ObjectPtr self)const;
         };
         /**Attribute with dynamic value.
          *
-         * Handles boolean as well as string attributes.
+         * Handles boolean as well as string attributes. The name and static values are rendered
+         * once on construction, and dynamic values are escaped directly into the output.
          */
         class TemplateTagAttr : public TemplatePart
         {
@@ -92,30 +107,52 @@ namespace slim
 
             virtual std::string to_string()const override;
             virtual void render(std::string &buffer, expr::Scope &scope)const override;
+            virtual void compile(RenderProgram &program)const override;
         protected:
             std::string attr;
             std::vector<std::string> static_values;
             std::vector<std::unique_ptr<Expression>> dynamic_values;
+            /**' name="' followed by the space separated static values.*/
+            std::string prefix;
         };
-        /**Renders all attributes for a tag with at least one splat attribute.*/
+        /**Renders all attributes for a tag with at least one splat attribute.
+         *
+         * Attributes are rendered in source order, followed by any other keys of the splat hashes
+         * in the order they first appear. The values for an attribute are its static values, then
+         * its dynamic values, then the values from each splat hash with the same key.
+         *
+         * If every splat is a hash literal then the keys are known when parsing, and an attribute
+         * with only static values and no matching key is rendered once on construction.
+         */
         class TemplateTagSplatAttrs: public TemplatePart
         {
         public:
-            typedef std::unordered_multimap<std::string, std::string> Static;
-            typedef std::unordered_multimap<std::string, std::unique_ptr<Expression>> Dynamic;
+            struct Attr
+            {
+                std::string name;
+                std::vector<std::string> static_values;
+                std::vector<std::unique_ptr<Expression>> dynamic_values;
+            };
+            typedef std::vector<Attr> Attrs;
             typedef std::vector<std::unique_ptr<Expression>> Splat;
 
-            TemplateTagSplatAttrs(
-                Static &&static_attrs,
-                Dynamic &&dynamic_attrs,
-                Splat &&splat_attrs);
+            TemplateTagSplatAttrs(Attrs &&attrs, Splat &&splat_attrs);
             ~TemplateTagSplatAttrs();
 
             virtual std::string to_string()const override;
             virtual void render(std::string &buffer, expr::Scope &scope)const override;
         private:
-            Static static_attrs;
-            Dynamic dynamic_attrs;
+            struct SourceAttr
+            {
+                std::string name;
+                /**' name="' followed by the space separated static values.*/
+                std::string prefix;
+                bool has_static;
+                /**No dynamic values and no splat can have this key, so prefix is the entire value.*/
+                bool fixed;
+                std::vector<std::unique_ptr<Expression>> dynamic_values;
+            };
+            std::vector<SourceAttr> attrs;
             Splat splat_attrs;
         };
         /**A script for loop, containing a template body.*/
@@ -128,12 +165,51 @@ namespace slim
                 std::vector<std::shared_ptr<Symbol>> &&param_names);
             ~TemplateForExpr();
 
+            virtual std::string to_string()const override;
+            virtual void render(std::string &buffer, expr::Scope &scope)const override;
+            virtual void compile(RenderProgram &program)const override;
+
+            const std::vector<std::shared_ptr<Symbol>> &get_param_names()const { return param_names; }
+        protected:
+            std::unique_ptr<Expression> expr;
+            std::unique_ptr<TemplatePart> body;
+            std::vector<std::shared_ptr<Symbol>> param_names;
+        };
+        /**A "- expr.parallel_each do |params|" loop.
+         *
+         * The elements of expr are split into chunks, which are rendered on worker threads into
+         * separate buffers, each element with its own child Scope, then appended in order.
+         * The parser refuses bodies that assign outer variables or call content_for, but any
+         * methods called on the view model must be safe to call concurrently.
+         */
+        class TemplateParallelEachExpr : public TemplatePart
+        {
+        public:
+            /**Fewest elements for each worker thread.*/
+            static const size_t MIN_CHUNK = 64;
+            /**Set the most threads used by one loop, including the rendering thread.
+             * 0, the default, uses std::thread::hardware_concurrency.
+             */
+            static void set_max_threads(size_t threads);
+
+            TemplateParallelEachExpr(
+                std::unique_ptr<Expression> &&expr,
+                std::unique_ptr<TemplatePart> &&body,
+                std::vector<std::shared_ptr<Symbol>> &&param_names);
+            ~TemplateParallelEachExpr();
+
             virtual std::string to_string()const override;
             virtual void render(std::string &buffer, expr::Scope &scope)const override;
         protected:
             std::unique_ptr<Expression> expr;
             std::unique_ptr<TemplatePart> body;
             std::vector<std::shared_ptr<Symbol>> param_names;
+            /**body compiled for rendering.*/
+            RenderProgram program;
+
+            /**Render elements from begin to end into buffer.*/
+            void render_chunk(std::string &buffer, expr::Scope &scope,
+                const ObjectPtr *begin, const ObjectPtr *end)const;
         };
         struct TemplateCondExpr
         {
@@ -161,6 +237,7 @@ namespace slim
 
             virtual std::string to_string()const override;
             virtual void render(std::string &buffer, expr::Scope &scope)const override;
+            virtual void compile(RenderProgram &program)const override;
         protected:
             TemplateCondExpr if_expr;
             std::vector<TemplateCondExpr> elseif_exprs;
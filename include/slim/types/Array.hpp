@@ -1,22 +1,68 @@
 #pragma once
 #include "Object.hpp"
 #include "Enumerable.hpp"
+#include <atomic>
+#include <mutex>
 #include <vector>
 namespace slim
 {
     class Boolean;
     class Number;
     class String;
-    /**Script array type.*/
+    /**The elements of an Array that only contains numbers.*/
+    struct PackedNumbers
+    {
+        enum Kind
+        {
+            /**Every element is an Integer, in ints.*/
+            INTS,
+            /**Every element is a Number other than Integer, in doubles.*/
+            DOUBLES,
+            /**A mix of Integer and Number, in doubles. Only made by Array::numbers scanning
+             * element objects, since the type of each element is lost.
+             */
+            MIXED
+        };
+        Kind kind;
+        std::vector<long long> ints;
+        std::vector<double> doubles;
+
+        PackedNumbers() : kind(INTS), ints(), doubles() {}
+        size_t size()const { return kind == INTS ? ints.size() : doubles.size(); }
+        /**Add obj if it is a number, returning false if not.
+         * Unless mixed is true, a Number is also not added to INTS or an Integer to DOUBLES.
+         */
+        bool push_back(const Object *obj, bool mixed);
+        /**Create the element object at index i, not for MIXED.*/
+        ObjectPtr box(size_t i)const;
+    };
+    /**Script array type.
+     *
+     * Elements are kept either as a list of objects (boxed), or just as a PackedNumbers while
+     * every element is an Integer, or every element is a Number. An array created from a vector
+     * of double or long long values is packed, as is one built by push_back from empty while
+     * every value is a number of the same kind.
+     *
+     * sum, min, max, minmax, sort and include? use the packed values directly, with SIMD where
+     * enabled for the build. each, reverse_each, first, last, at, join, inspect, hash,
+     * comparison, + and - create element objects one at a time as they go. Anything else that
+     * needs the list of objects, including get_value and a push_back of any other value, boxes
+     * the array once and drops the packed values. For a boxed array the kernels work on a
+     * temporary scan of the objects, which is not kept.
+     */
     class Array : public Object, public Enumerable
     {
     public:
         typedef std::vector<ObjectPtr> List;
         typedef List::iterator iterator;
 
-        explicit Array() : arr() {}
-        explicit Array(std::vector<ObjectPtr> &&arr) : arr(std::move(arr)) {}
-        explicit Array(const std::vector<ObjectPtr> &arr) : arr(arr) {}
+        explicit Array() : arr(), packed(), boxed(true) {}
+        explicit Array(std::vector<ObjectPtr> &&arr) : arr(std::move(arr)), packed(), boxed(true) {}
+        explicit Array(const std::vector<ObjectPtr> &arr) : arr(arr), packed(), boxed(true) {}
+        /**Array of Number, without creating an object for each value.*/
+        explicit Array(std::vector<double> &&values);
+        /**Array of Integer, without creating an object for each value.*/
+        explicit Array(std::vector<long long> &&values);
 
         static const std::string &name()
         {
@@ -35,20 +81,36 @@ namespace slim
 
         virtual ObjectPtr el_ref(const FunctionArgs &args)override { return slice(args); }
         virtual ObjectPtr add(Object *rhs)override;
+        /**Values not in rhs.*/
         virtual ObjectPtr sub(Object *rhs)override;
+        /**Unique values in both arrays, in the order of this array.*/
+        virtual ObjectPtr bit_and(Object *rhs)override;
+        /**Unique values in either array.*/
+        virtual ObjectPtr bit_or(Object *rhs)override;
 
-        iterator begin() { return arr.begin(); }
-        iterator end() { return arr.end(); }
+        /**Iterate the elements for modification, which boxes the array first.*/
+        iterator begin() { return mutable_list().begin(); }
+        iterator end() { return mutable_list().end(); }
 
-        const std::vector<ObjectPtr>& get_value()const { return arr; }
-
-        void push_back(ObjectPtr obj)
+        /**The element objects, boxing the array first if it is packed.*/
+        const std::vector<ObjectPtr>& get_value()const
         {
-            arr.push_back(obj);
+            if (!boxed.load(std::memory_order_acquire)) box();
+            return arr;
         }
+        /**The elements as packed numbers, or nullptr if any element is not a number.
+         * For a boxed array this scans the objects each time, so get it once per operation.
+         */
+        std::shared_ptr<const PackedNumbers> numbers()const;
+        /**True if the elements are only kept as packed numbers.*/
+        bool is_packed()const { return !boxed.load(std::memory_order_acquire); }
+        /**Number of elements, without creating element objects.*/
+        size_t length()const { return Elements(*this).size(); }
+
+        void push_back(ObjectPtr obj);
         void push_back(Object *obj)
         {
-            arr.push_back(obj->shared_from_this());
+            push_back(obj->shared_from_this());
         }
 
         //[]=. <<
@@ -80,6 +142,9 @@ namespace slim
         std::shared_ptr<String> join(const String *sep);
         //keep_if
         std::shared_ptr<Object> last(const FunctionArgs &args);
+        ObjectPtr max(const FunctionArgs &args);
+        ObjectPtr min(const FunctionArgs &args);
+        ObjectPtr minmax(const FunctionArgs &args);
         /**Also length */
         std::shared_ptr<Number> size();
         //pack
@@ -104,19 +169,57 @@ namespace slim
         std::shared_ptr<Object> slice(const FunctionArgs &args);
         Ptr<Array> sort(const FunctionArgs &args);
         ObjectPtr sort_by(const FunctionArgs &args);
-        //sort_by
+        /**sum(init = 0), adding each element, or the result of the block for each element.*/
+        ObjectPtr sum(const FunctionArgs &args);
         std::shared_ptr<Array> take(const Number *n);
         //take_while
         //to_ary
         //transpose
-        std::shared_ptr<Array> uniq();
+        std::shared_ptr<Array> uniq(const FunctionArgs &args);
         //unshift
         std::shared_ptr<Array> values_at(const FunctionArgs &args);
         //zip
     protected:
         virtual const MethodTable &method_table()const;
     private:
-        List arr;
+        /**Read access to the elements of an array, which stays valid if another thread boxes
+         * the array meanwhile, as it holds its own reference to the packed values.
+         */
+        class Elements
+        {
+        public:
+            explicit Elements(const Array &array);
+            size_t size()const { return values ? values->size() : arr.size(); }
+            /**The element at index i, created from the packed values if there are any.*/
+            ObjectPtr operator [](size_t i)const { return values ? values->box(i) : arr[i]; }
+            /**The packed values, or nullptr if the array is boxed.*/
+            const PackedNumbers *packed()const { return values.get(); }
+            /**See Array::numbers.*/
+            std::shared_ptr<const PackedNumbers> numbers()const;
+        private:
+            const List &arr;
+            std::shared_ptr<const PackedNumbers> values;
+        };
+
+        /**The elements once boxed, else empty.*/
+        mutable List arr;
+        /**The elements until boxed, else nullptr. Accessed with std::atomic_load and
+         * std::atomic_store by const methods, since box clears it.
+         */
+        mutable std::shared_ptr<PackedNumbers> packed;
+        /**Set once arr has the elements, before packed is cleared.*/
+        mutable std::atomic<bool> boxed;
+        /**Held to box the array.*/
+        mutable std::mutex lazy_mutex;
+
+        /**Create arr from packed and drop packed, once.*/
+        void box()const;
+        /**Get arr to modify, boxing the array first.*/
+        List &mutable_list();
+        /**Find the first smallest and largest of nums.
+         * Returns false if any is NaN, or nums is empty.
+         */
+        static bool packed_min_max(const PackedNumbers &nums, size_t *min, size_t *max);
     };
 
     inline std::shared_ptr<Array> make_value(std::vector<ObjectPtr> &&arr)
@@ -135,4 +238,14 @@ namespace slim
     {
         return create_object<Array>(arr);
     }
+    /**Array of Number values, without creating an object for each value.*/
+    inline std::shared_ptr<Array> make_number_array(std::vector<double> &&values)
+    {
+        return create_object<Array>(std::move(values));
+    }
+    /**Array of Integer values, without creating an object for each value.*/
+    inline std::shared_ptr<Array> make_number_array(std::vector<long long> &&values)
+    {
+        return create_object<Array>(std::move(values));
+    }
 }
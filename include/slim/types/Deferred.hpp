@@ -0,0 +1,46 @@
+#pragma once
+#include "Object.hpp"
+#include <functional>
+#include <future>
+namespace slim
+{
+    /**Script Deferred type.
+     *
+     * A value that is still being produced concurrently, such as the result of a request to a
+     * slow service, returned by a C++ method in place of the value itself.
+     *
+     * Outputting a Deferred in a template writes a placeholder and rendering continues, with
+     * the placeholder being replaced by the value once the rest of the render is done. Other
+     * uses, such as conditions and string conversion, wait for the value.
+     */
+    class Deferred : public Object
+    {
+    public:
+        explicit Deferred(std::shared_future<ObjectPtr> future);
+
+        static const std::string &name()
+        {
+            static const std::string TYPE_NAME = "Deferred";
+            return TYPE_NAME;
+        }
+        virtual const std::string& type_name()const override { return name(); }
+
+        virtual std::string to_string()const override;
+        virtual std::string inspect()const override;
+        virtual bool is_true()const override;
+
+        /**Wait for the value, rethrowing any exception from producing it.
+         * If the value is another Deferred, waits for that as well.
+         */
+        ObjectPtr value()const;
+        /**True if the value is available without waiting.*/
+        bool ready_q()const;
+    protected:
+        virtual const MethodTable &method_table()const override;
+    private:
+        std::shared_future<ObjectPtr> future;
+    };
+
+    /**Run func on a new thread, returning a Deferred for its result.*/
+    std::shared_ptr<Deferred> make_deferred(std::function<ObjectPtr()> func);
+}
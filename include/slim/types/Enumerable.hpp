@@ -8,6 +8,7 @@ namespace slim
     class Boolean;
     class Hash;
     class Proc;
+    class Set;
 
     /**Enumerable mixin module.*/
     class Enumerable
@@ -38,15 +39,17 @@ namespace slim
         Ptr<Boolean> all_q(const FunctionArgs &args);
         Ptr<Boolean> any_q(const FunctionArgs &args);
         //chunk
+        /**Arrays of consecutive elements, split between a and b where the block returns false.*/
+        ObjectPtr chunk_while(const FunctionArgs &args);
         //collect_concat (flat_map)
         Ptr<Number> count(const FunctionArgs &args);
         //cycle
         //detect (find)
         Ptr<Array> drop(Number *n);
         ObjectPtr drop_while(const FunctionArgs &args);
-        //each_cons
+        ObjectPtr each_cons(const FunctionArgs &args);
         //each_entry
-        //each_slice
+        ObjectPtr each_slice(const FunctionArgs &args);
         ObjectPtr each_with_index(const FunctionArgs &args);
         //each_with_object
         ObjectPtr find(const FunctionArgs &args);
@@ -74,14 +77,20 @@ namespace slim
         ObjectPtr select(const FunctionArgs &args);
         //slice_after
         //slice_before
-        //slice_when
+        /**Opposite of chunk_while, split between a and b where the block returns true.*/
+        ObjectPtr slice_when(const FunctionArgs &args);
         Ptr<Array> sort(const FunctionArgs &args);
         ObjectPtr sort_by(const FunctionArgs &args);
+        ObjectPtr sum(const FunctionArgs &args);
+        /**Hash of each distinct element to the number of times it occurs.*/
+        Ptr<Hash> tally();
         Ptr<Array> take(Number *n);
         ObjectPtr take_while(const FunctionArgs &args);
         Ptr<Array> to_a(const FunctionArgs &args);
         Ptr<Hash> to_h(const FunctionArgs &args);
-        //zip
+        Ptr<Set> to_set();
+        Ptr<Array> uniq(const FunctionArgs &args);
+        ObjectPtr zip(const FunctionArgs &args);
 
     protected:
         template<class Implementor>
@@ -91,11 +100,14 @@ namespace slim
             {
                 { method<Implementor>(&Enumerable::all_q), "all?" },
                 { method<Implementor>(&Enumerable::any_q), "any?" },
+                { method<Implementor>(&Enumerable::chunk_while), "chunk_while" },
                 { method<Implementor>(&Enumerable::count), "count" },
                 { method<Implementor>(&Enumerable::each), "each" },
                 { method<Implementor>(&Enumerable::map), "collect" },
                 { method<Implementor>(&Enumerable::drop), "drop" },
                 { method<Implementor>(&Enumerable::drop_while), "drop_while" },
+                { method<Implementor>(&Enumerable::each_cons), "each_cons" },
+                { method<Implementor>(&Enumerable::each_slice), "each_slice" },
                 { method<Implementor>(&Enumerable::each_with_index), "each_with_index" },
                 { method<Implementor>(&Enumerable::find), "find" },
                 { method<Implementor>(&Enumerable::find_index), "find_index" },
@@ -120,13 +132,19 @@ namespace slim
                 { method<Implementor>(&Enumerable::reverse_each), "reverse_each" },
                 { method<Implementor>(&Enumerable::select), "find_all" },
                 { method<Implementor>(&Enumerable::select), "select" },
+                { method<Implementor>(&Enumerable::slice_when), "slice_when" },
                 { method<Implementor>(&Enumerable::sort), "sort" },
                 { method<Implementor>(&Enumerable::sort_by), "sort_by" },
+                { method<Implementor>(&Enumerable::sum), "sum" },
+                { method<Implementor>(&Enumerable::tally), "tally" },
                 { method<Implementor>(&Enumerable::take), "take" },
                 { method<Implementor>(&Enumerable::take_while), "take_while" },
                 { method<Implementor>(&Enumerable::to_a), "to_a" },
                 { method<Implementor>(&Enumerable::to_a), "entries" },
-                { method<Implementor>(&Enumerable::to_h), "to_h" }
+                { method<Implementor>(&Enumerable::to_h), "to_h" },
+                { method<Implementor>(&Enumerable::to_set), "to_set" },
+                { method<Implementor>(&Enumerable::uniq), "uniq" },
+                { method<Implementor>(&Enumerable::zip), "zip" }
             };
         }
 
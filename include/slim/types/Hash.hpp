@@ -1,25 +1,224 @@
 #pragma once
 #include "Object.hpp"
 #include "Enumerable.hpp"
+#include <atomic>
 #include <vector>
+#include <memory>
+#include <mutex>
 #include <cassert>
+#include <cstdint>
 namespace slim
 {
     class Array;
     class Boolean;
     class Number;
     class String;
-    /**Script Hash type.*/
+
+    /**The layout of a Hash with only symbol keys (a "hidden class").
+     *
+     * Hashes built by adding the same symbol keys in the same order share a single shape, and
+     * store just their values in a flat array, indexed by the slot of each key in the shape.
+     *
+     * Shapes are interned in a tree of transitions from the empty root shape, and like symbols
+     * are never freed. The keys of a shape never change, adding a transition is thread safe,
+     * and finding an existing transition does not lock.
+     */
+    class HashShape
+    {
+    public:
+        enum : size_t
+        {
+            /**Hashes with more keys than this use a table.*/
+            MAX_KEYS = 32,
+            /**Limit on the shapes directly derived from a single shape, to limit the memory
+             * used for hashes with many different keys.
+             */
+            MAX_TRANSITIONS = 64,
+            NOT_FOUND = (size_t)-1
+        };
+
+        /**The shape with no keys.*/
+        static const HashShape *root();
+
+        /**Unique non-zero identifier, for use in inline caches.*/
+        uint32_t id()const { return _id; }
+        size_t size()const { return keys.size(); }
+        const SymPtr &key(size_t slot)const { return keys[slot]; }
+        /**Get the slot for key, or NOT_FOUND.*/
+        size_t find(const Symbol *key)const
+        {
+            for (size_t i = 0; i < keys.size(); ++i)
+            {
+                if (keys[i].get() == key) return i;
+            }
+            return NOT_FOUND;
+        }
+        /**Get the shape with key added after the existing keys, which must not contain key.
+         * Returns nullptr if a limit would be exceeded.
+         */
+        const HashShape *add(const SymPtr &key)const;
+    private:
+        HashShape(uint32_t id, std::vector<SymPtr> &&keys, const HashShape *next_transition);
+        ~HashShape();
+        HashShape(const HashShape&) = delete;
+        HashShape& operator = (const HashShape&) = delete;
+
+        uint32_t _id;
+        std::vector<SymPtr> keys;
+        /**Held to add a transition.*/
+        mutable std::mutex mutex;
+        /**The most recently added transition, or nullptr. Owned, along with the rest of the
+         * list through next_transition. A shape is complete before it is stored here, so the
+         * list can be searched without the lock.
+         */
+        mutable std::atomic<const HashShape*> transitions;
+        /**Number of shapes in transitions, only used with mutex held.*/
+        mutable size_t transition_count;
+        /**The transition from the same shape that was added before this one, or nullptr.*/
+        const HashShape *next_transition;
+    };
+
+    /**Script Hash type.
+     *
+     * Hashes with only symbol keys are stored as a HashShape and an array of values, switching
+     * to an ObjectMap table once any other key is added or the shape limits are exceeded.
+     *
+     * The entries are kept in a Storage behind a shared pointer, and dup and merge never modify
+     * the source hash, so they are safe while other threads read it. A small dup just shares the
+     * Storage, which is copied by whichever hash next modifies it. A larger source becomes the
+     * shared immutable base of the result, which stores just its own added or replaced entries
+     * (the overlay), so for example adding a couple of locals to a large hash for a partial does
+     * not copy it. Should the source itself be modified later, it first copies its Storage.
+     * A base is always the Storage of a hash without a base of its own, keeping lookups to at
+     * most two levels.
+     */
     class Hash : public Object, public Enumerable
     {
     public:
-        typedef std::vector<std::pair<ObjectPtr, ObjectPtr>> List;
-        typedef List::iterator const_iterator;
+        typedef std::pair<ObjectPtr, ObjectPtr> value_type;
+    private:
+        /**A set of entries, either of a single hash or the shared base of several.*/
+        struct Storage
+        {
+            Storage() : shape(HashShape::root()), slots(), map() {}
+
+            /**Key layout when only using symbol keys, else nullptr.*/
+            const HashShape *shape;
+            /**Value for each key of shape.*/
+            std::vector<ObjectPtr> slots;
+            /**Insertion ordered key-value pairs when not using a shape.*/
+            ObjectMap map;
+
+            /**Shared storage with no entries, for hashes that have not stored any.*/
+            static const Storage &empty();
+            size_t size()const { return shape ? slots.size() : map.size(); }
+            /**Pointer to the value for key, or nullptr.*/
+            const ObjectPtr *find(const ObjectPtr &key)const;
+            void set(const ObjectPtr &key, const ObjectPtr &val);
+            /**Switch from shape and slots to map.*/
+            void convert_to_table();
+        };
+        /**Iterates the entries of a Storage.*/
+        class flat_iterator
+        {
+        public:
+            flat_iterator() : storage(nullptr), slot(0), it(), kv() {}
+            flat_iterator(const Storage *storage, size_t slot, ObjectMap::const_iterator it)
+                : storage(storage), slot(slot), it(it), kv()
+            {}
+
+            const value_type &operator *()const
+            {
+                if (!storage->shape) return *it;
+                kv.first = storage->shape->key(slot);
+                kv.second = storage->slots[slot];
+                return kv;
+            }
+            const value_type *operator ->()const { return &**this; }
+            flat_iterator& operator ++()
+            {
+                if (storage->shape) ++slot;
+                else ++it;
+                return *this;
+            }
+            bool operator == (const flat_iterator &rhs)const
+            {
+                return storage == rhs.storage && slot == rhs.slot && it == rhs.it;
+            }
+            bool operator != (const flat_iterator &rhs)const { return !(*this == rhs); }
+        private:
+            const Storage *storage;
+            size_t slot;
+            ObjectMap::const_iterator it;
+            /**The current pair when using a shape.*/
+            mutable value_type kv;
+        };
+    public:
+        /**Iterates the key-value pairs in insertion order.
+         * With a base, that is the base keys (with overlay values), then the keys added by the
+         * overlay.
+         */
+        class const_iterator
+        {
+        public:
+            typedef std::forward_iterator_tag iterator_category;
+            typedef Hash::value_type value_type;
+            typedef std::ptrdiff_t difference_type;
+            typedef const value_type *pointer;
+            typedef const value_type &reference;
+
+            const value_type &operator *()const
+            {
+                if (!in_base) return *it;
+                kv.first = it->first;
+                auto val = hash->own().find(kv.first);
+                kv.second = val ? *val : it->second;
+                return kv;
+            }
+            const value_type *operator ->()const { return &**this; }
+            const_iterator& operator ++()
+            {
+                ++it;
+                settle();
+                return *this;
+            }
+            bool operator == (const const_iterator &rhs)const
+            {
+                return in_base == rhs.in_base && it == rhs.it;
+            }
+            bool operator != (const const_iterator &rhs)const { return !(*this == rhs); }
+        private:
+            friend class Hash;
+            const Hash *hash;
+            bool in_base;
+            flat_iterator it;
+            /**The current pair when it is not stored directly.*/
+            mutable value_type kv;
+
+            const_iterator(const Hash *hash, bool in_base, flat_iterator it)
+                : hash(hash), in_base(in_base), it(it), kv()
+            {
+                settle();
+            }
+            /**Move from the base to the overlay, and skip overlay keys that replaced base values.*/
+            void settle()
+            {
+                if (in_base && it == flat_end(*hash->base))
+                {
+                    in_base = false;
+                    it = flat_begin(hash->own());
+                }
+                if (!in_base && hash->base)
+                {
+                    auto own_end = flat_end(hash->own());
+                    while (it != own_end && hash->base->find(it->first)) ++it;
+                }
+            }
+        };
 
         Hash();
-        Hash(ObjectPtr def_value)
-            : def_value(), map(), list()
-        {}
+        Hash(ObjectPtr def_value);
+        ~Hash();
 
         static const std::string &name()
         {
@@ -37,10 +236,14 @@ namespace slim
 
         virtual ObjectPtr this_obj()override { return shared_from_this(); }
 
-        const_iterator begin() { return list.begin(); }
-        const_iterator end() { return list.end(); }
+        const_iterator begin()const
+        {
+            return base ? const_iterator(this, true, flat_begin(*base)) : const_iterator(this, false, flat_begin(own()));
+        }
+        const_iterator end()const { return const_iterator(this, false, flat_end(own())); }
 
         ObjectPtr get(ObjectPtr key);
+        /**Set the value for a key.*/
         void set(ObjectPtr key, ObjectPtr val);
         /**Gets a value by key if it exists, else creates a new blank one with
          * create_object.
@@ -49,15 +252,28 @@ namespace slim
         template<class T>
         ObjectPtr get_or_create(ObjectPtr key)
         {
-            auto x = map.emplace(key, list.size());
-            if (x.second)
-            {
-                auto created = create_object<T>();
-                list.emplace_back(key, created);
-                return created;
-            }
-            else return list[x.first->second].second;
+            if (auto val = find_value(key)) return *val;
+            auto created = create_object<T>();
+            set(key, created);
+            return created;
+        }
+
+        /**The shape if this hash only has symbol keys, and either has no base or has not
+         * modified its base, else nullptr.
+         */
+        const HashShape *get_shape()const
+        {
+            if (!base) return own().shape;
+            return own_count() == 0 ? base->shape : nullptr;
+        }
+        /**The value for a slot of get_shape(). Used by inline caches.*/
+        const ObjectPtr &get_slot(size_t slot)const
+        {
+            auto &flat = base ? *base : own();
+            assert(flat.shape && slot < flat.slots.size());
+            return flat.slots[slot];
         }
+        const ObjectPtr &get_default()const { return def_value; }
 
         //TODO: Needs some more thought (e.g. string vs symbol keys)
         /**C++ convinence function for "self.fetch(key, default).to_s" expression.*/
@@ -106,11 +322,44 @@ namespace slim
     protected:
         virtual const MethodTable &method_table()const;
     private:
-        typedef std::unordered_map<ObjectPtr, size_t, ObjHash, ObjEquals> Map;
+        /**Hashes smaller than this are copied rather than shared by dup and merge.*/
+        static const size_t MIN_SHARED_SIZE = 8;
 
         ObjectPtr def_value;
-        Map map;
-        List list;
+        /**The entries stored in this hash, or nullptr if there are none yet. May be shared
+         * with other hashes, as their Storage or base, in which case it is copied before
+         * modifying it.
+         */
+        std::shared_ptr<Storage> entries;
+        /**Shared immutable entries that are not in this hash, or nullptr.*/
+        std::shared_ptr<const Storage> base;
+        /**Number of keys stored in this hash that are not in base.*/
+        size_t added;
+
+        static flat_iterator flat_begin(const Storage &storage)
+        {
+            return flat_iterator(&storage, 0, storage.map.begin());
+        }
+        static flat_iterator flat_end(const Storage &storage)
+        {
+            return flat_iterator(&storage, storage.slots.size(), storage.map.end());
+        }
+
+        /**The entries stored in this hash, not including base.*/
+        const Storage &own()const { return entries ? *entries : Storage::empty(); }
+        /**own() to modify, first copying it if it is shared.*/
+        Storage &mutable_own();
+        /**Pointer to the value for key, or nullptr.*/
+        const ObjectPtr *find_value(const ObjectPtr &key)const;
+        /**Number of entries stored in this hash, not including base.*/
+        size_t own_count()const { return own().size(); }
+        size_t count()const { return base ? base->size() + added : own_count(); }
+        /**Create a hash with the same entries, sharing the Storage of this one without
+         * modifying it.
+         */
+        std::shared_ptr<Hash> share()const;
+        /**Copy the base entries into this hash, and remove the base.*/
+        void detach_base();
     };
 
     inline std::shared_ptr<Hash> make_hash(const std::vector<ObjectPtr> &arr)
@@ -1,11 +1,12 @@
 #pragma once
 #include "Object.hpp"
+#include <typeinfo>
 namespace slim
 {
     class Boolean;
     /**Number script type.
-     * Currently this is the only numeric type, taking the place of Ruby Numeric class and all its
-     * subtypes. The number is stored as a double.
+     * Takes the place of the Ruby Numeric class and its subtypes other than Integer. The number
+     * is stored as a double.
      */
     class Number : public Object
     {
@@ -96,12 +97,73 @@ namespace slim
         double v;
     };
 
+    /**Integer script type, an exact 64 bit integer.
+     *
+     * Integer literals, sizes, counts and indices are Integer. Integer is a Number, with the
+     * double value also set, so anything accepting a Number also accepts an Integer, and an
+     * Integer is equal to a Number with the same value.
+     *
+     * Arithmetic between two Integer values is done with 64 bit integers. If the result
+     * overflows, or is not a whole number such as "7 / 2", it is a Number instead.
+     */
+    class Integer : public Number
+    {
+    public:
+        explicit Integer(long long i) : Number((double)i), i(i) {}
+
+        static const std::string &name()
+        {
+            static const std::string TYPE_NAME = "Integer";
+            return TYPE_NAME;
+        }
+        virtual const std::string& type_name()const override { return name(); }
+        virtual std::string to_string()const override { return std::to_string(i); }
+        virtual bool eq(const Object *rhs)const override
+        {
+            if (typeid(*rhs) == typeid(Integer)) return i == ((const Integer*)rhs)->i;
+            else return Number::eq(rhs);
+        }
+        virtual int cmp(const Object *rhs)const override
+        {
+            if (typeid(*rhs) != typeid(Integer)) return Number::cmp(rhs);
+            long long i2 = ((const Integer*)rhs)->i;
+            if (i < i2) return -1;
+            if (i > i2) return 1;
+            else return 0;
+        }
+        long long get_int()const { return i; }
+
+        //operators
+        virtual ObjectPtr mul(Object *rhs)override;
+        virtual ObjectPtr div(Object *rhs)override;
+        virtual ObjectPtr mod(Object *rhs)override;
+        virtual ObjectPtr pow(Object *rhs)override;
+        virtual ObjectPtr add(Object *rhs)override;
+        virtual ObjectPtr sub(Object *rhs)override;
+        virtual ObjectPtr negate()override;
+
+        std::shared_ptr<Number> to_f();
+        std::shared_ptr<Number> to_i();
+        std::shared_ptr<Number> abs();
+        std::shared_ptr<Number> round(const FunctionArgs &args);
+    protected:
+        virtual const MethodTable &method_table()const;
+    private:
+        long long i;
+    };
+
     inline std::shared_ptr<Number> make_value(double v)
     {
         return create_object<Number>(v);
     }
-    std::shared_ptr<Number> make_value(int v);
-    std::shared_ptr<Number> make_value(unsigned v);
-    std::shared_ptr<Number> make_value(long long v);
+    std::shared_ptr<Integer> make_value(int v);
+    std::shared_ptr<Integer> make_value(unsigned v);
+    std::shared_ptr<Integer> make_value(long v);
+    std::shared_ptr<Integer> make_value(long long v);
+    /**An Integer, or a Number if v is too large.*/
+    std::shared_ptr<Number> make_value(unsigned long v);
+    /**An Integer, or a Number if v is too large.*/
     std::shared_ptr<Number> make_value(unsigned long long v);
+    /**An Integer if v is a whole number in range, else a Number.*/
+    std::shared_ptr<Number> make_integral(double v);
 }
@@ -1,9 +1,11 @@
 #pragma once
+#include <functional>
 #include <memory>
 #include <string>
 #include <vector>
-#include <unordered_map>
+#include <unordered_set>
 #include "../Error.hpp"
+#include "../OrderedMap.hpp"
 #include "../Operators.hpp"
 namespace slim
 {
@@ -205,7 +207,18 @@ namespace slim
         size_t operator()(const Object *obj)const { return obj->hash(); }
         size_t operator()(const ObjectPtr &obj)const { return obj->hash(); }
     };
-    typedef std::unordered_map<ObjectPtr, ObjectPtr, ObjHash, ObjEquals> ObjectMap;
+    /**Hash for containers that only hold symbols. Symbols are unique so this uses identity.*/
+    struct SymHash
+    {
+        size_t operator()(const SymPtr &sym)const { return std::hash<const Symbol*>()(sym.get()); }
+    };
+    /**Equality for containers that only hold symbols. See SymHash.*/
+    struct SymEquals
+    {
+        bool operator()(const SymPtr &lhs, const SymPtr &rhs)const { return lhs == rhs; }
+    };
+    typedef OrderedMap<ObjectPtr, ObjectPtr, ObjHash, ObjEquals> ObjectMap;
+    typedef std::unordered_set<ObjectPtr, ObjHash, ObjEquals> ObjectSet;
 }
 namespace std
 {
@@ -49,5 +49,10 @@ namespace slim
     private:
         double _begin, _end;
         bool exclude_end;
+        /**If begin and end were Integer values.*/
+        bool int_begin, int_end;
+
+        /**Make an element value, an Integer if begin was.*/
+        Ptr<Number> value(double x, bool integer)const;
     };
 }
@@ -1,7 +1,10 @@
 #pragma once
 #include "Object.hpp"
 #include "Type.hpp"
+#include "../StringView.hpp"
 #include <regex>
+#include <list>
+#include <mutex>
 #include <unordered_map>
 #include <vector>
 #include <cassert>
@@ -11,6 +14,10 @@ namespace slim
     class Number;
     class String;
     class Regexp;
+    namespace regex
+    {
+        class Program;
+    }
     /**MatchData for Regexp.*/
     class MatchData : public Object
     {
@@ -44,17 +51,26 @@ namespace slim
     private:
         friend class Regexp;
         Ptr<Regexp> regex;
-        std::string str;
-        std::smatch match;
+        /**The subject, sharing the bytes of the searched string where possible.
+         * Substrings of the match are slices of this.
+         */
+        Ptr<String> str;
+        /**The match and then each capture group, null for groups that did not match.*/
+        std::vector<StringView> groups;
 
-        MatchData(Ptr<Regexp> regex, const std::string &str)
-            : regex(regex), str(str), match()
+        MatchData(Ptr<Regexp> regex, Ptr<String> str)
+            : regex(regex), str(str), groups()
         {}
-        std::ssub_match get_sub(Number *n)const;
+        StringView get_sub(Number *n)const;
+        size_t offset_of(StringView sub)const;
         Ptr<Object> sub_str(int n)const;
     };
 
-    /**Script Regexp using std::regex.*/
+    /**Script Regexp.
+     *
+     * Patterns are compiled for the linear time regex::Program engine, and only use std::regex
+     * (ECMAScript syntax) if they use features that engine does not support.
+     */
     class Regexp : public Object
     {
     public:
@@ -84,19 +100,17 @@ namespace slim
         virtual size_t hash()const override;
         //unary ~
 
-        const std::regex& get()const { return regex; }
-        /**Returns nullptr rather than NIL_VALUE*/
-        Ptr<MatchData> do_match(const std::string &str, int pos);
-        /**Search from the end of str.
-         * Note that this creates a temp regex.
-         * Also note that all capture groups are +1. As such this does not conform with MatchData
-         * so the plain std::smatch is returned instead.
+        /**The whole match followed by each capture group.
+         * Groups that did not participate in the match have a null data().
          */
-        std::smatch do_rmatch(const std::string &str, int pos);
-        std::smatch do_rmatch(const std::string &str)
-        {
-            return do_rmatch(str, (int)str.size());
-        }
+        typedef std::vector<StringView> Groups;
+
+        /**Find the first match in str starting at or after pos.*/
+        bool search(StringView str, size_t pos, Groups *groups)const;
+        /**Find the match in str that starts last, which must end within str.*/
+        bool search_last(StringView str, Groups *groups)const;
+        /**Returns nullptr rather than NIL_VALUE*/
+        Ptr<MatchData> do_match(const String *str, int pos);
         virtual Ptr<Object> match(const FunctionArgs &args);
 
         Ptr<Boolean> casefold_q();
@@ -113,7 +127,59 @@ namespace slim
         static std::regex_constants::syntax_option_type syntax_options(int opts);
         std::string src;
         int opts;
-        std::regex regex;
+        std::shared_ptr<const regex::Program> program;
+        /**Used if program is null.*/
+        std::shared_ptr<const std::regex> fallback;
+    };
+
+    /**Thread safe, bounded cache of compiled Regexp objects by source and options, discarding
+     * the least recently used.
+     *
+     * Used for patterns only known at runtime, such as interpolated regex literals and string
+     * patterns, so that evaluating the same pattern repeatedly does not compile it each time.
+     * Regexp objects are immutable, so a cached object is shared by every user.
+     */
+    class RegexpCache
+    {
+    public:
+        static const size_t DEFAULT_CAPACITY = 256;
+
+        /**The cache shared by the script types.*/
+        static RegexpCache &instance();
+
+        explicit RegexpCache(size_t capacity = DEFAULT_CAPACITY);
+
+        /**Get the Regexp for src and opts, compiling it if not already cached.*/
+        Ptr<Regexp> get(const std::string &src, int opts = 0);
+
+        size_t size()const;
+        size_t capacity()const { return max_size; }
+        /**Number of get calls that found an existing Regexp.*/
+        size_t hits()const;
+        /**Number of get calls that had to compile.*/
+        size_t misses()const;
+        /**Remove all entries and reset the counters.*/
+        void clear();
+    private:
+        typedef std::pair<std::string, int> Key;
+        struct KeyHash
+        {
+            size_t operator()(const Key &key)const
+            {
+                size_t h = 0;
+                detail::hash_combine(h, key.first);
+                detail::hash_combine(h, key.second);
+                return h;
+            }
+        };
+        typedef std::list<std::pair<Key, Ptr<Regexp>>> Entries;
+
+        mutable std::mutex mutex;
+        size_t max_size;
+        /**Most recently used first.*/
+        Entries entries;
+        std::unordered_map<Key, Entries::iterator, KeyHash> index;
+        size_t hit_count, miss_count;
     };
 
     class RegexpType : public SimpleClass<Regexp>
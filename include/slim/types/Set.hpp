@@ -0,0 +1,109 @@
+#pragma once
+#include "Object.hpp"
+#include "Enumerable.hpp"
+#include "Type.hpp"
+#include <vector>
+namespace slim
+{
+    class Array;
+    class Boolean;
+    class Number;
+    /**Script Set type.
+     *
+     * An immutable collection of unique values, compared using eq and hash like Hash keys.
+     * Iteration order is the order in which each unique value was first added.
+     */
+    class Set : public Object, public Enumerable
+    {
+    public:
+        typedef std::vector<ObjectPtr> List;
+        typedef List::const_iterator const_iterator;
+
+        Set() : list(), set() {}
+        /**Creates a set of the unique values in values.*/
+        explicit Set(const std::vector<ObjectPtr> &values);
+
+        /**Set.new, Set.new(enum).*/
+        static Ptr<Set> new_instance(const FunctionArgs &args);
+        /**Creates a set from an Array, Set or other Enumerable object.*/
+        static Ptr<Set> create_from(Object *enumerable);
+
+        static const std::string &name()
+        {
+            static const std::string TYPE_NAME = "Set";
+            return TYPE_NAME;
+        }
+        virtual const std::string& type_name()const override { return name(); }
+
+        virtual ObjectPtr this_obj()override { return shared_from_this(); }
+
+        virtual std::string to_string()const override { return inspect(); }
+        virtual std::string inspect()const override;
+        virtual bool eq(const Object *rhs)const override;
+        virtual size_t hash()const override;
+
+        /**Union.*/
+        virtual ObjectPtr add(Object *rhs)override { return set_union(rhs); }
+        /**Difference.*/
+        virtual ObjectPtr sub(Object *rhs)override { return difference(rhs); }
+        /**Intersection.*/
+        virtual ObjectPtr bit_and(Object *rhs)override { return intersection(rhs); }
+        /**Union.*/
+        virtual ObjectPtr bit_or(Object *rhs)override { return set_union(rhs); }
+        /**Values in this set or rhs, but not both.*/
+        virtual ObjectPtr bit_xor(Object *rhs)override;
+
+        const_iterator begin()const { return list.begin(); }
+        const_iterator end()const { return list.end(); }
+        const std::vector<ObjectPtr>& get_value()const { return list; }
+
+        /**O(1) membership test.*/
+        bool contains(const ObjectPtr &obj)const
+        {
+            return set.count(obj) != 0;
+        }
+
+        Ptr<Set> difference(Object *enumerable);
+        Ptr<Boolean> disjoint_q(Object *enumerable);
+        virtual ObjectPtr each(const FunctionArgs &args)override;
+        Ptr<Boolean> empty_q();
+        Ptr<Boolean> include_q(Object *obj);
+        Ptr<Set> intersection(Object *enumerable);
+        Ptr<Boolean> intersect_q(Object *enumerable);
+        Ptr<Boolean> proper_subset_q(Set *other);
+        Ptr<Boolean> proper_superset_q(Set *other);
+        /**Also length*/
+        Ptr<Number> size();
+        Ptr<Boolean> subset_q(Set *other);
+        Ptr<Boolean> superset_q(Set *other);
+        Ptr<Array> to_a();
+        Ptr<Set> to_set();
+        /**"union" is a C++ keyword.*/
+        Ptr<Set> set_union(Object *enumerable);
+    protected:
+        virtual const MethodTable &method_table()const;
+    private:
+        List list;
+        ObjectSet set;
+
+        /**Adds obj if it is not already in the set.*/
+        void insert(const ObjectPtr &obj)
+        {
+            if (set.insert(obj).second) list.push_back(obj);
+        }
+        /**Ensure other has a hash table to use for membership tests.*/
+        static Ptr<Set> as_set(Object *enumerable);
+    };
+
+    /**The "Set" class object. Provides "new" and "Set[values...]".*/
+    class SetType : public SimpleClass<Set>
+    {
+    public:
+        virtual ObjectPtr el_ref(const FunctionArgs &args)override;
+    };
+
+    inline Ptr<Set> make_set(const std::vector<ObjectPtr> &values)
+    {
+        return create_object<Set>(values);
+    }
+}
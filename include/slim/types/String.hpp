@@ -1,17 +1,67 @@
 #pragma once
 #include "Object.hpp"
+#include "../StringView.hpp"
+#include <atomic>
+#include <deque>
+#include <mutex>
 namespace slim
 {
     class Array;
     class Boolean;
     class Number;
-    /**String script object.*/
+    class String;
+    /**The parts joined by String::add, see String.
+     *
+     * The parts are never ropes themselves, so flattening and destroying a rope do not recurse.
+     * Each String for the rope uses a range of the parts, numbered from first for parts.front().
+     * Adding to the front makes first negative.
+     */
+    struct StringRope
+    {
+        StringRope() : first(0) {}
+        std::mutex mutex;
+        std::deque<std::shared_ptr<const String>> parts;
+        ptrdiff_t first;
+    };
+    /**String script object.
+     *
+     * Larger strings keep their bytes in a shared immutable buffer, and substrings such as those
+     * from split, strip or a regex capture reference a range of that buffer rather than copying.
+     * Short substrings are still copied, since that is cheaper than sharing and avoids keeping a
+     * large buffer alive for a few bytes.
+     *
+     * get_mutable_value() makes a private copy of a shared buffer first (copy on write).
+     *
+     * Concatenating longer strings with add creates a rope, a list of the parts, which is only
+     * flattened into a contiguous string when it is first viewed. Adding to a String that ends at
+     * the end of the list appends to the same list, and adding in front of one that starts at the
+     * front prepends, so building a string with "out = out + x" or "out = x + out" in a loop is
+     * linear rather than quadratic. Otherwise the parts of both sides are copied to a new rope.
+     *
+     * Whether the string is ASCII or valid UTF-8, and its number of code points, are found in a
+     * single scan the first time any of them is needed and then cached until it is modified.
+     * For long non-ASCII strings, char_offset also builds a sparse index of code point offsets.
+     */
     class String : public Object
     {
     public:
-        explicit String(std::string &&v) : v(std::move(v)) {}
-        explicit String(const std::string &v) : v(v) {}
-        explicit String() : v() {}
+        explicit String(std::string &&v);
+        explicit String(const std::string &v);
+        explicit String()
+            : v(), buf(), off(0), len(0), rope(), rope_begin(0), rope_end(0), text_flags(0), text_length(0)
+        {}
+        /**Reference length bytes from offset in buffer, without copying.*/
+        String(std::shared_ptr<const std::string> buffer, size_t offset, size_t length)
+            : v(), buf(std::move(buffer)), off(offset), len(length), rope(), rope_begin(0), rope_end(0)
+            , text_flags(0), text_length(0)
+        {
+            assert(offset + length <= buf->size());
+        }
+        /**Concatenation of the parts of rope from begin to end, which are length bytes in total.*/
+        String(std::shared_ptr<StringRope> rope, ptrdiff_t begin, ptrdiff_t end, size_t length)
+            : v(), buf(), off(0), len(length), rope(std::move(rope)), rope_begin(begin), rope_end(end)
+            , text_flags(0), text_length(0)
+        {}
 
         static const std::string &name()
         {
@@ -19,7 +69,7 @@ namespace slim
             return TYPE_NAME;
         }
         virtual const std::string& type_name()const override { return name(); }
-        virtual std::string to_string()const override { return v; }
+        virtual std::string to_string()const override { return view().str(); }
         virtual std::string inspect()const override;
         virtual std::shared_ptr<String> to_string_obj()override
         {
@@ -27,18 +77,63 @@ namespace slim
         }
         virtual bool eq(const Object *rhs)const override
         {
-            return v == ((const String*)rhs)->v;
+            return view() == ((const String*)rhs)->view();
         }
-        virtual size_t hash()const { return detail::hash(v); }
+        virtual size_t hash()const override;
         virtual int cmp(const Object *rhs)const override
         {
-            return v.compare(((const String*)rhs)->v);
+            return view().compare(((const String*)rhs)->view());
+        }
+        /**The bytes of this string, valid until it is modified.*/
+        StringView view()const
+        {
+            if (rope) flatten_rope();
+            return buf ? StringView(buf->data() + off, len) : StringView(v);
+        }
+        /**Length in bytes, without flattening a rope.*/
+        size_t byte_size()const
+        {
+            return buf || rope ? len : v.size();
         }
-        std::string& get_value() { return v; }
-        const std::string& get_value()const { return v; }
+        /**Get the value as a std::string.
+         * For a substring of a shared buffer this makes a copy the first time it is called.
+         */
+        const std::string& get_value()const;
+        /**Get the value for modification, first copying any shared buffer.
+         * Invalidates previous views and get_value references, and the cached is_ascii,
+         * is_valid_utf8 and char_length results.
+         */
+        std::string& get_mutable_value();
+        /**Create a String for a range of view(), sharing the buffer if worthwhile.*/
+        std::shared_ptr<String> slice(StringView part)const;
+        std::shared_ptr<String> substr(size_t pos, size_t count = StringView::npos)const
+        {
+            return slice(view().substr(pos, count));
+        }
+        /**True if every byte is in the range 0 to 127.*/
+        bool is_ascii()const { return (text_info() & TEXT_ASCII) != 0; }
+        /**True if the bytes are well formed UTF-8.*/
+        bool is_valid_utf8()const { return (text_info() & TEXT_VALID) != 0; }
+        /**Number of code points. For invalid UTF-8 this counts the leading elements.*/
+        size_t char_length()const
+        {
+            text_info();
+            return text_length.load(std::memory_order_relaxed);
+        }
+        /**Byte offset of the code point at index, view().size() for char_length(), else npos.
+         * Constant time for ASCII strings, and at most CHAR_INDEX_STEP code points are walked
+         * for others.
+         */
+        size_t char_offset(size_t index)const;
+        /**Like substr, but pos and count are in code points.
+         * Returns nullptr if pos is past the end, as Ruby gives nil.
+         */
+        std::shared_ptr<String> char_substr(size_t pos, size_t count = StringView::npos)const;
 
         virtual ObjectPtr add(Object *rhs);
-        //% * << =~
+        /**Same as add, since strings are not modified.*/
+        virtual ObjectPtr bit_lshift(Object *rhs)override { return add(rhs); }
+        //% * =~
         virtual ObjectPtr el_ref(const FunctionArgs &args)override;
 
         std::shared_ptr<Number> to_f();
@@ -73,7 +168,8 @@ namespace slim
         //chomp!
         //chop!
         //clear
-        //concat
+        /**Add each argument, returning a new string.*/
+        ObjectPtr concat(const FunctionArgs &args);
         //count
         //crypt
         //Ptr<String> delete
@@ -137,18 +233,59 @@ namespace slim
         std::shared_ptr<String> upcase();
         //upcase!
         //upto
-        //valid_encoding?
+        std::shared_ptr<Boolean> valid_encoding_q();
 
     protected:
         virtual const MethodTable &method_table()const;
     private:
-        std::string v;
+        /**Strings at least this long are stored in a shared buffer.*/
+        static const size_t MIN_SHARED_SIZE = 64;
+        /**Substrings shorter than this are copied rather than shared.*/
+        static const size_t MIN_SLICE_SIZE = 16;
+        /**add results at least this long are made as a rope.*/
+        static const size_t MIN_ROPE_SIZE = 256;
+        /**Code points between each char_index entry.*/
+        static const size_t CHAR_INDEX_STEP = 64;
+        /**text_flags bits.*/
+        enum TextFlags : unsigned
+        {
+            TEXT_SCANNED = 1,
+            TEXT_ASCII = 2,
+            TEXT_VALID = 4
+        };
+
+        /**The bytes when buf and rope are null, else a copy made by get_value or flatten_rope.*/
+        mutable std::string v;
+        /**Shared immutable bytes, or nullptr.*/
+        std::shared_ptr<const std::string> buf;
+        /**Range of buf used by this string, or the length of the rope.*/
+        size_t off, len;
+        /**Rope to flatten into v, or nullptr. This string is the parts from rope_begin to rope_end.*/
+        std::shared_ptr<StringRope> rope;
+        ptrdiff_t rope_begin, rope_end;
+        mutable std::once_flag flat_once;
+        /**TextFlags from utf8_scan, or 0 if not yet scanned. text_length is set first.*/
+        mutable std::atomic<unsigned> text_flags;
+        mutable std::atomic<size_t> text_length;
+        /**Byte offset of every CHAR_INDEX_STEP'th code point, built by char_offset and accessed
+         * with std::atomic_load and std::atomic_store.
+         */
+        mutable std::shared_ptr<const std::vector<size_t>> char_index;
+
+        /**Fill v from rope, once.*/
+        void flatten_rope()const;
+        /**Append the rope parts of this string to out, or this string itself if it is not a rope.*/
+        void get_rope_parts(std::vector<std::shared_ptr<const String>> &out)const;
+        /**Get text_flags, scanning the bytes if needed.*/
+        unsigned text_info()const;
+        /**Set the cached results for a known ASCII string.*/
+        void set_ascii()const;
 
         std::shared_ptr<Array> do_partition(bool reverse, Object *sep);
         ObjectPtr do_slice(int start, int length);
         Ptr<String> do_sub(const FunctionArgs &args, bool global);
-        std::vector<std::string> split_lines()const;
-        std::vector<std::string> split_lines(const std::string &sep)const;
+        std::vector<StringView> split_lines()const;
+        std::vector<StringView> split_lines(StringView sep)const;
     };
     typedef std::shared_ptr<String> StringPtr;
 
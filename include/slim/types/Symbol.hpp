@@ -43,6 +43,8 @@ namespace slim
         virtual bool eq(const Object *rhs)const override { return this == rhs; }
         virtual size_t hash()const override;
         virtual int cmp(const Object *rhs)const override;
+        /**Returns the symbol name without copying it.*/
+        virtual std::shared_ptr<String> to_string_obj()override { return _str; }
 
         const std::shared_ptr<String> &str_obj()const { return _str; }
         const std::string &str()const;
@@ -4,6 +4,7 @@
 #include "types/Number.hpp"
 #include "types/String.hpp"
 #include "FunctionHelpers.hpp"
+#include <cstring>
 
 namespace slim
 {
@@ -305,58 +306,14 @@ namespace slim
             default: return false;
             }
         }
-        /**threadsafe, locale and timezone independent version of time.h strftime with Ruby strftime extensions
-         * http://ruby-doc.org/core-2.2.0/Time.html#method-i-strftime
-         *
-         * - '#' flag (change case) is not supported.
-         * - week numbers are not supported
-         * - '%::z' is not supported ('%:z' is)
-         * - Padding is limited to 99, restricting the possible size of the output relative to the format string.
-         */
-        std::string strftime(time_t t, const tm &tm, const std::string &fmt)
+        /**True if fmt_token will accept the conversion.*/
+        bool is_conversion(const Format &fmt, char conversion)
         {
-            std::string out;
-            out.reserve(fmt.size() * 2);
-            size_t i = 0;
-
-            for (i = 0; i < fmt.size();)
-            {
-                if (fmt[i] == '%')
-                {
-                    if (i + 1 == fmt.size())
-                    {
-                        out += '%';
-                        break;
-                    }
-
-                    auto c2 = fmt[i + 1];
-                    if (c2 == 'n' || c2 == 't' || c2 == '%')
-                    {
-                        i += 2;
-                        if (c2 == 'n') out += '\n';
-                        if (c2 == 't') out += '\t';
-                        if (c2 == '%') out += '%';
-                        continue;
-                    }
-
-                    auto j = ++i;
-                    //<flags><width><modifier>
-                    Format token_fmt;
-                    token_fmt.parse(fmt, &j);
-
-                    if (j == fmt.size()) continue;
-
-                    auto conversion = fmt[j++];
-                    if (fmt_token(&out, t, tm, token_fmt, conversion))
-                        i = j;
-                    else out += '%';
-                }
-                else out += fmt[i++];
-            }
-            return out;
+            if (conversion == 'z') return true;
+            if (fmt.flags.colon_tz) return false;
+            return conversion != '\0' && std::strchr("YCymBbhdejAauwHkIlPpMSsLNZcxDFvrRXT", conversion);
         }
 
-
         tm get_tm(const FunctionArgs &args)
         {
             int year;
@@ -417,6 +374,14 @@ namespace slim
             return tm;
         }
 
+        /**Seconds since 1970 for a UTC time, fields outside the normal range carry over.*/
+        time_t utc_time(const tm &tm)
+        {
+            auto days = days_from_civil(tm.tm_year + 1900LL, tm.tm_mon + 1, tm.tm_mday);
+            return (time_t)(days * Time::TICKS_DAY +
+                tm.tm_hour * Time::TICKS_HOUR + tm.tm_min * Time::TICKS_MIN + tm.tm_sec);
+        }
+
         int parse_utc_offset(Object *o)
         {
             static const std::string err = "\"+HH:MM\" or \"-HH:MM\" expected for utc_offset";
@@ -452,6 +417,172 @@ namespace slim
     }
 
 
+    /**threadsafe, locale and timezone independent version of time.h strftime with Ruby strftime extensions
+     * http://ruby-doc.org/core-2.2.0/Time.html#method-i-strftime
+     *
+     * - '#' flag (change case) is not supported.
+     * - week numbers are not supported
+     * - '%::z' is not supported ('%:z' is)
+     * - Padding is limited to 99, restricting the possible size of the output relative to the format string.
+     *
+     * The format is parsed once into a list of literal text and conversions.
+     */
+    class TimeFormat
+    {
+    public:
+        explicit TimeFormat(const std::string &fmt) : ops(), size_hint(fmt.size() * 2)
+        {
+            std::string literal;
+            for (size_t i = 0; i < fmt.size();)
+            {
+                if (fmt[i] == '%')
+                {
+                    if (i + 1 == fmt.size())
+                    {
+                        literal += '%';
+                        break;
+                    }
+
+                    auto c2 = fmt[i + 1];
+                    if (c2 == 'n' || c2 == 't' || c2 == '%')
+                    {
+                        i += 2;
+                        if (c2 == 'n') literal += '\n';
+                        if (c2 == 't') literal += '\t';
+                        if (c2 == '%') literal += '%';
+                        continue;
+                    }
+
+                    auto j = ++i;
+                    //<flags><width><modifier>
+                    Format token_fmt;
+                    token_fmt.parse(fmt, &j);
+
+                    if (j == fmt.size()) continue;
+
+                    auto conversion = fmt[j++];
+                    if (is_conversion(token_fmt, conversion))
+                    {
+                        ops.push_back({ std::move(literal), token_fmt, conversion });
+                        literal.clear();
+                        i = j;
+                    }
+                    else literal += '%';
+                }
+                else literal += fmt[i++];
+            }
+            if (!literal.empty()) ops.push_back({ std::move(literal), Format(), '\0' });
+        }
+
+        std::string format(time_t t, const tm &tm)const
+        {
+            std::string out;
+            out.reserve(size_hint);
+            for (auto &op : ops)
+            {
+                out += op.literal;
+                if (op.conversion) fmt_token(&out, t, tm, op.fmt, op.conversion);
+            }
+            return out;
+        }
+    private:
+        struct Op
+        {
+            /**Text before the conversion.*/
+            std::string literal;
+            Format fmt;
+            /**Conversion character, or 0 for just the literal text at the end.*/
+            char conversion;
+        };
+        std::vector<Op> ops;
+        size_t size_hint;
+    };
+
+    TimeFormatCache &TimeFormatCache::instance()
+    {
+        static TimeFormatCache cache;
+        return cache;
+    }
+    TimeFormatCache::TimeFormatCache(size_t capacity)
+        : mutex(), max_size(capacity), entries(), index()
+    {
+        assert(capacity > 0);
+    }
+    std::shared_ptr<const TimeFormat> TimeFormatCache::get(const std::string &fmt)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            auto it = index.find(fmt);
+            if (it != index.end())
+            {
+                entries.splice(entries.begin(), entries, it->second);
+                return it->second->second;
+            }
+        }
+        auto compiled = std::make_shared<const TimeFormat>(fmt);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        auto it = index.find(fmt);
+        if (it != index.end())
+        {
+            entries.splice(entries.begin(), entries, it->second);
+            return it->second->second;
+        }
+        entries.emplace_front(fmt, compiled);
+        index[fmt] = entries.begin();
+        if (entries.size() > max_size)
+        {
+            index.erase(entries.back().first);
+            entries.pop_back();
+        }
+        return compiled;
+    }
+    std::string TimeFormatCache::format(const std::string &fmt, time_t t, const tm &tm)
+    {
+        return get(fmt)->format(t, tm);
+    }
+    size_t TimeFormatCache::size()const
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        return entries.size();
+    }
+    void TimeFormatCache::clear()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        index.clear();
+        entries.clear();
+    }
+
+    long long days_from_civil(long long year, int month, int day)
+    {
+        //from http://howardhinnant.github.io/date_algorithms.html, using years starting in March
+        year += (month - 1) / 12;
+        month = (month - 1) % 12 + 1;
+        if (month < 1)
+        {
+            month += 12;
+            --year;
+        }
+        if (month <= 2) --year;
+        auto era = (year >= 0 ? year : year - 399) / 400;
+        auto year_of_era = year - era * 400; //0..399
+        auto day_of_year = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1; //0..365
+        auto day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+        return era * 146097 + day_of_era - 719468;
+    }
+    void civil_from_days(long long days, long long *year, int *month, int *day)
+    {
+        days += 719468;
+        auto era = (days >= 0 ? days : days - 146096) / 146097;
+        auto day_of_era = days - era * 146097; //0..146096
+        auto year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;
+        auto day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+        auto mp = (5 * day_of_year + 2) / 153; //0 is March
+        *day = (int)(day_of_year - (153 * mp + 2) / 5 + 1);
+        *month = (int)(mp < 10 ? mp + 3 : mp - 9);
+        *year = year_of_era + era * 400 + (*month <= 2 ? 1 : 0);
+    }
+
     Ptr<Time> number_ago(const Number *self, const FunctionArgs &args)
     {
         const Time *ref = nullptr;
@@ -475,9 +606,7 @@ namespace slim
     }
     Ptr<Time> TimeType::utc(const FunctionArgs &args)const
     {
-        auto tm = slim::get_tm(args);
-        auto t = _mkgmtime(&tm);
-        return at(t);
+        return at(utc_time(slim::get_tm(args)));
     }
     const MethodTable &TimeType::method_table()const
     {
@@ -512,19 +641,39 @@ namespace slim
             }
             else tm = slim::get_tm(args);
 
-            v = _mkgmtime(&tm);
-            v -= offset;
+            v = utc_time(tm) - offset;
         }
     }
     std::string Time::to_string()const
     {
-        return strftime("%Y-%m-%d %H:%M:%S %z");
+        static const TimeFormat FORMAT("%Y-%m-%d %H:%M:%S %z");
+        return FORMAT.format(v, get_tm());
     }
-    tm Time::get_tm()const
+    const tm &Time::get_tm()const
     {
-        tm tm;
-        gmtime_s(&tm, &v);
-        return tm;
+        std::call_once(tm_once, [this]()
+        {
+            auto days = (long long)v / TICKS_DAY;
+            auto secs = (int)((long long)v % TICKS_DAY);
+            if (secs < 0)
+            {
+                secs += TICKS_DAY;
+                --days;
+            }
+            long long year;
+            int month, day;
+            civil_from_days(days, &year, &month, &day);
+            fields.tm_year = (int)(year - 1900);
+            fields.tm_mon = month - 1;
+            fields.tm_mday = day;
+            fields.tm_hour = secs / TICKS_HOUR;
+            fields.tm_min = secs / TICKS_MIN % 60;
+            fields.tm_sec = secs % 60;
+            fields.tm_wday = (int)((days % 7 + 11) % 7); //1970-01-01 was a Thursday
+            fields.tm_yday = (int)(days - days_from_civil(year, 1, 1));
+            fields.tm_isdst = 0;
+        });
+        return fields;
     }
 
 
@@ -562,7 +711,6 @@ namespace slim
 
     Ptr<Array> Time::to_a()const
     {
-        tm tm = get_tm();
         std::vector<Ptr<Object>> arr = {
             make_value(sec()), make_value(min()), make_value(hour()),
             make_value(day()), make_value(month()), make_value(year()),
@@ -612,11 +760,12 @@ namespace slim
     }
     std::string Time::ctime()const
     {
-        return strftime("%a %b %e %T %Y");
+        static const TimeFormat FORMAT("%a %b %e %T %Y");
+        return FORMAT.format(v, get_tm());
     }
     std::string Time::strftime(const std::string &fmt)const
     {
-        return slim::strftime(v, get_tm(), fmt);
+        return TimeFormatCache::instance().format(fmt, v, get_tm());
     }
 
     const MethodTable &Time::method_table()const
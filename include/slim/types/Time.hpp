@@ -3,15 +3,27 @@
 #include "Number.hpp"
 #include "Type.hpp"
 #include <ctime>
+#include <list>
+#include <mutex>
+#include <unordered_map>
 namespace slim
 {
     class Array;
     class Boolean;
     class Number;
+    class TimeFormat;
+
+    /**Number of days since 1970-01-01 for a proleptic Gregorian date, month 1..12.
+     * Days and months outside the normal range carry over, as for timegm.
+     */
+    long long days_from_civil(long long year, int month, int day);
+    /**Inverse of days_from_civil.*/
+    void civil_from_days(long long days, long long *year, int *month, int *day);
 
     /**Time object using time_t (seconds since 1970).
      *
      * Has most of the Ruby methods, and some Rails methods, but only works with UTC internally.
+     * The broken down time is calculated the first time it is needed, then kept.
      */
     class Time : public Object
     {
@@ -21,7 +33,7 @@ namespace slim
         static const int TICKS_HOUR = TICKS_MIN * 60;
         static const int TICKS_DAY = TICKS_HOUR * 24;
         static const int TICKS_WEEK = TICKS_DAY * 7;
-        Time(time_t t) : v(t) {}
+        Time(time_t t) : v(t), tm_once(), fields() {}
         Time(const FunctionArgs &args);
 
         static const std::string &name()
@@ -32,7 +44,8 @@ namespace slim
         virtual const std::string& type_name()const override { return name(); }
 
         time_t get_value()const { return v; }
-        tm get_tm()const;
+        /**Broken down UTC time. tm_isdst is always 0.*/
+        const tm &get_tm()const;
 
         virtual std::string to_string()const override;
         virtual std::string inspect()const override { return to_string(); }
@@ -95,6 +108,39 @@ namespace slim
         virtual const MethodTable &method_table()const;
     private:
         time_t v;
+        mutable std::once_flag tm_once;
+        mutable tm fields;
+    };
+
+    /**LRU cache of strftime format strings parsed into a list of literal text and conversions,
+     * so that Time#strftime with the same format does not parse it again.
+     */
+    class TimeFormatCache
+    {
+    public:
+        static const size_t DEFAULT_CAPACITY = 64;
+
+        /**The cache used by Time#strftime.*/
+        static TimeFormatCache &instance();
+
+        explicit TimeFormatCache(size_t capacity = DEFAULT_CAPACITY);
+
+        /**Get the compiled format, parsing it if not already cached.*/
+        std::shared_ptr<const TimeFormat> get(const std::string &fmt);
+        /**Format t using fmt.*/
+        std::string format(const std::string &fmt, time_t t, const tm &tm);
+
+        size_t size()const;
+        size_t capacity()const { return max_size; }
+        /**Remove all entries.*/
+        void clear();
+    private:
+        typedef std::pair<std::string, std::shared_ptr<const TimeFormat>> Entry;
+        mutable std::mutex mutex;
+        size_t max_size;
+        /**Most recently used first.*/
+        std::list<Entry> entries;
+        std::unordered_map<std::string, std::list<Entry>::iterator> index;
     };
 
     class TimeType : public Type
@@ -1,5 +1,8 @@
 #pragma once
 #include "Object.hpp"
+#include <atomic>
+#include <cstdint>
+#include <mutex>
 namespace slim
 {
     class Proc;
@@ -31,6 +34,18 @@ namespace slim
         void set_attr(SymPtr name, ObjectPtr value);
         void set_attr(const std::string &name, ObjectPtr value);
 
+        /**Append the name of every attribute and constant read to reads, until called again
+         * with null. Used by IncrementalRender to find what each part of a template depends on.
+         * Reads from other threads (e.g. parallel_each) are included.
+         */
+        void record_reads(std::vector<SymPtr> *reads);
+        /**A counter incremented by every set_attr and add_constant.*/
+        uint64_t get_version()const { return version; }
+        /**The get_version() value from when the attribute or constant name was last set, or 0.
+         * An attribute and constant with the same name share a version.
+         */
+        uint64_t get_version(const SymPtr &name)const;
+
         void content_for(SymPtr name, std::shared_ptr<Proc> proc);
         std::shared_ptr<HtmlSafeString> yield(const FunctionArgs &args);
         /**Used by Template to store the content for the layout Template.*/
@@ -38,12 +53,20 @@ namespace slim
     protected:
         ObjectMap attrs;
         ObjectMap constants;
+        /**See get_version.*/
+        uint64_t version;
+        OrderedMap<SymPtr, uint64_t, SymHash, SymEquals> versions;
+        /**See record_reads. Checked without the lock, so normal renders do not take it.*/
+        std::atomic<std::vector<SymPtr>*> reads;
+        std::mutex reads_lock;
         /**Content from the main view for a "yield" in layout.*/
         std::shared_ptr<HtmlSafeString> main_content;
         /**Save all the rendered content_for blocks for yield.*/
         ObjectMap content_for_store;
 
         virtual const MethodTable &method_table()const override;
+    private:
+        void add_read(const SymPtr &name);
     };
 
     typedef std::shared_ptr<ViewModel> ViewModelPtr;
@@ -0,0 +1,235 @@
+#include "NumberKernels.hpp"
+#include <climits>
+#include <cstdint>
+
+#if defined(__AVX2__)
+#   define SLIM_KERNELS_AVX2
+#   include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#   define SLIM_KERNELS_SSE2
+#   include <emmintrin.h>
+#endif
+#if defined(_MSC_VER)
+#   include <intrin.h>
+#endif
+
+namespace slim
+{
+    namespace kernels
+    {
+        namespace
+        {
+#if defined(SLIM_KERNELS_AVX2) || defined(SLIM_KERNELS_SSE2)
+            unsigned lowest_bit(uint32_t mask)
+            {
+#if defined(_MSC_VER)
+                unsigned long i;
+                _BitScanForward(&i, mask);
+                return (unsigned)i;
+#else
+                return (unsigned)__builtin_ctz(mask);
+#endif
+            }
+#endif
+            bool add_overflow(long long a, long long b, long long *out)
+            {
+                if ((b > 0 && a > LLONG_MAX - b) || (b < 0 && a < LLONG_MIN - b)) return true;
+                *out = a + b;
+                return false;
+            }
+        }
+
+        double sum(const double *values, size_t n)
+        {
+            double s[4] = { 0, 0, 0, 0 };
+            size_t i = 0;
+#if defined(SLIM_KERNELS_AVX2)
+            auto acc = _mm256_setzero_pd();
+            for (; i + 4 <= n; i += 4) acc = _mm256_add_pd(acc, _mm256_loadu_pd(values + i));
+            _mm256_storeu_pd(s, acc);
+#elif defined(SLIM_KERNELS_SSE2)
+            auto acc01 = _mm_setzero_pd(), acc23 = _mm_setzero_pd();
+            for (; i + 4 <= n; i += 4)
+            {
+                acc01 = _mm_add_pd(acc01, _mm_loadu_pd(values + i));
+                acc23 = _mm_add_pd(acc23, _mm_loadu_pd(values + i + 2));
+            }
+            _mm_storeu_pd(s, acc01);
+            _mm_storeu_pd(s + 2, acc23);
+#endif
+            for (; i < n; ++i) s[i % 4] += values[i];
+            return (s[0] + s[1]) + (s[2] + s[3]);
+        }
+        bool sum(const long long *values, size_t n, long long *out)
+        {
+            if (n == 0)
+            {
+                *out = 0;
+                return true;
+            }
+            long long min, max;
+            min_max(values, n, &min, &max);
+            long long bound = LLONG_MAX / (long long)n;
+            if (min >= -bound && max <= bound)
+            {
+                //can not overflow, leave the loop simple enough to vectorise
+                long long s = 0;
+                for (size_t i = 0; i < n; ++i) s += values[i];
+                *out = s;
+                return true;
+            }
+            long long s = 0;
+            for (size_t i = 0; i < n; ++i)
+            {
+                if (add_overflow(s, values[i], &s)) return false;
+            }
+            *out = s;
+            return true;
+        }
+
+        bool min_max(const double *values, size_t n, double *min_out, double *max_out)
+        {
+            double min = values[0], max = values[0];
+            bool nan = false;
+            size_t i = 0;
+#if defined(SLIM_KERNELS_AVX2)
+            if (n >= 4)
+            {
+                auto vmin = _mm256_loadu_pd(values), vmax = vmin;
+                auto unord = _mm256_cmp_pd(vmin, vmin, _CMP_UNORD_Q);
+                for (i = 4; i + 4 <= n; i += 4)
+                {
+                    auto x = _mm256_loadu_pd(values + i);
+                    vmin = _mm256_min_pd(vmin, x);
+                    vmax = _mm256_max_pd(vmax, x);
+                    unord = _mm256_or_pd(unord, _mm256_cmp_pd(x, x, _CMP_UNORD_Q));
+                }
+                if (_mm256_movemask_pd(unord)) return false;
+                double lanes_min[4], lanes_max[4];
+                _mm256_storeu_pd(lanes_min, vmin);
+                _mm256_storeu_pd(lanes_max, vmax);
+                for (int j = 0; j < 4; ++j)
+                {
+                    if (lanes_min[j] < min) min = lanes_min[j];
+                    if (lanes_max[j] > max) max = lanes_max[j];
+                }
+            }
+#elif defined(SLIM_KERNELS_SSE2)
+            if (n >= 2)
+            {
+                auto vmin = _mm_loadu_pd(values), vmax = vmin;
+                auto unord = _mm_cmpunord_pd(vmin, vmin);
+                for (i = 2; i + 2 <= n; i += 2)
+                {
+                    auto x = _mm_loadu_pd(values + i);
+                    vmin = _mm_min_pd(vmin, x);
+                    vmax = _mm_max_pd(vmax, x);
+                    unord = _mm_or_pd(unord, _mm_cmpunord_pd(x, x));
+                }
+                if (_mm_movemask_pd(unord)) return false;
+                double lanes_min[2], lanes_max[2];
+                _mm_storeu_pd(lanes_min, vmin);
+                _mm_storeu_pd(lanes_max, vmax);
+                for (int j = 0; j < 2; ++j)
+                {
+                    if (lanes_min[j] < min) min = lanes_min[j];
+                    if (lanes_max[j] > max) max = lanes_max[j];
+                }
+            }
+#endif
+            for (; i < n; ++i)
+            {
+                auto x = values[i];
+                if (x != x) nan = true;
+                if (x < min) min = x;
+                if (x > max) max = x;
+            }
+            if (nan || min != min) return false;
+            *min_out = min;
+            *max_out = max;
+            return true;
+        }
+        void min_max(const long long *values, size_t n, long long *min_out, long long *max_out)
+        {
+            long long min = values[0], max = values[0];
+            for (size_t i = 1; i < n; ++i)
+            {
+                auto x = values[i];
+                min = x < min ? x : min;
+                max = x > max ? x : max;
+            }
+            *min_out = min;
+            *max_out = max;
+        }
+
+        size_t find(const double *values, size_t n, double x)
+        {
+            size_t i = 0;
+#if defined(SLIM_KERNELS_AVX2)
+            auto vx = _mm256_set1_pd(x);
+            for (; i + 4 <= n; i += 4)
+            {
+                auto mask = (uint32_t)_mm256_movemask_pd(_mm256_cmp_pd(_mm256_loadu_pd(values + i), vx, _CMP_EQ_OQ));
+                if (mask) return i + lowest_bit(mask);
+            }
+#elif defined(SLIM_KERNELS_SSE2)
+            auto vx = _mm_set1_pd(x);
+            for (; i + 4 <= n; i += 4)
+            {
+                auto lo = (uint32_t)_mm_movemask_pd(_mm_cmpeq_pd(_mm_loadu_pd(values + i), vx));
+                auto hi = (uint32_t)_mm_movemask_pd(_mm_cmpeq_pd(_mm_loadu_pd(values + i + 2), vx));
+                auto mask = lo | (hi << 2);
+                if (mask) return i + lowest_bit(mask);
+            }
+#endif
+            for (; i < n; ++i)
+            {
+                if (values[i] == x) return i;
+            }
+            return NOT_FOUND;
+        }
+        size_t find(const long long *values, size_t n, long long x)
+        {
+            size_t i = 0;
+#if defined(SLIM_KERNELS_AVX2)
+            auto vx = _mm256_set1_epi64x(x);
+            for (; i + 4 <= n; i += 4)
+            {
+                auto eq = _mm256_cmpeq_epi64(_mm256_loadu_si256((const __m256i*)(values + i)), vx);
+                auto mask = (uint32_t)_mm256_movemask_pd(_mm256_castsi256_pd(eq));
+                if (mask) return i + lowest_bit(mask);
+            }
+#elif defined(SLIM_KERNELS_SSE2)
+            //no 64 bit compare in SSE2, both 32 bit halves must be equal
+            auto vx = _mm_set1_epi64x(x);
+            auto eq64 = [vx](const long long *p)
+            {
+                auto eq = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)p), vx);
+                eq = _mm_and_si128(eq, _mm_shuffle_epi32(eq, _MM_SHUFFLE(2, 3, 0, 1)));
+                return (uint32_t)_mm_movemask_pd(_mm_castsi128_pd(eq));
+            };
+            for (; i + 4 <= n; i += 4)
+            {
+                auto mask = eq64(values + i) | (eq64(values + i + 2) << 2);
+                if (mask) return i + lowest_bit(mask);
+            }
+#endif
+            for (; i < n; ++i)
+            {
+                if (values[i] == x) return i;
+            }
+            return NOT_FOUND;
+        }
+
+        const char *simd_name()
+        {
+#if defined(SLIM_KERNELS_AVX2)
+            return "avx2";
+#elif defined(SLIM_KERNELS_SSE2)
+            return "sse2";
+#else
+            return "scalar";
+#endif
+        }
+    }
+}
@@ -6,18 +6,26 @@
 #include "types/String.hpp"
 namespace slim
 {
+    namespace
+    {
+        /**Integer and Number are different types that still compare by value.*/
+        bool both_numbers(const Object *lhs, const Object *rhs)
+        {
+            return dynamic_cast<const Number*>(lhs) && dynamic_cast<const Number*>(rhs);
+        }
+    }
     bool imp_eq(const Object *lhs, const Object *rhs)
     {
         auto &lhs_t = typeid(*lhs);
         auto &rhs_t = typeid(*rhs);
-        if (lhs_t == rhs_t) return lhs->eq(rhs);
+        if (lhs_t == rhs_t || both_numbers(lhs, rhs)) return lhs->eq(rhs);
         else return false;
     }
     int imp_cmp(const Object *lhs, const char *op, const Object *rhs)
     {
         auto &lhs_t = typeid(*lhs);
         auto &rhs_t = typeid(*rhs);
-        if (lhs_t == rhs_t) return lhs->cmp(rhs);
+        if (lhs_t == rhs_t || both_numbers(lhs, rhs)) return lhs->cmp(rhs);
         else throw UnorderableTypeError(lhs, op, rhs);
     }
 
@@ -41,7 +49,7 @@ namespace slim
     }
     ObjectPtr op_cmp(const Object *lhs, const Object *rhs)
     {
-        return make_value((double)cmp(lhs, rhs));
+        return make_value(cmp(lhs, rhs));
     }
      ObjectPtr op_lt(const Object *lhs, const Object *rhs)
     {
@@ -0,0 +1,816 @@
+#include "RegexEngine.hpp"
+#include <utility>
+
+namespace slim
+{
+    namespace regex
+    {
+        namespace
+        {
+            /**Thrown while compiling for syntax that is not supported or not valid.*/
+            struct Unsupported {};
+
+            const unsigned INF = (unsigned)-1;
+            /**Limits, beyond which compile gives up and lets the fallback deal with it.*/
+            const size_t MAX_INSTS = 50000;
+            const unsigned MAX_REPEAT = 1000;
+            const unsigned MAX_DEPTH = 200;
+            const uint32_t NONE = (uint32_t)-1;
+
+            bool is_digit(unsigned char c) { return c >= '0' && c <= '9'; }
+            bool is_upper(unsigned char c) { return c >= 'A' && c <= 'Z'; }
+            bool is_lower(unsigned char c) { return c >= 'a' && c <= 'z'; }
+            bool is_alpha(unsigned char c) { return is_upper(c) || is_lower(c); }
+            bool is_word(unsigned char c) { return is_alpha(c) || is_digit(c) || c == '_'; }
+            int hex_value(unsigned char c)
+            {
+                if (is_digit(c)) return c - '0';
+                if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+                if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+                return -1;
+            }
+
+            struct Node
+            {
+                enum Type { EMPTY, ATOM, ASSERT, CONCAT, ALT, REPEAT, GROUP };
+                explicit Node(Type type)
+                    : type(type), op(Program::BYTE), byte(0), set(), set_index(NONE),
+                    assertion(Program::TEXT_BEGIN), children(), min(0), max(0), greedy(true), group(0)
+                {}
+
+                Type type;
+                /**For ATOM, one of the consuming instructions.*/
+                Program::Op op;
+                unsigned char byte;
+                Program::ByteSet set;
+                /**Index in Program::sets once emitted, so repeated copies share it.*/
+                uint32_t set_index;
+                Program::Assertion assertion;
+                std::vector<std::unique_ptr<Node>> children;
+                unsigned min, max;
+                bool greedy;
+                unsigned group;
+            };
+            typedef std::unique_ptr<Node> NodePtr;
+
+            Program::ByteSet class_escape_set(char c)
+            {
+                Program::ByteSet set;
+                switch (c)
+                {
+                case 'd': case 'D':
+                    set.set_range('0', '9');
+                    break;
+                case 'w': case 'W':
+                    set.set_range('a', 'z');
+                    set.set_range('A', 'Z');
+                    set.set_range('0', '9');
+                    set.set('_');
+                    break;
+                case 's': case 'S':
+                    for (auto ws : " \t\n\v\f\r") if (ws) set.set((unsigned char)ws);
+                    break;
+                case 'h': case 'H':
+                    set.set_range('0', '9');
+                    set.set_range('a', 'f');
+                    set.set_range('A', 'F');
+                    break;
+                default: throw Unsupported();
+                }
+                if (is_upper((unsigned char)c)) set.invert();
+                return set;
+            }
+            bool posix_class_set(StringView name, Program::ByteSet *set)
+            {
+                Program::ByteSet s;
+                if (name == "alpha" || name == "alnum" || name == "upper") s.set_range('A', 'Z');
+                if (name == "alpha" || name == "alnum" || name == "lower") s.set_range('a', 'z');
+                if (name == "digit" || name == "alnum") s.set_range('0', '9');
+                if (name == "word") s = class_escape_set('w');
+                if (name == "xdigit") s = class_escape_set('h');
+                if (name == "space") s = class_escape_set('s');
+                if (name == "blank") { s.set(' '); s.set('\t'); }
+                if (name == "cntrl") { s.set_range(0, 31); s.set(127); }
+                if (name == "print") s.set_range(32, 126);
+                if (name == "graph") s.set_range(33, 126);
+                if (name == "punct")
+                {
+                    s.set_range(33, 47);
+                    s.set_range(58, 64);
+                    s.set_range(91, 96);
+                    s.set_range(123, 126);
+                }
+                if (name == "ascii") s.set_range(0, 127);
+                bool any = false;
+                for (auto b : s.bits) any = any || b != 0;
+                if (!any) return false;
+                set->merge(s);
+                return true;
+            }
+        }
+
+        /**Parses a pattern into a tree of Node, then emits the instructions for it.*/
+        class Compiler
+        {
+        public:
+            Compiler(StringView src, int flags)
+                : src(src), pos(0), flags(flags), groups(1), depth(0), prog()
+            {}
+
+            std::unique_ptr<Program> compile()
+            {
+                auto node = parse_alt();
+                if (pos != src.size()) throw Unsupported(); //unmatched ')'
+
+                prog.reset(new Program());
+                emit(Program::SAVE, 0);
+                emit_node(*node);
+                emit(Program::SAVE, 1);
+                emit(Program::MATCH);
+                prog->groups = groups;
+                prog->compute_first();
+                return std::move(prog);
+            }
+        private:
+            StringView src;
+            size_t pos;
+            int flags;
+            unsigned groups;
+            unsigned depth;
+            std::unique_ptr<Program> prog;
+
+            bool at_end()const { return pos >= src.size(); }
+            char peek()const { return src[pos]; }
+            bool accept(char c)
+            {
+                if (!at_end() && src[pos] == c)
+                {
+                    ++pos;
+                    return true;
+                }
+                return false;
+            }
+            /**In extended mode skip whitespace and comments.*/
+            void skip_extended()
+            {
+                if (!(flags & Program::EXTENDED)) return;
+                while (!at_end())
+                {
+                    auto c = peek();
+                    if (c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\f' || c == '\v') ++pos;
+                    else if (c == '#')
+                    {
+                        while (!at_end() && peek() != '\n') ++pos;
+                    }
+                    else break;
+                }
+            }
+
+            NodePtr make(Node::Type type)
+            {
+                return NodePtr(new Node(type));
+            }
+            /**Node matching a literal byte, considering IGNORECASE.*/
+            NodePtr literal(unsigned char c)
+            {
+                auto node = make(Node::ATOM);
+                if ((flags & Program::IGNORECASE) && is_alpha(c))
+                {
+                    node->op = Program::SET;
+                    node->set.set(c);
+                    node->set.set((unsigned char)(c ^ 0x20));
+                }
+                else
+                {
+                    node->op = Program::BYTE;
+                    node->byte = c;
+                }
+                return node;
+            }
+            NodePtr set_node(const Program::ByteSet &set)
+            {
+                auto node = make(Node::ATOM);
+                node->op = Program::SET;
+                node->set = set;
+                return node;
+            }
+            NodePtr assertion(Program::Assertion a)
+            {
+                auto node = make(Node::ASSERT);
+                node->assertion = a;
+                return node;
+            }
+
+            NodePtr parse_alt()
+            {
+                auto first = parse_concat();
+                if (at_end() || peek() != '|') return first;
+                auto alt = make(Node::ALT);
+                alt->children.push_back(std::move(first));
+                while (accept('|')) alt->children.push_back(parse_concat());
+                return alt;
+            }
+            NodePtr parse_concat()
+            {
+                auto concat = make(Node::CONCAT);
+                while (true)
+                {
+                    skip_extended();
+                    if (at_end() || peek() == '|' || peek() == ')') break;
+                    auto node = parse_repeat();
+                    if (node) concat->children.push_back(std::move(node));
+                }
+                return concat;
+            }
+            NodePtr parse_repeat()
+            {
+                auto atom = parse_atom();
+                if (!atom) return nullptr;
+                while (true)
+                {
+                    skip_extended();
+                    unsigned min, max;
+                    if (accept('*')) min = 0, max = INF;
+                    else if (accept('+')) min = 1, max = INF;
+                    else if (accept('?')) min = 0, max = 1;
+                    else if (!parse_braces(&min, &max)) break;
+
+                    bool greedy = true;
+                    if (accept('?')) greedy = false;
+                    else if (!at_end() && peek() == '+') throw Unsupported(); //possessive
+
+                    auto rep = make(Node::REPEAT);
+                    rep->min = min;
+                    rep->max = max;
+                    rep->greedy = greedy;
+                    rep->children.push_back(std::move(atom));
+                    atom = std::move(rep);
+                }
+                return atom;
+            }
+            /**Parse {n}, {n,}, {,m} or {n,m}. Anything else is not a quantifier.*/
+            bool parse_braces(unsigned *min, unsigned *max)
+            {
+                if (at_end() || peek() != '{') return false;
+                auto p = pos + 1;
+                auto number = [this, &p](unsigned *out) -> bool
+                {
+                    auto start = p;
+                    unsigned n = 0;
+                    while (p < src.size() && is_digit((unsigned char)src[p]))
+                    {
+                        n = n * 10 + (src[p] - '0');
+                        if (n > MAX_REPEAT) throw Unsupported();
+                        ++p;
+                    }
+                    *out = n;
+                    return p != start;
+                };
+                bool has_min = number(min);
+                if (p < src.size() && src[p] == ',')
+                {
+                    ++p;
+                    if (!number(max)) *max = INF;
+                    if (!has_min && *max == INF) return false;
+                    if (!has_min) *min = 0;
+                }
+                else if (has_min) *max = *min;
+                else return false;
+                if (p >= src.size() || src[p] != '}') return false;
+                if (*min > *max) throw Unsupported();
+                pos = p + 1;
+                return true;
+            }
+
+            NodePtr parse_atom()
+            {
+                auto c = (unsigned char)src[pos++];
+                switch (c)
+                {
+                case '(': return parse_group();
+                case '[': return parse_class();
+                case '.':
+                {
+                    auto node = make(Node::ATOM);
+                    node->op = (flags & Program::MULTILINE) ? Program::ANY_NL : Program::ANY;
+                    return node;
+                }
+                case '^': return assertion(Program::LINE_BEGIN);
+                case '$': return assertion(Program::LINE_END);
+                case '\\': return parse_escape();
+                case '*': case '+': case '?': throw Unsupported(); //nothing to repeat
+                default: return literal(c);
+                }
+            }
+            NodePtr parse_group()
+            {
+                if (++depth > MAX_DEPTH) throw Unsupported();
+                auto saved_flags = flags;
+                NodePtr node;
+                if (accept('?'))
+                {
+                    if (!accept(':'))
+                    {
+                        //options, (?imx-imx) or (?imx-imx:subexp)
+                        int on = 0, off = 0;
+                        bool negate = false, any = false;
+                        for (; !at_end(); ++pos)
+                        {
+                            int flag;
+                            auto c = peek();
+                            if (c == 'i') flag = Program::IGNORECASE;
+                            else if (c == 'm') flag = Program::MULTILINE;
+                            else if (c == 'x') flag = Program::EXTENDED;
+                            else if (c == '-' && !negate) { negate = true; continue; }
+                            else break;
+                            (negate ? off : on) |= flag;
+                            any = true;
+                        }
+                        if (!any) throw Unsupported(); //look around, named groups, etc.
+                        flags = (flags | on) & ~off;
+                        if (accept(')'))
+                        {
+                            //applies to the rest of the enclosing group
+                            --depth;
+                            return nullptr;
+                        }
+                        if (!accept(':')) throw Unsupported();
+                    }
+                    node = parse_alt();
+                }
+                else
+                {
+                    node = make(Node::GROUP);
+                    node->group = groups++;
+                    node->children.push_back(parse_alt());
+                }
+                if (!accept(')')) throw Unsupported();
+                flags = saved_flags;
+                --depth;
+                return node;
+            }
+            NodePtr parse_escape()
+            {
+                if (at_end()) throw Unsupported();
+                auto c = (unsigned char)src[pos++];
+                switch (c)
+                {
+                case 'd': case 'D': case 'w': case 'W': case 's': case 'S': case 'h': case 'H':
+                    return set_node(class_escape_set(c));
+                case 'b': return assertion(Program::WORD_BOUNDARY);
+                case 'B': return assertion(Program::NOT_WORD_BOUNDARY);
+                case 'A': return assertion(Program::TEXT_BEGIN);
+                case 'z': return assertion(Program::TEXT_END);
+                case 'Z': return assertion(Program::TEXT_END_NL);
+                case 'u':
+                {
+                    uint32_t cp = 0;
+                    for (int i = 0; i < 4; ++i)
+                    {
+                        int h = at_end() ? -1 : hex_value((unsigned char)src[pos++]);
+                        if (h < 0) throw Unsupported();
+                        cp = cp * 16 + h;
+                    }
+                    auto concat = make(Node::CONCAT);
+                    for (auto b : utf8_encode(cp)) concat->children.push_back(literal(b));
+                    return concat;
+                }
+                default:
+                    return literal(escaped_byte(c));
+                }
+            }
+            /**The byte for a simple escape (after the backslash), shared by classes.*/
+            unsigned char escaped_byte(unsigned char c)
+            {
+                switch (c)
+                {
+                case 'n': return '\n';
+                case 't': return '\t';
+                case 'r': return '\r';
+                case 'f': return '\f';
+                case 'v': return '\v';
+                case 'a': return '\a';
+                case 'e': return 0x1B;
+                case '0': return 0;
+                case 'x':
+                {
+                    int value = 0, digits = 0;
+                    for (; digits < 2 && !at_end(); ++digits)
+                    {
+                        int h = hex_value((unsigned char)peek());
+                        if (h < 0) break;
+                        value = value * 16 + h;
+                        ++pos;
+                    }
+                    if (!digits) throw Unsupported();
+                    return (unsigned char)value;
+                }
+                default:
+                    //back references, unicode properties, etc.
+                    if (is_word(c)) throw Unsupported();
+                    return c;
+                }
+            }
+            static std::vector<unsigned char> utf8_encode(uint32_t cp)
+            {
+                if (cp < 0x80) return { (unsigned char)cp };
+                if (cp < 0x800) return { (unsigned char)(0xC0 | (cp >> 6)), (unsigned char)(0x80 | (cp & 0x3F)) };
+                return {
+                    (unsigned char)(0xE0 | (cp >> 12)),
+                    (unsigned char)(0x80 | ((cp >> 6) & 0x3F)),
+                    (unsigned char)(0x80 | (cp & 0x3F)) };
+            }
+
+            NodePtr parse_class()
+            {
+                Program::ByteSet set;
+                bool negate = accept('^');
+                bool first = true;
+                while (true)
+                {
+                    if (at_end()) throw Unsupported();
+                    auto c = peek();
+                    if (c == ']' && !first)
+                    {
+                        ++pos;
+                        break;
+                    }
+                    first = false;
+                    if (c == '[')
+                    {
+                        if (src.substr(pos).starts_with("[:"))
+                        {
+                            auto end = src.find(":]", pos + 2);
+                            if (end == StringView::npos) throw Unsupported();
+                            auto name = src.substr(pos + 2, end - pos - 2);
+                            Program::ByteSet posix;
+                            bool invert = !name.empty() && name[0] == '^';
+                            if (invert) name = name.substr(1);
+                            if (!posix_class_set(name, &posix)) throw Unsupported();
+                            if (invert) posix.invert();
+                            set.merge(posix);
+                            pos = end + 2;
+                            continue;
+                        }
+                        throw Unsupported(); //nested class
+                    }
+                    if (src.substr(pos).starts_with("&&")) throw Unsupported(); //intersection
+
+                    unsigned char lo, hi;
+                    if (!class_atom(&lo, &set)) continue;
+                    if (pos + 1 < src.size() && peek() == '-' && src[pos + 1] != ']')
+                    {
+                        ++pos;
+                        Program::ByteSet unused;
+                        if (!class_atom(&hi, &unused) || hi < lo) throw Unsupported();
+                        set.set_range(lo, hi);
+                    }
+                    else set.set(lo);
+                }
+                if (flags & Program::IGNORECASE)
+                {
+                    for (unsigned char c = 'a'; c <= 'z'; ++c)
+                    {
+                        auto u = (unsigned char)(c ^ 0x20);
+                        if (set.test(c) || set.test(u))
+                        {
+                            set.set(c);
+                            set.set(u);
+                        }
+                    }
+                }
+                if (negate) set.invert();
+                return set_node(set);
+            }
+            /**Reads a class element. Returns false for escapes such as \d which are added to set.*/
+            bool class_atom(unsigned char *out, Program::ByteSet *set)
+            {
+                if (at_end()) throw Unsupported();
+                auto c = (unsigned char)src[pos++];
+                if (c >= 0x80) throw Unsupported(); //multi-byte character
+                if (c != '\\')
+                {
+                    *out = c;
+                    return true;
+                }
+                if (at_end()) throw Unsupported();
+                c = (unsigned char)src[pos++];
+                switch (c)
+                {
+                case 'd': case 'D': case 'w': case 'W': case 's': case 'S': case 'h': case 'H':
+                    set->merge(class_escape_set(c));
+                    return false;
+                case 'b':
+                    *out = '\b';
+                    return true;
+                default:
+                    *out = escaped_byte(c);
+                    return true;
+                }
+            }
+
+            size_t emit(Program::Op op, uint32_t arg = 0, uint32_t arg2 = 0)
+            {
+                if (prog->insts.size() >= MAX_INSTS) throw Unsupported();
+                prog->insts.push_back({ op, arg, arg2 });
+                return prog->insts.size() - 1;
+            }
+            uint32_t here()const { return (uint32_t)prog->insts.size(); }
+            /**Set the targets of a SPLIT so that body is preferred if greedy.*/
+            void patch_split(size_t split, uint32_t body, uint32_t out, bool greedy)
+            {
+                prog->insts[split].arg = greedy ? body : out;
+                prog->insts[split].arg2 = greedy ? out : body;
+            }
+            void emit_node(Node &node)
+            {
+                switch (node.type)
+                {
+                case Node::EMPTY: break;
+                case Node::ATOM:
+                    if (node.op == Program::BYTE) emit(Program::BYTE, node.byte);
+                    else if (node.op == Program::SET)
+                    {
+                        if (node.set_index == NONE)
+                        {
+                            node.set_index = (uint32_t)prog->sets.size();
+                            prog->sets.push_back(node.set);
+                        }
+                        emit(Program::SET, node.set_index);
+                    }
+                    else emit(node.op);
+                    break;
+                case Node::ASSERT:
+                    emit(Program::ASSERT, node.assertion);
+                    break;
+                case Node::CONCAT:
+                    for (auto &child : node.children) emit_node(*child);
+                    break;
+                case Node::GROUP:
+                    emit(Program::SAVE, node.group * 2);
+                    emit_node(*node.children[0]);
+                    emit(Program::SAVE, node.group * 2 + 1);
+                    break;
+                case Node::ALT:
+                {
+                    std::vector<size_t> jumps;
+                    for (size_t i = 0; i < node.children.size(); ++i)
+                    {
+                        if (i + 1 < node.children.size())
+                        {
+                            auto split = emit(Program::SPLIT);
+                            emit_node(*node.children[i]);
+                            jumps.push_back(emit(Program::JMP));
+                            patch_split(split, (uint32_t)split + 1, here(), true);
+                        }
+                        else emit_node(*node.children[i]);
+                    }
+                    for (auto jmp : jumps) prog->insts[jmp].arg = here();
+                    break;
+                }
+                case Node::REPEAT:
+                {
+                    auto &child = *node.children[0];
+                    if (node.max == INF)
+                    {
+                        if (node.min > 0)
+                        {
+                            //x{n,} as n-1 copies then x+
+                            for (unsigned i = 1; i < node.min; ++i) emit_node(child);
+                            auto start = here();
+                            emit_node(child);
+                            auto split = emit(Program::SPLIT);
+                            patch_split(split, start, here(), node.greedy);
+                        }
+                        else
+                        {
+                            auto split = emit(Program::SPLIT);
+                            emit_node(child);
+                            emit(Program::JMP, (uint32_t)split);
+                            patch_split(split, (uint32_t)split + 1, here(), node.greedy);
+                        }
+                    }
+                    else
+                    {
+                        for (unsigned i = 0; i < node.min; ++i) emit_node(child);
+                        std::vector<size_t> splits;
+                        for (unsigned i = node.min; i < node.max; ++i)
+                        {
+                            splits.push_back(emit(Program::SPLIT));
+                            emit_node(child);
+                        }
+                        for (auto split : splits)
+                            patch_split(split, (uint32_t)split + 1, here(), node.greedy);
+                    }
+                    break;
+                }
+                }
+            }
+        };
+
+        std::unique_ptr<Program> Program::compile(StringView pattern, int flags)
+        {
+            try
+            {
+                return Compiler(pattern, flags).compile();
+            }
+            catch (const Unsupported &)
+            {
+                return nullptr;
+            }
+        }
+
+        void Program::compute_first()
+        {
+            //follow the non-consuming instructions from the start
+            std::vector<bool> seen(insts.size(), false);
+            std::vector<uint32_t> stack = { 0 };
+            use_first = true;
+            while (!stack.empty())
+            {
+                auto pc = stack.back();
+                stack.pop_back();
+                if (seen[pc]) continue;
+                seen[pc] = true;
+                auto &inst = insts[pc];
+                switch (inst.op)
+                {
+                case BYTE: first.set((unsigned char)inst.arg); break;
+                case SET: first.merge(sets[inst.arg]); break;
+                case ANY: case ANY_NL: use_first = false; break;
+                case SPLIT: stack.push_back(inst.arg2); stack.push_back(inst.arg); break;
+                case JMP: stack.push_back(inst.arg); break;
+                case SAVE: case ASSERT: stack.push_back(pc + 1); break;
+                case MATCH: use_first = false; break;
+                }
+            }
+            if (first.all()) use_first = false;
+        }
+
+        namespace
+        {
+            bool check_assertion(uint32_t a, const unsigned char *data, size_t n, size_t pos)
+            {
+                switch (a)
+                {
+                case Program::LINE_BEGIN: return pos == 0 || data[pos - 1] == '\n';
+                case Program::LINE_END: return pos == n || data[pos] == '\n';
+                case Program::TEXT_BEGIN: return pos == 0;
+                case Program::TEXT_END: return pos == n;
+                case Program::TEXT_END_NL: return pos == n || (pos + 1 == n && data[pos] == '\n');
+                case Program::WORD_BOUNDARY:
+                case Program::NOT_WORD_BOUNDARY:
+                {
+                    bool before = pos > 0 && is_word(data[pos - 1]);
+                    bool after = pos < n && is_word(data[pos]);
+                    return (before != after) == (a == Program::WORD_BOUNDARY);
+                }
+                default: return false;
+                }
+            }
+
+            /**Threads for one position, in priority order, each with its capture slots.*/
+            struct ThreadList
+            {
+                std::vector<uint32_t> pcs;
+                std::vector<size_t> caps;
+
+                void clear()
+                {
+                    pcs.clear();
+                    caps.clear();
+                }
+            };
+        }
+
+        bool Program::run(StringView str, size_t start, bool last, std::vector<size_t> *slots)const
+        {
+            auto data = (const unsigned char*)str.data();
+            auto n = str.size();
+            auto nslots = groups * 2;
+            if (start > n) return false;
+
+            size_t pos = start;
+            if (!last && use_first)
+            {
+                while (pos < n && !first.test(data[pos])) ++pos;
+                if (pos == n) return false;
+            }
+
+            ThreadList lists[2];
+            for (auto &list : lists)
+            {
+                list.pcs.reserve(insts.size());
+                list.caps.reserve(insts.size() * nslots);
+            }
+            ThreadList *clist = &lists[0], *nlist = &lists[1];
+            //generation each instruction was last added to a list, to add each only once
+            std::vector<size_t> mark(insts.size(), 0);
+            size_t gen = 0;
+            std::vector<size_t> blank(nslots, NO_MATCH);
+
+            struct Frame
+            {
+                uint32_t pc;
+                /**If not NONE, restore caps[slot] to old rather than visit pc.*/
+                uint32_t slot;
+                size_t old;
+            };
+            std::vector<Frame> stack;
+            //add pc and the instructions reachable without consuming input, in priority order
+            auto add = [&](ThreadList &list, uint32_t pc0, size_t at, size_t *caps)
+            {
+                stack.push_back({ pc0, NONE, 0 });
+                while (!stack.empty())
+                {
+                    auto frame = stack.back();
+                    stack.pop_back();
+                    if (frame.slot != NONE)
+                    {
+                        caps[frame.slot] = frame.old;
+                        continue;
+                    }
+                    auto pc = frame.pc;
+                    if (mark[pc] == gen) continue;
+                    mark[pc] = gen;
+                    auto &inst = insts[pc];
+                    switch (inst.op)
+                    {
+                    case JMP:
+                        stack.push_back({ inst.arg, NONE, 0 });
+                        break;
+                    case SPLIT:
+                        stack.push_back({ inst.arg2, NONE, 0 });
+                        stack.push_back({ inst.arg, NONE, 0 });
+                        break;
+                    case SAVE:
+                        stack.push_back({ 0, inst.arg, caps[inst.arg] });
+                        caps[inst.arg] = at;
+                        stack.push_back({ pc + 1, NONE, 0 });
+                        break;
+                    case ASSERT:
+                        if (check_assertion(inst.arg, data, n, at)) stack.push_back({ pc + 1, NONE, 0 });
+                        break;
+                    default:
+                        list.pcs.push_back(pc);
+                        list.caps.insert(list.caps.end(), caps, caps + nslots);
+                        break;
+                    }
+                }
+            };
+
+            bool matched = false;
+            ++gen;
+            add(*clist, 0, pos, blank.data());
+            while (true)
+            {
+                if (!last && clist->pcs.empty())
+                {
+                    //no active threads, move to the next possible start
+                    if (matched || pos >= n) break;
+                    ++pos;
+                    if (use_first)
+                    {
+                        while (pos < n && !first.test(data[pos])) ++pos;
+                        if (pos == n) break;
+                    }
+                    ++gen;
+                    add(*clist, 0, pos, blank.data());
+                    continue;
+                }
+
+                ++gen;
+                nlist->clear();
+                //searching for the last match, a later start has priority
+                if (last && pos < n) add(*nlist, 0, pos + 1, blank.data());
+                for (size_t i = 0; i < clist->pcs.size(); ++i)
+                {
+                    auto pc = clist->pcs[i];
+                    auto caps = clist->caps.data() + i * nslots;
+                    auto &inst = insts[pc];
+                    bool ok = false;
+                    switch (inst.op)
+                    {
+                    case BYTE: ok = pos < n && data[pos] == inst.arg; break;
+                    case SET: ok = pos < n && sets[inst.arg].test(data[pos]); break;
+                    case ANY: ok = pos < n && data[pos] != '\n'; break;
+                    case ANY_NL: ok = pos < n; break;
+                    case MATCH:
+                        matched = true;
+                        slots->assign(caps, caps + nslots);
+                        //lower priority threads are no longer needed
+                        i = clist->pcs.size();
+                        break;
+                    default: break;
+                    }
+                    if (ok) add(*nlist, pc + 1, pos + 1, caps);
+                }
+                if (pos >= n) break;
+                ++pos;
+                if (!last && !matched) add(*nlist, 0, pos, blank.data());
+                std::swap(clist, nlist);
+            }
+            return matched;
+        }
+    }
+}
@@ -0,0 +1,139 @@
+#pragma once
+#include "StringView.hpp"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace slim
+{
+    namespace regex
+    {
+        /**Regular expression compiled to an NFA program, and matched by simulating all the NFA
+         * states in parallel (a Pike VM). Matching takes time linear in the length of the subject
+         * (times the program size), uses no recursion, and never backtracks, while still finding
+         * the same leftmost-first match and captures as a backtracking engine.
+         *
+         * The supported syntax is the common subset of Ruby and ECMAScript regular expressions:
+         * literals and escapes, ".", character classes (including \d \w \s \h and POSIX
+         * [:alpha:] style classes), the anchors ^ $ \A \z \Z \b \B, capturing and non-capturing
+         * groups, inline option groups, alternation, and greedy and lazy quantifiers.
+         * As in Ruby, ^ and $ match at line boundaries.
+         *
+         * Back references, look around, atomic groups, possessive quantifiers, named groups and
+         * non-ASCII characters in classes are not supported, compile returns nullptr so that the
+         * caller can use another implementation. Matching is by byte.
+         */
+        class Program
+        {
+        public:
+            /**Option flags, the same values as the Regexp constants.*/
+            enum Flags
+            {
+                IGNORECASE = 1,
+                /**Ignore whitespace and comments in the pattern.*/
+                EXTENDED = 2,
+                /**"." matches a new line.*/
+                MULTILINE = 4
+            };
+            enum : size_t { NO_MATCH = (size_t)-1 };
+
+            /**Compiles pattern.
+             * Returns nullptr if pattern uses unsupported or invalid syntax.
+             */
+            static std::unique_ptr<Program> compile(StringView pattern, int flags);
+
+            /**Number of capture groups, including group 0 for the whole match.*/
+            size_t group_count()const { return groups; }
+
+            /**Find the first match in str starting at or after start.
+             * On success sets slots to the begin and end offsets of each group, or NO_MATCH for
+             * groups that did not participate.
+             */
+            bool search(StringView str, size_t start, std::vector<size_t> *slots)const
+            {
+                return run(str, start, false, slots);
+            }
+            /**Find the match in str that starts last, as used by rindex and rpartition.
+             * The match must end within str.
+             */
+            bool search_last(StringView str, std::vector<size_t> *slots)const
+            {
+                return run(str, 0, true, slots);
+            }
+
+            enum Op : uint8_t
+            {
+                /**Consume the byte arg.*/
+                BYTE,
+                /**Consume a byte in sets[arg].*/
+                SET,
+                /**Consume any byte other than a new line.*/
+                ANY,
+                /**Consume any byte.*/
+                ANY_NL,
+                /**Continue at arg and then arg2, with arg preferred.*/
+                SPLIT,
+                JMP,
+                /**Record the position in slot arg.*/
+                SAVE,
+                /**Continue only if the Assertion arg holds.*/
+                ASSERT,
+                MATCH
+            };
+            enum Assertion : uint8_t
+            {
+                LINE_BEGIN,
+                LINE_END,
+                TEXT_BEGIN,
+                TEXT_END,
+                /**End of text, or before a final new line.*/
+                TEXT_END_NL,
+                WORD_BOUNDARY,
+                NOT_WORD_BOUNDARY
+            };
+            struct Inst
+            {
+                Op op;
+                uint32_t arg, arg2;
+            };
+            /**256 bit set of bytes.*/
+            struct ByteSet
+            {
+                uint64_t bits[4];
+
+                ByteSet() : bits() {}
+                bool test(unsigned char c)const { return (bits[c >> 6] >> (c & 63)) & 1; }
+                void set(unsigned char c) { bits[c >> 6] |= (uint64_t)1 << (c & 63); }
+                void set_range(unsigned char first, unsigned char last)
+                {
+                    for (unsigned c = first; c <= last; ++c) set((unsigned char)c);
+                }
+                void merge(const ByteSet &other)
+                {
+                    for (int i = 0; i < 4; ++i) bits[i] |= other.bits[i];
+                }
+                void invert()
+                {
+                    for (int i = 0; i < 4; ++i) bits[i] = ~bits[i];
+                }
+                bool all()const
+                {
+                    return (bits[0] & bits[1] & bits[2] & bits[3]) == ~(uint64_t)0;
+                }
+            };
+        private:
+            friend class Compiler;
+            std::vector<Inst> insts;
+            std::vector<ByteSet> sets;
+            size_t groups;
+            /**Bytes that can start a match, used to skip ahead when there are no active states.*/
+            ByteSet first;
+            /**If first can be used, false if the pattern can match without consuming a byte.*/
+            bool use_first;
+
+            Program() : insts(), sets(), groups(0), first(), use_first(false) {}
+            bool run(StringView str, size_t start, bool last, std::vector<size_t> *slots)const;
+            void compute_first();
+        };
+    }
+}
@@ -0,0 +1,387 @@
+#include "StringSearch.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__)
+#   define SLIM_SEARCH_AVX2
+#   include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#   define SLIM_SEARCH_SSE2
+#   include <emmintrin.h>
+#endif
+#if defined(_MSC_VER)
+#   include <intrin.h>
+#endif
+
+namespace slim
+{
+    namespace search
+    {
+        namespace
+        {
+            unsigned lowest_bit(uint32_t mask)
+            {
+#if defined(_MSC_VER)
+                unsigned long i;
+                _BitScanForward(&i, mask);
+                return (unsigned)i;
+#else
+                return (unsigned)__builtin_ctz(mask);
+#endif
+            }
+            unsigned highest_bit(uint32_t mask)
+            {
+#if defined(_MSC_VER)
+                unsigned long i;
+                _BitScanReverse(&i, mask);
+                return (unsigned)i;
+#else
+                return 31 - (unsigned)__builtin_clz(mask);
+#endif
+            }
+
+            /**Bytes read forwards from p.*/
+            struct Forward
+            {
+                const unsigned char *p;
+                unsigned char operator[](size_t i)const { return p[i]; }
+            };
+            /**Bytes read backwards from end, for searching from the end with Two-Way on the
+             * reversed haystack and needle.
+             */
+            struct Backward
+            {
+                const unsigned char *end;
+                unsigned char operator[](size_t i)const { return *(end - 1 - i); }
+            };
+
+            /**Critical factorization for Two-Way, returns the position and sets the period.*/
+            template<class Text>
+            size_t critical_factorization(const Text &needle, size_t m, size_t *period)
+            {
+                //maximal suffix for < and then for >, the later one is critical
+                size_t max_suffix = (size_t)-1, j = 0, k = 1, p = 1;
+                while (j + k < m)
+                {
+                    auto a = needle[j + k], b = needle[max_suffix + k];
+                    if (a < b)
+                    {
+                        j += k;
+                        k = 1;
+                        p = j - max_suffix;
+                    }
+                    else if (a == b)
+                    {
+                        if (k != p) ++k;
+                        else
+                        {
+                            j += p;
+                            k = 1;
+                        }
+                    }
+                    else
+                    {
+                        max_suffix = j++;
+                        k = p = 1;
+                    }
+                }
+                *period = p;
+
+                size_t max_suffix_rev = (size_t)-1;
+                j = 0;
+                k = p = 1;
+                while (j + k < m)
+                {
+                    auto a = needle[j + k], b = needle[max_suffix_rev + k];
+                    if (b < a)
+                    {
+                        j += k;
+                        k = 1;
+                        p = j - max_suffix_rev;
+                    }
+                    else if (a == b)
+                    {
+                        if (k != p) ++k;
+                        else
+                        {
+                            j += p;
+                            k = 1;
+                        }
+                    }
+                    else
+                    {
+                        max_suffix_rev = j++;
+                        k = p = 1;
+                    }
+                }
+                if (max_suffix_rev + 1 < max_suffix + 1) return max_suffix + 1;
+                *period = p;
+                return max_suffix_rev + 1;
+            }
+            /**Two-Way search of haystack h of length n for needle of length m.*/
+            template<class Text>
+            size_t two_way(const Text &h, size_t n, const Text &needle, size_t m)
+            {
+                size_t period;
+                auto suffix = critical_factorization(needle, m, &period);
+                size_t j = 0;
+                size_t same = 0;
+                while (same < suffix && needle[same] == needle[same + period]) ++same;
+                if (same == suffix)
+                {
+                    //periodic needle, remember how much of the left part is already known to match
+                    size_t memory = 0;
+                    while (j <= n - m)
+                    {
+                        auto i = std::max(suffix, memory);
+                        while (i < m && needle[i] == h[i + j]) ++i;
+                        if (i >= m)
+                        {
+                            i = suffix - 1;
+                            while (memory < i + 1 && needle[i] == h[i + j]) --i;
+                            if (i + 1 < memory + 1) return j;
+                            j += period;
+                            memory = m - period;
+                        }
+                        else
+                        {
+                            j += i - suffix + 1;
+                            memory = 0;
+                        }
+                    }
+                }
+                else
+                {
+                    period = std::max(suffix, m - suffix) + 1;
+                    while (j <= n - m)
+                    {
+                        auto i = suffix;
+                        while (i < m && needle[i] == h[i + j]) ++i;
+                        if (i >= m)
+                        {
+                            i = suffix - 1;
+                            while (i != (size_t)-1 && needle[i] == h[i + j]) --i;
+                            if (i == (size_t)-1) return j;
+                            j += period;
+                        }
+                        else j += i - suffix + 1;
+                    }
+                }
+                return NOT_FOUND;
+            }
+            size_t find_two_way(const char *haystack, size_t n, const char *needle, size_t m)
+            {
+                return two_way(Forward{ (const unsigned char*)haystack }, n, Forward{ (const unsigned char*)needle }, m);
+            }
+            /**The last match using Two-Way on the reversed haystack and needle.*/
+            size_t rfind_two_way(const char *haystack, size_t n, const char *needle, size_t m)
+            {
+                auto r = two_way(Backward{ (const unsigned char*)haystack + n }, n, Backward{ (const unsigned char*)needle + m }, m);
+                return r == NOT_FOUND ? NOT_FOUND : n - r - m;
+            }
+
+            /**Approximate frequency of each byte in typical text, higher is more common.
+             * Used to pick the needle bytes least likely to match by chance for the filter.
+             */
+            unsigned byte_rank(unsigned char c)
+            {
+                //position of each letter in "etaoinshrdlcumwfgypbvkjxqz"
+                static const unsigned char LETTER_ORDER[26] = {
+                    2, 19, 11, 9, 0, 15, 16, 7, 4, 22, 21, 10, 13, 5, 3, 18, 24, 8, 6, 1, 12, 20, 14, 23, 17, 25 };
+                if (c == ' ') return 255;
+                unsigned lower = c | 0x20;
+                if (lower >= 'a' && lower <= 'z') return (c == lower ? 250u : 200u) - LETTER_ORDER[lower - 'a'];
+                if (c == '\n' || c == ',' || c == '.' || c == '\t') return 210;
+                if (c >= '0' && c <= '9') return 160;
+                if (c >= 0x80) return 150; //UTF-8 sequences
+                if (c >= 0x20 && c < 0x7F) return 100;
+                return 50;
+            }
+
+            /**Compares two bytes of the needle at each candidate position.
+             * These are the two rarest bytes, so that few candidates need a full comparison.
+             */
+            struct Prefilter
+            {
+                size_t off1, off2;
+
+                Prefilter(const char *needle, size_t m) : off1(0), off2(0)
+                {
+                    auto rank = [needle](size_t i) { return byte_rank((unsigned char)needle[i]); };
+                    for (size_t i = 1; i < m; ++i)
+                    {
+                        if (rank(i) < rank(off1)) off1 = i;
+                    }
+                    if (m == 1)
+                    {
+                        off2 = 0;
+                        return;
+                    }
+                    off2 = off1 == 0 ? 1 : 0;
+                    for (size_t i = 0; i < m; ++i)
+                    {
+                        if (i != off1 && rank(i) < rank(off2)) off2 = i;
+                    }
+                }
+            };
+
+#if defined(SLIM_SEARCH_AVX2)
+            const size_t BLOCK = 32;
+            struct Filter
+            {
+                size_t off1, off2;
+                __m256i b1, b2;
+                Filter(const char *needle, const Prefilter &pre)
+                    : off1(pre.off1), off2(pre.off2),
+                    b1(_mm256_set1_epi8(needle[pre.off1])), b2(_mm256_set1_epi8(needle[pre.off2]))
+                {}
+                /**Bit i is set if both bytes match for the candidate p + i.*/
+                uint32_t mask(const char *p)const
+                {
+                    auto x = _mm256_loadu_si256((const __m256i*)(p + off1));
+                    auto y = _mm256_loadu_si256((const __m256i*)(p + off2));
+                    auto eq = _mm256_and_si256(_mm256_cmpeq_epi8(x, b1), _mm256_cmpeq_epi8(y, b2));
+                    return (uint32_t)_mm256_movemask_epi8(eq);
+                }
+            };
+#elif defined(SLIM_SEARCH_SSE2)
+            const size_t BLOCK = 16;
+            struct Filter
+            {
+                size_t off1, off2;
+                __m128i b1, b2;
+                Filter(const char *needle, const Prefilter &pre)
+                    : off1(pre.off1), off2(pre.off2),
+                    b1(_mm_set1_epi8(needle[pre.off1])), b2(_mm_set1_epi8(needle[pre.off2]))
+                {}
+                uint32_t mask(const char *p)const
+                {
+                    auto x = _mm_loadu_si128((const __m128i*)(p + off1));
+                    auto y = _mm_loadu_si128((const __m128i*)(p + off2));
+                    auto eq = _mm_and_si128(_mm_cmpeq_epi8(x, b1), _mm_cmpeq_epi8(y, b2));
+                    return (uint32_t)_mm_movemask_epi8(eq);
+                }
+            };
+#endif
+
+            /**Find using memchr for the rarest byte while it is rare in the haystack, else the
+             * block filter. For long needles switch to Two-Way if too many candidates need a full
+             * comparison, keeping the worst case linear.
+             */
+            size_t find_filter(const char *h, size_t n, const char *needle, size_t m)
+            {
+                Prefilter pre(needle, m);
+                auto b1 = needle[pre.off1], b2 = needle[pre.off2];
+                size_t candidates = n - m + 1;
+                size_t i = 0, checked = 0, found = NOT_FOUND;
+                //true if the search is complete, with the result in found
+                auto candidate = [&](size_t p) -> bool
+                {
+                    if (m >= TWO_WAY_MIN_NEEDLE && ++checked * 8 > p + 256)
+                    {
+                        auto r = find_two_way(h + p, n - p, needle, m);
+                        found = r == NOT_FOUND ? NOT_FOUND : r + p;
+                        return true;
+                    }
+                    if (std::memcmp(h + p, needle, m) != 0) return false;
+                    found = p;
+                    return true;
+                };
+
+                size_t hits = 0;
+                while (i < candidates)
+                {
+                    auto x = (const char*)std::memchr(h + i + pre.off1, b1, candidates - i);
+                    if (!x) return NOT_FOUND;
+                    auto p = (size_t)(x - h) - pre.off1;
+                    if (h[p + pre.off2] == b2 && candidate(p)) return found;
+                    i = p + 1;
+#if defined(SLIM_SEARCH_AVX2) || defined(SLIM_SEARCH_SSE2)
+                    //the byte is common here, memchr keeps stopping
+                    if (++hits >= 16 && hits * 64 > i) break;
+#endif
+                }
+#if defined(SLIM_SEARCH_AVX2) || defined(SLIM_SEARCH_SSE2)
+                Filter filter(needle, pre);
+                for (; i + BLOCK <= candidates; i += BLOCK)
+                {
+                    for (auto mask = filter.mask(h + i); mask; mask &= mask - 1)
+                    {
+                        if (candidate(i + lowest_bit(mask))) return found;
+                    }
+                }
+                for (; i < candidates; ++i)
+                {
+                    if (h[i + pre.off1] == b1 && h[i + pre.off2] == b2 && candidate(i)) return found;
+                }
+#endif
+                return NOT_FOUND;
+            }
+            /**find_filter from the end, switching to Two-Way on the reversed text in the same way.*/
+            size_t rfind_filter(const char *h, size_t n, const char *needle, size_t m)
+            {
+                Prefilter pre(needle, m);
+                size_t end = n - m + 1;
+                size_t checked = 0, found = NOT_FOUND;
+                //true if the search is complete, with the result in found
+                auto candidate = [&](size_t p) -> bool
+                {
+                    if (m >= TWO_WAY_MIN_NEEDLE && ++checked * 8 > (n - m + 1 - p) + 256)
+                    {
+                        found = rfind_two_way(h, p + m, needle, m);
+                        return true;
+                    }
+                    if (std::memcmp(h + p, needle, m) != 0) return false;
+                    found = p;
+                    return true;
+                };
+#if defined(SLIM_SEARCH_AVX2) || defined(SLIM_SEARCH_SSE2)
+                Filter filter(needle, pre);
+                for (; end >= BLOCK; end -= BLOCK)
+                {
+                    auto base = end - BLOCK;
+                    for (auto mask = filter.mask(h + base); mask; mask &= ~((uint32_t)1 << highest_bit(mask)))
+                    {
+                        if (candidate(base + highest_bit(mask))) return found;
+                    }
+                }
+#endif
+                auto b1 = needle[pre.off1], b2 = needle[pre.off2];
+                for (size_t p = end; p-- > 0;)
+                {
+                    if (h[p + pre.off1] == b1 && h[p + pre.off2] == b2 && candidate(p)) return found;
+                }
+                return NOT_FOUND;
+            }
+        }
+
+        size_t find(const char *haystack, size_t n, const char *needle, size_t m)
+        {
+            if (m == 0) return 0;
+            if (m > n) return NOT_FOUND;
+            if (m == 1)
+            {
+                auto p = (const char*)std::memchr(haystack, needle[0], n);
+                return p ? (size_t)(p - haystack) : NOT_FOUND;
+            }
+            return find_filter(haystack, n, needle, m);
+        }
+        size_t rfind(const char *haystack, size_t n, const char *needle, size_t m)
+        {
+            if (m == 0) return n;
+            if (m > n) return NOT_FOUND;
+            return rfind_filter(haystack, n, needle, m);
+        }
+        const char *filter_name()
+        {
+#if defined(SLIM_SEARCH_AVX2)
+            return "avx2";
+#elif defined(SLIM_SEARCH_SSE2)
+            return "sse2";
+#else
+            return "scalar";
+#endif
+        }
+    }
+}
@@ -2,10 +2,166 @@
 #include "expression/Scope.hpp"
 #include "template/Lexer.hpp"
 #include "template/Parser.hpp"
-#include <fstream>
+#include "Util.hpp"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#ifdef _WIN32
+#   define WIN32_LEAN_AND_MEAN
+#   define NOMINMAX
+#   include <windows.h>
+#else
+#   include <dirent.h>
+#   include <fcntl.h>
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <unistd.h>
+#endif
 
 namespace slim
 {
+    namespace
+    {
+        /**A read only memory mapping of an entire file.*/
+        class MappedFile
+        {
+        public:
+            explicit MappedFile(const std::string &path)
+                : _data(nullptr), _size(0)
+            {
+#ifdef _WIN32
+                file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+                mapping = nullptr;
+                LARGE_INTEGER size;
+                if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &size)) fail(path);
+                _size = (size_t)size.QuadPart;
+                if (_size == 0) return;
+                mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+                if (!mapping) fail(path);
+                _data = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+                if (!_data) fail(path);
+#else
+                int fd = open(path.c_str(), O_RDONLY);
+                struct stat st;
+                if (fd < 0) throw std::runtime_error("Failed to load " + path);
+                if (fstat(fd, &st) != 0)
+                {
+                    close(fd);
+                    throw std::runtime_error("Failed to load " + path);
+                }
+                _size = (size_t)st.st_size;
+                if (_size != 0)
+                {
+                    auto p = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+                    if (p != MAP_FAILED) _data = (const char*)p;
+                }
+                close(fd);
+                if (_size != 0 && !_data) throw std::runtime_error("Failed to load " + path);
+#endif
+            }
+            MappedFile(const MappedFile&) = delete;
+            MappedFile& operator = (const MappedFile&) = delete;
+            ~MappedFile()
+            {
+                release();
+            }
+
+            const char *data()const { return _size ? _data : ""; }
+            size_t size()const { return _size; }
+        private:
+            const char *_data;
+            size_t _size;
+#ifdef _WIN32
+            HANDLE file, mapping;
+
+            void fail(const std::string &path)
+            {
+                release();
+                throw std::runtime_error("Failed to load " + path);
+            }
+#endif
+            void release()
+            {
+#ifdef _WIN32
+                if (_data) UnmapViewOfFile(_data);
+                if (mapping) CloseHandle(mapping);
+                if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+#else
+                if (_data) munmap((void*)_data, _size);
+#endif
+            }
+        };
+
+        /**Match a file name against a pattern, where '*' matches any characters and '?' any one.*/
+        bool match_pattern(const std::string &pattern, const std::string &name)
+        {
+            size_t p = 0, n = 0;
+            //position of the last '*', and the name position it is currently matching up to
+            size_t star = std::string::npos, star_n = 0;
+            while (n < name.size())
+            {
+                if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == name[n]))
+                {
+                    ++p;
+                    ++n;
+                }
+                else if (p < pattern.size() && pattern[p] == '*')
+                {
+                    star = p++;
+                    star_n = n;
+                }
+                else if (star != std::string::npos)
+                {
+                    p = star + 1;
+                    n = ++star_n;
+                }
+                else return false;
+            }
+            while (p < pattern.size() && pattern[p] == '*') ++p;
+            return p == pattern.size();
+        }
+
+        /**Append the paths relative to root of files matching pattern in dir and its sub directories.*/
+        void list_files(const std::string &root, const std::string &dir, const std::string &pattern, std::vector<std::string> &out)
+        {
+            auto dir_path = dir.empty() ? root : root + "/" + dir;
+            auto add = [&](const std::string &name, bool is_dir)
+            {
+                if (name == "." || name == "..") return;
+                auto rel = dir.empty() ? name : dir + "/" + name;
+                if (is_dir) list_files(root, rel, pattern, out);
+                else if (match_pattern(pattern, name)) out.push_back(rel);
+            };
+#ifdef _WIN32
+            WIN32_FIND_DATAA entry;
+            auto find = FindFirstFileA((dir_path + "/*").c_str(), &entry);
+            if (find == INVALID_HANDLE_VALUE) throw std::runtime_error("Failed to list " + dir_path);
+            do
+            {
+                add(entry.cFileName, (entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0);
+            }
+            while (FindNextFileA(find, &entry));
+            FindClose(find);
+#else
+            auto d = opendir(dir_path.c_str());
+            if (!d) throw std::runtime_error("Failed to list " + dir_path);
+            std::vector<std::pair<std::string, bool>> entries;
+            while (auto entry = readdir(d))
+            {
+                std::string name = entry->d_name;
+                struct stat st;
+                if (name == "." || name == ".." || stat((dir_path + "/" + name).c_str(), &st) != 0) continue;
+                if (S_ISDIR(st.st_mode) || S_ISREG(st.st_mode)) entries.emplace_back(name, S_ISDIR(st.st_mode));
+            }
+            closedir(d);
+            for (auto &entry : entries) add(entry.first, entry.second);
+#endif
+        }
+    }
+
     Template parse_template(const char *str, size_t len)
     {
         tpl::Lexer lexer(str, str + len);
@@ -28,18 +184,76 @@ namespace slim
 
     Template parse_template_file(const std::string &path)
     {
-        std::ifstream is(path, std::ios::in | std::ios::binary);
-        is.seekg(0, std::ios::end);
-        size_t size = is.tellg();
-        std::unique_ptr<char[]> str(new char[size]);
-        is.seekg(0, std::ios::beg);
-        is.read(str.get(), size);
-
-        if (is.tellg() != (std::streampos)size) throw std::runtime_error("Failed to load " + path);
-
-        tpl::Lexer lexer(str.get(), str.get() + size);
+        // The template does not reference the source text once parsed, so it can be read
+        // straight from the mapping rather than copied first
+        MappedFile file(path);
+        tpl::Lexer lexer(file.data(), file.data() + file.size());
         lexer.file_name(path);
         tpl::Parser parser(lexer);
         return parser.parse();
     }
+
+    TemplateDirectory parse_template_directory(const std::string &path, const std::string &pattern, unsigned threads)
+    {
+        std::vector<std::string> names;
+        list_files(path, "", pattern, names);
+        std::sort(names.begin(), names.end());
+
+        struct Result
+        {
+            std::unique_ptr<Template> tpl;
+            std::unique_ptr<SyntaxError> error;
+            std::exception_ptr exception;
+            std::chrono::microseconds time;
+        };
+        std::vector<Result> results(names.size());
+        std::atomic<size_t> next(0);
+        auto worker = [&]()
+        {
+            for (size_t i; (i = next.fetch_add(1)) < names.size();)
+            {
+                auto &result = results[i];
+                auto start = std::chrono::steady_clock::now();
+                try
+                {
+                    result.tpl = slim::make_unique<Template>(parse_template_file(path + "/" + names[i]));
+                }
+                catch (const SyntaxError &e)
+                {
+                    result.error = slim::make_unique<SyntaxError>(e);
+                }
+                catch (...)
+                {
+                    result.exception = std::current_exception();
+                }
+                result.time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+            }
+        };
+
+        if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+        threads = (unsigned)std::min<size_t>(threads, names.size());
+        std::vector<std::thread> workers;
+        workers.reserve(threads);
+        try
+        {
+            for (unsigned i = 1; i < threads; ++i) workers.emplace_back(worker);
+        }
+        catch (const std::system_error &)
+        {
+            //could not start a thread, so make do with fewer
+        }
+        worker();
+        for (auto &thread : workers) thread.join();
+
+        TemplateDirectory dir;
+        for (size_t i = 0; i < names.size(); ++i)
+        {
+            auto &result = results[i];
+            if (result.exception) std::rethrow_exception(result.exception);
+            if (result.tpl) dir.templates.emplace(names[i], std::move(*result.tpl));
+            else dir.errors.push_back(*result.error);
+            dir.parse_times[names[i]] = result.time;
+        }
+        return dir;
+    }
 }
@@ -1,6 +1,15 @@
 #include "Unicode.hpp"
+#include <algorithm>
 #include <stdexcept>
 
+#if defined(__AVX2__)
+#   define SLIM_UTF8_AVX2
+#   include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#   define SLIM_UTF8_SSE2
+#   include <emmintrin.h>
+#endif
+
 namespace slim
 {
     /**Decode 10xx xxx element.*/
@@ -77,4 +86,116 @@ namespace slim
         else if (uc < 0xF8) return 4;
         else return 1;
     }
+
+    namespace
+    {
+#if defined(SLIM_UTF8_AVX2)
+        const size_t BLOCK = 32;
+        /**Bit i is set if element i is not ASCII.*/
+        uint32_t non_ascii_mask(const unsigned char *p)
+        {
+            return (uint32_t)_mm256_movemask_epi8(_mm256_loadu_si256((const __m256i*)p));
+        }
+        /**Bit i is set if element i is not a 10xx xxxx trailing element.*/
+        uint32_t leading_mask(const unsigned char *p)
+        {
+            auto x = _mm256_loadu_si256((const __m256i*)p);
+            //as signed, trailing elements are -128 to -65
+            return (uint32_t)_mm256_movemask_epi8(_mm256_cmpgt_epi8(x, _mm256_set1_epi8(-65)));
+        }
+#elif defined(SLIM_UTF8_SSE2)
+        const size_t BLOCK = 16;
+        uint32_t non_ascii_mask(const unsigned char *p)
+        {
+            return (uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)p));
+        }
+        uint32_t leading_mask(const unsigned char *p)
+        {
+            auto x = _mm_loadu_si128((const __m128i*)p);
+            return (uint32_t)_mm_movemask_epi8(_mm_cmpgt_epi8(x, _mm_set1_epi8(-65)));
+        }
+#endif
+#if defined(SLIM_UTF8_AVX2) || defined(SLIM_UTF8_SSE2)
+        unsigned popcount(uint32_t x)
+        {
+            x = x - ((x >> 1) & 0x55555555);
+            x = (x & 0x33333333) + ((x >> 2) & 0x33333333);
+            return (((x + (x >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24;
+        }
+#endif
+
+        bool is_trailing(unsigned char el)
+        {
+            return (el & 0xC0) == 0x80;
+        }
+        size_t count_leading(const unsigned char *str, size_t len)
+        {
+            size_t count = 0, i = 0;
+#if defined(SLIM_UTF8_AVX2) || defined(SLIM_UTF8_SSE2)
+            for (; i + BLOCK <= len; i += BLOCK) count += popcount(leading_mask(str + i));
+#endif
+            for (; i < len; ++i) count += is_trailing(str[i]) ? 0 : 1;
+            return count;
+        }
+    }
+
+    unsigned utf8_valid_len(const char *_str, size_t avail)
+    {
+        auto str = (const unsigned char*)_str;
+        auto c0 = str[0];
+        if (c0 < 0x80) return 1;
+        if (c0 < 0xC2) return 0; //trailing element, or overlong 2 element form
+        if (c0 < 0xE0) return avail >= 2 && is_trailing(str[1]) ? 2 : 0;
+        if (c0 < 0xF0)
+        {
+            if (avail < 3 || !is_trailing(str[1]) || !is_trailing(str[2])) return 0;
+            if (c0 == 0xE0 && str[1] < 0xA0) return 0; //overlong
+            if (c0 == 0xED && str[1] >= 0xA0) return 0; //UTF-16 surrogate
+            return 3;
+        }
+        if (c0 < 0xF5)
+        {
+            if (avail < 4 || !is_trailing(str[1]) || !is_trailing(str[2]) || !is_trailing(str[3])) return 0;
+            if (c0 == 0xF0 && str[1] < 0x90) return 0; //overlong
+            if (c0 == 0xF4 && str[1] >= 0x90) return 0; //above U+10FFFF
+            return 4;
+        }
+        return 0;
+    }
+
+    Utf8Info utf8_scan(const char *_str, size_t len)
+    {
+        auto str = (const unsigned char*)_str;
+        Utf8Info info = { 0, true, true };
+        size_t i = 0;
+        while (i < len)
+        {
+#if defined(SLIM_UTF8_AVX2) || defined(SLIM_UTF8_SSE2)
+            if (i + BLOCK <= len && non_ascii_mask(str + i) == 0)
+            {
+                info.length += BLOCK;
+                i += BLOCK;
+                continue;
+            }
+            //a code point may continue past the block
+            auto end = std::min(len, i + BLOCK);
+#else
+            auto end = len;
+#endif
+            while (i < end)
+            {
+                auto n = utf8_valid_len(_str + i, len - i);
+                if (n == 0)
+                {
+                    info.ascii = info.valid = false;
+                    info.length += count_leading(str + i, len - i);
+                    return info;
+                }
+                if (n > 1) info.ascii = false;
+                ++info.length;
+                i += n;
+            }
+        }
+        return info;
+    }
 }
@@ -1,4 +1,5 @@
 #pragma once
+#include <cstddef>
 #include <cstdint>
 
 namespace slim
@@ -16,4 +17,24 @@ namespace slim
     bool utf8_is_leading(char c);
     /**Returns the byte length of the UTF-8 codepoint based on a leading element.*/
     unsigned short utf8_next_len(char c);
+
+    /**Returns the byte length of the well formed UTF-8 codepoint at str, or 0 if it is invalid.
+     * @param avail Number of bytes available at str, which need not be null terminated.
+     */
+    unsigned utf8_valid_len(const char *str, size_t avail);
+
+    /**Result of utf8_scan.*/
+    struct Utf8Info
+    {
+        /**Number of leading elements, which for valid UTF-8 is the number of code points.*/
+        size_t length;
+        /**True if every element is in the range 0 to 127.*/
+        bool ascii;
+        /**True if well formed, with no overlong forms, surrogates or values above U+10FFFF.*/
+        bool valid;
+    };
+    /**Validates and counts len bytes of UTF-8 in one pass, str need not be null terminated.
+     * Runs of ASCII are checked a block at a time with SSE2 or AVX2 when enabled for the build.
+     */
+    Utf8Info utf8_scan(const char *str, size_t len);
 }
@@ -1,4 +1,5 @@
 #include "Util.hpp"
+#include "types/Deferred.hpp"
 #include "types/HtmlSafeString.hpp"
 namespace slim
 {
@@ -6,18 +7,7 @@ namespace slim
     {
         std::string buf;
         buf.reserve(str.size());
-        for (auto c : str)
-        {
-            switch (c)
-            {
-            case '&': buf += "&amp;"; break;
-            case '<': buf += "&lt;"; break;
-            case '>': buf += "&gt;"; break;
-            case '"': buf += "&quot;"; break;
-            case '\'': buf += "&#39;"; break;
-            default: buf += c; break;
-            }
-        }
+        html_escape_append(buf, str.data(), str.size());
         return buf;
     }
 
@@ -27,9 +17,56 @@ namespace slim
         {
             return safe->get_value();
         }
+        else if (auto deferred = dynamic_cast<const Deferred*>(obj))
+        {
+            return html_escape(deferred->value().get());
+        }
         else
         {
             return html_escape(obj->to_string());
         }
     }
+
+    void html_escape_append(std::string &out, const char *str, size_t len)
+    {
+        //copy runs of plain characters in one go
+        auto end = str + len;
+        auto run = str;
+        for (auto p = str; p != end; ++p)
+        {
+            const char *entity;
+            switch (*p)
+            {
+            case '&': entity = "&amp;"; break;
+            case '<': entity = "&lt;"; break;
+            case '>': entity = "&gt;"; break;
+            case '"': entity = "&quot;"; break;
+            case '\'': entity = "&#39;"; break;
+            default: continue;
+            }
+            out.append(run, p);
+            out += entity;
+            run = p + 1;
+        }
+        out.append(run, end);
+    }
+
+    void html_escape_append(std::string &out, const Object *obj)
+    {
+        if (auto str = dynamic_cast<const String*>(obj))
+        {
+            auto view = str->view();
+            if (dynamic_cast<const HtmlSafeString*>(obj)) out.append(view.data(), view.size());
+            else html_escape_append(out, view.data(), view.size());
+        }
+        else if (auto deferred = dynamic_cast<const Deferred*>(obj))
+        {
+            html_escape_append(out, deferred->value().get());
+        }
+        else
+        {
+            auto value = obj->to_string();
+            html_escape_append(out, value.data(), value.size());
+        }
+    }
 }
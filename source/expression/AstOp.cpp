@@ -120,9 +120,36 @@ namespace slim
         {
             return lhs->to_string() + "[" + FuncCall::to_string() + "]";
         }
+        ElementRefOp::ElementRefOp(ExpressionNodePtr &&lhs, Args &&args)
+            : FuncCall(std::move(args)), lhs(std::move(lhs)), sym_key(), shape_slot(0)
+        {
+            if (this->args.size() == 1)
+            {
+                if (auto literal = dynamic_cast<const Literal*>(this->args[0].get()))
+                {
+                    sym_key = std::dynamic_pointer_cast<Symbol>(literal->value);
+                }
+            }
+        }
         ObjectPtr ElementRefOp::eval(Scope & scope) const
         {
             auto self = lhs->eval(scope);
+            if (sym_key && typeid(*self) == typeid(Hash))
+            {
+                auto hash = static_cast<Hash*>(self.get());
+                if (auto shape = hash->get_shape())
+                {
+                    auto cached = shape_slot.load(std::memory_order_relaxed);
+                    if ((uint32_t)(cached >> 32) == shape->id())
+                    {
+                        return hash->get_slot((uint32_t)cached);
+                    }
+                    auto slot = shape->find(sym_key.get());
+                    if (slot == HashShape::NOT_FOUND) return hash->get_default();
+                    shape_slot.store(((uint64_t)shape->id() << 32) | slot, std::memory_order_relaxed);
+                    return hash->get_slot(slot);
+                }
+            }
             auto args = eval_args(scope);
             return self->el_ref(args);
         }
@@ -201,6 +228,11 @@ namespace slim
             }
         }
 
+        InterpolatedString::InterpolatedString(Nodes &&_nodes)
+            : nodes(std::move(_nodes)), literal_size(0)
+        {
+            for (auto &node : nodes) literal_size += node.literal_text.size();
+        }
         std::string InterpolatedString::to_string() const
         {
             std::string buf = "\"";
@@ -214,11 +246,35 @@ namespace slim
         }
         ObjectPtr InterpolatedString::eval(Scope & scope) const
         {
+            //evaluate all the expressions first to size the result
+            std::vector<ObjectPtr> values;
+            std::vector<std::string> converted;
+            auto size = literal_size;
+            for (auto &node : nodes)
+            {
+                if (!node.expr) continue;
+                values.push_back(node.expr->eval(scope));
+                if (auto str = dynamic_cast<const String*>(values.back().get())) size += str->view().size();
+                else
+                {
+                    converted.push_back(values.back()->to_string());
+                    size += converted.back().size();
+                }
+            }
+
             std::string buf;
+            buf.reserve(size);
+            auto value = values.begin();
+            auto next_converted = converted.begin();
             for (auto &node : nodes)
             {
-                if (node.expr) buf += node.expr->eval(scope)->to_string();
-                else buf += node.literal_text;
+                if (!node.expr) buf += node.literal_text;
+                else if (auto str = dynamic_cast<const String*>((value++)->get()))
+                {
+                    auto s = str->view();
+                    buf.append(s.data(), s.size());
+                }
+                else buf += *next_converted++;
             }
             return make_value(std::move(buf));
         }
@@ -234,7 +290,7 @@ namespace slim
         ObjectPtr InterpolatedRegex::eval(Scope &scope)const
         {
             auto str = src->eval(scope);
-            return create_object<Regexp>(coerce<String>(str)->get_value(), opts);
+            return RegexpCache::instance().get(coerce<String>(str)->get_value(), opts);
         }
 }
 }
@@ -26,7 +26,7 @@ namespace slim
     namespace expr
     {
         Parser::Parser(const LocalVarNames &vars, Lexer &lexer)
-            : lexer(lexer), current_token(), vars(vars)
+            : lexer(lexer), current_token(), vars(vars), assigned_vars(), called_methods(), main_yield_count(0)
         {
             next();
         }
@@ -55,6 +55,7 @@ namespace slim
                 {
                     auto name = current_token.str;
                     vars.add(name);
+                    assigned_vars.push_back(name);
 
                     next();
                     auto rhs = full_expression();
@@ -122,7 +123,7 @@ namespace slim
             {
             case Token::STRING_DELIM: return interp_string();
             case Token::DIV: return regex_literal();
-            case Token::NUMBER: return lit(make_value(parse_num()));
+            case Token::NUMBER: return lit(parse_num());
             case Token::NAME:
                 if (current_token.str == "true") return lit(TRUE_VALUE);
                 else if (current_token.str == "false") return lit(FALSE_VALUE);
@@ -136,6 +137,8 @@ namespace slim
                         (!in_cond_op && is_func_arg_start()))
                     {   //local variables and constants are not callable, so must be method
                         FuncCall::Args args = func_args(false);
+                        called_methods.push_back(name);
+                        if (name == "yield" && args.empty()) ++main_yield_count;
                         return slim::make_unique<GlobalFuncCall>(symbol(name), std::move(args));
                     }
                     else if (vars.is_var(name))
@@ -149,6 +152,8 @@ namespace slim
                     }
                     else
                     {   //method call with no args
+                        called_methods.push_back(name);
+                        if (name == "yield") ++main_yield_count;
                         return slim::make_unique<GlobalFuncCall>(symbol(name), FuncCall::Args());
                     }
                 }
@@ -640,6 +645,7 @@ namespace slim
                     next();
                     if (current_token.type != Token::NAME) error("Expected symbol");
                     auto name = symbol(current_token.str);
+                    called_methods.push_back(current_token.str);
 
                     next();
                     auto args = func_args(in_cond_op);
@@ -650,6 +656,7 @@ namespace slim
                     next();
                     if (current_token.type != Token::NAME) error("Expected symbol");
                     auto name = symbol(current_token.str);
+                    called_methods.push_back(current_token.str);
 
                     next();
                     auto args = func_args(in_cond_op);
@@ -682,18 +689,31 @@ namespace slim
         {
             throw SyntaxError(lexer.file_name(), current_token.line, current_token.offset, msg);
         }
-        double Parser::parse_num()const
+        std::shared_ptr<Number> Parser::parse_num()const
         {
+            auto &str = current_token.str;
             size_t count = 0;
+            if (str.find('.') == std::string::npos)
+            {
+                long long ret = 0;
+                try
+                {
+                    ret = std::stoll(str, &count);
+                }
+                catch (const std::out_of_range &) { count = 0; } //too large, use a double
+                catch (const std::exception &) { error("Invalid number: " + str); }
+                if (count && count == str.size()) return make_value(ret);
+            }
+
             double ret;
             try
             {
-                ret = std::stod(current_token.str, &count);
+                ret = std::stod(str, &count);
             }
             catch (const std::exception &) { count = 0; }
 
-            if (!count || count != current_token.str.size()) error("Invalid number: " + current_token.str);
-            return ret;
+            if (!count || count != str.size()) error("Invalid number: " + str);
+            return make_value(ret);
         }
     }
 }
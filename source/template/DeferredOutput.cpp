@@ -0,0 +1,91 @@
+#include "DeferredOutput.hpp"
+#include "expression/Scope.hpp"
+#include "Util.hpp"
+#include <cassert>
+#include <cstring>
+#include <typeinfo>
+namespace slim
+{
+    namespace tpl
+    {
+        DeferredOutput::DeferredOutput(std::string &buffer, expr::Scope &scope)
+            : buffer(buffer), scope(scope), placeholders(), previous(active())
+        {
+            active() = this;
+        }
+        DeferredOutput::~DeferredOutput()
+        {
+            assert(active() == this);
+            active() = previous;
+        }
+
+        DeferredOutput *&DeferredOutput::active()
+        {
+            thread_local DeferredOutput *current = nullptr;
+            return current;
+        }
+
+        void DeferredOutput::append_escaped(std::string &buffer, const ObjectPtr &value)
+        {
+            if (typeid(*value) != typeid(Deferred))
+            {
+                html_escape_append(buffer, value.get());
+                return;
+            }
+            auto deferred = std::static_pointer_cast<Deferred>(value);
+            auto out = active();
+            if (out && &out->buffer == &buffer)
+            {
+                out->add(deferred, nullptr);
+            }
+            else html_escape_append(buffer, deferred.get());
+        }
+        DeferredOutput *DeferredOutput::get(std::string &buffer, expr::Scope &scope)
+        {
+            auto out = active();
+            return out && &out->buffer == &buffer && &out->scope == &scope ? out : nullptr;
+        }
+
+        void DeferredOutput::add(std::shared_ptr<Deferred> value, Render render)
+        {
+            Placeholder placeholder = { buffer.size(), std::move(value), std::move(render) };
+            placeholders.push_back(std::move(placeholder));
+        }
+        std::shared_ptr<expr::Scope> DeferredOutput::copy_scope()const
+        {
+            auto copy = std::make_shared<expr::Scope>(scope.self());
+            for (auto &var : scope) copy->set(var.first, var.second);
+            return copy;
+        }
+
+        void DeferredOutput::finish()
+        {
+            if (placeholders.empty()) return;
+            // Values are taken in order, while any later ones continue to be produced
+            std::vector<std::string> values(placeholders.size());
+            size_t extra = 0;
+            for (size_t i = 0; i < placeholders.size(); ++i)
+            {
+                auto &placeholder = placeholders[i];
+                auto value = placeholder.value->value();
+                if (placeholder.render) placeholder.render(values[i], value);
+                else html_escape_append(values[i], value.get());
+                extra += values[i].size();
+            }
+            // Splice in place, moving the text after each placeholder back to make room
+            auto end = buffer.size();
+            buffer.resize(end + extra);
+            auto data = &buffer[0];
+            for (size_t i = placeholders.size(); i-- > 0;)
+            {
+                auto offset = placeholders[i].offset;
+                auto &value = values[i];
+                std::memmove(data + offset + extra, data + offset, end - offset);
+                extra -= value.size();
+                std::memcpy(data + offset + extra, value.data(), value.size());
+                end = offset;
+            }
+            placeholders.clear();
+        }
+    }
+}
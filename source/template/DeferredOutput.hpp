@@ -0,0 +1,73 @@
+#pragma once
+#include "types/Deferred.hpp"
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+namespace slim
+{
+    namespace expr
+    {
+        class Scope;
+    }
+    namespace tpl
+    {
+        /**Collects Deferred values output while rendering into a buffer, and splices them into
+         * the buffer once the rest of the render is finished, so that slow values are produced
+         * concurrently with rendering and with each other.
+         *
+         * The most recently created DeferredOutput on the current thread is active, but only for
+         * output to its own buffer. Output to any other buffer, such as the body of a loop or a
+         * capture block, waits for the value instead.
+         */
+        class DeferredOutput
+        {
+        public:
+            /**Renders a resolved value into a buffer.*/
+            typedef std::function<void(std::string &buffer, ObjectPtr value)> Render;
+
+            /**Make this the active DeferredOutput for buffer, until destroyed.
+             * @param scope The root scope of the render, see get.
+             */
+            DeferredOutput(std::string &buffer, expr::Scope &scope);
+            DeferredOutput(const DeferredOutput&) = delete;
+            DeferredOutput& operator = (const DeferredOutput&) = delete;
+            ~DeferredOutput();
+
+            /**Append value HTML escaped, or a placeholder if it is a Deferred and there is an
+             * active DeferredOutput for buffer.
+             */
+            static void append_escaped(std::string &buffer, const ObjectPtr &value);
+            /**The active DeferredOutput if it is for rendering into buffer with scope, else null.
+             * Deferring work that uses variables is limited to the root scope, which can be
+             * copied, as any inner scope will be gone before finish.
+             */
+            static DeferredOutput *get(std::string &buffer, expr::Scope &scope);
+
+            /**Add a placeholder at the end of the buffer, to be replaced by rendering the value.
+             * The render function is called by finish, on the rendering thread.
+             */
+            void add(std::shared_ptr<Deferred> value, Render render);
+            /**Copy the variables of the root scope, for use by a deferred Render.*/
+            std::shared_ptr<expr::Scope> copy_scope()const;
+            /**Wait for all the values, and replace the placeholders.
+             * Must be called before the buffer is used, any exceptions from the Deferred values
+             * are thrown here.
+             */
+            void finish();
+        private:
+            struct Placeholder
+            {
+                size_t offset;
+                std::shared_ptr<Deferred> value;
+                Render render;
+            };
+            std::string &buffer;
+            expr::Scope &scope;
+            std::vector<Placeholder> placeholders;
+            DeferredOutput *previous;
+
+            static DeferredOutput *&active();
+        };
+    }
+}
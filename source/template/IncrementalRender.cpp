@@ -0,0 +1,124 @@
+#include "template/IncrementalRender.hpp"
+#include "template/RenderProgram.hpp"
+#include "template/Template.hpp"
+#include "expression/Scope.hpp"
+#include "types/ViewModel.hpp"
+#include "Util.hpp"
+#include <algorithm>
+namespace slim
+{
+    namespace
+    {
+        /**Records reads from model into reads for its lifetime.*/
+        class RecordReads
+        {
+        public:
+            RecordReads(ViewModel &model, std::vector<SymPtr> &reads)
+                : model(model)
+            {
+                model.record_reads(&reads);
+            }
+            ~RecordReads()
+            {
+                model.record_reads(nullptr);
+            }
+        private:
+            ViewModel &model;
+        };
+    }
+
+    IncrementalRender::IncrementalRender(const Template &tpl, ViewModelPtr model, bool doctype)
+        : tpl(tpl), model(model), scope(slim::make_unique<expr::Scope>(model)), fragments()
+    {
+        auto &program = *tpl.program;
+        auto &ops = program.get_ops();
+        if (doctype)
+        {
+            Fragment fragment = { 0, 0, true, false, true, 0, {}, "<!DOCTYPE html>\n" };
+            fragments.push_back(std::move(fragment));
+        }
+        for (size_t begin = 0; begin < ops.size();)
+        {
+            auto end = program.block_end(begin);
+            Fragment fragment = { begin, end, false, false, false, 0, {}, {} };
+            for (auto i = begin; i < end; ++i)
+            {
+                if (ops[i].code == tpl::RenderOp::EVAL) fragment.code = true;
+            }
+            if (program.is_static(begin, end))
+            {
+                auto &op = ops[begin];
+                fragment.output.assign(program.get_text(), op.a, op.b);
+                fragment.text = true;
+                fragment.rendered = true;
+            }
+            fragments.push_back(std::move(fragment));
+            begin = end;
+        }
+    }
+    IncrementalRender::~IncrementalRender()
+    {}
+
+    std::string IncrementalRender::render()
+    {
+        render_changes();
+        size_t size = 0;
+        for (auto &fragment : fragments) size += fragment.output.size();
+        std::string out;
+        out.reserve(size);
+        for (auto &fragment : fragments) out += fragment.output;
+        return out;
+    }
+    std::vector<IncrementalRender::Change> IncrementalRender::render_changes()
+    {
+        std::vector<Change> changes;
+        //reads of earlier fragments that might have assigned a local variable
+        std::vector<SymPtr> inherited;
+        for (size_t id = 0; id < fragments.size(); ++id)
+        {
+            auto &fragment = fragments[id];
+            if (changed(fragment, inherited))
+            {
+                auto previous = std::move(fragment.output);
+                render(fragment);
+                if (fragment.output != previous)
+                {
+                    Change change = { id, fragment.output };
+                    changes.push_back(std::move(change));
+                }
+            }
+            if (fragment.code)
+            {
+                inherited.insert(inherited.end(), fragment.reads.begin(), fragment.reads.end());
+            }
+        }
+        return changes;
+    }
+
+    bool IncrementalRender::changed(const Fragment &fragment, const std::vector<SymPtr> &inherited)const
+    {
+        if (fragment.text) return false;
+        if (!fragment.rendered) return true;
+        auto changed_since = [this, &fragment](const SymPtr &name)
+        {
+            return model->get_version(name) > fragment.version;
+        };
+        return std::any_of(fragment.reads.begin(), fragment.reads.end(), changed_since) ||
+            std::any_of(inherited.begin(), inherited.end(), changed_since);
+    }
+    void IncrementalRender::render(Fragment &fragment)
+    {
+        fragment.rendered = false;
+        fragment.reads.clear();
+        fragment.output.clear();
+        fragment.version = model->get_version();
+        {
+            RecordReads record(*model, fragment.reads);
+            tpl.program->render(fragment.output, *scope, fragment.begin, fragment.end);
+        }
+        //the same name is often read many times, e.g. within a loop
+        std::sort(fragment.reads.begin(), fragment.reads.end());
+        fragment.reads.erase(std::unique(fragment.reads.begin(), fragment.reads.end()), fragment.reads.end());
+        fragment.rendered = true;
+    }
+}
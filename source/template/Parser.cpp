@@ -107,11 +107,11 @@ namespace slim
         };
 
         Parser::Parser(Lexer &lexer)
-            : lexer(lexer)
+            : lexer(lexer), main_yield_count(0)
         {}
 
         Parser::Parser(Lexer &lexer, const expr::LocalVarNames &local_vars)
-            : lexer(lexer), local_vars(local_vars)
+            : lexer(lexer), local_vars(local_vars), main_yield_count(0)
         {}
         Parser::~Parser()
         {}
@@ -122,7 +122,7 @@ namespace slim
             current_token = lexer.next_indent();
             parse_lines(-1, root);
             auto root_tpl = root.make_tpl();
-            return Template(std::move(root_tpl));
+            return Template(std::move(root_tpl), main_yield_count);
         }
 
         void Parser::parse_lines(int base_indent, OutputFrame &output)
@@ -198,12 +198,7 @@ namespace slim
         void Parser::parse_tag(int base_indent, OutputFrame & output)
         {
             //name, id and class
-            struct Attr
-            {
-                std::string name;
-                std::vector<std::string> static_values;
-                std::vector<expr::ExpressionNodePtr> dynamic_values;
-            };
+            typedef TemplateTagSplatAttrs::Attr Attr;
             std::vector<Attr> attributes;
             std::vector<expr::ExpressionNodePtr> splat_attributes;
             auto get_attr = [&attributes](const std::string &name) -> Attr&
@@ -290,7 +285,9 @@ namespace slim
                 expr_lexer.set_reported_pos(line, offset);
                 expr::Parser expr_parser(local_vars, expr_lexer);
 
-                return expr_parser.full_expression();
+                auto expr = expr_parser.full_expression();
+                add_names(expr_parser);
+                return expr;
             };
             if (current_token.type == Token::ATTR_WRAPPER_START)
             {
@@ -353,15 +350,8 @@ namespace slim
             }
             else
             {
-                TemplateTagSplatAttrs::Static static_attrs;
-                TemplateTagSplatAttrs::Dynamic dynamic_attrs;
-                for (auto &attr : attributes)
-                {
-                    for (auto &i : attr.static_values) static_attrs.emplace(attr.name, i);
-                    for (auto &i : attr.dynamic_values) dynamic_attrs.emplace(attr.name, std::move(i));
-                }
                 output << slim::make_unique<TemplateTagSplatAttrs>(
-                    std::move(static_attrs), std::move(dynamic_attrs), std::move(splat_attributes));
+                    std::move(attributes), std::move(splat_attributes));
             }
 
 
@@ -472,6 +462,7 @@ namespace slim
             expr::Parser expr_parser(local_vars, expr_lexer);
 
             *expr = expr_parser.full_expression();
+            add_names(expr_parser);
         }
 
         void Parser::parse_code_line(int base_indent, OutputFrame &output)
@@ -579,6 +570,25 @@ namespace slim
                     auto func_call = dynamic_cast<expr::FuncCall*>(expr.get());
                     if (!func_call) error("Found 'do' at end of line, but does not follow method call");
 
+                    auto parallel = dynamic_cast<expr::MemberFuncCall*>(expr.get());
+                    if (parallel && parallel->name->str() == "parallel_each")
+                    {
+                        if (!parallel->args.empty()) error("parallel_each does not take arguments");
+                        auto old_vars = local_vars;
+                        auto assigned_start = assigned_vars.size();
+                        auto called_start = called_methods.size();
+                        for (auto &param : params)
+                            local_vars.add(param->str());
+                        OutputFrame block_frame;
+                        parse_lines(base_indent, block_frame);
+                        check_parallel_block(old_vars, assigned_start, called_start);
+                        local_vars = old_vars;
+
+                        output << slim::make_unique<TemplateParallelEachExpr>(
+                            std::move(parallel->lhs), block_frame.make_tpl(), std::move(params));
+                        continue;
+                    }
+
                     //add new local variables for block call
                     auto old_vars = local_vars;
                     local_vars.add("output_buffer");
@@ -611,7 +621,9 @@ namespace slim
             expr_lexer.set_reported_pos(line, offset);
             expr_lexer.file_name(lexer.file_name());
             expr::Parser expr_parser(local_vars, expr_lexer);
-            return expr_parser.full_expression();
+            auto expr = expr_parser.full_expression();
+            add_names(expr_parser);
+            return expr;
         }
 
         std::string Parser::parse_code_src()
@@ -687,6 +699,7 @@ namespace slim
                     auto expr = expr_parser.expression();
                     if (expr_parser.get_last_token().type != expr::Token::R_CURLY_BRACKET)
                         error("Expected '}' to end interpolated text");
+                    add_names(expr_parser);
 
                     output << std::move(expr);
 
@@ -710,6 +723,7 @@ namespace slim
                 expr::Parser expr_parser(local_vars, expr_lexer);
 
                 auto stmt = expr_parser.statement();
+                add_names(expr_parser);
                 output << slim::make_unique<TemplateCodeBlock>(std::move(stmt));
 
                 local_vars = expr_parser.get_var_names(); // Code block may introduce new variables
@@ -718,6 +732,30 @@ namespace slim
             }
         }
 
+        void Parser::add_names(const expr::Parser &expr_parser)
+        {
+            auto &assigned = expr_parser.get_assigned_vars();
+            auto &called = expr_parser.get_called_methods();
+            assigned_vars.insert(assigned_vars.end(), assigned.begin(), assigned.end());
+            called_methods.insert(called_methods.end(), called.begin(), called.end());
+            main_yield_count += expr_parser.get_main_yield_count();
+        }
+
+        void Parser::check_parallel_block(const expr::LocalVarNames &outer_vars, size_t assigned_start, size_t called_start)
+        {
+            auto outer = outer_vars; //is_var is not const
+            for (auto i = assigned_start; i < assigned_vars.size(); ++i)
+            {
+                if (outer.is_var(assigned_vars[i]))
+                    error("parallel_each block can not assign the outer variable '" + assigned_vars[i] + "'");
+            }
+            for (auto i = called_start; i < called_methods.size(); ++i)
+            {
+                if (called_methods[i] == "content_for")
+                    error("parallel_each block can not call content_for");
+            }
+        }
+
         void Parser::error(const std::string &msg)
         {
             throw TemplateSyntaxError(lexer.file_name(), current_token.line, current_token.offset, msg);
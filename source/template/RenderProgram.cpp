@@ -0,0 +1,213 @@
+#include "template/RenderProgram.hpp"
+#include "DeferredOutput.hpp"
+#include "template/SegmentedOutput.hpp"
+#include "template/TemplateParts.hpp"
+#include "expression/AstOp.hpp"
+#include "types/HtmlSafeString.hpp"
+#include "types/Enumerator.hpp"
+#include "types/Proc.hpp"
+#include "Util.hpp"
+#include <algorithm>
+#include <cassert>
+namespace slim
+{
+    namespace tpl
+    {
+        RenderProgram::RenderProgram()
+            : text(), ops(), merge_start(0), expected_size(0)
+        {}
+        RenderProgram::RenderProgram(const TemplatePart &root)
+            : text(), ops(), merge_start(0), expected_size(0)
+        {
+            root.compile(*this);
+            ops.shrink_to_fit();
+            text.shrink_to_fit();
+        }
+
+        void RenderProgram::render(std::string &buffer, expr::Scope &scope)const
+        {
+            run(0, ops.size(), buffer, nullptr, scope);
+        }
+        void RenderProgram::render(SegmentedOutput &out, expr::Scope &scope)const
+        {
+            run(0, ops.size(), out.get_buffer(), &out, scope);
+        }
+        void RenderProgram::render(std::string &buffer, expr::Scope &scope, size_t begin, size_t end)const
+        {
+            run(begin, end, buffer, nullptr, scope);
+        }
+        void RenderProgram::render(SegmentedOutput &out, expr::Scope &scope, size_t begin, size_t end)const
+        {
+            run(begin, end, out.get_buffer(), &out, scope);
+        }
+
+        size_t RenderProgram::find_main_yield()const
+        {
+            size_t found = ops.size();
+            //end of the IF, else or FOR body containing the current op
+            size_t block_end = 0;
+            for (size_t i = 0; i < ops.size(); ++i)
+            {
+                auto &op = ops[i];
+                if (op.code == RenderOp::IF || op.code == RenderOp::JUMP || op.code == RenderOp::FOR_BEGIN)
+                {
+                    block_end = std::max<size_t>(block_end, op.a);
+                }
+                auto call = op.code == RenderOp::EVAL_ESCAPED ? dynamic_cast<const expr::GlobalFuncCall*>(op.expr) : nullptr;
+                if (call && call->args.empty() && call->name->str() == "yield")
+                {
+                    if (found != ops.size() || i < block_end) return ops.size();
+                    found = i;
+                }
+            }
+            return found;
+        }
+        size_t RenderProgram::block_end(size_t begin)const
+        {
+            size_t end = begin;
+            size_t block_end = begin + 1;
+            while (end < block_end)
+            {
+                auto &op = ops[end];
+                if (op.code == RenderOp::IF || op.code == RenderOp::JUMP) block_end = std::max<size_t>(block_end, op.a);
+                else if (op.code == RenderOp::FOR_BEGIN) block_end = std::max<size_t>(block_end, op.a + 1);
+                ++end;
+            }
+            return end;
+        }
+        bool RenderProgram::is_static(size_t begin, size_t end)const
+        {
+            for (auto i = begin; i < end; ++i)
+            {
+                if (ops[i].code != RenderOp::EMIT_STATIC) return false;
+            }
+            return true;
+        }
+
+        size_t RenderProgram::get_expected_size()const
+        {
+            auto expected = expected_size.load(std::memory_order_relaxed);
+            //some slack, so an output slightly above the average does not reallocate
+            return std::max(text.size(), expected + expected / 8);
+        }
+        void RenderProgram::record_size(size_t size)const
+        {
+            auto old = expected_size.load(std::memory_order_relaxed);
+            auto next = old ? old - old / 4 + size / 4 : size;
+            expected_size.store(next, std::memory_order_relaxed);
+        }
+
+        void RenderProgram::add_text(const std::string &str)
+        {
+            if (str.empty()) return;
+            if (ops.size() > merge_start && ops.back().code == RenderOp::EMIT_STATIC)
+            {
+                ops.back().b += (uint32_t)str.size();
+            }
+            else
+            {
+                auto i = add(RenderOp::EMIT_STATIC, nullptr);
+                ops[i].a = (uint32_t)text.size();
+                ops[i].b = (uint32_t)str.size();
+            }
+            text += str;
+        }
+        size_t RenderProgram::add(RenderOp::Code code, const Expression *expr, const TemplatePart *part)
+        {
+            RenderOp op = { code, 0, 0, expr, part };
+            ops.push_back(op);
+            return ops.size() - 1;
+        }
+        size_t RenderProgram::label()
+        {
+            merge_start = ops.size();
+            return ops.size();
+        }
+        void RenderProgram::set_target(size_t op, size_t target)
+        {
+            assert(ops[op].code == RenderOp::IF || ops[op].code == RenderOp::JUMP || ops[op].code == RenderOp::FOR_BEGIN);
+            ops[op].a = (uint32_t)target;
+        }
+
+        void RenderProgram::run(size_t begin, size_t end, std::string &buffer, SegmentedOutput *out, expr::Scope &scope)const
+        {
+            auto pc = begin;
+            while (pc < end)
+            {
+                auto &op = ops[pc];
+                switch (op.code)
+                {
+                case RenderOp::EMIT_STATIC:
+                    if (out) out->add_static(text.data() + op.a, op.b);
+                    else buffer.append(text, op.a, op.b);
+                    ++pc;
+                    break;
+                case RenderOp::EVAL_ESCAPED:
+                {
+                    auto value = op.expr->eval(scope);
+                    auto safe = out ? dynamic_cast<const HtmlSafeString*>(value.get()) : nullptr;
+                    if (safe)
+                    {
+                        auto view = safe->view();
+                        out->add_object(value, view.data(), view.size());
+                    }
+                    else DeferredOutput::append_escaped(buffer, value);
+                    ++pc;
+                    break;
+                }
+                case RenderOp::EVAL:
+                    op.expr->eval(scope);
+                    ++pc;
+                    break;
+                case RenderOp::ATTR:
+                    static_cast<const TemplateTagAttr*>(op.part)->TemplateTagAttr::render(buffer, scope);
+                    ++pc;
+                    break;
+                case RenderOp::PART:
+                    op.part->render(buffer, scope);
+                    ++pc;
+                    break;
+                case RenderOp::IF:
+                    pc = op.expr->eval(scope)->is_true() ? pc + 1 : op.a;
+                    break;
+                case RenderOp::JUMP:
+                    pc = op.a;
+                    break;
+                case RenderOp::FOR_BEGIN:
+                    run_for(pc, buffer, out, scope);
+                    pc = op.a + 1;
+                    break;
+                case RenderOp::FOR_END:
+                    ++pc;
+                    break;
+                }
+            }
+        }
+
+        void RenderProgram::run_for(size_t begin, std::string &buffer, SegmentedOutput *out, expr::Scope &scope)const
+        {
+            struct CallNode : public expr::ExpressionNode
+            {
+                CallNode(const RenderProgram *program, size_t begin, size_t end, std::string &buffer, SegmentedOutput *out)
+                    : program(program), begin(begin), end(end), buffer(buffer), out(out)
+                {}
+                virtual std::string to_string()const override { std::terminate(); }
+                virtual ObjectPtr eval(expr::Scope &scope)const override
+                {
+                    program->run(begin, end, buffer, out, scope);
+                    return NIL_VALUE;
+                }
+                const RenderProgram *program;
+                size_t begin, end;
+                std::string &buffer;
+                SegmentedOutput *out;
+            };
+            auto &op = ops[begin];
+            auto loop = static_cast<const TemplateForExpr*>(op.part);
+            CallNode call(this, begin + 1, op.a, buffer, out);
+            auto enumerator = coerce<Enumerator>(op.expr->eval(scope));
+            auto proc = std::make_shared<BlockProc>(call, loop->get_param_names(), scope);
+            enumerator->each({ proc });
+        }
+    }
+}
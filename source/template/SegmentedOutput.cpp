@@ -0,0 +1,97 @@
+#include "template/SegmentedOutput.hpp"
+#include "types/Object.hpp"
+namespace slim
+{
+    SegmentedOutput::SegmentedOutput(size_t min_segment)
+        : min_segment(min_segment), buffer(new std::string())
+        , pending(), buffer_start(0), retained(), retained_buffers(), segments(), resolved((size_t)-1)
+    {}
+    SegmentedOutput::SegmentedOutput(SegmentedOutput &&) = default;
+    SegmentedOutput& SegmentedOutput::operator = (SegmentedOutput &&) = default;
+    SegmentedOutput::~SegmentedOutput()
+    {}
+
+    void SegmentedOutput::add_static(const char *data, size_t size)
+    {
+        if (size < min_segment) buffer->append(data, size);
+        else add(data, size);
+    }
+    void SegmentedOutput::add_object(ObjectPtr obj, const char *data, size_t size)
+    {
+        if (size < min_segment) buffer->append(data, size);
+        else
+        {
+            retained.push_back(std::move(obj));
+            add(data, size);
+        }
+    }
+
+    void SegmentedOutput::append(SegmentedOutput &&other)
+    {
+        // other's buffer will not change again, so its segments can be resolved to pointers
+        for (auto &segment : other.get_segments()) add(segment.data, segment.size);
+        for (auto &obj : other.retained) retained.push_back(std::move(obj));
+        for (auto &buf : other.retained_buffers) retained_buffers.push_back(std::move(buf));
+        retained_buffers.push_back(std::move(other.buffer));
+        other = SegmentedOutput(other.min_segment);
+    }
+
+    const std::vector<SegmentedOutput::Segment> &SegmentedOutput::get_segments()
+    {
+        flush_buffer();
+        if (resolved != pending.size())
+        {
+            // The buffer may have been reallocated since the previous call, so resolve everything
+            segments.clear();
+            for (auto &p : pending)
+            {
+                Segment segment = { p.data ? p.data : buffer->data() + p.offset, p.size };
+                segments.push_back(segment);
+            }
+            resolved = pending.size();
+        }
+        return segments;
+    }
+    size_t SegmentedOutput::size()
+    {
+        size_t total = 0;
+        for (auto &segment : get_segments()) total += segment.size;
+        return total;
+    }
+    std::string SegmentedOutput::to_string()
+    {
+        std::string str;
+        str.reserve(size());
+        for (auto &segment : segments) str.append(segment.data, segment.size);
+        return str;
+    }
+    void SegmentedOutput::write(const std::function<void(const char *data, size_t size)> &write)
+    {
+        for (auto &segment : get_segments()) write(segment.data, segment.size);
+    }
+
+    void SegmentedOutput::add(const char *data, size_t size)
+    {
+        flush_buffer();
+        // Adjacent references, such as static text either side of an empty expression, are merged
+        if (!pending.empty() && pending.back().data && pending.back().data + pending.back().size == data)
+        {
+            pending.back().size += size;
+            resolved = (size_t)-1;
+        }
+        else
+        {
+            Pending p = { data, 0, size };
+            pending.push_back(p);
+        }
+    }
+    void SegmentedOutput::flush_buffer()
+    {
+        if (buffer->size() > buffer_start)
+        {
+            Pending p = { nullptr, buffer_start, buffer->size() - buffer_start };
+            pending.push_back(p);
+            buffer_start = buffer->size();
+        }
+    }
+}
@@ -1,12 +1,85 @@
 #include "template/Template.hpp"
+#include "template/RenderProgram.hpp"
+#include "DeferredOutput.hpp"
 #include "template/TemplatePart.hpp"
 #include "expression/Scope.hpp"
 #include "types/HtmlSafeString.hpp"
+#include "Util.hpp"
+#include <algorithm>
 namespace slim
 {
-    Template::Template(std::unique_ptr<tpl::TemplatePart> &&root)
-        : root(std::move(root))
-    {}
+    namespace
+    {
+        const char DOCTYPE[] = "<!DOCTYPE html>\n";
+        const size_t DOCTYPE_LEN = sizeof(DOCTYPE) - 1;
+        /**Most buffers a thread keeps.*/
+        const size_t POOL_MAX_BUFFERS = 4;
+        /**Larger buffers are not kept, so one huge page does not pin its memory forever.*/
+        const size_t POOL_MAX_CAPACITY = 16 * 1024 * 1024;
+
+        std::vector<std::string> &thread_buffers()
+        {
+            thread_local std::vector<std::string> buffers;
+            return buffers;
+        }
+    }
+
+    std::string RenderBufferPool::acquire(size_t capacity)
+    {
+        auto &buffers = thread_buffers();
+        // Smallest buffer that is large enough, so a small render does not take a large buffer
+        auto best = buffers.end();
+        for (auto i = buffers.begin(); i != buffers.end(); ++i)
+        {
+            if (i->capacity() >= capacity && (best == buffers.end() || i->capacity() < best->capacity()))
+            {
+                best = i;
+            }
+        }
+        std::string buffer;
+        if (best != buffers.end())
+        {
+            buffer = std::move(*best);
+            buffers.erase(best);
+        }
+        buffer.reserve(capacity);
+        return buffer;
+    }
+    void RenderBufferPool::release(std::string &&buffer)
+    {
+        if (buffer.capacity() > POOL_MAX_CAPACITY) return;
+        auto &buffers = thread_buffers();
+        buffer.clear();
+        if (buffers.size() < POOL_MAX_BUFFERS)
+        {
+            buffers.push_back(std::move(buffer));
+        }
+        else
+        {
+            // Keep the largest buffers
+            auto smallest = std::min_element(buffers.begin(), buffers.end(),
+                [](const std::string &a, const std::string &b) { return a.capacity() < b.capacity(); });
+            if (smallest->capacity() < buffer.capacity()) *smallest = std::move(buffer);
+        }
+    }
+    void RenderBufferPool::clear()
+    {
+        std::vector<std::string>().swap(thread_buffers());
+    }
+    size_t RenderBufferPool::size()
+    {
+        return thread_buffers().size();
+    }
+
+    Template::Template(std::unique_ptr<tpl::TemplatePart> &&root, size_t main_yields)
+        : root(std::move(root)), program(slim::make_unique<tpl::RenderProgram>(*this->root))
+        , layout_split(program->find_main_yield()), layout_static_prefix(false)
+    {
+        // Any other main yield, such as within a nested block or expression, would need the
+        // main content from the view model, which a split render does not set.
+        if (main_yields != 1) layout_split = program->get_ops().size();
+        layout_static_prefix = program->is_static(0, layout_split);
+    }
 
     Template::~Template()
     {}
@@ -16,23 +89,134 @@ namespace slim
 
     std::string Template::render(ViewModelPtr model, bool doctype)const
     {
-        std::string buffer;
-        if (doctype) buffer += "<!DOCTYPE html>\n";
-        expr::Scope scope(model);
-        root->render(buffer, scope);
+        auto buffer = RenderBufferPool::acquire((doctype ? DOCTYPE_LEN : 0) + program->get_expected_size());
+        render_into(buffer, model, doctype);
         return buffer;
     }
+    void Template::render_into(std::string &buffer, ViewModelPtr model, bool doctype)const
+    {
+        if (doctype) buffer.append(DOCTYPE, DOCTYPE_LEN);
+        auto start = buffer.size();
+        buffer.reserve(start + program->get_expected_size());
+        expr::Scope scope(model);
+        tpl::DeferredOutput deferred(buffer, scope);
+        program->render(buffer, scope);
+        deferred.finish();
+        program->record_size(buffer.size() - start);
+    }
+    SegmentedOutput Template::render_segments(ViewModelPtr model, bool doctype, size_t min_segment)const
+    {
+        SegmentedOutput out(min_segment);
+        if (doctype) out.add_static(DOCTYPE, DOCTYPE_LEN);
+        expr::Scope scope(model);
+        program->render(out, scope);
+        return out;
+    }
     std::string Template::render_partial(expr::Scope &scope)
     {
-        std::string buffer;
-        root->render(buffer, scope);
+        auto buffer = RenderBufferPool::acquire(program->get_expected_size());
+        program->render(buffer, scope);
+        program->record_size(buffer.size());
         return buffer;
     }
     std::string Template::render_layout(Template &layout, ViewModelPtr model, bool doctype)const
     {
-        auto main_content = render(model, false);
-        model->set_main_content(create_object<HtmlSafeString>(std::move(main_content)));
-        return layout.render(model, doctype);
+        auto buffer = RenderBufferPool::acquire((doctype ? DOCTYPE_LEN : 0) +
+            layout.program->get_expected_size() + program->get_expected_size());
+        render_layout_into(buffer, layout, model, doctype);
+        return buffer;
+    }
+    void Template::render_layout_into(std::string &buffer, Template &layout, ViewModelPtr model, bool doctype)const
+    {
+        auto &layout_program = *layout.program;
+        auto split = layout.layout_split;
+        auto end = layout_program.get_ops().size();
+        if (split == end)
+        {
+            auto main_content = render(model, false);
+            model->set_main_content(create_object<HtmlSafeString>(std::move(main_content)));
+            layout.render_into(buffer, model, doctype);
+            return;
+        }
+
+        if (doctype) buffer.append(DOCTYPE, DOCTYPE_LEN);
+        auto start = buffer.size();
+        buffer.reserve(start + layout_program.get_expected_size() + program->get_expected_size());
+        size_t main_size;
+        std::unique_ptr<expr::Scope> layout_scope;
+        // Deferred values in the main content are finished first, so the offsets of the
+        // layout placeholders after it are not disturbed
+        std::unique_ptr<tpl::DeferredOutput> layout_deferred;
+        if (layout.layout_static_prefix)
+        {
+            // Main content goes straight into the output after the prefix
+            layout_scope = slim::make_unique<expr::Scope>(model);
+            layout_deferred = slim::make_unique<tpl::DeferredOutput>(buffer, *layout_scope);
+            layout_program.render(buffer, *layout_scope, 0, split);
+            auto main_start = buffer.size();
+            expr::Scope scope(model);
+            tpl::DeferredOutput deferred(buffer, scope);
+            program->render(buffer, scope);
+            deferred.finish();
+            main_size = buffer.size() - main_start;
+        }
+        else
+        {
+            // The prefix might output "content_for" blocks, so the main content must be first
+            auto main_content = RenderBufferPool::acquire(program->get_expected_size());
+            {
+                expr::Scope scope(model);
+                tpl::DeferredOutput deferred(main_content, scope);
+                program->render(main_content, scope);
+                deferred.finish();
+            }
+            layout_scope = slim::make_unique<expr::Scope>(model);
+            layout_deferred = slim::make_unique<tpl::DeferredOutput>(buffer, *layout_scope);
+            layout_program.render(buffer, *layout_scope, 0, split);
+            buffer += main_content;
+            main_size = main_content.size();
+            RenderBufferPool::release(std::move(main_content));
+        }
+        layout_program.render(buffer, *layout_scope, split + 1, end);
+        layout_deferred->finish();
+        program->record_size(main_size);
+        layout_program.record_size(buffer.size() - start - main_size);
+    }
+    SegmentedOutput Template::render_layout_segments(Template &layout, ViewModelPtr model, bool doctype, size_t min_segment)const
+    {
+        auto &layout_program = *layout.program;
+        auto split = layout.layout_split;
+        auto end = layout_program.get_ops().size();
+        if (split == end)
+        {
+            auto main_content = render(model, false);
+            model->set_main_content(create_object<HtmlSafeString>(std::move(main_content)));
+            return layout.render_segments(model, doctype, min_segment);
+        }
+
+        SegmentedOutput out(min_segment);
+        if (doctype) out.add_static(DOCTYPE, DOCTYPE_LEN);
+        std::unique_ptr<expr::Scope> layout_scope;
+        if (layout.layout_static_prefix)
+        {
+            layout_scope = slim::make_unique<expr::Scope>(model);
+            layout_program.render(out, *layout_scope, 0, split);
+            expr::Scope scope(model);
+            program->render(out, scope);
+        }
+        else
+        {
+            SegmentedOutput main_content(min_segment);
+            {
+                expr::Scope scope(model);
+                program->render(main_content, scope);
+            }
+            layout_scope = slim::make_unique<expr::Scope>(model);
+            layout_program.render(out, *layout_scope, 0, split);
+            out.append(std::move(main_content));
+        }
+        layout_program.render(out, *layout_scope, split + 1, end);
+        return out;
     }
     std::string Template::to_string()const
     {
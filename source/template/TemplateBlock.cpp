@@ -9,7 +9,7 @@ namespace slim
     namespace tpl
     {
         TemplateBlock::TemplateBlock(std::unique_ptr<TemplatePart> &&tpl)
-            : tpl(std::move(tpl))
+            : tpl(std::move(tpl)), program(*this->tpl)
         {}
         TemplateBlock::~TemplateBlock() {}
 
@@ -21,15 +21,17 @@ namespace slim
         ObjectPtr TemplateCaptureBlock::eval(expr::Scope &scope)const
         {
             std::string str;
-            tpl->render(str, scope);
+            str.reserve(program.get_expected_size());
+            program.render(str, scope);
+            program.record_size(str.size());
             return create_object<HtmlSafeString>(std::move(str));
         }
 
         ObjectPtr TemplateOutputBlock::eval(expr::Scope &scope)const
         {
             static auto SYM_output_buffer = symbol("output_buffer");
-            auto &str = coerce<String>(scope.get(SYM_output_buffer))->get_value();
-            tpl->render(str, scope);
+            auto &str = coerce<String>(scope.get(SYM_output_buffer))->get_mutable_value();
+            program.render(str, scope);
             return NIL_VALUE;
         }
 
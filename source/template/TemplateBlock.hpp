@@ -1,6 +1,7 @@
 #pragma once
 #include "expression/Ast.hpp"
 #include "types/Proc.hpp"
+#include "template/RenderProgram.hpp"
 namespace slim
 {
     namespace tpl
@@ -16,6 +17,8 @@ namespace slim
             virtual std::string to_string()const override;
         protected:
             std::unique_ptr<TemplatePart> tpl;
+            /**tpl compiled for rendering.*/
+            RenderProgram program;
         };
         /**When evaluated returns a HtmlSafeString.*/
         class TemplateCaptureBlock : public TemplateBlock
@@ -1,5 +1,8 @@
 #include "template/TemplateParts.hpp"
+#include "DeferredOutput.hpp"
 #include "template/Attributes.hpp"
+#include "template/RenderProgram.hpp"
+#include "expression/AstOp.hpp"
 #include "expression/Expression.hpp"
 #include "types/Array.hpp"
 #include "types/Boolean.hpp"
@@ -9,10 +12,31 @@
 #include "types/Proc.hpp"
 #include "types/Symbol.hpp"
 #include "Util.hpp"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <system_error>
+#include <thread>
+#include <typeinfo>
 namespace slim
 {
     namespace tpl
     {
+        void TemplatePart::compile(RenderProgram &program)const
+        {
+            program.add(RenderOp::PART, nullptr, this);
+        }
+
+        void TemplatePartsList::compile(RenderProgram &program)const
+        {
+            for (auto &part : parts) part->compile(program);
+        }
+
+        void TemplateText::compile(RenderProgram &program)const
+        {
+            program.add_text(text);
+        }
+
         TemplateOutputExpr::TemplateOutputExpr(std::unique_ptr<Expression>&& expression)
             : expression(std::move(expression))
         {}
@@ -25,7 +49,11 @@ namespace slim
         void TemplateOutputExpr::render(std::string & buffer, expr::Scope &scope) const
         {
             auto val = expression->eval(scope);
-            buffer += html_escape(val);
+            DeferredOutput::append_escaped(buffer, val);
+        }
+        void TemplateOutputExpr::compile(RenderProgram &program)const
+        {
+            program.add(RenderOp::EVAL_ESCAPED, expression.get());
         }
         
         TemplateCodeBlock::TemplateCodeBlock(std::unique_ptr<Expression>&& expression)
@@ -41,10 +69,17 @@ namespace slim
         {
             expression->eval(scope);
         }
+        void TemplateCodeBlock::compile(RenderProgram &program)const
+        {
+            program.add(RenderOp::EVAL, expression.get());
+        }
 
         TemplateEachExpr::TemplateEachExpr(std::unique_ptr<Expression>&& expression)
-            : expression(std::move(expression))
-        {}
+            : expression(std::move(expression)), member_call(nullptr)
+        {
+            if (typeid(*this->expression) == typeid(expr::MemberFuncCall))
+                member_call = static_cast<const expr::MemberFuncCall*>(this->expression.get());
+        }
         TemplateEachExpr::~TemplateEachExpr()
         {}
         std::string TemplateEachExpr::to_string() const
@@ -53,27 +88,152 @@ namespace slim
         }
         void TemplateEachExpr::render(std::string & buffer, expr::Scope &scope) const
         {
-            //TODO: This is somewhat a workaround because String always owns the std::string.
-            //It may be better just to always use the String object for template rendering
+            if (!member_call)
+            {
+                //TODO: This is somewhat a workaround because String always owns the std::string.
+                //It may be better just to always use the String object for template rendering
+                auto tmp = create_object<String>(std::move(buffer));
+                expr::Scope new_scope(scope);
+                new_scope.set("output_buffer", tmp);
+                expression->eval(new_scope);
+                buffer = std::move(tmp->get_mutable_value());
+                return;
+            }
+            // The receiver is evaluated separately, so that if it is a Deferred the loop can be
+            // deferred as well, see DeferredOutput
+            auto self = member_call->lhs->eval(scope);
+            if (typeid(*self) == typeid(Deferred))
+            {
+                auto deferred = std::static_pointer_cast<Deferred>(self);
+                if (auto out = DeferredOutput::get(buffer, scope))
+                {
+                    auto loop_scope = out->copy_scope();
+                    out->add(deferred, [this, loop_scope](std::string &loop_buffer, ObjectPtr value)
+                    {
+                        render_call(loop_buffer, *loop_scope, value);
+                    });
+                    return;
+                }
+                self = deferred->value();
+            }
+            render_call(buffer, scope, self);
+        }
+        void TemplateEachExpr::render_call(std::string &buffer, expr::Scope &scope, ObjectPtr self) const
+        {
+            //See above, the block writes to output_buffer
             auto tmp = create_object<String>(std::move(buffer));
             expr::Scope new_scope(scope);
             new_scope.set("output_buffer", tmp);
-            auto val = expression->eval(new_scope);
-            buffer = std::move(tmp->get_value());
+            auto args = member_call->eval_args(new_scope);
+            (*member_call->method(self.get()))(self.get(), args);
+            buffer = std::move(tmp->get_mutable_value());
         }
 
         namespace
         {
-            /**Adds value to out.
-             * If value is an array, then all elements are added.
+            /**Writes the values of a single attribute to the buffer.
+             * With no static values a single true, false or nil value is a boolean attribute, so
+             * the first value is held back until it is known if there are any more.
+             */
+            class AttrWriter
+            {
+            public:
+                /**prefix is ' name="' followed by any static values, or nullptr to write the
+                 * escaped name.
+                 */
+                AttrWriter(std::string &buffer, StringView name, const std::string *prefix, bool has_static)
+                    : buffer(buffer), name(name), prefix(prefix), first(nullptr), started(has_static)
+                {
+                    if (started) write_prefix();
+                }
+                /**Adds value. If value is an array, then all elements are added.*/
+                void add(const ObjectPtr &value)
+                {
+                    if (auto arr = dynamic_cast<Array*>(value.get()))
+                    {
+                        for (auto &i : arr->get_value()) add_single(i);
+                    }
+                    else add_single(value);
+                }
+                void finish()
+                {
+                    if (!started)
+                    {
+                        if (!first || first == FALSE_VALUE || first == NIL_VALUE) return;
+                        if (first == TRUE_VALUE)
+                        {
+                            buffer += ' ';
+                            write_name();
+                            return;
+                        }
+                        write_prefix();
+                        html_escape_append(buffer, first.get());
+                    }
+                    buffer += '"';
+                }
+            private:
+                std::string &buffer;
+                StringView name;
+                const std::string *prefix;
+                ObjectPtr first;
+                bool started;
+
+                void add_single(const ObjectPtr &value)
+                {
+                    if (!started)
+                    {
+                        if (!first)
+                        {
+                            first = value;
+                            return;
+                        }
+                        write_prefix();
+                        html_escape_append(buffer, first.get());
+                        started = true;
+                    }
+                    buffer += ' ';
+                    html_escape_append(buffer, value.get());
+                }
+                void write_name()
+                {
+                    if (prefix) buffer.append(name.data(), name.size());
+                    else html_escape_append(buffer, name.data(), name.size());
+                }
+                void write_prefix()
+                {
+                    if (prefix) buffer += *prefix;
+                    else
+                    {
+                        buffer += ' ';
+                        write_name();
+                        buffer += "=\"";
+                    }
+                }
+            };
+
+            /**Adds the keys of a hash literal to keys.
+             * Returns false if expr is not a hash literal with literal keys.
              */
-            void add_attr_value(std::vector<Ptr<Object>> &out, Ptr<Object> value)
+            bool literal_keys(const Expression *expr, std::vector<std::string> *keys)
             {
-                if (auto arr = dynamic_cast<Array*>(value.get()))
+                if (auto lit = dynamic_cast<const expr::Literal*>(expr))
                 {
-                    for (auto val2 : arr->get_value())out.push_back(val2);
+                    auto hash = dynamic_cast<Hash*>(lit->value.get());
+                    if (!hash) return false;
+                    for (auto &i : *hash) keys->push_back(i.first->to_string());
+                    return true;
                 }
-                else out.push_back(value);
+                else if (auto hash = dynamic_cast<const expr::HashLiteral*>(expr))
+                {
+                    for (size_t i = 0; i < hash->args.size(); i += 2)
+                    {
+                        auto key = dynamic_cast<const expr::Literal*>(hash->args[i].get());
+                        if (!key) return false;
+                        keys->push_back(key->value->to_string());
+                    }
+                    return true;
+                }
+                else return false;
             }
         }
 
@@ -84,6 +244,7 @@ namespace slim
             : attr(attr)
             , static_values(std::move(static_values))
             , dynamic_values(std::move(dynamic_values))
+            , prefix(' ' + attr + "=\"" + merge_attr_values(this->static_values))
         {}
         TemplateTagAttr::~TemplateTagAttr()
         {}
@@ -98,39 +259,33 @@ namespace slim
         }
         void TemplateTagAttr::render(std::string &buffer, expr::Scope &scope)const
         {
-            std::vector<ObjectPtr> values;
-            for (auto &expr : dynamic_values)
-            {
-                auto val = expr->eval(scope);
-                add_attr_value(values, val);
-            }
+            AttrWriter writer(buffer, attr, &prefix, !static_values.empty());
+            for (auto &expr : dynamic_values) writer.add(expr->eval(scope));
+            writer.finish();
+        }
+        void TemplateTagAttr::compile(RenderProgram &program)const
+        {
+            program.add(RenderOp::ATTR, nullptr, this);
+        }
 
-            if (static_values.empty() && values.empty()) return;
+        TemplateTagSplatAttrs::TemplateTagSplatAttrs(Attrs &&source_attrs, Splat &&splat_attrs)
+            : attrs(), splat_attrs(std::move(splat_attrs))
+        {
+            std::vector<std::string> keys;
+            bool keys_known = true;
+            for (auto &splat : this->splat_attrs)
+                keys_known = keys_known && literal_keys(splat.get(), &keys);
 
-            if (static_values.empty() && values.size() == 1)
+            for (auto &attr : source_attrs)
             {
-                if (values[0] == TRUE_VALUE)
-                {
-                    buffer += ' ' + attr;
-                    return;
-                }
-                else if (values[0] == FALSE_VALUE || values[0] == NIL_VALUE) return;
+                bool fixed = keys_known && attr.dynamic_values.empty() &&
+                    std::find(keys.begin(), keys.end(), attr.name) == keys.end();
+                auto prefix = ' ' + attr.name + "=\"" + merge_attr_values(attr.static_values);
+                attrs.push_back({
+                    attr.name, std::move(prefix), !attr.static_values.empty(), fixed,
+                    std::move(attr.dynamic_values) });
             }
-
-            std::vector<std::string> strings = static_values;
-            for (auto &v : values) strings.push_back(html_escape(v));
-
-            buffer += attr_str(attr, strings);
         }
-
-        TemplateTagSplatAttrs::TemplateTagSplatAttrs(
-            Static &&static_attrs,
-            Dynamic &&dynamic_attrs,
-            Splat &&splat_attrs)
-            : static_attrs(std::move(static_attrs))
-            , dynamic_attrs(std::move(dynamic_attrs))
-            , splat_attrs(std::move(splat_attrs))
-        {}
         TemplateTagSplatAttrs::~TemplateTagSplatAttrs()
         {}
         std::string TemplateTagSplatAttrs::to_string()const
@@ -139,56 +294,72 @@ namespace slim
         }
         void TemplateTagSplatAttrs::render(std::string &buffer, expr::Scope &scope)const
         {
-            std::unordered_map<std::string, std::vector<Ptr<Object>>> attrs;
-            //Determine all attributes
-            for (auto &i : static_attrs)
-                attrs[i.first].push_back(make_value(i.second));
-
-            for (auto &i : dynamic_attrs)
+            struct SplatValue
             {
-                auto &attr = attrs[i.first];
-                auto val = i.second->eval(scope);
-                add_attr_value(attr, val);
-            }
-
+                StringView name;
+                ObjectPtr value;
+            };
+            std::vector<Ptr<Hash>> hashes;
+            hashes.reserve(splat_attrs.size());
+            size_t count = 0;
             for (auto &splat : splat_attrs)
             {
                 auto hash = coerce<Hash>(splat->eval(scope));
+                for (auto it = hash->begin(); it != hash->end(); ++it) ++count;
+                hashes.push_back(std::move(hash));
+            }
+            //flat list of the splat values in order, with names that remain valid while the
+            //hashes are alive, or for keys that are not strings, in key_strings
+            std::vector<SplatValue> values;
+            std::vector<std::string> key_strings;
+            values.reserve(count);
+            key_strings.reserve(count);
+            for (auto &hash : hashes)
+            {
                 for (auto &i : *hash)
                 {
-                    auto &attr = attrs[i.first->to_string()];
-                    auto val = i.second;
-                    add_attr_value(attr, val);
+                    if (auto sym = dynamic_cast<const Symbol*>(i.first.get())) values.push_back({ sym->str(), i.second });
+                    else if (auto str = dynamic_cast<const String*>(i.first.get())) values.push_back({ str->view(), i.second });
+                    else
+                    {
+                        key_strings.push_back(i.first->to_string());
+                        values.push_back({ key_strings.back(), i.second });
+                    }
                 }
             }
-            //Output attributes
-            for (auto &i : attrs)
-            {
-                auto &name = html_escape(i.first);
-                auto &values = i.second;
 
-                if (values.empty()) continue; //empty / no value
-                else if (values.size() == 1)
+            //attributes from the source, merged with any splat values for the same name
+            for (auto &attr : attrs)
+            {
+                if (attr.fixed)
                 {
-                    auto val = values[0];
-                    if (val == TRUE_VALUE) //true boolean attr
-                    {
-                        buffer += ' ';
-                        buffer += name;
-                    }
-                    else if (val == FALSE_VALUE || val == NIL_VALUE) //false boolean attr
-                    {
-                        continue;
-                    }
-                    else buffer += attr_str(name, {val->to_string()});
+                    buffer += attr.prefix;
+                    buffer += '"';
+                    continue;
                 }
-                else
+                AttrWriter writer(buffer, attr.name, &attr.prefix, attr.has_static);
+                for (auto &expr : attr.dynamic_values) writer.add(expr->eval(scope));
+                for (auto &value : values)
                 {
-                    //array of values, e.g. "class"
-                    std::vector<std::string> strings;
-                    for (auto &j : values) strings.push_back(j->to_string());
-                    buffer += attr_str(name, strings);
+                    if (value.name == attr.name) writer.add(value.value);
                 }
+                writer.finish();
+            }
+            //remaining splat keys, in the order they first appear
+            for (size_t i = 0; i < values.size(); ++i)
+            {
+                auto name = values[i].name;
+                bool done = false;
+                for (auto &attr : attrs) done = done || name == attr.name;
+                for (size_t j = 0; j < i && !done; ++j) done = name == values[j].name;
+                if (done) continue;
+
+                AttrWriter writer(buffer, name, nullptr, false);
+                for (size_t j = i; j < values.size(); ++j)
+                {
+                    if (values[j].name == name) writer.add(values[j].value);
+                }
+                writer.finish();
             }
         }
 
@@ -230,6 +401,128 @@ namespace slim
             auto proc = std::make_shared<BlockProc>(call, param_names, scope);
             enumerator->each({ proc });
         }
+        void TemplateForExpr::compile(RenderProgram &program)const
+        {
+            auto begin = program.add(RenderOp::FOR_BEGIN, expr.get(), this);
+            body->compile(program);
+            program.set_target(begin, program.add(RenderOp::FOR_END, nullptr));
+            program.label();
+        }
+
+        namespace
+        {
+            std::atomic<size_t> parallel_max_threads(0);
+        }
+        void TemplateParallelEachExpr::set_max_threads(size_t threads)
+        {
+            parallel_max_threads = threads;
+        }
+
+        TemplateParallelEachExpr::TemplateParallelEachExpr(
+            std::unique_ptr<Expression> &&expr,
+            std::unique_ptr<TemplatePart> &&body,
+            std::vector<std::shared_ptr<Symbol>> &&param_names)
+            : expr(std::move(expr)), body(std::move(body)), param_names(std::move(param_names))
+            , program(*this->body)
+        {}
+        TemplateParallelEachExpr::~TemplateParallelEachExpr()
+        {}
+        std::string TemplateParallelEachExpr::to_string() const
+        {
+            std::string out = "<% " + expr->to_string() + ".parallel_each do |";
+            if (!param_names.empty()) out += param_names[0]->str();
+            for (size_t i = 1; i < param_names.size(); ++i) out += ", " + param_names[i]->str();
+            out += "| %>";
+            out += body->to_string();
+            out += "<% end %>";
+            return out;
+        }
+        void TemplateParallelEachExpr::render(std::string &buffer, expr::Scope &scope) const
+        {
+            auto value = expr->eval(scope);
+            auto arr = std::dynamic_pointer_cast<Array>(value);
+            if (!arr) arr = coerce<Array>(value->call_method(symbol("to_a"), {}));
+            auto &elements = arr->get_value();
+            auto count = elements.size();
+
+            size_t threads = parallel_max_threads;
+            if (!threads) threads = std::thread::hardware_concurrency();
+            threads = std::min(threads, count / MIN_CHUNK);
+            if (threads <= 1)
+            {
+                expr::Scope chunk_scope(scope);
+                render_chunk(buffer, chunk_scope, elements.data(), elements.data() + count);
+                return;
+            }
+
+            // Several chunks per thread, taken in turn, so a slow chunk does not hold up the rest
+            auto chunk_count = std::min(threads * 4, count / MIN_CHUNK);
+            auto chunk_size = (count + chunk_count - 1) / chunk_count;
+            chunk_count = (count + chunk_size - 1) / chunk_size;
+            std::vector<std::string> chunks(chunk_count);
+            std::atomic<size_t> next_chunk(0);
+            std::atomic<bool> failed(false);
+            std::exception_ptr error;
+            auto worker = [&]()
+            {
+                try
+                {
+                    // scope is only read while the workers run
+                    expr::Scope chunk_scope(scope);
+                    while (!failed)
+                    {
+                        auto i = next_chunk++;
+                        if (i >= chunk_count) break;
+                        auto begin = elements.data() + i * chunk_size;
+                        auto end = std::min(begin + chunk_size, elements.data() + count);
+                        render_chunk(chunks[i], chunk_scope, begin, end);
+                    }
+                }
+                catch (...)
+                {
+                    if (!failed.exchange(true)) error = std::current_exception();
+                }
+            };
+            std::vector<std::thread> workers;
+            workers.reserve(threads - 1);
+            try
+            {
+                for (size_t i = 1; i < threads; ++i) workers.emplace_back(worker);
+            }
+            catch (const std::system_error &)
+            {
+                //could not start a thread, so make do with fewer
+            }
+            worker();
+            for (auto &thread : workers) thread.join();
+            if (error) std::rethrow_exception(error);
+
+            size_t size = 0;
+            for (auto &chunk : chunks) size += chunk.size();
+            buffer.reserve(buffer.size() + size);
+            for (auto &chunk : chunks) buffer += chunk;
+        }
+        void TemplateParallelEachExpr::render_chunk(std::string &buffer, expr::Scope &scope,
+            const ObjectPtr *begin, const ObjectPtr *end)const
+        {
+            for (auto i = begin; i != end; ++i)
+            {
+                expr::Scope element_scope(scope);
+                if (param_names.size() > 1)
+                {
+                    // Like a block, an array element is spread over multiple params
+                    auto values = std::dynamic_pointer_cast<Array>(*i);
+                    for (size_t j = 0; j < param_names.size(); ++j)
+                    {
+                        element_scope.set(param_names[j],
+                            values && j < values->get_value().size() ? values->get_value()[j] :
+                            j == 0 ? *i : NIL_VALUE);
+                    }
+                }
+                else if (!param_names.empty()) element_scope.set(param_names[0], *i);
+                program.render(buffer, element_scope);
+            }
+        }
 
         TemplateIfExpr::TemplateIfExpr(TemplateCondExpr &&if_expr, std::vector<TemplateCondExpr> &&elseif_exprs, std::unique_ptr<TemplatePart> &&else_body)
             : if_expr(std::move(if_expr)), elseif_exprs(std::move(elseif_exprs)), else_body(std::move(else_body))
@@ -270,6 +563,23 @@ namespace slim
                 else_body->render(buffer, scope);
             }
         }
+        void TemplateIfExpr::compile(RenderProgram &program)const
+        {
+            //IF cond, body, JUMP end, for each condition, then the else body
+            std::vector<size_t> end_jumps;
+            auto add_cond = [&program, &end_jumps](const TemplateCondExpr &cond)
+            {
+                auto test = program.add(RenderOp::IF, cond.expr.get());
+                cond.body->compile(program);
+                end_jumps.push_back(program.add(RenderOp::JUMP, nullptr));
+                program.set_target(test, program.label());
+            };
+            add_cond(if_expr);
+            for (auto &elseif : elseif_exprs) add_cond(elseif);
+            if (else_body) else_body->compile(program);
+            auto end = program.label();
+            for (auto jump : end_jumps) program.set_target(jump, end);
+        }
 
     }
 }
@@ -1,76 +1,303 @@
 #include "types/Array.hpp"
 #include "types/Enumerator.hpp"
 #include "types/Proc.hpp"
+#include "types/Set.hpp"
 #include "types/Range.hpp"
 #include "Value.hpp"
 #include "Function.hpp"
+#include "NumberKernels.hpp"
 #include "Operators.hpp"
 #include <algorithm>
+#include <cassert>
+#include <cmath>
 #include <sstream>
 #include <set>
 
 namespace slim
 {
+    namespace
+    {
+        /**Tracks which values have been seen for uniq and the set operators.
+         * Small inputs are scanned linearly, since hashing every element costs more than a few
+         * eq calls, larger ones use a hash table to avoid O(n^2) behaviour.
+         */
+        class SeenSet
+        {
+        public:
+            explicit SeenSet(size_t expected)
+                : use_hash(expected > HASH_THRESHOLD), list(), set()
+            {
+                if (use_hash) set.reserve(expected);
+            }
+            /**Adds obj, returns false if an equal value was already present.*/
+            bool insert(const ObjectPtr &obj)
+            {
+                if (use_hash) return set.insert(obj).second;
+                if (contains(obj)) return false;
+                list.push_back(obj);
+                return true;
+            }
+            bool contains(const ObjectPtr &obj)const
+            {
+                if (use_hash) return set.count(obj) != 0;
+                for (auto &i : list)
+                {
+                    if (slim::eq(i.get(), obj.get())) return true;
+                }
+                return false;
+            }
+        private:
+            static const size_t HASH_THRESHOLD = 16;
+            bool use_hash;
+            std::vector<ObjectPtr> list;
+            ObjectSet set;
+        };
+    }
+
+    bool PackedNumbers::push_back(const Object *obj, bool mixed)
+    {
+        if (typeid(*obj) == typeid(Integer))
+        {
+            auto i = static_cast<const Integer*>(obj)->get_int();
+            if (kind == INTS) ints.push_back(i);
+            else if (kind == MIXED || mixed)
+            {
+                kind = MIXED;
+                doubles.push_back((double)i);
+            }
+            else return false;
+            return true;
+        }
+        else if (typeid(*obj) == typeid(Number))
+        {
+            auto d = static_cast<const Number*>(obj)->get_value();
+            if (kind == INTS && ints.empty()) kind = DOUBLES;
+            else if (kind == INTS)
+            {
+                if (!mixed) return false;
+                kind = MIXED;
+                doubles.assign(ints.begin(), ints.end());
+                ints.clear();
+                ints.shrink_to_fit();
+            }
+            doubles.push_back(d);
+            return true;
+        }
+        else return false;
+    }
+    ObjectPtr PackedNumbers::box(size_t i)const
+    {
+        assert(kind != MIXED);
+        if (kind == INTS) return make_value(ints[i]);
+        else return make_value(doubles[i]);
+    }
+
+    Array::Array(std::vector<double> &&values)
+        : arr(), packed(std::make_shared<PackedNumbers>()), boxed(false)
+    {
+        packed->kind = PackedNumbers::DOUBLES;
+        packed->doubles = std::move(values);
+    }
+    Array::Array(std::vector<long long> &&values)
+        : arr(), packed(std::make_shared<PackedNumbers>()), boxed(false)
+    {
+        packed->ints = std::move(values);
+    }
+
+    Array::Elements::Elements(const Array &array)
+        : arr(array.arr), values()
+    {
+        //if box clears packed after this checks boxed, then arr is set by then
+        if (!array.boxed.load(std::memory_order_acquire))
+            values = std::atomic_load(&array.packed);
+    }
+    std::shared_ptr<const PackedNumbers> Array::Elements::numbers()const
+    {
+        if (values) return values;
+        auto scanned = std::make_shared<PackedNumbers>();
+        for (auto &i : arr)
+        {
+            if (!scanned->push_back(i.get(), true)) return nullptr;
+        }
+        return scanned;
+    }
+
+    void Array::box()const
+    {
+        std::unique_lock<std::mutex> lock(lazy_mutex);
+        if (boxed.load(std::memory_order_relaxed)) return;
+        auto n = packed->size();
+        arr.reserve(n);
+        for (size_t i = 0; i < n; ++i) arr.push_back(packed->box(i));
+        boxed.store(true, std::memory_order_release);
+        //readers that already have packed keep their own reference
+        std::atomic_store(&packed, std::shared_ptr<PackedNumbers>());
+    }
+    std::shared_ptr<const PackedNumbers> Array::numbers()const
+    {
+        return Elements(*this).numbers();
+    }
+    void Array::push_back(ObjectPtr obj)
+    {
+        if (!boxed.load(std::memory_order_relaxed))
+        {
+            if (packed->push_back(obj.get(), false)) return;
+            //a different kind of number, or not a number
+            box();
+        }
+        else if (arr.empty())
+        {
+            //start packed again if the first element is a number
+            PackedNumbers first;
+            if (first.push_back(obj.get(), false))
+            {
+                std::atomic_store(&packed, std::make_shared<PackedNumbers>(std::move(first)));
+                boxed.store(false, std::memory_order_release);
+                return;
+            }
+        }
+        arr.push_back(std::move(obj));
+    }
+    Array::List &Array::mutable_list()
+    {
+        get_value();
+        return arr;
+    }
+    bool Array::packed_min_max(const PackedNumbers &nums, size_t *min, size_t *max)
+    {
+        if (nums.size() == 0) return false;
+        if (nums.kind == PackedNumbers::INTS)
+        {
+            long long lo, hi;
+            kernels::min_max(nums.ints.data(), nums.ints.size(), &lo, &hi);
+            *min = kernels::find(nums.ints.data(), nums.ints.size(), lo);
+            *max = kernels::find(nums.ints.data(), nums.ints.size(), hi);
+        }
+        else
+        {
+            double lo, hi;
+            if (!kernels::min_max(nums.doubles.data(), nums.doubles.size(), &lo, &hi)) return false;
+            *min = kernels::find(nums.doubles.data(), nums.doubles.size(), lo);
+            *max = kernels::find(nums.doubles.data(), nums.doubles.size(), hi);
+        }
+        return true;
+    }
+
     std::string Array::inspect() const
     {
+        Elements list(*this);
         std::stringstream ss;
         ss << '[';
-        bool first = true;
-        for (auto &i : arr)
+        for (size_t i = 0; i < list.size(); ++i)
         {
-            if (first) first = false;
-            else ss << ", ";
-            ss << i->inspect();
+            if (i > 0) ss << ", ";
+            ss << list[i]->inspect();
         }
         ss << ']';
         return ss.str();
     }
     size_t Array::hash()const
     {
+        Elements list(*this);
         size_t h = 0;
-        for (auto &i : arr) detail::hash_combine(h, *i);
+        for (size_t i = 0; i < list.size(); ++i) detail::hash_combine(h, *list[i]);
         return h;
     }
     int Array::cmp(const Object * orhs) const
     {
-        auto &rhs = ((const Array*)orhs)->get_value();
-        size_t i, j;
-        for (i = j = 0; i < arr.size() && j < rhs.size(); ++i, ++j)
+        Elements list(*this), rhs_list(*(const Array*)orhs);
+        auto n = list.size(), rhs_n = rhs_list.size();
+        for (size_t i = 0; i < n && i < rhs_n; ++i)
         {
-            int c = slim::cmp(arr[i].get(), rhs[j].get());
+            int c = slim::cmp(list[i].get(), rhs_list[i].get());
             if (c != 0) return c;
         }
-        if (arr.size() < rhs.size()) return -1;
-        else if (arr.size() > rhs.size()) return 1;
+        if (n < rhs_n) return -1;
+        else if (n > rhs_n) return 1;
         else return 0;
     }
-    ObjectPtr Array::add(Object *rhs)
+    ObjectPtr Array::add(Object *orhs)
     {
-        auto rhs_arr = coerce<Array>(rhs);
+        Elements list(*this), rhs_list(*coerce<Array>(orhs));
+        //two packed arrays of the same kind stay packed
+        auto nums = list.packed(), rhs_nums = rhs_list.packed();
+        if (nums && rhs_nums && nums->kind == rhs_nums->kind)
+        {
+            if (nums->kind == PackedNumbers::INTS)
+            {
+                std::vector<long long> out;
+                out.reserve(nums->ints.size() + rhs_nums->ints.size());
+                out.insert(out.end(), nums->ints.begin(), nums->ints.end());
+                out.insert(out.end(), rhs_nums->ints.begin(), rhs_nums->ints.end());
+                return create_object<Array>(std::move(out));
+            }
+            std::vector<double> out;
+            out.reserve(nums->doubles.size() + rhs_nums->doubles.size());
+            out.insert(out.end(), nums->doubles.begin(), nums->doubles.end());
+            out.insert(out.end(), rhs_nums->doubles.begin(), rhs_nums->doubles.end());
+            return create_object<Array>(std::move(out));
+        }
+        auto n = list.size(), rhs_n = rhs_list.size();
         std::vector<ObjectPtr> out;
-        out.reserve(arr.size() + rhs_arr->arr.size());
-        out = arr;
-        out.insert(out.end(), rhs_arr->arr.begin(), rhs_arr->arr.end());
+        out.reserve(n + rhs_n);
+        for (size_t i = 0; i < n; ++i) out.push_back(list[i]);
+        for (size_t i = 0; i < rhs_n; ++i) out.push_back(rhs_list[i]);
         return make_value(std::move(out));
     }
-    ObjectPtr Array::sub(Object *rhs)
+    ObjectPtr Array::sub(Object *orhs)
     {
-        auto rhs_arr = coerce<Array>(rhs);
-        std::vector<ObjectPtr> out; 
-        for (auto &i : arr)
+        Elements list(*this), rhs_list(*coerce<Array>(orhs));
+        auto rhs_n = rhs_list.size();
+        SeenSet exclude(rhs_n);
+        for (size_t i = 0; i < rhs_n; ++i) exclude.insert(rhs_list[i]);
+        std::vector<ObjectPtr> out;
+        for (size_t i = 0; i < list.size(); ++i)
         {
-            if (!rhs_arr->include_q_imp(i.get()))
+            auto e = list[i];
+            if (!exclude.contains(e))
+                out.push_back(std::move(e));
+        }
+        return make_value(std::move(out));
+    }
+    ObjectPtr Array::bit_and(Object *rhs)
+    {
+        auto &list = get_value();
+        auto &rhs_list = coerce<Array>(rhs)->get_value();
+        SeenSet other(rhs_list.size());
+        for (auto &i : rhs_list) other.insert(i);
+        SeenSet seen(list.size());
+        std::vector<ObjectPtr> out;
+        for (auto &i : list)
+        {
+            if (other.contains(i) && seen.insert(i))
                 out.push_back(i);
         }
         return make_value(std::move(out));
     }
+    ObjectPtr Array::bit_or(Object *rhs)
+    {
+        auto &list = get_value();
+        auto &rhs_list = coerce<Array>(rhs)->get_value();
+        SeenSet seen(list.size() + rhs_list.size());
+        std::vector<ObjectPtr> out;
+        for (auto &i : list)
+        {
+            if (seen.insert(i)) out.push_back(i);
+        }
+        for (auto &i : rhs_list)
+        {
+            if (seen.insert(i)) out.push_back(i);
+        }
+        return make_value(std::move(out));
+    }
 
     std::shared_ptr<Object> Array::assoc(const Object * a)
     {
-        for (auto &i : arr)
+        auto &list = get_value();
+        for (auto &i : list)
         {
             auto arr2 = dynamic_cast<Array*>(i.get());
-            if (arr2 && !arr2->arr.empty() && slim::eq(a, arr2->get_value().front().get()))
+            if (arr2 && !arr2->get_value().empty() && slim::eq(a, arr2->get_value().front().get()))
             {
                 return arr2->shared_from_this();
             }
@@ -79,15 +306,17 @@ namespace slim
     }
     std::shared_ptr<Object> Array::at(const Number * n)
     {
+        Elements list(*this);
         int i = (int)n->get_value();
-        if (i < 0) i = ((int)arr.size()) + i;
-        if (i < 0 || i >= (int)arr.size()) return NIL_VALUE;
-        else return arr[(size_t)i];
+        if (i < 0) i = ((int)list.size()) + i;
+        if (i < 0 || i >= (int)list.size()) return NIL_VALUE;
+        else return list[(size_t)i];
     }
     std::shared_ptr<Array> Array::compact()
     {
+        auto &list = get_value();
         std::vector<ObjectPtr> compacted;
-        for (auto &i : arr)
+        for (auto &i : list)
         {
             if (i != NIL_VALUE) compacted.push_back(i);
         }
@@ -104,9 +333,10 @@ namespace slim
         unpack<0>(args, &proc);
         if (proc)
         {
-            for (auto &i : arr)
+            Elements list(*this);
+            for (size_t i = 0; i < list.size(); ++i)
             {
-                proc->call({i});
+                proc->call({list[i]});
             }
             return shared_from_this();
         }
@@ -114,28 +344,31 @@ namespace slim
     }
     std::shared_ptr<Boolean> Array::empty_q()
     {
-        return make_value(arr.empty());
+        return make_value(length() == 0);
     }
     std::shared_ptr<Object> Array::fetch(const FunctionArgs & args)
     {
+        auto &list = get_value();
         if (args.empty() || args.size() > 2) throw ArgumentError(this, "fetch");
         int i = (int)as_number(args[0]);
-        if (i >= 0 && i < (int)arr.size()) return arr[(size_t)i];
+        if (i >= 0 && i < (int)list.size()) return list[(size_t)i];
         else if (args.size() == 2) return args[1];
         else throw IndexError("Index out of bounds");
     }
     std::shared_ptr<Object> Array::first(const FunctionArgs & args)
     {
+        Elements list(*this);
+        auto n = list.size();
         if (args.size() == 0)
         {
-            return arr.empty() ? NIL_VALUE : arr.front();
+            return n == 0 ? NIL_VALUE : list[0];
         }
         else if (args.size() == 1)
         {
             auto count = (int)as_number(args[0].get());
             if (count < 0) throw ArgumentError(this, "first");
             std::vector<ObjectPtr> out;
-            for (int i = 0; i < count && i < (int)arr.size(); ++i) out.push_back(arr[i]);
+            for (int i = 0; i < count && i < (int)n; ++i) out.push_back(list[i]);
             return make_value(std::move(out));
         }
         else throw ArgumentError(this, "first");
@@ -154,7 +387,8 @@ namespace slim
     }
     void Array::flatten_imp(std::vector<ObjectPtr> &out, int level)
     {
-        for (auto &i : arr)
+        auto &list = get_value();
+        for (auto &i : list)
         {
             auto arr2 = dynamic_cast<Array*>(i.get());
             if (arr2 && level != 0) arr2->flatten_imp(out, level - 1);
@@ -167,9 +401,33 @@ namespace slim
     }
     bool Array::include_q_imp(const Object *obj)
     {
-        for (size_t i = 0; i < arr.size(); ++i)
+        Elements list(*this);
+        if (auto nums = list.numbers())
         {
-            if (slim::eq(obj, arr[i].get())) return true;
+            //only numbers are equal to numbers
+            auto num = dynamic_cast<const Number*>(obj);
+            if (!num) return false;
+            auto d = num->get_value();
+            auto integer = typeid(*num) == typeid(Integer);
+            if (nums->kind == PackedNumbers::INTS)
+            {
+                if (integer)
+                {
+                    auto i = static_cast<const Integer*>(num)->get_int();
+                    return kernels::find(nums->ints.data(), nums->ints.size(), i) != kernels::NOT_FOUND;
+                }
+                //-2^63 and 2^63 are exact doubles
+                if (d != std::trunc(d) || !(d >= -9223372036854775808.0 && d < 9223372036854775808.0)) return false;
+                return kernels::find(nums->ints.data(), nums->ints.size(), (long long)d) != kernels::NOT_FOUND;
+            }
+            //NaN needs the identity check, and integers above 2^53 are not exact as doubles
+            bool exact = d == d && (!integer || (d >= -9007199254740992.0 && d <= 9007199254740992.0));
+            if (exact) return kernels::find(nums->doubles.data(), nums->doubles.size(), d) != kernels::NOT_FOUND;
+        }
+        for (size_t i = 0; i < list.size(); ++i)
+        {
+            auto e = list[i];
+            if (e.get() == obj || slim::eq(obj, e.get())) return true;
         }
         return false;
     }
@@ -179,41 +437,96 @@ namespace slim
     }
     std::shared_ptr<String> Array::join(const String * o_sep)
     {
-        auto sep = o_sep->get_value();
-        std::stringstream ss;
-        if (!arr.empty()) ss << arr.front()->to_string();
-        for (size_t i = 1; i < arr.size(); ++i) ss << sep << arr[i]->to_string();
-        return make_value(ss.str());
+        Elements list(*this);
+        auto n = list.size();
+        auto sep = o_sep->view();
+        //size the output first, converting only non-string elements
+        std::vector<std::string> converted;
+        size_t size = n == 0 ? 0 : sep.size() * (n - 1);
+        for (size_t i = 0; i < n; ++i)
+        {
+            auto e = list[i];
+            if (auto str = dynamic_cast<const String*>(e.get())) size += str->view().size();
+            else
+            {
+                converted.push_back(e->to_string());
+                size += converted.back().size();
+            }
+        }
+        std::string out;
+        out.reserve(size);
+        auto next_converted = converted.begin();
+        for (size_t i = 0; i < n; ++i)
+        {
+            if (i > 0) out.append(sep.data(), sep.size());
+            //a packed element is always converted, so is not created again here
+            auto e = list.packed() ? ObjectPtr() : list[i];
+            if (auto str = dynamic_cast<const String*>(e.get()))
+            {
+                auto s = str->view();
+                out.append(s.data(), s.size());
+            }
+            else out += *next_converted++;
+        }
+        return make_value(std::move(out));
     }
     std::shared_ptr<Object> Array::last(const FunctionArgs & args)
     {
+        Elements list(*this);
+        auto n = list.size();
         if (args.size() == 0)
         {
-            return arr.empty() ? NIL_VALUE : arr.back();
+            return n == 0 ? NIL_VALUE : list[n - 1];
         }
         else if (args.size() == 1)
         {
             auto count = (int)as_number(args[0].get());
             if (count < 0) throw ArgumentError(this, "last");
             std::vector<ObjectPtr> out;
-            int start = (int)arr.size() - count;
+            int start = (int)n - count;
             if (start < 0) start = 0;
-            for (int i = start; i < (int)arr.size(); ++i) out.push_back(arr[i]);
+            for (int i = start; i < (int)n; ++i) out.push_back(list[i]);
             return make_value(std::move(out));
         }
         else throw ArgumentError(this, "last");
     }
 
+    ObjectPtr Array::max(const FunctionArgs &args)
+    {
+        Elements list(*this);
+        auto nums = args.empty() ? list.numbers() : nullptr;
+        size_t lo, hi;
+        if (nums && packed_min_max(*nums, &lo, &hi)) return list[hi];
+        else return Enumerable::max(args);
+    }
+    ObjectPtr Array::min(const FunctionArgs &args)
+    {
+        Elements list(*this);
+        auto nums = args.empty() ? list.numbers() : nullptr;
+        size_t lo, hi;
+        if (nums && packed_min_max(*nums, &lo, &hi)) return list[lo];
+        else return Enumerable::min(args);
+    }
+    ObjectPtr Array::minmax(const FunctionArgs &args)
+    {
+        Elements list(*this);
+        auto nums = args.empty() ? list.numbers() : nullptr;
+        size_t lo, hi;
+        if (nums && packed_min_max(*nums, &lo, &hi)) return make_array({list[lo], list[hi]});
+        else return Enumerable::minmax(args);
+    }
+
     std::shared_ptr<Number> Array::size()
     {
-        return make_value((double)arr.size());
+        return make_value(length());
     }
     std::shared_ptr<Object> Array::rassoc(const Object * a)
     {
-        for (auto &i : arr)
+        auto &list = get_value();
+        for (auto &i : list)
         {
             auto arr2 = dynamic_cast<Array*>(i.get());
-            if (arr2 && arr2->arr.size() >= 2 && slim::eq(a, arr2->get_value()[1].get()))
+            if (arr2 && arr2->get_value().size() >= 2 && slim::eq(a, arr2->get_value()[1].get()))
             {
                 return arr2->shared_from_this();
             }
@@ -222,33 +535,36 @@ namespace slim
     }
     std::shared_ptr<Array> Array::reverse()
     {
-        std::vector<ObjectPtr> out{arr.rbegin(), arr.rend()};
+        auto &list = get_value();
+        std::vector<ObjectPtr> out{list.rbegin(), list.rend()};
         return make_value(std::move(out));
     }
     std::shared_ptr<Object> Array::rindex(const Object *obj)
     {
-        for (int i = (int)arr.size() - 1;  i >= 0; --i)
+        auto &list = get_value();
+        for (int i = (int)list.size() - 1;  i >= 0; --i)
         {
-            if (slim::eq(obj, arr[i].get())) return make_value((double)i);
+            if (slim::eq(obj, list[i].get())) return make_value(i);
         }
         return NIL_VALUE;
     }
     std::shared_ptr<Array> Array::rotate(const FunctionArgs & args)
     {
+        auto &list = get_value();
         int start = 1;
         if (args.size() == 1) start = (int)as_number(args[0]);
         else if (args.size() > 1) throw ArgumentError(this, "rotate");
         
-        if (arr.empty()) return std::static_pointer_cast<Array>(shared_from_this());
+        if (list.empty()) return std::static_pointer_cast<Array>(shared_from_this());
 
         std::vector<ObjectPtr> out;
         while (start < 0)
         {
-            start = ((int)arr.size()) + start;
+            start = ((int)list.size()) + start;
         }
-        for (size_t i = 0; i < arr.size(); ++i)
+        for (size_t i = 0; i < list.size(); ++i)
         {
-            out.push_back(arr[(i + start) % arr.size()]);
+            out.push_back(list[(i + start) % list.size()]);
         }
         return make_value(std::move(out));
     }
@@ -258,9 +574,10 @@ namespace slim
         unpack<0>(args, &proc);
         if (proc)
         {
-            for (auto it = arr.rbegin(); it != arr.rend(); ++it)
+            Elements list(*this);
+            for (auto i = list.size(); i-- > 0;)
             {
-                proc->call({ *it });
+                proc->call({ list[i] });
             }
             return shared_from_this();
         }
@@ -269,14 +586,15 @@ namespace slim
 
     std::shared_ptr<Object> Array::slice(const FunctionArgs & args)
     {
+        auto &list = get_value();
         auto do_slice = [&](int start, int length) -> Ptr<Object>
         {
-            if (start < 0 || length < 0 || start > (int)arr.size())
+            if (start < 0 || length < 0 || start > (int)list.size())
                 return NIL_VALUE;
             std::vector<ObjectPtr> out;
-            for (int i = start; i < start + length && i < (int)arr.size(); ++i)
+            for (int i = start; i < start + length && i < (int)list.size(); ++i)
             {
-                out.push_back(arr[(size_t)i]);
+                out.push_back(list[(size_t)i]);
             }
             return make_value(std::move(out));
         };
@@ -285,15 +603,15 @@ namespace slim
             if (auto range = dynamic_cast<Range*>(args[0].get()))
             {
                 int start, length;
-                if (range->get_beg_len(&start, &length, (int)arr.size()))
+                if (range->get_beg_len(&start, &length, (int)list.size()))
                     return do_slice(start, length);
                 else return NIL_VALUE;
             }
             else
             {
                 int i = (int)as_number(args[0]);
-                if (i < 0) i = ((int)arr.size() + i);
-                if (i >= 0 && i < (int)arr.size()) return arr[(size_t)i];
+                if (i < 0) i = ((int)list.size() + i);
+                if (i >= 0 && i < (int)list.size()) return list[(size_t)i];
                 else return NIL_VALUE;
             }
         }
@@ -301,7 +619,7 @@ namespace slim
         {
             int start = (int)as_number(args[0]);
             int length = (int)as_number(args[1]);
-            if (start < 0) start = ((int)arr.size()) + start;
+            if (start < 0) start = ((int)list.size()) + start;
             return do_slice(start, length);
         }
         else throw ArgumentError(this, "slice");
@@ -311,9 +629,42 @@ namespace slim
     {
         Proc *proc = nullptr;
         unpack<0>(args, &proc);
+        Elements list(*this);
+        auto nums = proc ? nullptr : list.numbers();
+        size_t lo, hi;
+        if (nums && packed_min_max(*nums, &lo, &hi)) //all numbers and no NaN
+        {
+            if (nums->kind == PackedNumbers::INTS)
+            {
+                auto out = nums->ints;
+                std::sort(out.begin(), out.end());
+                return make_number_array(std::move(out));
+            }
+            else if (nums->kind == PackedNumbers::DOUBLES)
+            {
+                auto out = nums->doubles;
+                std::sort(out.begin(), out.end());
+                return make_number_array(std::move(out));
+            }
+            else
+            {
+                //keep the Integer and Number objects
+                auto &values = nums->doubles;
+                std::vector<size_t> order(values.size());
+                for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+                std::sort(order.begin(), order.end(), [&values](size_t a, size_t b) {
+                    return values[a] < values[b];
+                });
+                std::vector<ObjectPtr> out;
+                out.reserve(order.size());
+                for (auto i : order) out.push_back(list[i]);
+                return make_value(std::move(out));
+            }
+        }
+        auto &values = get_value();
         if (proc)
         {
-            std::vector<ObjectPtr> out = arr;
+            std::vector<ObjectPtr> out = values;
             std::sort(out.begin(), out.end(), [proc](ObjectPtr a, ObjectPtr b) {
                 return coerce<Number>(proc->call({a, b}))->get_value() < 0;
             });
@@ -321,54 +672,93 @@ namespace slim
         }
         else
         {
-            std::vector<ObjectPtr> out = arr;
+            std::vector<ObjectPtr> out = values;
             std::sort(out.begin(), out.end(), ObjLess());
             return make_value(std::move(out));
         }
     }
     ObjectPtr Array::sort_by(const FunctionArgs &args)
     {
+        auto &list = get_value();
         Proc *proc = nullptr;
         unpack<0>(args, &proc);
         if (proc)
         {
-            std::vector<ObjectPtr> out = arr;
-            std::sort(out.begin(), out.end(), [proc](ObjectPtr a, ObjectPtr b) {
-                return slim::cmp(proc->call({a}).get(), proc->call({b}).get()) < 0;
+            //call the block once per element, rather than twice per comparison
+            std::vector<std::pair<ObjectPtr, ObjectPtr>> keyed;
+            keyed.reserve(list.size());
+            for (auto &i : list) keyed.emplace_back(proc->call({ i }), i);
+            std::sort(keyed.begin(), keyed.end(), [](const std::pair<ObjectPtr, ObjectPtr> &a, const std::pair<ObjectPtr, ObjectPtr> &b) {
+                return slim::cmp(a.first.get(), b.first.get()) < 0;
             });
+            std::vector<ObjectPtr> out;
+            out.reserve(keyed.size());
+            for (auto &i : keyed) out.push_back(std::move(i.second));
             return make_value(std::move(out));
         }
         else return make_enumerator(this, { &Array::sort_by, "sort_by" });
     }
+    ObjectPtr Array::sum(const FunctionArgs &args)
+    {
+        Proc *proc = nullptr;
+        auto n_args = args.size();
+        if (n_args && (proc = dynamic_cast<Proc*>(args.back().get()))) --n_args;
+        if (n_args > 1) throw ArgumentCountError(args.size(), 0, 2);
+        ObjectPtr init = n_args ? args[0] : make_value(0);
+
+        Elements list(*this);
+        auto nums = proc ? nullptr : list.numbers();
+        if (nums && dynamic_cast<const Number*>(init.get()))
+        {
+            if (nums->kind != PackedNumbers::INTS)
+            {
+                auto total = kernels::sum(nums->doubles.data(), nums->doubles.size());
+                return init->add(make_value(total).get());
+            }
+            long long total;
+            if (kernels::sum(nums->ints.data(), nums->ints.size(), &total))
+                return init->add(make_value(total).get());
+            //else it overflows, so add each in turn, switching to Number where needed
+        }
+        auto total = init;
+        for (size_t i = 0; i < list.size(); ++i)
+        {
+            auto e = list[i];
+            total = total->add(proc ? proc->call({ e }).get() : e.get());
+        }
+        return total;
+    }
     std::shared_ptr<Array> Array::take(const Number * n)
     {
+        auto &list = get_value();
         std::vector<ObjectPtr> out;
         auto count = (int)n->get_value();
         if (count < 0) throw ArgumentError("negative array size");
-        for (int i = 0; i < count && i < (int)arr.size(); ++i) out.push_back(arr[i]);
+        for (int i = 0; i < count && i < (int)list.size(); ++i) out.push_back(list[i]);
         return make_value(std::move(out));
     }
-    std::shared_ptr<Array> Array::uniq()
+    std::shared_ptr<Array> Array::uniq(const FunctionArgs &args)
     {
+        auto &list = get_value();
+        Proc *proc = nullptr;
+        unpack<0>(args, &proc);
+        SeenSet seen(list.size());
         std::vector<ObjectPtr> out;
-        for (auto &i : arr)
+        for (auto &i : list)
         {
-            if (std::find_if(out.begin(), out.end(), [i](const ObjectPtr &a) {
-                return slim::eq(a.get(), i.get());
-            }) == out.end())
-            {
-                out.push_back(i);
-            }
+            auto key = proc ? proc->call({ i }) : i;
+            if (seen.insert(key)) out.push_back(i);
         }
         return make_value(std::move(out));
     }
     std::shared_ptr<Array> Array::values_at(const FunctionArgs & args)
     {
+        auto &list = get_value();
         std::vector<ObjectPtr> out;
         for (auto &arg : args)
         {
             auto i = (int)as_number(arg);
-            if (i >= 0 && i < (int)arr.size()) out.push_back(arr[i]);
+            if (i >= 0 && i < (int)list.size()) out.push_back(list[i]);
             else out.push_back(NIL_VALUE);
         }
         return make_value(std::move(out));
@@ -390,9 +780,13 @@ namespace slim
             { &Array::flatten, "flatten" },
             { &Array::frozen_q, "frozen?" },
             { &Array::include_q, "include?" },
+            { &Array::include_q, "member?" },
             { Enumerable::method<Array>(&Array::find_index), "index" },
             { &Array::join, "join" },
             { &Array::last, "last" },
+            { &Array::max, "max" },
+            { &Array::min, "min" },
+            { &Array::minmax, "minmax" },
             { &Array::size, "size" },
             { &Array::size, "length" },
             { &Array::rassoc, "rassoc" },
@@ -403,6 +797,7 @@ namespace slim
             { &Array::slice, "slice" },
             { &Array::sort, "sort" },
             { &Array::sort_by, "sort_by" },
+            { &Array::sum, "sum" },
             { &Array::take, "take" },
             { &Array::uniq, "uniq" },
             { &Array::values_at, "values_at" }
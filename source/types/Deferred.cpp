@@ -0,0 +1,48 @@
+#include "types/Deferred.hpp"
+#include "Function.hpp"
+#include <chrono>
+namespace slim
+{
+    Deferred::Deferred(std::shared_future<ObjectPtr> future)
+        : future(std::move(future))
+    {}
+
+    std::string Deferred::to_string()const
+    {
+        return value()->to_string();
+    }
+    std::string Deferred::inspect()const
+    {
+        return value()->inspect();
+    }
+    bool Deferred::is_true()const
+    {
+        return value()->is_true();
+    }
+
+    ObjectPtr Deferred::value()const
+    {
+        auto val = future.get();
+        if (auto next = dynamic_cast<const Deferred*>(val.get())) return next->value();
+        return val;
+    }
+    bool Deferred::ready_q()const
+    {
+        return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }
+
+    const MethodTable &Deferred::method_table()const
+    {
+        static const MethodTable table(Object::method_table(),
+        {
+            { &Deferred::ready_q, "ready?" },
+            { &Deferred::value, "value" }
+        });
+        return table;
+    }
+
+    std::shared_ptr<Deferred> make_deferred(std::function<ObjectPtr()> func)
+    {
+        return create_object<Deferred>(std::async(std::launch::async, std::move(func)).share());
+    }
+}
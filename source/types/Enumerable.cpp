@@ -3,7 +3,9 @@
 #include "types/Array.hpp"
 #include "types/Hash.hpp"
 #include "types/Proc.hpp"
+#include "types/Set.hpp"
 #include "Function.hpp"
+#include "Operators.hpp"
 #include <sstream>
 #include <algorithm>
 #include <deque>
@@ -98,6 +100,41 @@ namespace slim
         catch (const SpecialFlowException &) { return TRUE_VALUE; }
     }
 
+    namespace
+    {
+        /**Arrays of consecutive elements, split between each pair for which split is true.*/
+        template<class T> Ptr<Array> do_chunk(Enumerable *self, T split)
+        {
+            std::vector<ObjectPtr> out, chunk;
+            ObjectPtr prev = nullptr;
+            self->each_single([&out, &chunk, &prev, split](Object *nextp) {
+                auto next = nextp->shared_from_this();
+                if (prev && split(prev, next))
+                {
+                    out.push_back(make_value(std::move(chunk)));
+                    chunk.clear();
+                }
+                chunk.push_back(next);
+                prev = next;
+                return NIL_VALUE;
+            });
+            if (!chunk.empty()) out.push_back(make_value(std::move(chunk)));
+            return make_value(std::move(out));
+        }
+    }
+    ObjectPtr Enumerable::chunk_while(const FunctionArgs &args)
+    {
+        Proc *proc = nullptr;
+        unpack<0>(args, &proc);
+        if (proc)
+        {
+            return do_chunk(this, [proc](ObjectPtr a, ObjectPtr b) {
+                return !proc->call({ a, b })->is_true();
+            });
+        }
+        else return make_enumerator(this_obj(), this, &Enumerable::chunk_while, "chunk_while");
+    }
+
     Ptr<Number> Enumerable::count(const FunctionArgs &args)
     {
         unsigned count = 0;
@@ -164,6 +201,51 @@ namespace slim
         else throw ArgumentCountError(args.size(), 0, 1);
     }
 
+    ObjectPtr Enumerable::each_cons(const FunctionArgs &args)
+    {
+        Number *n_obj;
+        Proc *proc = nullptr;
+        unpack<1>(args, &n_obj, &proc);
+        int n = (int)n_obj->get_value();
+        if (n <= 0) throw ArgumentError("invalid size");
+        if (proc)
+        {
+            std::deque<ObjectPtr> window;
+            each_single([&window, proc, n](Object *arg) {
+                window.push_back(arg->shared_from_this());
+                if (window.size() > (size_t)n) window.pop_front();
+                if (window.size() == (size_t)n) proc->call({ make_array({ window.begin(), window.end() }) });
+                return NIL_VALUE;
+            });
+            return this_obj();
+        }
+        else return make_enumerator(this_obj(), this, &Enumerable::each_cons, "each_cons", args);
+    }
+
+    ObjectPtr Enumerable::each_slice(const FunctionArgs &args)
+    {
+        Number *n_obj;
+        Proc *proc = nullptr;
+        unpack<1>(args, &n_obj, &proc);
+        int n = (int)n_obj->get_value();
+        if (n <= 0) throw ArgumentError("invalid slice size");
+        if (proc)
+        {
+            std::vector<ObjectPtr> slice;
+            each_single([&slice, proc, n](Object *arg) {
+                slice.push_back(arg->shared_from_this());
+                if (slice.size() == (size_t)n)
+                {
+                    proc->call({ make_value(std::move(slice)) });
+                    slice.clear();
+                }
+                return NIL_VALUE;
+            });
+            if (!slice.empty()) proc->call({ make_value(std::move(slice)) });
+            return this_obj();
+        }
+        else return make_enumerator(this_obj(), this, &Enumerable::each_slice, "each_slice", args);
+    }
 
     ObjectPtr Enumerable::each_with_index(const FunctionArgs &args)
     {
@@ -304,7 +386,7 @@ namespace slim
         try
         {
             each_single([obj](Object *arg) {
-                if (arg->eq(obj)) throw SpecialFlowException(arg->shared_from_this());
+                if (arg == obj || slim::eq(arg, obj)) throw SpecialFlowException(arg->shared_from_this());
                 return NIL_VALUE;
             });
             return FALSE_VALUE;
@@ -351,33 +433,74 @@ namespace slim
             else throw ArgumentCountError(args.size(), 0, 2);
         }
     
-        template<class T> ObjectPtr do_min(Enumerable *self, int n, T cmp)
+        /**The n smallest elements by cmp, in order, or for n == 1 just the smallest element.
+         * key is called once for each element and cmp compares the keys, returning < 0, 0 or > 0.
+         * Equal elements keep their original order. For n > 1 a heap of the best n so far is
+         * kept, so only O(log n) comparisons are needed per element.
+         */
+        template<class Key, class Cmp> ObjectPtr do_min(Enumerable *self, int n, Key key, Cmp cmp)
         {
             if (n == 0) return make_array({});
             else if (n == 1)
             {
-                ObjectPtr min = nullptr;
-                self->each_single([&min, cmp](Object *nextp) {
+                ObjectPtr min = nullptr, min_key = nullptr;
+                self->each_single([&min, &min_key, key, cmp](Object *nextp) {
                     auto next = nextp->shared_from_this();
-                    if (!min) min = next;
-                    else if (cmp(next, min)) min = next;
+                    auto next_key = key(next);
+                    if (!min || cmp(next_key, min_key) < 0)
+                    {
+                        min = next;
+                        min_key = next_key;
+                    }
                     return NIL_VALUE;
                 });
                 return min ? min : NIL_VALUE;
             }
             else if (n > 1)
             {
-                std::deque<ObjectPtr> arr;
-                self->each_single([&arr, cmp, n](Object *nextp) {
+                struct Entry
+                {
+                    ObjectPtr key, value;
+                    size_t index;
+                };
+                auto before = [cmp](const Entry &a, const Entry &b) {
+                    auto c = cmp(a.key, b.key);
+                    return c < 0 || (c == 0 && a.index < b.index);
+                };
+                //max heap by "before", so the front is the first to discard
+                std::vector<Entry> heap;
+                size_t index = 0;
+                self->each_single([&heap, &index, key, before, n](Object *nextp) {
                     auto next = nextp->shared_from_this();
-                    arr.insert(std::upper_bound(arr.begin(), arr.end(), next, cmp), next);
-                    if (arr.size() > (size_t)n) arr.pop_back();
+                    Entry entry = { key(next), next, index++ };
+                    if (heap.size() < (size_t)n)
+                    {
+                        heap.push_back(std::move(entry));
+                        std::push_heap(heap.begin(), heap.end(), before);
+                    }
+                    else if (before(entry, heap.front()))
+                    {
+                        std::pop_heap(heap.begin(), heap.end(), before);
+                        heap.back() = std::move(entry);
+                        std::push_heap(heap.begin(), heap.end(), before);
+                    }
                     return NIL_VALUE;
                 });
-                return make_array({arr.begin(), arr.end()});
+                std::sort_heap(heap.begin(), heap.end(), before);
+                std::vector<ObjectPtr> out;
+                out.reserve(heap.size());
+                for (auto &i : heap) out.push_back(std::move(i.value));
+                return make_value(std::move(out));
             }
             else throw ArgumentError("negative size (" + std::to_string(n) + ")");
         }
+
+        ObjectPtr identity_key(const ObjectPtr &x) { return x; }
+        int block_cmp(Proc *proc, const ObjectPtr &a, const ObjectPtr &b)
+        {
+            auto c = coerce<Number>(proc->call({ a, b }))->get_value();
+            return c < 0 ? -1 : c > 0 ? 1 : 0;
+        }
     }
     ObjectPtr Enumerable::max(const FunctionArgs &args)
     {
@@ -386,14 +509,14 @@ namespace slim
         minmax_args(args, &proc, &n);
         if (proc)
         {
-            return do_min(this, n, [proc](ObjectPtr a, ObjectPtr b) {
-                return coerce<Number>(proc->call({ a, b }))->get_value() > 0;
+            return do_min(this, n, identity_key, [proc](const ObjectPtr &a, const ObjectPtr &b) {
+                return -block_cmp(proc, a, b);
             });
         }
         else
         {
-            return do_min(this, n, [](ObjectPtr a, ObjectPtr b) {
-                return slim::cmp(a.get(), b.get()) > 0;
+            return do_min(this, n, identity_key, [](const ObjectPtr &a, const ObjectPtr &b) {
+                return -slim::cmp(a.get(), b.get());
             });
         }
     }
@@ -404,9 +527,9 @@ namespace slim
         minmax_args(args, &proc, &n);
         if (proc)
         {
-            return do_min(this, n, [proc](ObjectPtr a, ObjectPtr b) {
-                return slim::cmp(proc->call({a}).get(), proc->call({b}).get()) > 0;
-            });
+            return do_min(this, n,
+                [proc](const ObjectPtr &x) { return proc->call({ x }); },
+                [](const ObjectPtr &a, const ObjectPtr &b) { return -slim::cmp(a.get(), b.get()); });
         }
         else return make_enumerator(this_obj(), this, &Enumerable::max_by, "max_by", args);
     }
@@ -417,14 +540,14 @@ namespace slim
         minmax_args(args, &proc, &n);
         if (proc)
         {
-            return do_min(this, n, [proc](ObjectPtr a, ObjectPtr b) {
-                return coerce<Number>(proc->call({ a, b }))->get_value() < 0;
+            return do_min(this, n, identity_key, [proc](const ObjectPtr &a, const ObjectPtr &b) {
+                return block_cmp(proc, a, b);
             });
         }
         else
         {
-            return do_min(this, n, [](ObjectPtr a, ObjectPtr b) {
-                return slim::cmp(a.get(), b.get()) < 0;
+            return do_min(this, n, identity_key, [](const ObjectPtr &a, const ObjectPtr &b) {
+                return slim::cmp(a.get(), b.get());
             });
         }
     }
@@ -435,25 +558,39 @@ namespace slim
         minmax_args(args, &proc, &n);
         if (proc)
         {
-            return do_min(this, n, [proc](ObjectPtr a, ObjectPtr b) {
-                return slim::cmp(proc->call({ a }).get(), proc->call({ b }).get()) < 0;
-            });
+            return do_min(this, n,
+                [proc](const ObjectPtr &x) { return proc->call({ x }); },
+                [](const ObjectPtr &a, const ObjectPtr &b) { return slim::cmp(a.get(), b.get()); });
         }
         else return make_enumerator(this_obj(), this, &Enumerable::min_by, "min_by", args);
     }
 
     namespace
     {
-        template<class T> ObjectPtr do_minmax(Enumerable *self, T cmp)
+        /**[min, max] by cmp, calling key once for each element, see do_min.*/
+        template<class Key, class Cmp> ObjectPtr do_minmax(Enumerable *self, Key key, Cmp cmp)
         {
-            ObjectPtr min = nullptr, max = nullptr;
-            self->each_single([&min, &max, cmp](Object *nextp) {
+            ObjectPtr min = nullptr, max = nullptr, min_key = nullptr, max_key = nullptr;
+            self->each_single([&min, &max, &min_key, &max_key, key, cmp](Object *nextp) {
                 auto next = nextp->shared_from_this();
-                if (!min) min = max = next;
+                auto next_key = key(next);
+                if (!min)
+                {
+                    min = max = next;
+                    min_key = max_key = next_key;
+                }
                 else
                 {
-                    if (cmp(next, min) < 0) min = next;
-                    if (cmp(next, max) > 0) max = next;
+                    if (cmp(next_key, min_key) < 0)
+                    {
+                        min = next;
+                        min_key = next_key;
+                    }
+                    if (cmp(next_key, max_key) > 0)
+                    {
+                        max = next;
+                        max_key = next_key;
+                    }
                 }
                 return NIL_VALUE;
             });
@@ -466,13 +603,13 @@ namespace slim
         unpack<0>(args, &proc);
         if (proc)
         {
-            return do_minmax(this, [proc](ObjectPtr a, ObjectPtr b) {
-                return (int)coerce<Number>(proc->call({ a, b }))->get_value();
+            return do_minmax(this, identity_key, [proc](const ObjectPtr &a, const ObjectPtr &b) {
+                return block_cmp(proc, a, b);
             });
         }
         else
         {
-            return do_minmax(this, [](ObjectPtr a, ObjectPtr b) {
+            return do_minmax(this, identity_key, [](const ObjectPtr &a, const ObjectPtr &b) {
                 return slim::cmp(a.get(), b.get());
             });
         }
@@ -484,9 +621,9 @@ namespace slim
         unpack<0>(args, &proc);
         if (proc)
         {
-            return do_minmax(this, [proc](ObjectPtr a, ObjectPtr b) {
-                return slim::cmp(proc->call({a}).get(), proc->call({b}).get());
-            });
+            return do_minmax(this,
+                [proc](const ObjectPtr &x) { return proc->call({ x }); },
+                [](const ObjectPtr &a, const ObjectPtr &b) { return slim::cmp(a.get(), b.get()); });
         }
         else return make_enumerator(this_obj(), this, &Enumerable::minmax_by, "minmax_by");
     }
@@ -616,6 +753,19 @@ namespace slim
         else return make_enumerator(this_obj(), this, &Enumerable::select, "select", args);
     }
 
+    ObjectPtr Enumerable::slice_when(const FunctionArgs &args)
+    {
+        Proc *proc = nullptr;
+        unpack<0>(args, &proc);
+        if (proc)
+        {
+            return do_chunk(this, [proc](ObjectPtr a, ObjectPtr b) {
+                return proc->call({ a, b })->is_true();
+            });
+        }
+        else return make_enumerator(this_obj(), this, &Enumerable::slice_when, "slice_when");
+    }
+
     Ptr<Array> Enumerable::sort(const FunctionArgs &args)
     {
         return to_a({})->sort(args);
@@ -626,6 +776,32 @@ namespace slim
         return to_a({})->sort_by(args);
     }
 
+    ObjectPtr Enumerable::sum(const FunctionArgs &args)
+    {
+        Proc *proc = nullptr;
+        auto n_args = args.size();
+        if (n_args && (proc = dynamic_cast<Proc*>(args.back().get()))) --n_args;
+        if (n_args > 1) throw ArgumentCountError(args.size(), 0, 2);
+        ObjectPtr total = n_args ? args[0] : make_value(0);
+        each_single([&total, proc](Object *arg) {
+            total = total->add(proc ? proc->call({ arg->shared_from_this() }).get() : arg);
+            return NIL_VALUE;
+        });
+        return total;
+    }
+
+    Ptr<Hash> Enumerable::tally()
+    {
+        OrderedMap<ObjectPtr, long long, ObjHash, ObjEquals> counts;
+        each_single([&counts](Object *arg) {
+            ++counts[arg->shared_from_this()];
+            return NIL_VALUE;
+        });
+        auto ret = create_object<Hash>();
+        for (auto &i : counts) ret->set(i.first, make_value(i.second));
+        return ret;
+    }
+
     Ptr<Array> Enumerable::take(Number *n_obj)
     {
         int n = (int)n_obj->get_value();
@@ -703,4 +879,55 @@ namespace slim
         });
         return ret;
     }
+
+    Ptr<Set> Enumerable::to_set()
+    {
+        return Set::create_from(this_obj().get());
+    }
+
+    Ptr<Array> Enumerable::uniq(const FunctionArgs &args)
+    {
+        Proc *proc = nullptr;
+        unpack<0>(args, &proc);
+        ObjectSet seen;
+        std::vector<ObjectPtr> out;
+        each_single([&seen, &out, proc](Object *arg) {
+            auto value = arg->shared_from_this();
+            if (seen.insert(proc ? proc->call({ value }) : value).second) out.push_back(value);
+            return NIL_VALUE;
+        });
+        return make_value(std::move(out));
+    }
+
+    ObjectPtr Enumerable::zip(const FunctionArgs &args)
+    {
+        Proc *proc = nullptr;
+        auto n_args = args.size();
+        if (n_args && (proc = dynamic_cast<Proc*>(args.back().get()))) --n_args;
+        std::vector<Ptr<Array>> others;
+        for (size_t i = 0; i < n_args; ++i)
+        {
+            if (auto arr = std::dynamic_pointer_cast<Array>(args[i])) others.push_back(arr);
+            else if (auto e = dynamic_cast<Enumerable*>(args[i].get())) others.push_back(e->to_a({}));
+            else throw TypeError(args[i].get(), Array::name());
+        }
+        std::vector<ObjectPtr> out;
+        size_t index = 0;
+        each_single([&others, &out, &index, proc](Object *arg) {
+            std::vector<ObjectPtr> tuple;
+            tuple.reserve(others.size() + 1);
+            tuple.push_back(arg->shared_from_this());
+            for (auto &other : others)
+            {
+                auto &list = other->get_value();
+                tuple.push_back(index < list.size() ? list[index] : NIL_VALUE);
+            }
+            ++index;
+            if (proc) proc->call({ make_value(std::move(tuple)) });
+            else out.push_back(make_value(std::move(tuple)));
+            return NIL_VALUE;
+        });
+        if (proc) return NIL_VALUE;
+        else return make_value(std::move(out));
+    }
 }
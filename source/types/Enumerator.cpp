@@ -2,6 +2,7 @@
 #include "types/Array.hpp"
 #include "types/Hash.hpp"
 #include "types/Proc.hpp"
+#include "types/Set.hpp"
 #include "Function.hpp"
 #include <sstream>
 
@@ -2,17 +2,74 @@
 #include "types/Array.hpp"
 #include "types/Enumerator.hpp"
 #include "types/Proc.hpp"
+#include "types/Set.hpp"
+#include "types/Symbol.hpp"
 #include "Value.hpp"
 #include "Function.hpp"
 #include "Operators.hpp"
 #include <algorithm>
+#include <atomic>
 #include <sstream>
 #include <set>
+#include <typeinfo>
 
 namespace slim
 {
+    HashShape::HashShape(uint32_t id, std::vector<SymPtr> &&keys, const HashShape *next_transition)
+        : _id(id), keys(std::move(keys)), mutex(), transitions(nullptr), transition_count(0)
+        , next_transition(next_transition)
+    {}
+    HashShape::~HashShape()
+    {
+        for (auto i = transitions.load(std::memory_order_relaxed); i;)
+        {
+            auto next = i->next_transition;
+            delete i;
+            i = next;
+        }
+    }
+    const HashShape *HashShape::root()
+    {
+        static const HashShape root(1, {}, nullptr);
+        return &root;
+    }
+    const HashShape *HashShape::add(const SymPtr &key)const
+    {
+        static std::atomic<uint32_t> next_id(2);
+        assert(find(key.get()) == NOT_FOUND);
+        if (keys.size() >= MAX_KEYS) return nullptr;
+
+        //every hash starts from the root, so finding an existing shape must not lock
+        auto head = transitions.load(std::memory_order_acquire);
+        for (auto i = head; i; i = i->next_transition)
+        {
+            if (i->keys.back() == key) return i;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        //only those added since head was loaded still need checking
+        auto latest = transitions.load(std::memory_order_relaxed);
+        for (auto i = latest; i != head; i = i->next_transition)
+        {
+            if (i->keys.back() == key) return i;
+        }
+        if (transition_count >= MAX_TRANSITIONS) return nullptr;
+
+        auto new_keys = keys;
+        new_keys.push_back(key);
+        auto shape = new HashShape(next_id++, std::move(new_keys), latest);
+        ++transition_count;
+        transitions.store(shape, std::memory_order_release);
+        return shape;
+    }
+
     Hash::Hash()
-        : def_value(NIL_VALUE), map(), list()
+        : Hash(NIL_VALUE)
+    {}
+    Hash::Hash(ObjectPtr def_value)
+        : def_value(def_value), entries(), base(), added(0)
+    {}
+    Hash::~Hash()
     {}
 
     std::string Hash::inspect() const
@@ -20,7 +77,7 @@ namespace slim
         std::stringstream ss;
         ss << '{';
         bool first = true;
-        for (auto &i : list)
+        for (auto &i : *this)
         {
             if (first) first = false;
             else ss << ", ";
@@ -32,19 +89,27 @@ namespace slim
     bool Hash::eq(const Object * orhs) const
     {
         auto rhs = coerce<Hash>(orhs);
-        if (map.size() != rhs->map.size()) return false;
-        for (auto &i : map)
+        if (count() != rhs->count()) return false;
+        if (get_shape() && get_shape() == rhs->get_shape())
+        {
+            for (size_t i = 0; i < get_shape()->size(); ++i)
+            {
+                if (!slim::eq(get_slot(i).get(), rhs->get_slot(i).get())) return false;
+            }
+            return true;
+        }
+        for (auto &i : *this)
         {
-            auto it = rhs->map.find(i.first);
-            if (it == rhs->map.end()) return false;
-            if (!slim::eq(list[i.second].second.get(), rhs->list[it->second].second.get())) return false;
+            auto val = rhs->find_value(i.first);
+            if (!val) return false;
+            if (!slim::eq(i.second.get(), val->get())) return false;
         }
         return true;
     }
     size_t Hash::hash() const
     {
         size_t h = 0;
-        for (auto &i : list)
+        for (auto &i : *this)
         {
             auto h2 = detail::hash(*i.first);
             detail::hash_combine(h2, *i.second);
@@ -53,45 +118,135 @@ namespace slim
         return h;
     }
 
+    const Hash::Storage &Hash::Storage::empty()
+    {
+        static const Storage storage;
+        return storage;
+    }
+    const ObjectPtr *Hash::Storage::find(const ObjectPtr &key)const
+    {
+        if (shape)
+        {
+            //A key of any other type can not be equal to a symbol
+            if (typeid(*key) != typeid(Symbol)) return nullptr;
+            auto slot = shape->find(static_cast<const Symbol*>(key.get()));
+            return slot != HashShape::NOT_FOUND ? &slots[slot] : nullptr;
+        }
+        else
+        {
+            auto it = map.find(key);
+            return it != map.end() ? &it->second : nullptr;
+        }
+    }
+    void Hash::Storage::set(const ObjectPtr &key, const ObjectPtr &val)
+    {
+        if (shape)
+        {
+            if (typeid(*key) == typeid(Symbol))
+            {
+                auto sym = std::static_pointer_cast<Symbol>(key);
+                auto slot = shape->find(sym.get());
+                if (slot != HashShape::NOT_FOUND)
+                {
+                    slots[slot] = val;
+                    return;
+                }
+                if (auto next = shape->add(sym))
+                {
+                    shape = next;
+                    slots.push_back(val);
+                    return;
+                }
+            }
+            convert_to_table();
+        }
+        auto x = map.emplace(key, val);
+        if (!x.second) x.first->second = val;
+    }
+    void Hash::Storage::convert_to_table()
+    {
+        assert(shape);
+        map.reserve(slots.size() + 1);
+        for (size_t i = 0; i < slots.size(); ++i)
+        {
+            map.emplace(shape->key(i), std::move(slots[i]));
+        }
+        slots.clear();
+        slots.shrink_to_fit();
+        shape = nullptr;
+    }
+
+    const ObjectPtr *Hash::find_value(const ObjectPtr &key)const
+    {
+        auto val = own().find(key);
+        if (val || !base) return val;
+        else return base->find(key);
+    }
+    Hash::Storage &Hash::mutable_own()
+    {
+        if (!entries) entries = std::make_shared<Storage>();
+        //also shared if another hash uses it as a base
+        else if (entries.use_count() > 1) entries = std::make_shared<Storage>(*entries);
+        return *entries;
+    }
+
     ObjectPtr Hash::get(ObjectPtr key)
     {
-        auto it = map.find(key);
-        if (it != map.end()) return list[it->second].second;
-        else return NIL_VALUE;
+        auto val = find_value(key);
+        return val ? *val : NIL_VALUE;
     }
     void Hash::set(ObjectPtr key, ObjectPtr val)
     {
-        auto x = map.emplace(key, 0);
-        if (x.second)
+        if (base)
         {
-            x.first->second = list.size();
-            list.emplace_back(key, val);
+            if (!own().find(key) && !base->find(key)) ++added;
+            mutable_own().set(key, val);
+            //Once most entries are in the overlay, sharing the base no longer saves anything
+            if (own_count() > base->size()) detach_base();
         }
-        else list[x.first->second].second = val;
+        else mutable_own().set(key, val);
     }
 
     std::string Hash::get_str(const std::string &key, const std::string &def)
     {
-        auto it = map.find(make_value(key));
-        if (it != map.end()) return list[it->second].second->to_string();
-        else return def;
+        auto val = find_value(make_value(key));
+        return val ? (*val)->to_string() : def;
     }
 
 
+    std::shared_ptr<Hash> Hash::share()const
+    {
+        auto out = create_object<Hash>(def_value);
+        if (base || count() >= MIN_SHARED_SIZE)
+        {
+            //this hash copies entries before its next change, so it is immutable as a base
+            out->base = base ? base : entries;
+            if (base) out->entries = entries;
+            out->added = added;
+        }
+        else out->entries = entries;
+        return out;
+    }
+    void Hash::detach_base()
+    {
+        assert(base);
+        std::vector<value_type> flat(begin(), end());
+        entries = std::make_shared<Storage>();
+        base.reset();
+        added = 0;
+        for (auto &i : flat) entries->set(i.first, i.second);
+    }
+
     std::shared_ptr<Hash> Hash::dup()
     {
-        auto ret = create_object<Hash>();
-        ret->list = list;
-        ret->map = map;
-        return ret;
+        return share();
     }
 
     ObjectPtr Hash::el_ref(const FunctionArgs &args)
     {
         if (args.size() != 1) throw ArgumentError(this, "[]");
-        auto it = map.find(args[0]);
-        if (it != map.end()) return list[it->second].second;
-        else return def_value;
+        auto val = find_value(args[0]);
+        return val ? *val : def_value;
     }
 
     ObjectPtr Hash::each(const FunctionArgs &args)
@@ -100,7 +255,7 @@ namespace slim
         unpack<0>(args, &proc);
         if (proc)
         {
-            for (auto &i : list)
+            for (auto &i : *this)
             {
                 proc->call({ i.first, i.second });
             }
@@ -114,7 +269,7 @@ namespace slim
         unpack<0>(args, &proc);
         if (proc)
         {
-            for (auto &i : list)
+            for (auto &i : *this)
             {
                 proc->call({ i.first });
             }
@@ -128,7 +283,7 @@ namespace slim
         unpack<0>(args, &proc);
         if (proc)
         {
-            for (auto &i : list)
+            for (auto &i : *this)
             {
                 proc->call({ i.second });
             }
@@ -139,14 +294,14 @@ namespace slim
 
     ObjectPtr Hash::empty_q()
     {
-        return make_value(map.empty());
+        return make_value(count() == 0);
     }
 
     ObjectPtr Hash::fetch(const FunctionArgs &args)
     {
         if (args.empty()) throw ArgumentError(this, "fetch");
-        auto it = map.find(args[0]);
-        if (it != map.end()) return list[it->second].second;
+        auto val = find_value(args[0]);
+        if (val) return *val;
 
         if (args.size() == 1) throw KeyError(args[0]);
         //TODO: Block
@@ -159,67 +314,73 @@ namespace slim
         else if (args.size() > 1) throw ArgumentError(this, "flatten");
 
         std::vector<ObjectPtr> out;
-        for (auto &i : list)
+        for (auto &i : *this)
         {
             out.push_back(i.first);
             out.push_back(i.second);
         }
 
         auto arr = make_array(std::move(out));
-        if (level > 1) arr = arr->flatten({ make_value((double)level - 1) });
+        if (level > 1) arr = arr->flatten({ make_value(level - 1) });
         return arr;
     }
 
     ObjectPtr Hash::has_key_q(Object * obj)
     {
-        return make_value(map.find(obj->shared_from_this()) != map.end());
+        return make_value(find_value(obj->shared_from_this()) != nullptr);
     }
     ObjectPtr Hash::has_value_q(const Object * obj)
     {
-        for (auto &i : list) if (slim::eq(i.second.get(), obj)) return TRUE_VALUE;
+        for (auto &i : *this) if (slim::eq(i.second.get(), obj)) return TRUE_VALUE;
         return FALSE_VALUE;
     }
 
     std::shared_ptr<Hash> Hash::invert()
     {
         auto out = create_object<Hash>(def_value);
-        for (auto &i : list)
+        for (auto &i : *this)
             out->set(i.second, i.first);
         return out;
     }
 
     ObjectPtr Hash::key(const Object *val)
     {
-        for (auto &i : list) if (slim::eq(i.second.get(), val)) return i.first;
+        for (auto &i : *this) if (slim::eq(i.second.get(), val)) return i.first;
         return NIL_VALUE;
     }
 
     std::shared_ptr<Array> Hash::keys()
     {
         std::vector<ObjectPtr> out;
-        for (auto &i : list) out.push_back(i.first);
+        for (auto &i : *this) out.push_back(i.first);
         return make_array(std::move(out));
     }
 
     std::shared_ptr<Array> Hash::values()
     {
         std::vector<ObjectPtr> out;
-        for (auto &i : list) out.push_back(i.second);
+        for (auto &i : *this) out.push_back(i.second);
         return make_array(std::move(out));
     }
 
     ObjectPtr Hash::size()
     {
-        return make_value((double)map.size());
+        return make_value(count());
     }
 
     std::shared_ptr<Hash> Hash::merge(Hash *other_hash)
     {
         //TODO: Block
-        auto out = create_object<Hash>(def_value);
-        for (auto &i : list)
-            out->set(i.first, i.second);
-        for (auto &i : other_hash->list)
+        //Share this hash when adding a few entries to a larger one, e.g. locals for a partial
+        std::shared_ptr<Hash> out;
+        if (count() >= MIN_SHARED_SIZE && other_hash->count() < count()) out = share();
+        else
+        {
+            out = create_object<Hash>(def_value);
+            auto &storage = out->mutable_own();
+            for (auto &i : *this) storage.set(i.first, i.second);
+        }
+        for (auto &i : *other_hash)
             out->set(i.first, i.second);
         return out;
     }
@@ -227,7 +388,7 @@ namespace slim
     std::shared_ptr<Array> Hash::to_a()
     {
         std::vector<ObjectPtr> out;
-        for (auto &i : list)
+        for (auto &i : *this)
             out.push_back(make_array({ i.first, i.second }));
         return make_array(std::move(out));
     }
@@ -3,6 +3,7 @@
 #include "Error.hpp"
 #include "Function.hpp"
 #include <sstream>
+#include <climits>
 #include <cmath>
 
 namespace slim
@@ -79,29 +80,98 @@ namespace slim
         return make_value(-v);
     }
 
+    namespace
+    {
+        /**Value for the bit operators, truncated to an integer.*/
+        long long bits(const Number *n)
+        {
+            if (typeid(*n) == typeid(Integer)) return static_cast<const Integer*>(n)->get_int();
+            else return (long long)n->get_value();
+        }
+        long long bits(Object *obj)
+        {
+            return bits(coerce<Number>(obj));
+        }
+        ObjectPtr shift_right(long long x, long long n);
+        ObjectPtr shift_left(long long x, long long n)
+        {
+            if (n < 0) return shift_right(x, n == LLONG_MIN ? LLONG_MAX : -n);
+            if (x == 0) return make_value(0);
+            if (n >= 63 || x > (LLONG_MAX >> n) || x < (LLONG_MIN >> n))
+                return make_value(std::ldexp((double)x, n >= 2048 ? 2048 : (int)n));
+            return make_value((long long)((unsigned long long)x << n));
+        }
+        ObjectPtr shift_right(long long x, long long n)
+        {
+            if (n < 0) return shift_left(x, n == LLONG_MIN ? LLONG_MAX : -n);
+            if (n >= 63) return make_value(x < 0 ? -1 : 0);
+            return make_value(x >> n);
+        }
+
+        bool add_overflow(long long a, long long b, long long *out)
+        {
+#if defined(__GNUC__)
+            return __builtin_add_overflow(a, b, out);
+#else
+            if ((b > 0 && a > LLONG_MAX - b) || (b < 0 && a < LLONG_MIN - b)) return true;
+            *out = a + b;
+            return false;
+#endif
+        }
+        bool sub_overflow(long long a, long long b, long long *out)
+        {
+#if defined(__GNUC__)
+            return __builtin_sub_overflow(a, b, out);
+#else
+            if ((b < 0 && a > LLONG_MAX + b) || (b > 0 && a < LLONG_MIN + b)) return true;
+            *out = a - b;
+            return false;
+#endif
+        }
+        bool mul_overflow(long long a, long long b, long long *out)
+        {
+#if defined(__GNUC__)
+            return __builtin_mul_overflow(a, b, out);
+#else
+            if (a > 0)
+            {
+                if (b > 0 ? a > LLONG_MAX / b : b < LLONG_MIN / a) return true;
+            }
+            else if (b > 0 ? a < LLONG_MIN / b : (a != 0 && b < LLONG_MAX / a)) return true;
+            *out = a * b;
+            return false;
+#endif
+        }
+        /**rhs as an Integer, or nullptr for other types.*/
+        const Integer *as_int(const Object *rhs)
+        {
+            return typeid(*rhs) == typeid(Integer) ? static_cast<const Integer*>(rhs) : nullptr;
+        }
+    }
+
     ObjectPtr Number::bit_lshift(Object * rhs)
     {
-        return make_value((int)v << (int)coerce<Number>(rhs)->get_value());
+        return shift_left(bits(this), bits(rhs));
     }
     ObjectPtr Number::bit_rshift(Object * rhs)
     {
-        return make_value((int)v >> (int)coerce<Number>(rhs)->get_value());
+        return shift_right(bits(this), bits(rhs));
     }
     ObjectPtr Number::bit_and(Object * rhs)
     {
-        return make_value((int)v & (int)coerce<Number>(rhs)->get_value());
+        return make_value(bits(this) & bits(rhs));
     }
     ObjectPtr Number::bit_or(Object * rhs)
     {
-        return make_value((int)v | (int)coerce<Number>(rhs)->get_value());
+        return make_value(bits(this) | bits(rhs));
     }
     ObjectPtr Number::bit_xor(Object * rhs)
     {
-        return make_value((int)v ^ (int)coerce<Number>(rhs)->get_value());
+        return make_value(bits(this) ^ bits(rhs));
     }
     ObjectPtr Number::bit_not()
     {
-        return make_value(~(int)v);
+        return make_value(~bits(this));
     }
 
     std::shared_ptr<Number> Number::to_f()
@@ -110,7 +180,7 @@ namespace slim
     }
     std::shared_ptr<Number> Number::to_i()
     {
-        return make_value(std::trunc(v));
+        return make_integral(std::trunc(v));
     }
 
     std::shared_ptr<Number> Number::abs()
@@ -132,12 +202,12 @@ namespace slim
 
     std::shared_ptr<Number> Number::ceil()
     {
-        return make_value(std::ceil(v));
+        return make_integral(std::ceil(v));
     }
 
     std::shared_ptr<Number> Number::floor()
     {
-        return make_value(std::floor(v));
+        return make_integral(std::floor(v));
     }
 
 
@@ -153,9 +223,9 @@ namespace slim
         else if (args.size() > 1) throw ArgumentError(this, "round");
 
         if (v == 0) return std::static_pointer_cast<Number>(shared_from_this());
-        if (ndigits == 0) return make_value(std::round(v));
+        if (ndigits == 0) return make_integral(std::round(v));
         else if (ndigits > 0) return make_value(round_f(v, ndigits));
-        else return make_value(std::round(round_f(v, -ndigits)));
+        else return make_integral(std::round(round_f(v, -ndigits)));
     }
 
     Ptr<Boolean> Number::finite_q()
@@ -181,43 +251,149 @@ namespace slim
     }
 
 
+    const MethodTable &Integer::method_table()const
+    {
+        static const MethodTable table(Number::method_table(),
+        {
+            { &Integer::to_f, "to_f" },
+            { &Integer::to_f, "to_d" },
+            { &Integer::to_i, "to_i" },
+            { &Integer::abs, "abs" },
+            { &Integer::to_i, "ceil" },
+            { &Integer::to_i, "floor" },
+            { &Integer::round, "round" },
+
+            //alias
+            { &Integer::to_i, "truncate" },
+            { &Integer::to_i, "to_int" },
+            { &Integer::abs, "magnitude" }
+        });
+        return table;
+    }
+
+    ObjectPtr Integer::mul(Object *rhs)
+    {
+        long long r;
+        auto rhs_i = as_int(rhs);
+        if (rhs_i && !mul_overflow(i, rhs_i->i, &r)) return make_value(r);
+        else return Number::mul(rhs);
+    }
+    ObjectPtr Integer::div(Object *rhs)
+    {
+        auto rhs_i = as_int(rhs);
+        //LLONG_MIN / -1 overflows, and so does LLONG_MIN % -1 on some platforms
+        if (rhs_i && rhs_i->i == -1) return negate();
+        else if (rhs_i && rhs_i->i != 0 && i % rhs_i->i == 0)
+            return make_value(i / rhs_i->i);
+        else return Number::div(rhs);
+    }
+    ObjectPtr Integer::mod(Object *rhs)
+    {
+        auto rhs_i = as_int(rhs);
+        if (rhs_i && rhs_i->i == -1) return make_value(0);
+        else if (rhs_i && rhs_i->i != 0) return make_value(i % rhs_i->i);
+        else return Number::mod(rhs);
+    }
+    ObjectPtr Integer::pow(Object *rhs)
+    {
+        auto rhs_i = as_int(rhs);
+        if (!rhs_i || rhs_i->i < 0) return Number::pow(rhs);
+        long long result = 1, base = i;
+        for (auto n = rhs_i->i; n; n >>= 1)
+        {
+            if ((n & 1) && mul_overflow(result, base, &result)) return Number::pow(rhs);
+            if (n > 1 && mul_overflow(base, base, &base)) return Number::pow(rhs);
+        }
+        return make_value(result);
+    }
+    ObjectPtr Integer::add(Object *rhs)
+    {
+        long long r;
+        auto rhs_i = as_int(rhs);
+        if (rhs_i && !add_overflow(i, rhs_i->i, &r)) return make_value(r);
+        else return Number::add(rhs);
+    }
+    ObjectPtr Integer::sub(Object *rhs)
+    {
+        long long r;
+        auto rhs_i = as_int(rhs);
+        if (rhs_i && !sub_overflow(i, rhs_i->i, &r)) return make_value(r);
+        else return Number::sub(rhs);
+    }
+    ObjectPtr Integer::negate()
+    {
+        if (i == LLONG_MIN) return Number::negate();
+        else return make_value(-i);
+    }
+
+    std::shared_ptr<Number> Integer::to_f()
+    {
+        return make_value(get_value());
+    }
+    std::shared_ptr<Number> Integer::to_i()
+    {
+        return std::static_pointer_cast<Integer>(shared_from_this());
+    }
+    std::shared_ptr<Number> Integer::abs()
+    {
+        if (i >= 0) return to_i();
+        else return std::static_pointer_cast<Number>(negate());
+    }
+    std::shared_ptr<Number> Integer::round(const FunctionArgs &args)
+    {
+        if (args.empty()) return to_i();
+        else return make_integral(Number::round(args)->get_value());
+    }
+
     namespace
     {
         static const unsigned char CACHE_MAX = 100;
         struct CachedNumbers
         {
-            std::shared_ptr<Number> numbers[CACHE_MAX + 1];
+            std::shared_ptr<Integer> numbers[CACHE_MAX + 1];
             CachedNumbers()
             {
                 for (int i = 0; i <= CACHE_MAX; ++i)
-                    numbers[i] = create_object<Number>(i);
+                    numbers[i] = create_object<Integer>(i);
             }
         };
-        std::shared_ptr<Number> *cached_numbers()
+        std::shared_ptr<Integer> *cached_numbers()
         {
             static CachedNumbers cache;
             return cache.numbers;
         }
     }
-    std::shared_ptr<Number> make_value(int v)
+    std::shared_ptr<Integer> make_value(int v)
     {
-        if (v >= 0 && v <= CACHE_MAX) return cached_numbers()[v];
-        else return create_object<Number>(v);
+        return make_value((long long)v);
     }
-    std::shared_ptr<Number> make_value(unsigned v)
+    std::shared_ptr<Integer> make_value(unsigned v)
     {
-        if (v >= 0 && v <= CACHE_MAX) return cached_numbers()[v];
-        else return create_object<Number>(v);
+        return make_value((long long)v);
     }
-    std::shared_ptr<Number> make_value(long long v)
+    std::shared_ptr<Integer> make_value(long v)
+    {
+        return make_value((long long)v);
+    }
+    std::shared_ptr<Integer> make_value(long long v)
     {
         if (v >= 0 && v <= CACHE_MAX) return cached_numbers()[v];
-        else return create_object<Number>((double)v);
+        else return create_object<Integer>(v);
+    }
+    std::shared_ptr<Number> make_value(unsigned long v)
+    {
+        return make_value((unsigned long long)v);
     }
     std::shared_ptr<Number> make_value(unsigned long long v)
     {
-        if (v >= 0 && v <= CACHE_MAX) return cached_numbers()[v];
+        if (v <= (unsigned long long)LLONG_MAX) return make_value((long long)v);
         else return create_object<Number>((double)v);
     }
+    std::shared_ptr<Number> make_integral(double v)
+    {
+        //-2^63 and 2^63 are exact doubles, every whole double in between fits
+        if (v >= -9223372036854775808.0 && v < 9223372036854775808.0 && std::trunc(v) == v)
+            return make_value((long long)v);
+        else return make_value(v);
+    }
 }
-
@@ -166,7 +166,50 @@ namespace slim
 
     ObjectPtr String::add(Object *rhs)
     {
-        return make_value(v + coerce<String>(rhs)->get_value());
+        auto rhs_str = std::static_pointer_cast<const String>(coerce<String>(rhs)->shared_from_this());
+        auto size = byte_size() + rhs_str->byte_size();
+        if (size < MIN_ROPE_SIZE)
+        {
+            auto a = view(), b = rhs_str->view();
+            std::string out;
+            out.reserve(size);
+            out.append(a.data(), a.size());
+            out.append(b.data(), b.size());
+            return make_value(std::move(out));
+        }
+        //the parts are copied out first, as both sides may be Strings for the same rope
+        std::vector<std::shared_ptr<const String>> parts;
+        if (rope)
+        {
+            //extend the list if this string ends at the end of it
+            rhs_str->get_rope_parts(parts);
+            std::unique_lock<std::mutex> lock(rope->mutex);
+            auto end = rope->first + (ptrdiff_t)rope->parts.size();
+            if (rope_end == end)
+            {
+                rope->parts.insert(rope->parts.end(), parts.begin(), parts.end());
+                return create_object<String>(rope, rope_begin, end + (ptrdiff_t)parts.size(), size);
+            }
+        }
+        else if (rhs_str->rope)
+        {
+            //or the front, if rhs starts at the start of it
+            auto &rhs_rope = rhs_str->rope;
+            get_rope_parts(parts);
+            std::unique_lock<std::mutex> lock(rhs_rope->mutex);
+            if (rhs_str->rope_begin == rhs_rope->first)
+            {
+                rhs_rope->parts.insert(rhs_rope->parts.begin(), parts.begin(), parts.end());
+                rhs_rope->first -= (ptrdiff_t)parts.size();
+                return create_object<String>(rhs_rope, rhs_rope->first, rhs_str->rope_end, size);
+            }
+        }
+        parts.clear();
+        get_rope_parts(parts);
+        rhs_str->get_rope_parts(parts);
+        auto new_rope = std::make_shared<StringRope>();
+        new_rope->parts.assign(parts.begin(), parts.end());
+        return create_object<String>(std::move(new_rope), 0, (ptrdiff_t)parts.size(), size);
     }
 
     //to_f
@@ -182,11 +225,11 @@ namespace slim
     //to_i
     std::shared_ptr<Number> Nil::to_i()
     {
-        return make_value(0.0);
+        return make_value(0);
     }
     std::shared_ptr<Number> Boolean::to_i()
     {
-        return make_value(b ? 1.0 : 0.0);
+        return make_value(b ? 1 : 0);
     }
 
 
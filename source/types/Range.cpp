@@ -5,6 +5,7 @@
 #include "types/Hash.hpp"
 #include "types/Number.hpp"
 #include "types/Proc.hpp"
+#include "types/Set.hpp"
 #include <deque>
 #include <sstream>
 
@@ -16,6 +17,7 @@ namespace slim
     Range::Range(Ptr<Number> begin, Ptr<Number> end, bool exclude_end)
         : _begin(begin->get_value()), _end(end->get_value())
         , exclude_end(exclude_end)
+        , int_begin(typeid(*begin) == typeid(Integer)), int_end(typeid(*end) == typeid(Integer))
     {}
     Range::Range(Ptr<Object> begin, Ptr<Object> end, bool exclude_end)
         : Range(coerce<Number>(begin), coerce<Number>(end), exclude_end)
@@ -25,7 +27,8 @@ namespace slim
     std::string Range::to_string()const
     {
         std::stringstream ss;
-        ss << _begin << (exclude_end ? "..." : "..") << _end;
+        ss << value(_begin, int_begin)->to_string() << (exclude_end ? "..." : "..")
+            << value(_end, int_end)->to_string();
         return ss.str();
     }
     bool Range::eq(const Object *rhs)const
@@ -62,9 +65,14 @@ namespace slim
         return 0 <= b && b <= seq_len && 0 <= *range_len;
     }
 
+    Ptr<Number> Range::value(double x, bool integer)const
+    {
+        return integer ? make_integral(x) : make_value(x);
+    }
+
     Ptr<Object> Range::begin()
     {
-        return make_value(_begin);
+        return value(_begin, int_begin);
     }
     bool Range::cover_q(Object *obj)
     {
@@ -81,12 +89,12 @@ namespace slim
             if (exclude_end)
             {
                 for (auto i = _begin; i < _end; i += 1)
-                    proc->call({make_value(i)});
+                    proc->call({value(i, int_begin)});
             }
             else
             {
                 for (auto i = _begin; i <= _end; i += 1)
-                    proc->call({make_value(i)});
+                    proc->call({value(i, int_begin)});
             }
             return shared_from_this();
         }
@@ -94,7 +102,7 @@ namespace slim
     }
     Ptr<Object> Range::end()
     {
-        return make_value(_end);
+        return value(_end, int_end);
     }
     bool Range::exclude_end_q()
     {
@@ -112,16 +120,16 @@ namespace slim
             if (exclude_end)
             {
                 for (auto i = _begin; i < _end && (int)arr.size() < n; i += 1)
-                    arr.push_back(make_value(i));
+                    arr.push_back(value(i, int_begin));
             }
             else
             {
                 for (auto i = _begin; i <= _end && (int)arr.size() < n; i += 1)
-                    arr.push_back(make_value(i));
+                    arr.push_back(value(i, int_begin));
             }
             return make_value(arr);
         }
-        else return make_value(_begin);
+        else return begin();
     }
     bool Range::include_q(Object *obj)
     {
@@ -141,7 +149,7 @@ namespace slim
                 for (auto i = _begin; i < _end; i += 1)
                 {
                     if ((int)arr.size() >= n) arr.pop_front();
-                    arr.push_back(make_value(i));
+                    arr.push_back(value(i, int_begin));
                 }
             }
             else
@@ -149,12 +157,12 @@ namespace slim
                 for (auto i = _begin; i <= _end; i += 1)
                 {
                     if ((int)arr.size() >= n) arr.pop_front();
-                    arr.push_back(make_value(i));
+                    arr.push_back(value(i, int_begin));
                 }
             }
             return make_array({arr.begin(), arr.end()});
         }
-        else return make_value(_end);
+        else return end();
     }
     Ptr<Object> Range::size()
     {
@@ -169,7 +177,7 @@ namespace slim
         else
         {
             if (_end < _begin) return make_value(0);
-            return make_value((int)(_end - _begin + 1));
+            return make_value((long long)(_end - _begin + 1));
         }
     }
     Ptr<Object> Range::step(const FunctionArgs &args)
@@ -183,15 +191,16 @@ namespace slim
         {
             double step = 1;
             if (args.size() == 2) step = coerce<Number>(args[0])->get_value();
+            bool integer = int_begin && (args.size() < 2 || typeid(*args[0]) == typeid(Integer));
             if (exclude_end)
             {
                 for (auto i = _begin; i < _end; i += step)
-                    proc->call({make_value(i)});
+                    proc->call({value(i, integer)});
             }
             else
             {
                 for (auto i = _begin; i <= _end; i += step)
-                    proc->call({make_value(i)});
+                    proc->call({value(i, integer)});
             }
             return shared_from_this();
         }
@@ -2,23 +2,32 @@
 #include "types/Array.hpp"
 #include "types/Boolean.hpp"
 #include "types/String.hpp"
+#include "RegexEngine.hpp"
 #include <sstream>
 
 namespace slim
 {
     std::string MatchData::to_string() const
     {
-        return match[0];
+        return groups[0].str();
     }
     bool MatchData::eq(const Object *rhs) const
     {
         auto rhs2 = coerce<MatchData>(rhs);
-        return str == rhs2->str && regex->eq(rhs2->regex.get()) && match == rhs2->match;
+        if (!str->eq(rhs2->str.get()) || !regex->eq(rhs2->regex.get())) return false;
+        if (groups.size() != rhs2->groups.size()) return false;
+        for (size_t i = 0; i < groups.size(); ++i)
+        {
+            auto &a = groups[i], &b = rhs2->groups[i];
+            if (!a.data() != !b.data()) return false;
+            if (a.data() && (offset_of(a) != rhs2->offset_of(b) || a.size() != b.size())) return false;
+        }
+        return true;
     }
     size_t MatchData::hash() const
     {
         size_t h = 0;
-        detail::hash_combine(h, str);
+        detail::hash_combine(h, str->hash());
         detail::hash_combine(h, regex->hash());
         return h;
     }
@@ -27,21 +36,21 @@ namespace slim
         if (args.size() == 1)
         {
             auto i = (int)coerce<Number>(args[0])->get_value();
-            if (i < 0) i = i + (int)match.size();
-            if (i < 0 || i >= (int)match.size()) return NIL_VALUE;
+            if (i < 0) i = i + (int)groups.size();
+            if (i < 0 || i >= (int)groups.size()) return NIL_VALUE;
             else return sub_str(i);
         }
         else if (args.size() == 2)
         {
             auto start  = (int)coerce<Number>(args[0])->get_value();
-            if (start < 0) start = start + (int)match.size();
-            if (start < 0 || start >= (int)match.size()) return NIL_VALUE;
+            if (start < 0) start = start + (int)groups.size();
+            if (start < 0 || start >= (int)groups.size()) return NIL_VALUE;
 
             auto length = (int)coerce<Number>(args[1])->get_value();
             if (length < 0) return NIL_VALUE;
 
             auto out = create_object<Array>();
-            for (int i = start; i < start + length && i < (int)match.size(); ++i)
+            for (int i = start; i < start + length && i < (int)groups.size(); ++i)
                 out->push_back(sub_str(i));
             return out;
         }
@@ -50,15 +59,14 @@ namespace slim
     Ptr<Object> MatchData::begin(Number *n)
     {
         auto sub = get_sub(n);
-        if (!sub.matched) return NIL_VALUE;
-        else return make_value(sub.first - str.begin());
+        if (!sub.data()) return NIL_VALUE;
+        else return make_value(offset_of(sub));
     }
     Ptr<Array> MatchData::captures()
     {
         auto out = create_object<Array>();
-        for (size_t i = 1; i < match.size(); ++i)
+        for (size_t i = 1; i < groups.size(); ++i)
         {
-            auto &sub = match[i];
             out->push_back(sub_str((int)i));
         }
         return out;
@@ -66,38 +74,38 @@ namespace slim
     Ptr<Object> MatchData::end(Number * n)
     {
         auto sub = get_sub(n);
-        if (!sub.matched) return NIL_VALUE;
-        else return make_value(sub.second - str.begin());
+        if (!sub.data()) return NIL_VALUE;
+        else return make_value(offset_of(sub) + sub.size());
     }
     Ptr<Object> MatchData::offset(Number * n)
     {
         auto sub = get_sub(n);
-        if (!sub.matched) return make_array({NIL_VALUE, NIL_VALUE});
+        if (!sub.data()) return make_array({NIL_VALUE, NIL_VALUE});
         return make_array({
-                make_value(sub.first - str.begin()),
-                make_value(sub.second - str.begin())
+                make_value(offset_of(sub)),
+                make_value(offset_of(sub) + sub.size())
             });
     }
     Ptr<String> MatchData::post_match()
     {
-        return make_value(match.suffix());
+        return str->slice(str->view().substr(offset_of(groups[0]) + groups[0].size()));
     }
     Ptr<String> MatchData::pre_match()
     {
-        return make_value(match.prefix());
+        return str->slice(str->view().substr(0, offset_of(groups[0])));
     }
     Ptr<Number> MatchData::size()
     {
-        return make_value(match.size());
+        return make_value(groups.size());
     }
     Ptr<String> MatchData::string()
     {
-        return make_value(str);
+        return str;
     }
     Ptr<Array> MatchData::to_a()
     {
         auto out = create_object<Array>();
-        for (size_t i = 0; i < match.size(); ++i)
+        for (size_t i = 0; i < groups.size(); ++i)
         {
             out->push_back(sub_str((int)i));
         }
@@ -109,8 +117,8 @@ namespace slim
         for (auto &arg : args)
         {
             auto i = (int)coerce<Number>(arg)->get_value();
-            if (i < 0) i = i + (int)match.size();
-            if (i < 0 || i >= (int)match.size())
+            if (i < 0) i = i + (int)groups.size();
+            if (i < 0 || i >= (int)groups.size())
                 out->push_back(NIL_VALUE);
             else out->push_back(sub_str(i));
         }
@@ -134,17 +142,21 @@ namespace slim
         return table;
     }
 
-    std::ssub_match MatchData::get_sub(Number *n)const
+    StringView MatchData::get_sub(Number *n)const
     {
         auto i = (int)n->get_value();
-        if (i < 0 || i >= (int)match.size())
+        if (i < 0 || i >= (int)groups.size())
             throw IndexError("index " + std::to_string(i) + " out of matches");
-        return match[i];
+        return groups[i];
+    }
+    size_t MatchData::offset_of(StringView sub)const
+    {
+        return sub.data() - str->view().data();
     }
     Ptr<Object> MatchData::sub_str(int n)const
     {
-        auto &sub = match[n];
-        if (sub.matched) return make_value(sub.str());
+        auto &sub = groups[n];
+        if (sub.data()) return str->slice(sub);
         else return NIL_VALUE;
     }
 
@@ -152,7 +164,7 @@ namespace slim
     {
         static const char hex[] = {'0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F'};
         std::string ret;
-        for (char c : str->get_value())
+        for (char c : str->view())
         {
             if (c < 128 && (c < 'a' || c > 'z') && (c < 'A' || c > 'Z') && (c < '0' || c > '9'))
             {
@@ -180,14 +192,23 @@ namespace slim
     std::regex_constants::syntax_option_type Regexp::syntax_options(int opts)
     {
         auto flags = std::regex_constants::ECMAScript;
+        //^ and $ match at line breaks, as with the built in engine (and Ruby)
+#if defined(_MSC_VER)
+        //the MSVC ECMAScript grammar already treats them as line anchors
+#elif defined(__GLIBCXX__)
+        flags |= std::regex_constants::__multiline;
+#else
+        flags |= std::regex_constants::multiline;
+#endif
         if (opts & IGNORECASE) flags |= std::regex_constants::icase;
-        if (opts & EXTENDED) throw ScriptError("Regexp::EXTENDED is not supported");
-        if (opts & MULTILINE) throw ScriptError("Regex multiline mode not supported by std::regex");
+        if (opts & EXTENDED) throw ScriptError("Regexp::EXTENDED is not supported by this pattern");
+        if (opts & MULTILINE) throw ScriptError("Regexp::MULTILINE is not supported by this pattern");
         return flags;
     }
     Regexp::Regexp(const std::string &str, int opts)
-        : src(str), opts(opts), regex(str, syntax_options(opts))
+        : src(str), opts(opts), program(regex::Program::compile(str, opts)), fallback()
     {
+        if (!program) fallback = std::make_shared<std::regex>(str, syntax_options(opts));
     }
     std::string Regexp::to_string() const
     {
@@ -216,36 +237,86 @@ namespace slim
         detail::hash_combine(h, opts);
         return h;
     }
-    Ptr<MatchData> Regexp::do_match(const std::string &str, int pos)
+    namespace
     {
-        if (pos < 0) pos = (int)str.size() + pos;
-        if (pos < 0 || pos >(int)str.size()) return nullptr;
-
-        Ptr<MatchData> results(new MatchData(
-            std::static_pointer_cast<Regexp>(shared_from_this()),
-            str));
-        if (std::regex_search(
-            results->str.cbegin() + pos, results->str.cend(),
-            results->match, regex))
+        void to_groups(StringView str, const std::vector<size_t> &slots, Regexp::Groups *groups)
+        {
+            groups->clear();
+            for (size_t i = 0; i < slots.size(); i += 2)
+            {
+                if (slots[i] == regex::Program::NO_MATCH || slots[i + 1] == regex::Program::NO_MATCH)
+                    groups->emplace_back();
+                else groups->push_back(str.substr(slots[i], slots[i + 1] - slots[i]));
+            }
+        }
+        void to_groups(const std::cmatch &match, size_t skip, Regexp::Groups *groups)
+        {
+            groups->clear();
+            for (size_t i = skip; i < match.size(); ++i)
+            {
+                auto &sub = match[i];
+                if (sub.matched) groups->emplace_back(sub.first, (size_t)sub.length());
+                else groups->emplace_back();
+            }
+        }
+    }
+    bool Regexp::search(StringView str, size_t pos, Groups *groups)const
+    {
+        if (pos > str.size()) return false;
+        if (program)
         {
-            return results;
+            std::vector<size_t> slots;
+            if (!program->search(str, pos, &slots)) return false;
+            to_groups(str, slots, groups);
+            return true;
         }
-        else return nullptr;
+        std::cmatch match;
+        auto flags = pos > 0 ? std::regex_constants::match_prev_avail : std::regex_constants::match_default;
+        if (!std::regex_search(str.begin() + pos, str.end(), match, *fallback, flags)) return false;
+        to_groups(match, 0, groups);
+        return true;
     }
-    std::smatch Regexp::do_rmatch(const std::string &str, int pos)
+    bool Regexp::search_last(StringView str, Groups *groups)const
     {
-        if (pos < 0) pos = (int)str.size() + pos;
-        if (pos < 0 || pos >(int)str.size()) return {};
+        if (program)
+        {
+            std::vector<size_t> slots;
+            if (!program->search_last(str, &slots)) return false;
+            to_groups(str, slots, groups);
+            return true;
+        }
+        //greedy prefix to find the last match, at the cost of a temp regex and an extra group
+        std::regex last_regex("^[\\s\\S]*(" + src + ")", syntax_options(opts));
+        std::cmatch match;
+        if (!std::regex_search(str.begin(), str.end(), match, last_regex)) return false;
+        to_groups(match, 1, groups);
+        return true;
+    }
+    Ptr<MatchData> Regexp::do_match(const String *str, int pos)
+    {
+        auto view = str->view();
+        auto size = (int)view.size();
+        if (pos < 0) pos = size + pos;
+        if (pos < 0 || pos > size) return nullptr;
+
+        Groups groups;
+        if (!search(view, pos, &groups)) return nullptr;
 
-        auto new_src = "^[\\s\\S]*(" + src + ")";
-        std::regex regex(new_src, syntax_options(opts));
-        std::smatch match;
-        std::regex_search(str.cbegin(), str.cbegin() + pos, match, regex);
-        return match;
+        Ptr<MatchData> results(new MatchData(
+            std::static_pointer_cast<Regexp>(shared_from_this()),
+            str->substr(0)));
+        //the subject may be a copy, rebase the groups onto it
+        auto subject = results->str->view();
+        for (auto &group : groups)
+        {
+            if (group.data()) results->groups.emplace_back(subject.data() + (group.data() - view.data()), group.size());
+            else results->groups.emplace_back();
+        }
+        return results;
     }
     Ptr<Object> Regexp::match(const FunctionArgs &args)
     {
-        std::string str;
+        String *str;
         int pos = 0;
         unpack<1>(args, &str, &pos);
         auto ret = do_match(str, pos);
@@ -275,6 +346,73 @@ namespace slim
         return table;
     }
 
+    RegexpCache &RegexpCache::instance()
+    {
+        static RegexpCache cache;
+        return cache;
+    }
+    RegexpCache::RegexpCache(size_t capacity)
+        : mutex(), max_size(capacity), entries(), index(), hit_count(0), miss_count(0)
+    {
+        assert(capacity > 0);
+    }
+    Ptr<Regexp> RegexpCache::get(const std::string &src, int opts)
+    {
+        Key key(src, opts);
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            auto it = index.find(key);
+            if (it != index.end())
+            {
+                ++hit_count;
+                entries.splice(entries.begin(), entries, it->second);
+                return it->second->second;
+            }
+            ++miss_count;
+        }
+        //compile without holding the lock, an invalid pattern throws and is not cached
+        auto regex = create_object<Regexp>(src, opts);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        auto it = index.find(key);
+        if (it != index.end())
+        {
+            //another thread compiled the same pattern first
+            entries.splice(entries.begin(), entries, it->second);
+            return it->second->second;
+        }
+        entries.emplace_front(key, regex);
+        index[key] = entries.begin();
+        if (entries.size() > max_size)
+        {
+            index.erase(entries.back().first);
+            entries.pop_back();
+        }
+        return regex;
+    }
+    size_t RegexpCache::size()const
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        return entries.size();
+    }
+    size_t RegexpCache::hits()const
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        return hit_count;
+    }
+    size_t RegexpCache::misses()const
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        return miss_count;
+    }
+    void RegexpCache::clear()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        index.clear();
+        entries.clear();
+        hit_count = miss_count = 0;
+    }
+
     RegexpType::RegexpType()
     {
         constants[symbol("IGNORECASE")] = make_value(Regexp::IGNORECASE);
@@ -0,0 +1,210 @@
+#include "types/Set.hpp"
+#include "types/Array.hpp"
+#include "types/Boolean.hpp"
+#include "types/Enumerator.hpp"
+#include "types/Hash.hpp"
+#include "types/Number.hpp"
+#include "types/Proc.hpp"
+#include "Function.hpp"
+#include "Operators.hpp"
+#include <sstream>
+
+namespace slim
+{
+    Set::Set(const std::vector<ObjectPtr> &values)
+        : list(), set()
+    {
+        list.reserve(values.size());
+        set.reserve(values.size());
+        for (auto &i : values) insert(i);
+    }
+
+    Ptr<Set> Set::new_instance(const FunctionArgs &args)
+    {
+        if (args.empty()) return create_object<Set>();
+        else if (args.size() == 1) return create_from(args[0].get());
+        else throw ArgumentCountError(args.size(), 0, 1);
+    }
+    Ptr<Set> Set::create_from(Object *enumerable)
+    {
+        if (auto arr = dynamic_cast<Array*>(enumerable))
+        {
+            return create_object<Set>(arr->get_value());
+        }
+        else if (auto other = dynamic_cast<Set*>(enumerable))
+        {
+            return std::static_pointer_cast<Set>(other->shared_from_this());
+        }
+        else if (auto e = dynamic_cast<Enumerable*>(enumerable))
+        {
+            auto out = create_object<Set>();
+            e->each_single([&out](Object *arg) {
+                out->insert(arg->shared_from_this());
+                return NIL_VALUE;
+            });
+            return out;
+        }
+        else throw TypeError(enumerable, "Enumerable");
+    }
+    Ptr<Set> Set::as_set(Object *enumerable)
+    {
+        return create_from(enumerable);
+    }
+
+    std::string Set::inspect()const
+    {
+        std::stringstream ss;
+        ss << "#<Set: {";
+        bool first = true;
+        for (auto &i : list)
+        {
+            if (first) first = false;
+            else ss << ", ";
+            ss << i->inspect();
+        }
+        ss << "}>";
+        return ss.str();
+    }
+    bool Set::eq(const Object *orhs)const
+    {
+        auto rhs = coerce<Set>(orhs);
+        if (list.size() != rhs->list.size()) return false;
+        for (auto &i : list)
+        {
+            if (!rhs->contains(i)) return false;
+        }
+        return true;
+    }
+    size_t Set::hash()const
+    {
+        size_t h = 0;
+        for (auto &i : list) h ^= i->hash(); //order independent, as eq is
+        return h;
+    }
+
+    ObjectPtr Set::bit_xor(Object *rhs)
+    {
+        auto other = as_set(rhs);
+        auto out = create_object<Set>();
+        for (auto &i : list) if (!other->contains(i)) out->insert(i);
+        for (auto &i : other->list) if (!contains(i)) out->insert(i);
+        return out;
+    }
+
+    Ptr<Set> Set::difference(Object *enumerable)
+    {
+        auto other = as_set(enumerable);
+        auto out = create_object<Set>();
+        for (auto &i : list) if (!other->contains(i)) out->insert(i);
+        return out;
+    }
+    Ptr<Boolean> Set::disjoint_q(Object *enumerable)
+    {
+        return make_value(!intersect_q(enumerable)->is_true());
+    }
+    ObjectPtr Set::each(const FunctionArgs &args)
+    {
+        Proc*proc = nullptr;
+        unpack<0>(args, &proc);
+        if (proc)
+        {
+            for (auto &i : list)
+            {
+                proc->call({i});
+            }
+            return shared_from_this();
+        }
+        else return make_enumerator(this, { &Set::each, "each" });
+    }
+    Ptr<Boolean> Set::empty_q()
+    {
+        return make_value(list.empty());
+    }
+    Ptr<Boolean> Set::include_q(Object *obj)
+    {
+        return make_value(contains(obj->shared_from_this()));
+    }
+    Ptr<Set> Set::intersection(Object *enumerable)
+    {
+        auto other = as_set(enumerable);
+        auto out = create_object<Set>();
+        for (auto &i : list) if (other->contains(i)) out->insert(i);
+        return out;
+    }
+    Ptr<Boolean> Set::intersect_q(Object *enumerable)
+    {
+        auto other = as_set(enumerable);
+        auto &small = list.size() <= other->list.size() ? *this : *other;
+        auto &large = list.size() <= other->list.size() ? *other : *this;
+        for (auto &i : small.list) if (large.contains(i)) return TRUE_VALUE;
+        return FALSE_VALUE;
+    }
+    Ptr<Boolean> Set::proper_subset_q(Set *other)
+    {
+        return make_value(list.size() < other->list.size() && subset_q(other)->is_true());
+    }
+    Ptr<Boolean> Set::proper_superset_q(Set *other)
+    {
+        return other->proper_subset_q(this);
+    }
+    Ptr<Number> Set::size()
+    {
+        return make_value(list.size());
+    }
+    Ptr<Boolean> Set::subset_q(Set *other)
+    {
+        if (list.size() > other->list.size()) return FALSE_VALUE;
+        for (auto &i : list) if (!other->contains(i)) return FALSE_VALUE;
+        return TRUE_VALUE;
+    }
+    Ptr<Boolean> Set::superset_q(Set *other)
+    {
+        return other->subset_q(this);
+    }
+    Ptr<Array> Set::to_a()
+    {
+        return make_array(list);
+    }
+    Ptr<Set> Set::to_set()
+    {
+        return std::static_pointer_cast<Set>(shared_from_this());
+    }
+    Ptr<Set> Set::set_union(Object *enumerable)
+    {
+        auto other = as_set(enumerable);
+        auto out = create_object<Set>(list);
+        for (auto &i : other->list) out->insert(i);
+        return out;
+    }
+
+    const MethodTable &Set::method_table()const
+    {
+        static const MethodTable table = MethodTable(Object::method_table())
+            .add_all(Enumerable::get_methods<Set>())
+            .add_all({
+            { &Set::difference, "difference" },
+            { &Set::disjoint_q, "disjoint?" },
+            { &Set::each, "each" },
+            { &Set::empty_q, "empty?" },
+            { &Set::include_q, "include?" },
+            { &Set::include_q, "member?" },
+            { &Set::intersection, "intersection" },
+            { &Set::intersect_q, "intersect?" },
+            { &Set::proper_subset_q, "proper_subset?" },
+            { &Set::proper_superset_q, "proper_superset?" },
+            { &Set::size, "size" },
+            { &Set::size, "length" },
+            { &Set::subset_q, "subset?" },
+            { &Set::superset_q, "superset?" },
+            { &Set::to_a, "to_a" },
+            { &Set::to_set, "to_set" },
+            { &Set::set_union, "union" }
+        });
+        return table;
+    }
+
+    ObjectPtr SetType::el_ref(const FunctionArgs &args)
+    {
+        return make_set(args);
+    }
+}
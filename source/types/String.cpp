@@ -18,17 +18,197 @@ namespace slim
 {
     namespace
     {
-        const std::string WHITESPACE = " \t\r\n";
-        bool ends_with(const std::string &str, const std::string &with)
+        const StringView WHITESPACE = " \t\r\n";
+
+        /**Decode the code point at p, without decoding if the string is known to be ASCII.*/
+        unsigned next_code_point(StringView s, size_t p, bool ascii, uint32_t *cp)
+        {
+            if (ascii)
+            {
+                *cp = (unsigned char)s[p];
+                return 1;
+            }
+            unsigned cp_len;
+            utf8_decode(s.data() + p, cp, &cp_len);
+            return cp_len;
+        }
+    }
+
+    String::String(std::string &&v)
+        : v(std::move(v)), buf(), off(0), len(0), rope(), rope_begin(0), rope_end(0), text_flags(0), text_length(0)
+    {
+        if (this->v.size() >= MIN_SHARED_SIZE)
+        {
+            len = this->v.size();
+            buf = std::make_shared<std::string>(std::move(this->v));
+            this->v.clear();
+        }
+    }
+    String::String(const std::string &v)
+        : v(), buf(), off(0), len(0), rope(), rope_begin(0), rope_end(0), text_flags(0), text_length(0)
+    {
+        if (v.size() >= MIN_SHARED_SIZE)
+        {
+            len = v.size();
+            buf = std::make_shared<std::string>(v);
+        }
+        else this->v = v;
+    }
+
+    size_t String::hash()const
+    {
+        //FNV-1a, since std::hash is only provided for std::string
+        auto s = view();
+        size_t h = (size_t)14695981039346656037ull;
+        for (auto c : s)
+        {
+            h ^= (unsigned char)c;
+            h *= (size_t)1099511628211ull;
+        }
+        return h;
+    }
+
+    const std::string &String::get_value()const
+    {
+        if (rope) flatten_rope();
+        if (!buf) return v;
+        if (off == 0 && len == buf->size()) return *buf;
+        std::call_once(flat_once, [this]() { v.assign(buf->data() + off, len); });
+        return v;
+    }
+    std::string &String::get_mutable_value()
+    {
+        if (buf)
+        {
+            std::call_once(flat_once, [this]()
+            {
+                //buffer is never created const, so can take it if this is the only user
+                if (off == 0 && len == buf->size() && buf.use_count() == 1)
+                    v = std::move(const_cast<std::string&>(*buf));
+                else v.assign(buf->data() + off, len);
+            });
+            buf.reset();
+            off = len = 0;
+        }
+        else if (rope)
+        {
+            flatten_rope();
+            rope.reset();
+            rope_begin = rope_end = 0;
+            len = 0;
+        }
+        text_flags.store(0, std::memory_order_relaxed);
+        std::atomic_store(&char_index, std::shared_ptr<const std::vector<size_t>>());
+        return v;
+    }
+
+    void String::flatten_rope()const
+    {
+        std::call_once(flat_once, [this]()
+        {
+            std::vector<std::shared_ptr<const String>> parts;
+            get_rope_parts(parts);
+            v.reserve(len);
+            for (auto &part : parts)
+            {
+                auto s = part->view();
+                v.append(s.data(), s.size());
+            }
+            assert(v.size() == len);
+        });
+    }
+    void String::get_rope_parts(std::vector<std::shared_ptr<const String>> &out)const
+    {
+        if (!rope)
         {
-            return str.size() >= with.size() && str.compare(str.size() - with.size(), with.size(), with) == 0;
+            out.push_back(std::static_pointer_cast<const String>(shared_from_this()));
+            return;
         }
+        //copied under the lock, since add may be growing the deque on another thread
+        std::unique_lock<std::mutex> lock(rope->mutex);
+        out.insert(out.end(), rope->parts.begin() + (rope_begin - rope->first), rope->parts.begin() + (rope_end - rope->first));
+    }
+
+    unsigned String::text_info()const
+    {
+        auto flags = text_flags.load(std::memory_order_acquire);
+        if (flags) return flags;
+        auto s = view();
+        auto info = utf8_scan(s.data(), s.size());
+        flags = TEXT_SCANNED | (info.ascii ? TEXT_ASCII : 0) | (info.valid ? TEXT_VALID : 0);
+        //another thread may do the same scan, but will store the same result
+        text_length.store(info.length, std::memory_order_relaxed);
+        text_flags.store(flags, std::memory_order_release);
+        return flags;
+    }
+    void String::set_ascii()const
+    {
+        text_length.store(view().size(), std::memory_order_relaxed);
+        text_flags.store(TEXT_SCANNED | TEXT_ASCII | TEXT_VALID, std::memory_order_release);
+    }
+
+    size_t String::char_offset(size_t index)const
+    {
+        auto s = view();
+        auto length = char_length();
+        if (index >= length) return index == length ? s.size() : StringView::npos;
+        if (is_ascii()) return index;
+
+        //code points start at 0 and each leading element after, invalid or not
+        size_t p = 0, skip = index;
+        if (index >= CHAR_INDEX_STEP)
+        {
+            auto offsets = std::atomic_load(&char_index);
+            if (!offsets)
+            {
+                auto built = std::make_shared<std::vector<size_t>>();
+                built->reserve(length / CHAR_INDEX_STEP + 1);
+                size_t n = 0;
+                for (size_t i = 0; i < s.size(); ++i)
+                {
+                    if ((i == 0 || utf8_is_leading(s[i])) && n++ % CHAR_INDEX_STEP == 0)
+                        built->push_back(i);
+                }
+                offsets = built;
+                std::atomic_store(&char_index, offsets);
+            }
+            p = (*offsets)[index / CHAR_INDEX_STEP];
+            skip = index % CHAR_INDEX_STEP;
+        }
+        for (; skip > 0; --skip)
+        {
+            ++p;
+            while (p < s.size() && !utf8_is_leading(s[p])) ++p;
+        }
+        return p;
+    }
+    std::shared_ptr<String> String::char_substr(size_t pos, size_t count)const
+    {
+        auto length = char_length();
+        if (pos > length) return nullptr;
+        auto start = char_offset(pos);
+        auto end = count >= length - pos ? view().size() : char_offset(pos + count);
+        return substr(start, end - start);
+    }
+
+    std::shared_ptr<String> String::slice(StringView part)const
+    {
+        std::shared_ptr<String> ret;
+        if (buf && part.size() >= MIN_SLICE_SIZE)
+        {
+            assert(part.data() >= buf->data() && part.end() <= buf->data() + buf->size());
+            ret = create_object<String>(buf, (size_t)(part.data() - buf->data()), part.size());
+        }
+        else ret = make_value(part.str());
+        //any part of an ASCII string is ASCII, so need not be scanned again
+        if (text_flags.load(std::memory_order_acquire) & TEXT_ASCII) ret->set_ascii();
+        return ret;
     }
 
     std::string String::inspect()const
     {
         std::string out = "\"";
-        for (auto c : v)
+        for (auto c : view())
         {
             switch (c)
             {
@@ -48,29 +228,31 @@ namespace slim
     std::shared_ptr<Number> String::to_f()
     {
         double d = 0;
-        try { d = std::stod(v.c_str()); }
+        try { d = std::stod(get_value()); }
         catch (const std::exception &) {}
         return make_value(d);
     }
     std::shared_ptr<Number> String::to_i()
     {
-        int i = 0;
-        try { i = std::stoi(v.c_str()); }
+        long long i = 0;
+        try { i = std::stoll(get_value()); }
         catch (const std::exception &) {}
-        return make_value((double)i);
+        return make_value(i);
     }
     std::shared_ptr<Symbol> String::to_sym()
     {
-        return symbol(v);
+        return symbol(get_value());
     }
 
     std::shared_ptr<String> String::html_safe()
     {
-        return std::make_shared<HtmlSafeString>(v);
+        if (buf) return std::make_shared<HtmlSafeString>(buf, off, len);
+        else return std::make_shared<HtmlSafeString>(get_value());
     }
 
     ObjectPtr String::el_ref(const FunctionArgs & args)
     {
+        auto s = view();
         if (args.size() == 1)
         {
             if (auto index = std::dynamic_pointer_cast<Number>(args[0]))
@@ -79,20 +261,20 @@ namespace slim
             }
             else if (auto regex = std::dynamic_pointer_cast<Regexp>(args[0]))
             {
-                auto match = regex->do_match(v, 0);
-                if (match) return match->to_string_obj();
+                auto match = regex->do_match(this, 0);
+                if (match) return match->el_ref({make_value(0)});
                 else return NIL_VALUE;
             }
             else if (auto match_str = std::dynamic_pointer_cast<String>(args[0]))
             {
-                if (v.find(match_str->v) != std::string::npos) return match_str;
+                if (s.find(match_str->view()) != StringView::npos) return match_str;
                 else return NIL_VALUE;
             }
             else if (auto range = std::dynamic_pointer_cast<Range>(args[0]))
             {
                 int start, length;
-                if (range->get_beg_len(&start, &length, (int)v.size()))
-                    return make_value(v.substr((size_t)start, (size_t)length));
+                if (range->get_beg_len(&start, &length, (int)s.size()))
+                    return substr((size_t)start, (size_t)length);
                 else return NIL_VALUE;
             }
             else throw ArgumentError(this, "slice");
@@ -101,7 +283,7 @@ namespace slim
         {
             if (auto regex = std::dynamic_pointer_cast<Regexp>(args[0]))
             {
-                auto match = regex->do_match(v, 0);
+                auto match = regex->do_match(this, 0);
                 if (match) return match->el_ref({args[1]});
                 else return NIL_VALUE;
             }
@@ -116,107 +298,116 @@ namespace slim
     }
     ObjectPtr String::do_slice(int start, int length)
     {
+        auto size = (int)view().size();
         if (length < 0) return NIL_VALUE;
-        if (start < 0) start = ((int)v.size()) + start;
-        if (start == (int)v.size()) return make_value("");
-        if (start < 0 || start >(int)v.size()) return NIL_VALUE;
-        return make_value(v.substr((size_t)start, (size_t)length));
+        if (start < 0) start = size + start;
+        if (start == size) return make_value("");
+        if (start < 0 || start > size) return NIL_VALUE;
+        return substr((size_t)start, (size_t)length);
     }
 
     //Encoding/unicode
     std::shared_ptr<Boolean> String::ascii_only_q()
     {
-        for (auto c : v) if (c < 0 || c >= 128) return FALSE_VALUE;
-        return TRUE_VALUE;
+        return make_value(is_ascii());
     }
     Ptr<Array> String::bytes()
     {
+        auto s = view();
         std::vector<ObjectPtr> vec;
-        vec.reserve(v.size());
-        for (auto &c : v)
+        vec.reserve(s.size());
+        for (auto c : s)
             vec.emplace_back(make_value((unsigned char)c));
         return make_value(std::move(vec));
     }
     Ptr<Object> String::byteslice(const FunctionArgs &args)
     {
+        auto size = (int)view().size();
         Range *range;
         if (args.size() == 1 && (range = dynamic_cast<Range*>(args[0].get())))
         {
             int start, length;
-            if (range->get_beg_len(&start, &length, (int)v.size()))
-                return make_value(v.substr((size_t)start, (size_t)length));
+            if (range->get_beg_len(&start, &length, size))
+                return substr((size_t)start, (size_t)length);
             else return NIL_VALUE;
         }
         else
         {
             int offset, len = 1;
             unpack<1>(args, &offset, &len);
-            if (offset < 0) offset = (int)v.size() + offset;
-            if (offset < 0 || offset >= (int)v.size() || len < 0) return NIL_VALUE;
-            return make_value(v.substr((size_t)offset, (size_t)len));
+            if (offset < 0) offset = size + offset;
+            if (offset < 0 || offset >= size || len < 0) return NIL_VALUE;
+            return substr((size_t)offset, (size_t)len);
         }
     }
     Ptr<Array> String::chars()
     {
+        auto s = view();
+        auto ascii = is_ascii();
         std::vector<ObjectPtr> vec;
-        vec.reserve(v.size());
+        vec.reserve(char_length());
         uint32_t cp;
-        unsigned cp_len;
-        for (size_t p = 0; p < v.size(); p += cp_len)
+        for (size_t p = 0; p < s.size();)
         {
-            utf8_decode(v.c_str() + p, &cp, &cp_len);
-            vec.push_back(make_value(v.substr(p, cp_len)));
+            auto cp_len = next_code_point(s, p, ascii, &cp);
+            vec.push_back(make_value(s.substr(p, cp_len).str()));
+            p += cp_len;
         }
         return make_value(std::move(vec));
     }
     Ptr<String> String::chop()
     {
-        for (int p = (int)v.size() - 1; p > 0; --p)
+        auto s = view();
+        for (int p = (int)s.size() - 1; p > 0; --p)
         {
-            if (utf8_is_leading(v[p]))
+            if (utf8_is_leading(s[p]))
             {
-                return make_value(v.substr(0, (size_t)p));
+                return substr(0, (size_t)p);
             }
         }
         return make_value(std::string());
     }
     Ptr<String> String::chr()
     {
-        if (v.empty()) return make_value(std::string());
-        else return make_value(v.substr(0, utf8_next_len(v[0])));
+        auto s = view();
+        if (s.empty()) return make_value(std::string());
+        else return make_value(s.substr(0, utf8_next_len(s[0])).str());
     }
     Ptr<Array> String::codepoints()
     {
+        auto s = view();
+        auto ascii = is_ascii();
         std::vector<ObjectPtr> vec;
-        vec.reserve(v.size());
+        vec.reserve(char_length());
         uint32_t cp;
-        unsigned cp_len;
-        for (size_t p = 0; p < v.size(); p += cp_len)
+        for (size_t p = 0; p < s.size();)
         {
-            utf8_decode(v.c_str() + p, &cp, &cp_len);
+            p += next_code_point(s, p, ascii, &cp);
             vec.push_back(make_value(cp));
         }
         return make_value(std::move(vec));
     }
     Ptr<Object> String::getbyte(Number *index)
     {
+        auto s = view();
         auto n = (int)index->get_value();
-        if (n < 0) n = (int)v.size() + n;
-        if (n < 0 || n >= (int)v.size()) return NIL_VALUE;
-        else return make_value((unsigned char)v[n]);
+        if (n < 0) n = (int)s.size() + n;
+        if (n < 0 || n >= (int)s.size()) return NIL_VALUE;
+        else return make_value((unsigned char)s[n]);
     }
     Ptr<String> String::scrub(const FunctionArgs &args)
     {
         std::string replacement = "\xEF\xBF\xBD"; //REPLACEMENT CHARACTER
         unpack<0>(args, &replacement);
+        auto s = view();
+        if (is_valid_utf8()) return slice(s);
         std::string out;
-        for (size_t i = 0; i < v.size();)
+        for (size_t i = 0; i < s.size();)
         {
-            uint32_t cp;
-            unsigned len;
-            if (try_utf8_decode(v.c_str() + i, &cp, &len))
+            auto len = utf8_valid_len(s.data() + i, s.size() - i);
+            if (len)
             {
-                out.append(v.c_str() + i, len);
+                out.append(s.data() + i, len);
                 i += len;
             }
             else
@@ -230,23 +421,24 @@ namespace slim
 
     std::shared_ptr<String> String::capitalize()
     {
-        std::string ret = v;
+        std::string ret = view().str();
         if (!ret.empty() && ret[0] >= 'a' && ret[0] <= 'z') ret[0] = (char)(ret[0] - 'a' + 'A');
         return make_value(ret);
     }
 
     ObjectPtr String::casecmp(String * rhs)
     {
-        auto i1 = v.begin(), i2 = rhs->v.begin();
-        for (; i1 != v.end() && i2 != rhs->v.end(); ++i1, ++i2)
+        auto s1 = view(), s2 = rhs->view();
+        auto i1 = s1.begin(), i2 = s2.begin();
+        for (; i1 != s1.end() && i2 != s2.end(); ++i1, ++i2)
         {
             auto c1 = ::tolower(*i1), c2 = ::tolower(*i2);
-            if (c1 < c2) return make_value(-1.0);
-            if (c1 > c2) return make_value(+1.0);
+            if (c1 < c2) return make_value(-1);
+            if (c1 > c2) return make_value(+1);
         }
-        if (v.size() < rhs->v.size()) return make_value(-1.0);
-        if (v.size() > rhs->v.size()) return make_value(+1.0);
-        return make_value(0.0);
+        if (s1.size() < s2.size()) return make_value(-1);
+        if (s1.size() > s2.size()) return make_value(+1);
+        return make_value(0);
     }
 
     std::shared_ptr<String> String::center(const FunctionArgs & args)
@@ -255,14 +447,15 @@ namespace slim
         std::string padstr = " ";
         unpack<1>(args, &width, &padstr);
 
+        auto s = view();
         if (padstr.empty()) throw ArgumentError(this, "ljust");
-        if (width <= (int)v.size()) return make_value(v);
-        
-        auto left = (width - v.size()) / 2;
-        auto right = left + (width - v.size()) % 2;
+        if (width <= (int)s.size()) return make_value(s.str());
+
+        auto left = (width - s.size()) / 2;
+        auto right = left + (width - s.size()) % 2;
         std::string new_str;
         for (size_t i = 0; i < left; ++i) new_str += padstr[i % padstr.size()];
-        new_str += v;
+        new_str.append(s.data(), s.size());
         for (size_t i = 0; i < right; ++i) new_str += padstr[i % padstr.size()];
         return make_value(new_str);
     }
@@ -273,11 +466,12 @@ namespace slim
         std::string padstr = " ";
         unpack<1>(args, &width, &padstr);
 
+        auto s = view();
         if (padstr.empty()) throw ArgumentError(this, "ljust");
-        if (width <= (int)v.size()) return make_value(v);
+        if (width <= (int)s.size()) return make_value(s.str());
 
-        std::string ret = v;
-        for (int i = 0; i < width - (int)v.size(); ++i) ret += padstr[i % padstr.size()];
+        std::string ret = s.str();
+        for (int i = 0; i < width - (int)s.size(); ++i) ret += padstr[i % padstr.size()];
         return make_value(ret);
     }
     std::shared_ptr<String> String::rjust(const FunctionArgs & args)
@@ -286,50 +480,59 @@ namespace slim
         std::string padstr = " ";
         unpack<1>(args, &width, &padstr);
 
+        auto s = view();
         if (padstr.empty()) throw ArgumentError(this, "rjust");
-        if (width <= (int)v.size()) return make_value(v);
+        if (width <= (int)s.size()) return make_value(s.str());
 
         std::string ret;
-        for (int i = 0; i < width - (int)v.size(); ++i) ret += padstr[i % padstr.size()];
-        ret += v;
+        for (int i = 0; i < width - (int)s.size(); ++i) ret += padstr[i % padstr.size()];
+        ret.append(s.data(), s.size());
         return make_value(ret);
     }
 
     std::shared_ptr<String> String::chomp(const FunctionArgs & args)
     {
+        auto s = view();
         if (args.empty())
         {
-            if (v.size() >= 2 && v[v.size() - 2] == '\r' && v[v.size() - 1] == '\n')
+            if (s.ends_with("\r\n"))
             {
-                return make_value(std::string(v.begin(), v.end() - 2));
+                return substr(0, s.size() - 2);
             }
-            else if (v.size() >= 1 && (v.back() == '\r' || v.back() == '\n'))
+            else if (s.size() >= 1 && (s.back() == '\r' || s.back() == '\n'))
             {
-                return make_value(std::string(v.begin(), v.end() - 1));
+                return substr(0, s.size() - 1);
             }
             else return coerce<String>(shared_from_this());
         }
         else if (args.size() == 1)
         {
-            auto &sep = coerce<String>(args[0])->v;
+            auto sep = coerce<String>(args[0])->view();
             if (sep.empty())
             {
-                auto end = v.find_last_not_of("\r\n");
-                if (end == std::string::npos) return make_value("");
-                else return make_value(std::string(v.c_str(), end + 1));
+                auto end = s.find_last_not_of("\r\n");
+                if (end == StringView::npos) return make_value("");
+                else return substr(0, end + 1);
             }
-            else if (ends_with(v, sep))
+            else if (s.ends_with(sep))
             {
-                return make_value(std::string(v.c_str(), v.size() - sep.size()));
+                return substr(0, s.size() - sep.size());
             }
             else return coerce<String>(shared_from_this());
         }
         else throw ArgumentError(this, "chomp");
     }
 
+    ObjectPtr String::concat(const FunctionArgs &args)
+    {
+        ObjectPtr ret = shared_from_this();
+        for (auto &arg : args) ret = ret->add(arg.get());
+        return ret;
+    }
+
     std::shared_ptr<String> String::downcase()
     {
-        auto ret = v;
+        auto ret = view().str();
         std::transform(ret.begin(), ret.end(), ret.begin(), ::tolower);
         return make_value(ret);
     }
@@ -342,7 +545,7 @@ namespace slim
         {
             try
             {
-                for (auto &i : v)
+                for (auto i : view())
                     proc->call({ make_value((unsigned char)i) });
                 return shared_from_this();
             }
@@ -361,12 +564,14 @@ namespace slim
         {
             try
             {
+                auto s = view();
+                auto ascii = is_ascii();
                 uint32_t cp;
-                unsigned cp_len;
-                for (size_t p = 0; p < v.size(); p += cp_len)
+                for (size_t p = 0; p < s.size();)
                 {
-                    utf8_decode(v.c_str() + p, &cp, &cp_len);
-                    proc->call({ make_value(v.substr(p, cp_len)) });
+                    auto cp_len = next_code_point(s, p, ascii, &cp);
+                    proc->call({ make_value(s.substr(p, cp_len).str()) });
+                    p += cp_len;
                 }
                 return shared_from_this();
             }
@@ -385,11 +590,12 @@ namespace slim
         {
             try
             {
+                auto s = view();
+                auto ascii = is_ascii();
                 uint32_t cp;
-                unsigned cp_len;
-                for (size_t p = 0; p < v.size(); p += cp_len)
+                for (size_t p = 0; p < s.size();)
                 {
-                    utf8_decode(v.c_str() + p, &cp, &cp_len);
+                    p += next_code_point(s, p, ascii, &cp);
                     proc->call({ make_value(cp) });
                 }
                 return shared_from_this();
@@ -419,7 +625,7 @@ namespace slim
             auto lines = split_lines(sep);
             try
             {
-                for (auto &i : lines) proc->call({ make_value(i) });
+                for (auto &i : lines) proc->call({ slice(i) });
                 return shared_from_this();
             }
             catch(const BreakException &e)
@@ -435,27 +641,28 @@ namespace slim
 
     std::shared_ptr<Boolean> String::empty_q()
     {
-        return make_value(v.empty());
+        return make_value(view().empty());
     }
 
     std::shared_ptr<Boolean> String::end_with_q(const FunctionArgs & args)
     {
+        auto s = view();
         for (auto &suffix : args)
         {
-            auto &str = coerce<String>(suffix)->v;
-            if (ends_with(v, str)) return TRUE_VALUE;
+            if (s.ends_with(coerce<String>(suffix)->view())) return TRUE_VALUE;
         }
         return FALSE_VALUE;
     }
 
     std::shared_ptr<Number> String::hex()
     {
+        auto v = view();
         size_t p = 0;
         //optional sign
         bool neg = false;
         if (!v.empty() && v[0] == '+') p = 1;
         if (!v.empty() && v[0] == '-') { p = 1; neg = true; }
-        
+
         //optional 0x
         if (v.size() >= p + 2 && v[p + 0] == '0' && v[p + 1] == 'x') p += 2;
 
@@ -476,7 +683,7 @@ namespace slim
 
     std::shared_ptr<Boolean> String::include_q(const String * rhs)
     {
-        return make_value(v.find(rhs->v) != std::string::npos);
+        return make_value(view().find(rhs->view()) != StringView::npos);
     }
 
     ObjectPtr String::index(const FunctionArgs &args)
@@ -485,18 +692,19 @@ namespace slim
         int offset = 0;
         unpack<1>(args, &pattern, &offset);
 
-        if (offset < 0) offset = ((int)v.size()) + offset;
-        if (offset < 0 || offset > (int)v.size()) return NIL_VALUE;
+        auto s = view();
+        if (offset < 0) offset = ((int)s.size()) + offset;
+        if (offset < 0 || offset > (int)s.size()) return NIL_VALUE;
         if (auto regex = dynamic_cast<Regexp*>(pattern))
         {
-            auto match = regex->do_match(v, offset);
+            auto match = regex->do_match(this, offset);
             if (match) return match->begin(make_value(0).get());
             else return NIL_VALUE;
         }
         else if (auto substring = dynamic_cast<String*>(pattern))
         {
-            auto p = v.find(substring->get_value(), (size_t)offset);
-            if (p != std::string::npos) return make_value((double)p);
+            auto p = s.find(substring->view(), (size_t)offset);
+            if (p != StringView::npos) return make_value(p);
             else return NIL_VALUE;
         }
         else throw ArgumentError("Expected String or Regexp");
@@ -509,14 +717,16 @@ namespace slim
 
         auto out = split_lines(sep);
         std::vector<ObjectPtr> ret;
-        for (auto &s : out) ret.push_back(make_value(s));
+        ret.reserve(out.size());
+        for (auto &s : out) ret.push_back(slice(s));
         return make_array(ret);
     }
 
     std::shared_ptr<Number> String::ord()
     {
-        if (v.empty()) throw ArgumentError(this, "ord");
-        else return make_value((double)v[0]);
+        auto s = view();
+        if (s.empty()) throw ArgumentError(this, "ord");
+        else return make_value((int)s[0]);
     }
 
     std::shared_ptr<Array> String::partition(Object *obj)
@@ -526,9 +736,10 @@ namespace slim
 
     std::shared_ptr<String> String::reverse()
     {
-        std::string ret;
-        for (auto i = v.rbegin(); i != v.rend(); ++i) ret += *i;
-        return make_value(ret);
+        auto s = view();
+        return make_value(std::string(
+            std::reverse_iterator<const char*>(s.end()),
+            std::reverse_iterator<const char*>(s.begin())));
     }
 
     std::shared_ptr<Array> String::rpartition(Object *obj)
@@ -538,23 +749,25 @@ namespace slim
 
     ObjectPtr String::rindex(const FunctionArgs &args)
     {
+        auto s = view();
         Object *pattern;
-        int offset = (int)v.size();
+        int offset = (int)s.size();
         unpack<1>(args, &pattern, &offset);
 
-        if (offset < 0) offset = ((int)v.size()) + offset;
+        if (offset < 0) offset = ((int)s.size()) + offset;
         if (offset < 0) return NIL_VALUE;
         if (auto regex = dynamic_cast<Regexp*>(pattern))
         {
-            if (offset >= (int)v.size()) offset = (int)v.size() - 1;
-            auto match = regex->do_rmatch(v, offset + 1);
-            if (match.size()) return make_value(match[1].first - v.begin());
+            if (offset >= (int)s.size()) offset = (int)s.size() - 1;
+            Regexp::Groups groups;
+            if (regex->search_last(s.substr(0, offset + 1), &groups))
+                return make_value(groups[0].data() - s.data());
             else return NIL_VALUE;
         }
         else if (auto substring = dynamic_cast<String*>(pattern))
         {
-            auto p = v.rfind(substring->get_value(), (size_t)offset);
-            if (p != std::string::npos) return make_value((double)p);
+            auto p = s.rfind(substring->view(), (size_t)offset);
+            if (p != StringView::npos) return make_value(p);
             else return NIL_VALUE;
         }
         else throw ArgumentError("Expected String or Regexp");
@@ -562,7 +775,7 @@ namespace slim
 
     std::shared_ptr<Number> String::size()
     {
-        return make_value((double)v.size());
+        return make_value(byte_size());
     }
 
     std::shared_ptr<Array> String::split(const FunctionArgs &args)
@@ -581,11 +794,12 @@ namespace slim
         }
         else suppress_nulls = true;
 
-        std::vector<std::string> out;
+        auto v = view();
+        std::vector<StringView> out;
 
         if (auto str_obj = dynamic_cast<String*>(pattern.get()))
         {
-            auto &str = str_obj->get_value();
+            auto str = str_obj->view();
             if (str.empty())
             {
                 for (size_t p = 0; p < v.size(); ++p)
@@ -601,7 +815,7 @@ namespace slim
             }
             else if (str == " ")
             {
-                static const auto WS = " \t\n\r";
+                static const StringView WS = " \t\n\r";
                 auto p = v.find_first_not_of(WS);
                 while (p < v.size())
                 {
@@ -612,7 +826,7 @@ namespace slim
                         break;
                     }
                     auto next = v.find_first_of(WS, p);
-                    if (next != std::string::npos)
+                    if (next != StringView::npos)
                     {
                         out.push_back(v.substr(p, next - p));
                         p = v.find_first_not_of(WS, next);
@@ -630,7 +844,7 @@ namespace slim
                 while (limit == 0 || limit > (int)out.size() + 1)
                 {
                     auto next = v.find(str, p);
-                    if (next == std::string::npos) break;
+                    if (next == StringView::npos) break;
                     out.push_back(v.substr(p, next - p));
                     p = next + str.size();
                 }
@@ -639,28 +853,28 @@ namespace slim
         }
         else if (auto regex_obj = dynamic_cast<Regexp*>(pattern.get()))
         {
-            auto &regex = regex_obj->get();
-            auto i = v.cbegin(), end = v.cend();
-            while ((limit == 0 || limit > (int)out.size() + 1) && i != end)
+            Regexp::Groups groups;
+            size_t i = 0;
+            while ((limit == 0 || limit > (int)out.size() + 1) && i < v.size())
             {
-                std::smatch match;
-                std::regex_search(i, end, match, regex);
-                if (match.empty()) break;
-                if (match[0].first == match[0].second)
+                if (!regex_obj->search(v, i, &groups)) break;
+                auto begin = (size_t)(groups[0].data() - v.data());
+                if (groups[0].empty())
                 {
-                    out.emplace_back(i, match[0].first + 1);
-                    i = match[0].first + 1;
+                    auto next = std::min(begin + 1, v.size());
+                    out.push_back(v.substr(i, next - i));
+                    i = next;
                 }
                 else
                 {
-                    out.emplace_back(i, match[0].first);
-                    i = match[0].second;
+                    out.push_back(v.substr(i, begin - i));
+                    i = begin + groups[0].size();
                 }
                 //captures
-                for (size_t j = 1; j < match.size(); ++j)
-                    out.push_back(match.str(j));
+                for (size_t j = 1; j < groups.size(); ++j)
+                    out.push_back(groups[j]);
             }
-            out.emplace_back(i, end);
+            out.push_back(v.substr(i));
         }
         else throw ArgumentError("Expected String or Regexp");
 
@@ -671,33 +885,34 @@ namespace slim
         }
 
         auto arr = create_object<Array>();
-        for (auto &&str : out)
-            arr->push_back(make_value(std::move(str)));
+        for (auto &str : out)
+            arr->push_back(slice(str));
         return arr;
     }
 
     std::shared_ptr<Boolean> String::start_with_q(const FunctionArgs & args)
     {
-        for (auto &suffix : args)
+        auto s = view();
+        for (auto &prefix : args)
         {
-            auto &str = coerce<String>(suffix)->v;
-            if (v.find(str) == 0) return TRUE_VALUE;
+            if (s.starts_with(coerce<String>(prefix)->view())) return TRUE_VALUE;
         }
         return FALSE_VALUE;
     }
 
     std::shared_ptr<String> String::strip()
     {
-        auto start = v.find_first_not_of(WHITESPACE);
-        if (start == std::string::npos) return make_value("");
-        auto end = v.find_last_not_of(WHITESPACE);
-        return make_value(v.substr(start, end - start + 1));
+        auto s = view();
+        auto start = s.find_first_not_of(WHITESPACE);
+        if (start == StringView::npos) return make_value("");
+        auto end = s.find_last_not_of(WHITESPACE);
+        return substr(start, end - start + 1);
     }
     std::shared_ptr<String> String::lstrip()
     {
-        auto p = v.find_first_not_of(WHITESPACE);
-        if (p == std::string::npos) return make_value("");
-        else return make_value(v.substr(p));
+        auto p = view().find_first_not_of(WHITESPACE);
+        if (p == StringView::npos) return make_value("");
+        else return substr(p);
     }
     Ptr<Object> String::match(const FunctionArgs &args)
     {
@@ -705,29 +920,34 @@ namespace slim
         Ptr<Regexp> regex;
         Ptr<Number> pos = nullptr;
         if (try_unpack<1>(args, &str, &pos))
-            regex = create_object<Regexp>(str);
+            regex = RegexpCache::instance().get(str);
         else unpack<1>(args, &regex, &pos);
-        
+
         if (pos) return regex->match({shared_from_this(), pos});
         else return regex->match({shared_from_this()});
     }
     std::shared_ptr<String> String::rstrip()
     {
-        auto p = v.find_last_not_of(WHITESPACE);
-        if (p == std::string::npos) return make_value("");
-        else return make_value(v.substr(0, p + 1));
+        auto p = view().find_last_not_of(WHITESPACE);
+        if (p == StringView::npos) return make_value("");
+        else return substr(0, p + 1);
     }
 
     std::shared_ptr<String> String::upcase()
     {
-        auto ret = v;
+        auto ret = view().str();
         std::transform(ret.begin(), ret.end(), ret.begin(), ::toupper);
         return make_value(ret);
     }
 
+    std::shared_ptr<Boolean> String::valid_encoding_q()
+    {
+        return make_value(is_valid_utf8());
+    }
+
     namespace
     {
-        typedef std::function<std::string(const std::string &, const std::smatch *)> ReplaceFunc;
+        typedef std::function<std::string(const std::string &, const Regexp::Groups *)> ReplaceFunc;
         ReplaceFunc replace_func(Object *replace)
         {
             if (auto str_obj = dynamic_cast<String*>(replace))
@@ -758,7 +978,7 @@ namespace slim
                 if (last != std::string::npos)
                     parts.push_back({-1, str.substr(last)});
 
-                return [parts](const std::string &str, const std::smatch *match) -> std::string
+                return [parts](const std::string &str, const Regexp::Groups *match) -> std::string
                 {
                     std::string out;
                     for (auto &part : parts)
@@ -766,21 +986,21 @@ namespace slim
                         if (part.sub < 0) out += part.str;
                         else if (part.sub == 0) out += str;
                         else if (match && (size_t)part.sub < match->size())
-                            out += match->str((size_t)part.sub);
+                            out.append((*match)[part.sub].data(), (*match)[part.sub].size());
                     }
                     return out;
                 };
             }
             else if (auto hash = dynamic_cast<Hash*>(replace))
             {
-                return [hash](const std::string &str, const std::smatch *) -> std::string
+                return [hash](const std::string &str, const Regexp::Groups *) -> std::string
                 {
                     return hash->get(make_value(str))->to_string();
                 };
             }
             else if (auto proc = dynamic_cast<Proc*>(replace))
             {
-                return [proc](const std::string &str, const std::smatch *) -> std::string
+                return [proc](const std::string &str, const Regexp::Groups *) -> std::string
                 {
                     return coerce<String>(proc->call({make_value(str)}))->get_value();
                 };
@@ -803,35 +1023,44 @@ namespace slim
         auto f = replace_func(replace);
         if (auto regex = dynamic_cast<Regexp*>(pattern))
         {
-            auto i = v.cbegin(), end = v.cend();
+            auto v = view();
+            Regexp::Groups groups;
+            size_t i = 0;
             std::string out;
             do
             {
-                std::smatch match;
-                if (!std::regex_search(i, end, match, regex->get())) break;
-                out.append(i, match[0].first);
-                out += f(match.str(0), &match);
-                i = match[0].second;
+                if (!regex->search(v, i, &groups)) break;
+                auto begin = (size_t)(groups[0].data() - v.data());
+                out.append(v.data() + i, begin - i);
+                out += f(groups[0].str(), &groups);
+                i = begin + groups[0].size();
+                if (groups[0].empty())
+                {
+                    //step past an empty match so the next search makes progress
+                    if (i == v.size()) break;
+                    out += v[i++];
+                }
             }
             while (global);
-            out.append(i, end);
+            out.append(v.data() + i, v.size() - i);
             return make_value(out);
         }
         else if (auto str_obj = dynamic_cast<String*>(pattern))
         {
+            auto v = view();
             auto &str = str_obj->get_value();
             size_t i = 0;
             std::string out;
             do
             {
                 auto next = v.find(str, i);
-                if (next == std::string::npos) break;
-                out += v.substr(i, next - i);
+                if (next == StringView::npos) break;
+                out.append(v.data() + i, next - i);
                 out += f(str, nullptr);
                 i = next + str.size();
             }
             while (global);
-            out += v.substr(i);
+            out.append(v.data() + i, v.size() - i);
             return make_value(out);
         }
         else throw ArgumentError("Expected String or Regexp");
@@ -860,6 +1089,7 @@ namespace slim
             { &String::casecmp, "casecmp" },
             { &String::center, "center" },
             { &String::chomp, "chomp" },
+            { &String::concat, "concat" },
             { &String::downcase, "downcase" },
             { &String::each_byte, "each_byte" },
             { &String::each_char, "each_char" },
@@ -888,21 +1118,22 @@ namespace slim
             { &String::start_with_q, "start_with?" },
             { &String::strip, "strip" },
             { &String::substitute, "sub" },
-            { &String::upcase, "upcase" }
+            { &String::upcase, "upcase" },
+            { &String::valid_encoding_q, "valid_encoding?" }
         });
         return table;
     }
 
     std::shared_ptr<Array> String::do_partition(bool reverse, Object *sep)
     {
+        auto v = view();
         if (auto str = dynamic_cast<String*>(sep))
         {
-            auto p = reverse ? v.rfind(str->v) : v.find(str->v);
-            if (p != std::string::npos)
+            auto sep_str = str->view();
+            auto p = reverse ? v.rfind(sep_str) : v.find(sep_str);
+            if (p != StringView::npos)
             {
-                auto before = v.substr(0, p);
-                auto after = v.substr(p + str->v.size());
-                return make_array({make_value(before), str->shared_from_this(), make_value(after)});
+                return make_array({substr(0, p), str->shared_from_this(), substr(p + sep_str.size())});
             }
         }
         else
@@ -910,21 +1141,21 @@ namespace slim
             auto regex = coerce<Regexp>(sep);
             if (reverse)
             {
-                auto match = regex->do_rmatch(v);
-                if (match.size() > 1)
+                Regexp::Groups groups;
+                if (regex->search_last(v, &groups))
                 {
-                    auto begin = match[1].first;
-                    auto end = match[1].second;
+                    auto begin = groups[0].begin();
+                    auto end = groups[0].end();
                     return make_array({
-                        make_value(std::string(v.cbegin(), begin)),
-                        make_value(std::string(begin, end)),
-                        make_value(std::string(end, v.cend()))
+                        slice({v.begin(), (size_t)(begin - v.begin())}),
+                        slice({begin, (size_t)(end - begin)}),
+                        slice({end, (size_t)(v.end() - end)})
                     });
                 }
             }
             else
             {
-                auto match = regex->do_match(v, 0);
+                auto match = regex->do_match(this, 0);
                 if (match)
                     return make_array({match->pre_match(), match->to_string_obj(), match->post_match()});
             }
@@ -934,25 +1165,26 @@ namespace slim
         else return make_array({ make_value(""), make_value(""), shared_from_this() });
     }
 
-    std::vector<std::string> String::split_lines() const
+    std::vector<StringView> String::split_lines() const
     {
-        auto find = [this](size_t offset) -> size_t
+        auto v = view();
+        auto find = [v](size_t offset) -> size_t
         {
             while (true)
             {
                 auto p = v.find("\n\n", offset);
-                if (p == std::string::npos) return std::string::npos;
-                auto p2 = v.find_first_not_of('\n', p + 2);
-                if (p2 == std::string::npos) return std::string::npos;
+                if (p == StringView::npos) return StringView::npos;
+                auto p2 = v.find_first_not_of("\n", p + 2);
+                if (p2 == StringView::npos) return StringView::npos;
                 return p2;
             }
         };
-        std::vector<std::string> out;
+        std::vector<StringView> out;
         size_t p = 0;
         while (p < v.size())
         {
             auto p2 = find(p);
-            if (p2 == std::string::npos)
+            if (p2 == StringView::npos)
             {
                 out.push_back(v.substr(p));
                 break;
@@ -964,16 +1196,17 @@ namespace slim
         return out;
     }
 
-    std::vector<std::string> String::split_lines(const std::string &sep) const
+    std::vector<StringView> String::split_lines(StringView sep) const
     {
         if (sep.empty()) return split_lines();
 
-        std::vector<std::string> out;
+        auto v = view();
+        std::vector<StringView> out;
         size_t p = 0;
         while (p < v.size())
         {
             auto p_end = v.find(sep, p);
-            if (p_end == std::string::npos)
+            if (p_end == StringView::npos)
             {
                 out.push_back(v.substr(p));
                 break;
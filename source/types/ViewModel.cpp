@@ -8,7 +8,9 @@
 
 namespace slim
 {
-    ViewModel::ViewModel() {}
+    ViewModel::ViewModel()
+        : attrs(), constants(), version(0), versions(), reads(nullptr)
+    {}
     ViewModel::~ViewModel() {}
 
     const MethodTable &ViewModel::method_table()const
@@ -24,6 +26,7 @@ namespace slim
 
     ObjectPtr ViewModel::get_constant(SymPtr name)
     {
+        if (reads.load(std::memory_order_relaxed)) add_read(name);
         auto it = constants.find(name);
         if (it != constants.end()) return it->second;
         else throw NoConstantError(this, name);
@@ -32,6 +35,7 @@ namespace slim
     void ViewModel::add_constant(SymPtr name, ObjectPtr constant)
     {
         constants[name] = constant;
+        versions[name] = ++version;
     }
     void ViewModel::add_constant(const std::string &name, ObjectPtr constant)
     {
@@ -41,6 +45,7 @@ namespace slim
 
     ObjectPtr ViewModel::get_attr(SymPtr name)
     {
+        if (reads.load(std::memory_order_relaxed)) add_read(name);
         auto it = attrs.find(name);
         return it != attrs.end() ? it->second : NIL_VALUE;
     }
@@ -48,12 +53,29 @@ namespace slim
     void ViewModel::set_attr(SymPtr name, ObjectPtr value)
     {
         attrs[name] = value;
+        versions[name] = ++version;
     }
     void ViewModel::set_attr(const std::string &name, ObjectPtr value)
     {
         set_attr(symbol(name), value);
     }
 
+    void ViewModel::record_reads(std::vector<SymPtr> *reads)
+    {
+        std::lock_guard<std::mutex> lock(reads_lock);
+        this->reads = reads;
+    }
+    void ViewModel::add_read(const SymPtr &name)
+    {
+        std::lock_guard<std::mutex> lock(reads_lock);
+        if (auto out = reads.load()) out->push_back(name);
+    }
+    uint64_t ViewModel::get_version(const SymPtr &name)const
+    {
+        auto it = versions.find(name);
+        return it != versions.end() ? it->second : 0;
+    }
+
     void ViewModel::content_for(SymPtr name, std::shared_ptr<Proc> proc)
     {
         content_for_store[name] = proc->call({});
@@ -0,0 +1,80 @@
+#include <boost/test/unit_test.hpp>
+#include "NumberKernels.hpp"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace slim;
+
+BOOST_AUTO_TEST_SUITE(TestNumberKernels)
+
+BOOST_AUTO_TEST_CASE(sum)
+{
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<double> dist(-1000, 1000);
+    std::vector<double> values;
+    for (size_t n = 0; n < 40; ++n)
+    {
+        //four partial sums, whatever the build uses
+        double s[4] = { 0, 0, 0, 0 };
+        for (size_t i = 0; i < n; ++i) s[i % 4] += values[i];
+        BOOST_CHECK_EQUAL((s[0] + s[1]) + (s[2] + s[3]), kernels::sum(values.data(), n));
+        values.push_back(dist(rng));
+    }
+
+    long long total;
+    std::vector<long long> ints = { 1, 2, 3, -4, 5 };
+    BOOST_CHECK(kernels::sum(ints.data(), 0, &total));
+    BOOST_CHECK_EQUAL(0, total);
+    BOOST_CHECK(kernels::sum(ints.data(), ints.size(), &total));
+    BOOST_CHECK_EQUAL(7, total);
+    ints = { LLONG_MAX, 1, -2 };
+    BOOST_CHECK(!kernels::sum(ints.data(), 2, &total));
+    //only the partial sum overflows
+    ints = { LLONG_MAX, -2, 1 };
+    BOOST_CHECK(kernels::sum(ints.data(), ints.size(), &total));
+    BOOST_CHECK_EQUAL(LLONG_MAX - 1, total);
+    ints = { LLONG_MIN, -1 };
+    BOOST_CHECK(!kernels::sum(ints.data(), ints.size(), &total));
+}
+
+BOOST_AUTO_TEST_CASE(min_max_find)
+{
+    std::vector<double> values;
+    for (int i = 0; i < 37; ++i) values.push_back((i * 7) % 37 - 10.5);
+    double lo, hi;
+    for (size_t n = 1; n <= values.size(); ++n)
+    {
+        BOOST_CHECK(kernels::min_max(values.data(), n, &lo, &hi));
+        auto range = std::minmax_element(values.begin(), values.begin() + n);
+        BOOST_CHECK_EQUAL(*range.first, lo);
+        BOOST_CHECK_EQUAL(*range.second, hi);
+        BOOST_CHECK_EQUAL((size_t)(range.first - values.begin()), kernels::find(values.data(), n, lo));
+        BOOST_CHECK_EQUAL(kernels::NOT_FOUND, kernels::find(values.data(), n, 100.0));
+    }
+    for (size_t i = 0; i < values.size(); ++i)
+    {
+        auto copy = values;
+        copy[i] = NAN;
+        BOOST_CHECK(!kernels::min_max(copy.data(), copy.size(), &lo, &hi));
+        BOOST_CHECK_EQUAL(kernels::NOT_FOUND, kernels::find(copy.data(), copy.size(), (double)NAN));
+    }
+
+    std::vector<long long> ints;
+    for (long long i = 0; i < 37; ++i) ints.push_back((i * 7) % 37 * 0x100000001LL);
+    long long ilo, ihi;
+    kernels::min_max(ints.data(), ints.size(), &ilo, &ihi);
+    BOOST_CHECK_EQUAL(0, ilo);
+    BOOST_CHECK_EQUAL(36 * 0x100000001LL, ihi);
+    for (size_t i = 0; i < ints.size(); ++i)
+    {
+        BOOST_CHECK_EQUAL(i, kernels::find(ints.data(), ints.size(), ints[i]));
+    }
+    //only one 32 bit half matches
+    BOOST_CHECK_EQUAL(kernels::NOT_FOUND, kernels::find(ints.data(), ints.size(), 0x100000002LL));
+    BOOST_CHECK_EQUAL(kernels::NOT_FOUND, kernels::find(ints.data(), ints.size(), 0x200000001LL));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -54,6 +54,13 @@ BOOST_AUTO_TEST_CASE(equals)
     //Number and String
     BOOST_CHECK(!op_eq(a.get(), c.get())->is_true());
     BOOST_CHECK(op_ne(a.get(), c.get())->is_true());
+
+    //Number and Integer
+    auto i = make_value(55);
+    BOOST_CHECK(op_eq(a.get(), i.get())->is_true());
+    BOOST_CHECK(op_eq(i.get(), a.get())->is_true());
+    BOOST_CHECK(op_ne(b.get(), i.get())->is_true());
+    BOOST_CHECK_EQUAL(a->hash(), i->hash());
 }
 
 BOOST_AUTO_TEST_CASE(rel_cmp)
@@ -99,6 +106,12 @@ BOOST_AUTO_TEST_CASE(rel_cmp)
     //Null, no-order
     BOOST_CHECK_THROW(op_lt(NIL_VALUE.get(), NIL_VALUE.get()), UnorderableTypeError);
 
+    //Number and Integer
+    auto i = make_value(58);
+    BOOST_CHECK(op_lt(a.get(), i.get())->is_true());
+    BOOST_CHECK(op_gt(b.get(), i.get())->is_true());
+    BOOST_CHECK_EQUAL(-1, to_d(op_cmp(i.get(), b.get())));
+
     //Number and Boolean, different types
     BOOST_CHECK_THROW(op_le(FALSE_VALUE.get(), a.get()), UnorderableTypeError);
 
@@ -153,7 +166,7 @@ BOOST_AUTO_TEST_CASE(binary)
     //lshift
     BOOST_CHECK_EQUAL(2 << 5, to_d(a->bit_lshift(b.get())));
     BOOST_CHECK_THROW(a->bit_lshift(c.get()), TypeError);
-    BOOST_CHECK_THROW(c->bit_lshift(d.get()), NoMethodError);
+    BOOST_CHECK_EQUAL("55test", c->bit_lshift(d.get())->to_string());
     
     //rshift
     BOOST_CHECK_EQUAL(2 >> 5, to_d(a->bit_rshift(b.get())));
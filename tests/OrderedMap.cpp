@@ -0,0 +1,108 @@
+#include <boost/test/unit_test.hpp>
+#include "OrderedMap.hpp"
+#include "types/Symbol.hpp"
+#include "Value.hpp"
+
+using namespace slim;
+BOOST_AUTO_TEST_SUITE(TestOrderedMap)
+
+std::string keys(const ObjectMap &map)
+{
+    std::string out;
+    for (auto &i : map) out += i.first->to_string();
+    return out;
+}
+
+BOOST_AUTO_TEST_CASE(insert_find)
+{
+    ObjectMap map;
+    BOOST_CHECK(map.empty());
+    BOOST_CHECK(map.find(make_value("a")) == map.end());
+
+    BOOST_CHECK(map.emplace(make_value("a"), make_value(1.0)).second);
+    BOOST_CHECK(map.emplace(make_value("b"), make_value(2.0)).second);
+    BOOST_CHECK(!map.emplace(make_value("a"), make_value(3.0)).second);
+    map[make_value(5.0)] = make_value(4.0);
+    BOOST_CHECK_EQUAL(3U, map.size());
+    BOOST_CHECK_EQUAL("ab5", keys(map));
+
+    BOOST_CHECK_EQUAL("1", map.find(make_value("a"))->second->inspect());
+    BOOST_CHECK_EQUAL("4", map[make_value(5.0)]->inspect());
+    BOOST_CHECK_EQUAL(0U, map.count(make_value(5.5)));
+    BOOST_CHECK_EQUAL(1U, map.count(make_value(5.0)));
+}
+
+BOOST_AUTO_TEST_CASE(grow)
+{
+    ObjectMap map;
+    std::vector<SymPtr> syms;
+    for (int i = 0; i < 1000; ++i)
+    {
+        syms.push_back(symbol("ordered_map_" + std::to_string(i)));
+        map[syms.back()] = make_value(i);
+    }
+    BOOST_CHECK_EQUAL(1000U, map.size());
+    int i = 0;
+    for (auto &x : map)
+    {
+        BOOST_CHECK(x.first == syms[i]);
+        BOOST_CHECK_EQUAL(std::to_string(i), x.second->inspect());
+        ++i;
+    }
+    for (i = 0; i < 1000; ++i) BOOST_CHECK(map.find(syms[i])->second->eq(make_value(i).get()));
+}
+
+BOOST_AUTO_TEST_CASE(erase)
+{
+    ObjectMap map;
+    for (int i = 0; i < 10; ++i) map[make_value(i)] = NIL_VALUE;
+    BOOST_CHECK_EQUAL(1U, map.erase(make_value(0)));
+    BOOST_CHECK_EQUAL(0U, map.erase(make_value(0)));
+    BOOST_CHECK_EQUAL(1U, map.erase(make_value(5)));
+    BOOST_CHECK_EQUAL(1U, map.erase(make_value(9)));
+    BOOST_CHECK_EQUAL(7U, map.size());
+    BOOST_CHECK_EQUAL("1234678", keys(map));
+    BOOST_CHECK(map.find(make_value(5)) == map.end());
+
+    auto it = map.erase(map.find(make_value(6)));
+    BOOST_CHECK_EQUAL("7", it->first->inspect());
+    BOOST_CHECK_EQUAL("123478", keys(map));
+
+    //reinsert after erase goes to the end
+    map[make_value(0)] = NIL_VALUE;
+    BOOST_CHECK_EQUAL("1234780", keys(map));
+
+    //repeated insert/erase must reclaim space
+    for (int i = 100; i < 10000; ++i)
+    {
+        map[make_value(i)] = NIL_VALUE;
+        map.erase(make_value(i));
+    }
+    BOOST_CHECK_EQUAL("1234780", keys(map));
+
+    for (auto it = map.begin(); it != map.end();) it = map.erase(it);
+    BOOST_CHECK(map.empty());
+    BOOST_CHECK(map.begin() == map.end());
+}
+
+BOOST_AUTO_TEST_CASE(churn)
+{
+    //sizes just below where the index grows
+    for (int n : { 10, 21, 1365 })
+    {
+        ObjectMap map;
+        for (int i = 0; i < n; ++i) map[make_value(i)] = NIL_VALUE;
+        for (int i = n; i < n + 100000; ++i)
+        {
+            map.erase(make_value(i - n));
+            map[make_value(i)] = NIL_VALUE;
+        }
+        BOOST_CHECK_EQUAL((size_t)n, map.size());
+        BOOST_CHECK_EQUAL(100000, as_number(map.begin()->first));
+        BOOST_CHECK(map.find(make_value(n + 100000 - 1)) != map.end());
+        //a rebuild leaves room for at least half the entries again
+        BOOST_CHECK_GE(map.bucket_count() * 2 / 3, (size_t)n + n / 2);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
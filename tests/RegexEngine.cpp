@@ -0,0 +1,145 @@
+#include <boost/test/unit_test.hpp>
+#include "RegexEngine.hpp"
+#include <string>
+
+using namespace slim;
+using namespace slim::regex;
+
+BOOST_AUTO_TEST_SUITE(TestRegexEngine)
+
+namespace
+{
+    /**Compiles and searches, giving the match and groups as "[a][b]" with "-" for no match.*/
+    std::string search(const std::string &pattern, const std::string &str, int flags = 0, size_t start = 0)
+    {
+        auto prog = Program::compile(pattern, flags);
+        if (!prog) return "unsupported";
+        std::vector<size_t> slots;
+        if (!prog->search(str, start, &slots)) return "-";
+        std::string out;
+        for (size_t i = 0; i < slots.size(); i += 2)
+        {
+            if (slots[i] == Program::NO_MATCH) out += "[]";
+            else out += "[" + str.substr(slots[i], slots[i + 1] - slots[i]) + "]";
+        }
+        return out;
+    }
+    std::string search_last(const std::string &pattern, const std::string &str)
+    {
+        auto prog = Program::compile(pattern, 0);
+        std::vector<size_t> slots;
+        if (!prog->search_last(str, &slots)) return "-";
+        return std::to_string(slots[0]) + ":" + str.substr(slots[0], slots[1] - slots[0]);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(literals)
+{
+    BOOST_CHECK_EQUAL("[test]", search("test", "a test"));
+    BOOST_CHECK_EQUAL("-", search("test", "a tes"));
+    BOOST_CHECK_EQUAL("[]", search("", "abc"));
+    BOOST_CHECK_EQUAL("[a.b]", search("a\\.b", "axb a.b"));
+    BOOST_CHECK_EQUAL("[\t]", search("\\t", "a\tb"));
+    BOOST_CHECK_EQUAL("[AB]", search("\\x41\\x42", "xAB"));
+    BOOST_CHECK_EQUAL("[\xE2\x82\xAC]", search("\\u20AC", "5 \xE2\x82\xAC"));
+    BOOST_CHECK_EQUAL("[{a}]", search("{a}", "{a}"));
+    BOOST_CHECK_EQUAL("[TeSt]", search("test", "TeSt", Program::IGNORECASE));
+}
+
+BOOST_AUTO_TEST_CASE(classes)
+{
+    BOOST_CHECK_EQUAL("[123]", search("\\d+", "abc123def"));
+    BOOST_CHECK_EQUAL("[abc]", search("\\D+", "abc123def"));
+    BOOST_CHECK_EQUAL("[a_1]", search("\\w+", "  a_1 "));
+    BOOST_CHECK_EQUAL("[ \t]", search("\\s+", "a \tb"));
+    BOOST_CHECK_EQUAL("[cafe]", search("\\h+", "xcafez"));
+    BOOST_CHECK_EQUAL("[b-c]", search("[a-c-]+", "xb-cx"));
+    BOOST_CHECK_EQUAL("[xyz]", search("[^a-c]+", "abxyz"));
+    BOOST_CHECK_EQUAL("[]]", search("[]]", "a]"));
+    BOOST_CHECK_EQUAL("[a1]", search("[[:alpha:][:digit:]]+", " a1 "));
+    BOOST_CHECK_EQUAL("[ABC]", search("[a-c]+", "ABC", Program::IGNORECASE));
+    BOOST_CHECK_EQUAL("[d]", search("[^a-c]", "ABCd", Program::IGNORECASE));
+    BOOST_CHECK_EQUAL("[a]", search(".", "\na"));
+    BOOST_CHECK_EQUAL("[\n]", search(".", "\na", Program::MULTILINE));
+}
+
+BOOST_AUTO_TEST_CASE(anchors)
+{
+    BOOST_CHECK_EQUAL("[b]", search("^b", "a\nb"));
+    BOOST_CHECK_EQUAL("[a]", search("a$", "a\nb"));
+    BOOST_CHECK_EQUAL("-", search("\\Ab", "a\nb"));
+    BOOST_CHECK_EQUAL("[b]", search("b\\z", "a\nb"));
+    BOOST_CHECK_EQUAL("[b]", search("b\\Z", "a\nb\n"));
+    BOOST_CHECK_EQUAL("-", search("b\\z", "a\nb\n"));
+    BOOST_CHECK_EQUAL("[cat]", search("\\bcat\\b", "concat cat"));
+    BOOST_CHECK_EQUAL("[cat]", search("\\Bcat", "cat concat"));
+    BOOST_CHECK_EQUAL("-", search("^test", "xtest", 0, 1));
+}
+
+BOOST_AUTO_TEST_CASE(groups_and_alternation)
+{
+    BOOST_CHECK_EQUAL("[ab][a][b]", search("(a)(b)", "ab"));
+    BOOST_CHECK_EQUAL("[b][][b]", search("(a)|(b)", "b"));
+    BOOST_CHECK_EQUAL("[abab][b]", search("(?:a(b))+", "ababa"));
+    BOOST_CHECK_EQUAL("[cat]", search("cat|dog", "a cat dog"));
+    BOOST_CHECK_EQUAL("[dog]", search("cat|dog", "hotdog"));
+    //leftmost first, not leftmost longest
+    BOOST_CHECK_EQUAL("[a]", search("a|ab", "ab"));
+    BOOST_CHECK_EQUAL("[aB][B]", search("a(?i:(b))", "aB"));
+    BOOST_CHECK_EQUAL("-", search("a(?i:b)c", "aBC"));
+    BOOST_CHECK_EQUAL("[aBC]", search("a(?i)bc", "aBC"));
+    BOOST_CHECK_EQUAL("[ab]", search("a b # comment", "ab", Program::EXTENDED));
+}
+
+BOOST_AUTO_TEST_CASE(quantifiers)
+{
+    BOOST_CHECK_EQUAL("[aaa]", search("a*", "aaab"));
+    BOOST_CHECK_EQUAL("[]", search("a*?", "aaab"));
+    BOOST_CHECK_EQUAL("[<a><b>]", search("<.*>", "<a><b>"));
+    BOOST_CHECK_EQUAL("[<a>]", search("<.*?>", "<a><b>"));
+    BOOST_CHECK_EQUAL("[aa]", search("a{2}", "aaa"));
+    BOOST_CHECK_EQUAL("[aaa]", search("a{2,}", "aaa"));
+    BOOST_CHECK_EQUAL("[aa]", search("a{,2}", "aaa"));
+    BOOST_CHECK_EQUAL("[aa]", search("a{1,3}?a", "aaa"));
+    BOOST_CHECK_EQUAL("[a{1,x}]", search("a{1,x}", "a{1,x}"));
+    BOOST_CHECK_EQUAL("[colour]", search("colou?r", "colour"));
+    BOOST_CHECK_EQUAL("[][]", search("(a*)*", "b"));
+    BOOST_CHECK_EQUAL("[aab][b]", search("(a|b)*", "aab"));
+}
+
+BOOST_AUTO_TEST_CASE(linear_time)
+{
+    //exponential for a backtracking engine
+    std::string str(5000, 'a');
+    BOOST_CHECK_EQUAL("-", search("(a*)*b", str));
+    BOOST_CHECK_EQUAL("-", search("(a|aa)+$", str + "!"));
+    BOOST_CHECK_EQUAL("[" + str + "b]", search("(?:a+)+b", str + "b"));
+}
+
+BOOST_AUTO_TEST_CASE(last)
+{
+    BOOST_CHECK_EQUAL("7:test", search_last("test", "a test test"));
+    BOOST_CHECK_EQUAL("-", search_last("x", "a test test"));
+    BOOST_CHECK_EQUAL("5:test", search_last("^test", "test\ntest"));
+    BOOST_CHECK_EQUAL("3:", search_last("", "abc"));
+    BOOST_CHECK_EQUAL("4:a", search_last("a+", "aa aa"));
+}
+
+BOOST_AUTO_TEST_CASE(unsupported)
+{
+    BOOST_CHECK_EQUAL("unsupported", search("(a)\\1", "aa"));
+    BOOST_CHECK_EQUAL("unsupported", search("a(?=b)", "ab"));
+    BOOST_CHECK_EQUAL("unsupported", search("(?<name>a)", "a"));
+    BOOST_CHECK_EQUAL("unsupported", search("a++", "a"));
+    BOOST_CHECK_EQUAL("unsupported", search("[\xC3\xA9]", "a"));
+    BOOST_CHECK_EQUAL("unsupported", search("\\p{Alpha}", "a"));
+    //invalid
+    BOOST_CHECK_EQUAL("unsupported", search("(a", "a"));
+    BOOST_CHECK_EQUAL("unsupported", search("a)", "a"));
+    BOOST_CHECK_EQUAL("unsupported", search("[a", "a"));
+    BOOST_CHECK_EQUAL("unsupported", search("*a", "a"));
+    BOOST_CHECK_EQUAL("unsupported", search("[z-a]", "a"));
+    BOOST_CHECK_EQUAL("unsupported", search("a{3,1}", "a"));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,109 @@
+#include <boost/test/unit_test.hpp>
+#include "StringSearch.hpp"
+#include "StringView.hpp"
+#include <random>
+#include <string>
+
+using namespace slim;
+
+BOOST_AUTO_TEST_SUITE(TestStringSearch)
+
+namespace
+{
+    size_t find(const std::string &haystack, const std::string &needle)
+    {
+        return search::find(haystack.data(), haystack.size(), needle.data(), needle.size());
+    }
+    size_t rfind(const std::string &haystack, const std::string &needle)
+    {
+        return search::rfind(haystack.data(), haystack.size(), needle.data(), needle.size());
+    }
+    /**Compare with std::string for every needle position, including block boundaries.*/
+    void check_all(const std::string &haystack, const std::string &needle)
+    {
+        BOOST_CHECK_EQUAL(haystack.find(needle), find(haystack, needle));
+        BOOST_CHECK_EQUAL(haystack.rfind(needle), rfind(haystack, needle));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(basic)
+{
+    BOOST_CHECK_EQUAL(0U, find("test", ""));
+    BOOST_CHECK_EQUAL(4U, rfind("test", ""));
+    BOOST_CHECK_EQUAL(search::NOT_FOUND, find("te", "test"));
+    BOOST_CHECK_EQUAL(1U, find("test", "e"));
+    BOOST_CHECK_EQUAL(2U, find("test", "st"));
+    BOOST_CHECK_EQUAL(0U, rfind("test", "te"));
+    BOOST_CHECK_EQUAL(search::NOT_FOUND, find("test", "tx"));
+    BOOST_CHECK_EQUAL(3U, find(std::string("ab\0cd\0e", 7), std::string("cd\0", 3)));
+
+    StringView view("one two one two");
+    BOOST_CHECK_EQUAL(8U, view.find("one", 1));
+    BOOST_CHECK_EQUAL(StringView::npos, view.find("one", 9));
+    BOOST_CHECK_EQUAL(StringView::npos, view.find("one", 100));
+    BOOST_CHECK_EQUAL(8U, view.rfind("one"));
+    BOOST_CHECK_EQUAL(0U, view.rfind("one", 7));
+    BOOST_CHECK_EQUAL(15U, view.rfind(""));
+}
+
+BOOST_AUTO_TEST_CASE(positions)
+{
+    for (size_t len : {2, 3, 7, 16, 31, 32, 33, 64, 100})
+    {
+        std::string needle;
+        for (size_t i = 0; i < len; ++i) needle += (char)('a' + i % 26);
+        for (size_t size = len; size < 200; ++size)
+        {
+            for (size_t pos = 0; pos + len <= size; pos += 13)
+            {
+                std::string haystack(size, 'x');
+                haystack.replace(pos, len, needle);
+                check_all(haystack, needle);
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(random)
+{
+    //small alphabet for many partial matches, including periodic needles for Two-Way
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> letter(0, 2);
+    for (int n = 0; n < 2000; ++n)
+    {
+        std::string haystack(rng() % 300, ' '), needle(1 + rng() % 48, ' ');
+        for (auto &c : haystack) c = (char)('a' + letter(rng));
+        for (auto &c : needle) c = (char)('a' + letter(rng));
+        check_all(haystack, needle);
+    }
+    std::string periodic, haystack;
+    for (int i = 0; i < 20; ++i) periodic += "abaab";
+    for (int i = 0; i < 100; ++i) haystack += "abaab";
+    check_all(haystack, periodic);
+    check_all(haystack + "a", periodic + "a");
+    check_all(haystack, periodic + "b");
+}
+
+BOOST_AUTO_TEST_CASE(two_way)
+{
+    //long periodic needles that nearly match everywhere, so both directions switch to Two-Way
+    std::string unit(99, 'a');
+    unit += 'b';
+    std::string haystack;
+    for (int i = 0; i < 2000; ++i) haystack += unit;
+    std::string needle(150, 'a');
+    check_all(haystack, needle);
+    check_all(haystack, unit + unit + "a");
+    check_all(haystack, "b" + unit + unit);
+    check_all(haystack.substr(0, haystack.size() - 1), unit + unit);
+
+    std::string periodic;
+    for (int i = 0; i < 40; ++i) periodic += "abaab";
+    haystack.clear();
+    for (int i = 0; i < 5000; ++i) haystack += "abaab";
+    check_all("x" + haystack + "x", periodic);
+    check_all("x" + haystack, periodic + "x");
+    check_all(haystack + "x", "x" + periodic);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
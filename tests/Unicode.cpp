@@ -1,5 +1,6 @@
 #include <boost/test/unit_test.hpp>
 #include "Unicode.hpp"
+#include <string>
 
 BOOST_AUTO_TEST_SUITE(TestUnicode)
 
@@ -30,4 +31,37 @@ BOOST_AUTO_TEST_CASE(utf8_decode)
     BOOST_CHECK_THROW(slim::utf8_decode("\xFF-----", &cp, &elements), std::runtime_error);
 }
 
+BOOST_AUTO_TEST_CASE(utf8_scan)
+{
+    auto scan = [](const std::string &str) { return slim::utf8_scan(str.data(), str.size()); };
+    auto info = scan("");
+    BOOST_CHECK(info.ascii && info.valid);
+    BOOST_CHECK_EQUAL(0U, info.length);
+
+    //long enough for whole blocks, with code points crossing block boundaries
+    std::string ascii(100, 'x');
+    info = scan(ascii);
+    BOOST_CHECK(info.ascii && info.valid);
+    BOOST_CHECK_EQUAL(100U, info.length);
+    for (size_t i = 0; i < 40; ++i)
+    {
+        auto str = ascii.substr(0, i) + "\xE2\x82\xAC" + ascii.substr(0, 40) + "\xF0\x90\x8D\x88";
+        info = scan(str);
+        BOOST_CHECK(!info.ascii && info.valid);
+        BOOST_CHECK_EQUAL(i + 42, info.length);
+        //truncated
+        info = scan(str.substr(0, str.size() - 1));
+        BOOST_CHECK(!info.ascii && !info.valid);
+        BOOST_CHECK_EQUAL(i + 42, info.length);
+    }
+
+    BOOST_CHECK(!scan("\xC0\xAF").valid); //overlong
+    BOOST_CHECK(!scan("\xE0\x80\xAF").valid); //overlong
+    BOOST_CHECK(!scan("\xED\xA0\x80").valid); //surrogate
+    BOOST_CHECK(!scan("\xF4\x90\x80\x80").valid); //above U+10FFFF
+    BOOST_CHECK(!scan("a\x80").valid);
+    BOOST_CHECK_EQUAL(1U, scan("a\x80").length);
+    BOOST_CHECK(scan("\xED\x9F\xBF\xF4\x8F\xBF\xBF").valid);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -1,5 +1,7 @@
 #include <boost/test/unit_test.hpp>
 #include "Util.hpp"
+#include "types/HtmlSafeString.hpp"
+#include "types/Number.hpp"
 
 BOOST_AUTO_TEST_SUITE(TestUtil)
 
@@ -10,4 +12,18 @@ BOOST_AUTO_TEST_CASE(html_escape)
         slim::html_escape("& < > \" '"));
 }
 
+BOOST_AUTO_TEST_CASE(html_escape_append)
+{
+    std::string out = "x";
+    slim::html_escape_append(out, "a<b>c", 5);
+    BOOST_CHECK_EQUAL("xa&lt;b&gt;c", out);
+    slim::html_escape_append(out, slim::make_value("&'").get());
+    BOOST_CHECK_EQUAL("xa&lt;b&gt;c&amp;&#39;", out);
+    slim::html_escape_append(out, slim::create_object<slim::HtmlSafeString>("<br>").get());
+    BOOST_CHECK_EQUAL("xa&lt;b&gt;c&amp;&#39;<br>", out);
+    out.clear();
+    slim::html_escape_append(out, slim::make_value(5).get());
+    BOOST_CHECK_EQUAL("5", out);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -1,7 +1,9 @@
 #include <boost/test/unit_test.hpp>
 #include "Template.hpp"
+#include "types/Deferred.hpp"
 #include "types/ViewModel.hpp"
 #include "types/HtmlSafeString.hpp"
+#include "Value.hpp"
 #include "Util.hpp"
 
 using namespace slim;
@@ -50,4 +52,123 @@ BOOST_AUTO_TEST_CASE(yield)
         , html);
 }
 
+BOOST_AUTO_TEST_CASE(yield_segments)
+{
+    auto tpl = parse_template(
+        "= content_for :head do\n"
+        "  title head content\n"
+        "p main content\n");
+    auto layout = parse_template(
+        "header header\n"
+        "=yield\n"
+        "footer footer\n"
+    );
+    auto mv = create_view_model();
+    auto out = tpl.render_layout_segments(layout, mv, false, 8);
+    auto &segments = out.get_segments();
+    BOOST_REQUIRE_EQUAL(3U, segments.size());
+    BOOST_CHECK_EQUAL("<p>main content</p>", std::string(segments[1].data, segments[1].size));
+    //the main content static text is referenced, not copied
+    auto out2 = tpl.render_layout_segments(layout, mv, false, 8);
+    BOOST_CHECK_EQUAL((const void*)segments[1].data, (const void*)out2.get_segments()[1].data);
+    BOOST_CHECK_EQUAL(
+        "<header>header</header>"
+        "<p>main content</p>"
+        "<footer>footer</footer>"
+        , out.to_string());
+
+    //prefix needs the content_for block, so the main content is rendered first and spliced in
+    layout = parse_template(
+        "head\n"
+        "  =yield :head\n"
+        "=yield\n"
+        "footer footer\n"
+    );
+    out = tpl.render_layout_segments(layout, mv, true, 8);
+    BOOST_CHECK_EQUAL(
+        "<!DOCTYPE html>\n"
+        "<head><title>head content</title></head>"
+        "<p>main content</p>"
+        "<footer>footer</footer>"
+        , out.to_string());
+    BOOST_CHECK_EQUAL(out.to_string(), tpl.render_layout(layout, mv, true));
+}
+
+BOOST_AUTO_TEST_CASE(layout_split)
+{
+    auto tpl = parse_template(
+        "= content_for :head do\n"
+        "  title head\n"
+        "p main\n");
+    auto check = [&tpl](const char *layout_src, const char *expected) {
+        auto layout = parse_template(layout_src);
+        auto mv = create_view_model();
+        BOOST_CHECK_EQUAL(expected, tpl.render_layout(layout, mv, false));
+        std::string buffer = "x";
+        tpl.render_layout_into(buffer, layout, mv, false);
+        BOOST_CHECK_EQUAL(std::string("x") + expected, buffer);
+    };
+    //static prefix, the main content is rendered directly into the output
+    check("div\n  =yield\nruby: x = 5\n= x", "<div><p>main</p></div>5");
+    //dynamic prefix, sharing locals with the suffix
+    check("ruby: x = 5\n=yield :head\n=yield\n= x", "<title>head</title><p>main</p>5");
+    //main yield in a condition or used twice, can not split
+    check("- if true\n  =yield\n=yield :head", "<p>main</p><title>head</title>");
+    check("=yield\n=yield", "<p>main</p><p>main</p>");
+    check("=yield\n- [1, 2].each do |i|\n  =yield", "<p>main</p><p>main</p><p>main</p>");
+    check("=yield\np = yield.size", "<p>main</p><p>11</p>");
+    check("=yield\np a=yield() b", "<p>main</p><p a=\"<p>main</p>\">b</p>");
+    //only calls count, not text that looks like one
+    check("p yield() and #{'yield()'}\n=yield", "<p>yield() and yield()</p><p>main</p>");
+    //no main yield
+    check("=yield :head", "<title>head</title>");
+}
+
+BOOST_AUTO_TEST_CASE(layout_deferred)
+{
+    auto tpl = parse_template(
+        "= content_for :head do\n"
+        "  title = @title\n"
+        "p = @main\n");
+    auto mv = create_view_model();
+    mv->set_attr("title", make_deferred([]{ return make_value("<title>"); }));
+    mv->set_attr("main", make_deferred([]{ return make_value("main"); }));
+    mv->set_attr("foot", make_deferred([]{ return make_value("foot"); }));
+    //static prefix
+    auto layout = parse_template("div\n  =yield\np = @foot");
+    BOOST_CHECK_EQUAL("<div><p>main</p></div><p>foot</p>", tpl.render_layout(layout, mv, false));
+    //dynamic prefix
+    layout = parse_template("p = @foot\n=yield :head\n=yield\np = @foot");
+    BOOST_CHECK_EQUAL("<p>foot</p><title>&lt;title&gt;</title><p>main</p><p>foot</p>", tpl.render_layout(layout, mv, false));
+    //not split
+    layout = parse_template("=yield :head\n=yield\n=yield");
+    BOOST_CHECK_EQUAL("<title>&lt;title&gt;</title><p>main</p><p>main</p>", tpl.render_layout(layout, mv, false));
+}
+
+BOOST_AUTO_TEST_CASE(template_directory)
+{
+    for (unsigned threads : { 1, 3 })
+    {
+        auto dir = parse_template_directory("tests/data/templates", "*.slim", threads);
+        BOOST_REQUIRE_EQUAL(3, dir.templates.size());
+        BOOST_CHECK(dir.templates.count("index.html.slim"));
+        BOOST_CHECK(dir.templates.count("layout.slim"));
+        BOOST_CHECK(dir.templates.count("partials/item.slim"));
+        //a syntax error does not stop the other files
+        BOOST_REQUIRE_EQUAL(1, dir.errors.size());
+        BOOST_CHECK_EQUAL("tests/data/templates/partials/bad.slim", dir.errors[0].file_name());
+        BOOST_CHECK_EQUAL(2, dir.errors[0].line());
+        BOOST_CHECK_EQUAL(4, dir.parse_times.size());
+
+        auto mv = create_view_model();
+        mv->set_attr("title", make_value("Title"));
+        BOOST_CHECK_EQUAL("<h1>Title</h1><p>Index</p>",
+            dir.templates.at("index.html.slim").render_layout(dir.templates.at("layout.slim"), mv, false));
+    }
+    BOOST_CHECK_EQUAL(1, parse_template_directory("tests/data/templates", "*.html.slim").templates.size());
+    BOOST_CHECK_EQUAL(1, parse_template_directory("tests/data/templates", "?ayout.*").templates.size());
+    BOOST_CHECK_EQUAL(0, parse_template_directory("tests/data/templates", "*.txt").errors.size());
+    BOOST_CHECK_THROW(parse_template_directory("tests/data/missing"), std::runtime_error);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
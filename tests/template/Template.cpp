@@ -1,11 +1,21 @@
 #include <boost/test/unit_test.hpp>
 #include "template/Template.hpp"
+#include "template/IncrementalRender.hpp"
 #include "template/TemplatePart.hpp"
 #include "template/Lexer.hpp"
 #include "template/Parser.hpp"
+#include "template/RenderProgram.hpp"
+#include "template/TemplateParts.hpp"
+#include "expression/Lexer.hpp"
+#include "expression/Parser.hpp"
 #include "expression/Scope.hpp"
 #include "Value.hpp"
+#include "types/Deferred.hpp"
+#include "types/Hash.hpp"
+#include "types/HtmlSafeString.hpp"
+#include "types/Symbol.hpp"
 #include "Error.hpp"
+#include "Util.hpp"
 
 using namespace slim;
 using namespace slim::tpl;
@@ -171,6 +181,27 @@ BOOST_AUTO_TEST_CASE(attributes)
         "<!DOCTYPE html>\n"
         "<p class=\"HTML <b>Safe</b>\"></p>",
         render_tpl("p class=@e.html_safe", model));
+    //no static values, more than one dynamic value, or boolean values within an array
+    BOOST_CHECK_EQUAL(
+        "<!DOCTYPE html>\n"
+        "<p class=\"Test HTML &lt;b&gt;Safe&lt;/b&gt; true\"></p>",
+        render_tpl("p class=[@a, @e, @b]", model));
+    BOOST_CHECK_EQUAL(
+        "<!DOCTYPE html>\n"
+        "<p class=\"true Test\"></p>",
+        render_tpl("p class=[@b, @a]", model));
+    BOOST_CHECK_EQUAL(
+        "<!DOCTYPE html>\n"
+        "<p disabled></p>",
+        render_tpl("p disabled=[@b]", model));
+    BOOST_CHECK_EQUAL(
+        "<!DOCTYPE html>\n"
+        "<p></p>",
+        render_tpl("p class=[]", model));
+    BOOST_CHECK_EQUAL(
+        "<!DOCTYPE html>\n"
+        "<p class=\"a\"></p>",
+        render_tpl("p.a class=[]", model));
 }
 
 BOOST_AUTO_TEST_CASE(splat_attributes)
@@ -196,6 +227,25 @@ BOOST_AUTO_TEST_CASE(splat_attributes)
         "<!DOCTYPE html>\n"
         "<p class=\"c dd a b\"></p>",
         render_tpl("p.c *{class: ['a', 'b']} class=('d' + 'd')", model));
+    //source order, then splat order
+    BOOST_CHECK_EQUAL(
+        "<!DOCTYPE html>\n"
+        "<p id=\"i\" class=\"c z\" title=\"t\" b=\"1\" a=\"2\"></p>",
+        render_tpl("p#i.c *{b: 1, a: 2, class: 'z'} title='t'", model));
+    auto hash = create_object<Hash>();
+    hash->set(make_value("b"), make_value("<x>"));
+    hash->set(symbol("title"), make_value("u"));
+    hash->set(make_value(5), make_value(6));
+    model->set_attr("h", hash);
+    BOOST_CHECK_EQUAL(
+        "<!DOCTYPE html>\n"
+        "<p title=\"t u\" b=\"&lt;x&gt; y\" 5=\"6\"></p>",
+        render_tpl("p title='t' *@h *{b: 'y'}", model));
+    //boolean attributes
+    BOOST_CHECK_EQUAL(
+        "<!DOCTYPE html>\n"
+        "<p disabled></p>",
+        render_tpl("p *{disabled: true, hidden: false, name: nil}", model));
 }
 
 BOOST_AUTO_TEST_CASE(cond_if)
@@ -292,4 +342,265 @@ BOOST_AUTO_TEST_CASE(each)
         ));
 }
 
+BOOST_AUTO_TEST_CASE(render_program)
+{
+    auto parse_expr = [](const std::string &src) {
+        expr::Lexer lexer(src);
+        expr::LocalVarNames vars;
+        vars.add("i");
+        expr::Parser parser(vars, lexer);
+        return parser.full_expression();
+    };
+    //"<p>a", if @x "b" else "c", "</p>", [1, 2, 3].each do |i| =i * 2
+    auto make_tree = [&parse_expr]() {
+        std::vector<std::unique_ptr<TemplatePart>> parts;
+        parts.push_back(slim::make_unique<TemplateText>("<p>"));
+        parts.push_back(slim::make_unique<TemplateText>("a"));
+        parts.push_back(slim::make_unique<TemplateIfExpr>(
+            TemplateCondExpr(parse_expr("@x"), slim::make_unique<TemplateText>("b")),
+            std::vector<TemplateCondExpr>(),
+            slim::make_unique<TemplateText>("c")));
+        parts.push_back(slim::make_unique<TemplateText>("</p>"));
+        parts.push_back(slim::make_unique<TemplateForExpr>(
+            parse_expr("[1, 2, 3].each"),
+            slim::make_unique<TemplateOutputExpr>(parse_expr("i * 2")),
+            std::vector<SymPtr>{ symbol("i") }));
+        return slim::make_unique<TemplatePartsList>(std::move(parts));
+    };
+
+    auto tree = make_tree();
+    RenderProgram program(*tree);
+    auto &ops = program.get_ops();
+    BOOST_CHECK_EQUAL("<p>abc</p>", program.get_text());
+    BOOST_REQUIRE_EQUAL(9U, ops.size());
+    //adjacent text is merged, but not the "</p>" after the else body, which is a jump target
+    BOOST_CHECK_EQUAL(RenderOp::EMIT_STATIC, ops[0].code);
+    BOOST_CHECK_EQUAL(4U, ops[0].b);
+    BOOST_CHECK_EQUAL(RenderOp::IF, ops[1].code);
+    BOOST_CHECK_EQUAL(4U, ops[1].a);
+    BOOST_CHECK_EQUAL(RenderOp::JUMP, ops[3].code);
+    BOOST_CHECK_EQUAL(5U, ops[3].a);
+    BOOST_CHECK_EQUAL(RenderOp::EMIT_STATIC, ops[5].code);
+    BOOST_CHECK_EQUAL(RenderOp::FOR_BEGIN, ops[6].code);
+    BOOST_CHECK_EQUAL(8U, ops[6].a);
+    BOOST_CHECK_EQUAL(RenderOp::EVAL_ESCAPED, ops[7].code);
+    BOOST_CHECK_EQUAL(RenderOp::FOR_END, ops[8].code);
+
+    Template tpl(make_tree());
+    auto model = create_view_model();
+    model->set_attr("x", TRUE_VALUE);
+    BOOST_CHECK_EQUAL("<p>ab</p>246", tpl.render(model, false));
+    model->set_attr("x", FALSE_VALUE);
+    BOOST_CHECK_EQUAL("<p>ac</p>246", tpl.render(model, false));
+}
+
+BOOST_AUTO_TEST_CASE(render_buffers)
+{
+    const char *src = "ul\n  - @items.each do |i|\n    li = i\n";
+    Lexer lexer(src, src + strlen(src));
+    Parser parser(lexer);
+    auto tpl = parser.parse();
+    auto model = create_view_model();
+    std::vector<ObjectPtr> items;
+    for (int i = 0; i < 1000; ++i) items.push_back(make_value((double)i));
+    model->set_attr("items", make_value(std::move(items)));
+
+    //render_into appends
+    std::string buffer = "prefix";
+    tpl.render_into(buffer, model, false);
+    auto html = tpl.render(model, false);
+    BOOST_CHECK_EQUAL("prefix" + html, buffer);
+    BOOST_CHECK_EQUAL(0U, html.find("<ul><li>0</li><li>1</li>"));
+    //the previous output size is reserved up front
+    BOOST_CHECK_GE(html.capacity(), html.size());
+    auto expected = html.capacity();
+    BOOST_CHECK_GE(expected, html.size() + html.size() / 8);
+
+    //released buffers are reused by the next render on the thread
+    RenderBufferPool::clear();
+    std::string big;
+    big.reserve(expected * 2);
+    auto big_capacity = big.capacity();
+    RenderBufferPool::release(std::move(big));
+    BOOST_CHECK_EQUAL(1U, RenderBufferPool::size());
+    html = tpl.render(model, true);
+    BOOST_CHECK_EQUAL(0U, RenderBufferPool::size());
+    BOOST_CHECK_EQUAL(big_capacity, html.capacity());
+    BOOST_CHECK_EQUAL("<!DOCTYPE html>\n" + buffer.substr(6), html);
+    //a buffer that is too small is left in the pool
+    RenderBufferPool::release(std::string());
+    html = tpl.render(model, false);
+    BOOST_CHECK_EQUAL(1U, RenderBufferPool::size());
+    RenderBufferPool::clear();
+    BOOST_CHECK_EQUAL(0U, RenderBufferPool::size());
+}
+
+BOOST_AUTO_TEST_CASE(render_segments)
+{
+    const char *src = "div.long-class-name\n  p = @a\n  p = @b\n  p Some static text here";
+    Lexer lexer(src, src + strlen(src));
+    Parser parser(lexer);
+    auto tpl = parser.parse();
+    auto model = create_view_model();
+    model->set_attr("a", make_value("<x>"));
+    model->set_attr("b", create_object<HtmlSafeString>("<b>safe content</b>"));
+    auto expected = tpl.render(model);
+
+    //everything copied
+    auto out = tpl.render_segments(model, true, 1000);
+    BOOST_CHECK_EQUAL(expected, out.to_string());
+    BOOST_CHECK_EQUAL(1U, out.get_segments().size());
+
+    out = tpl.render_segments(model, true, 8);
+    BOOST_CHECK_EQUAL(expected, out.to_string());
+    BOOST_CHECK_EQUAL(expected.size(), out.size());
+    auto &segments = out.get_segments();
+    std::vector<std::string> parts;
+    for (auto &segment : segments) parts.emplace_back(segment.data, segment.size);
+    //doctype and "<x>" are copied, "</p><p>" is too short, the rest is referenced
+    std::vector<std::string> expected_parts = {
+        "<!DOCTYPE html>\n", "<div class=\"long-class-name\"><p>", "&lt;x&gt;</p><p>",
+        "<b>safe content</b>", "</p><p>Some static text here</p></div>" };
+    BOOST_CHECK_EQUAL_COLLECTIONS(expected_parts.begin(), expected_parts.end(), parts.begin(), parts.end());
+
+    struct IoVec { void *iov_base; size_t iov_len; };
+    std::vector<IoVec> iovecs;
+    out.get_iovecs(iovecs);
+    BOOST_REQUIRE_EQUAL(segments.size(), iovecs.size());
+    std::string written;
+    out.write([&written](const char *data, size_t size) { written.append(data, size); });
+    BOOST_CHECK_EQUAL(expected, written);
+    for (size_t i = 0; i < segments.size(); ++i)
+    {
+        BOOST_CHECK_EQUAL((const void*)segments[i].data, iovecs[i].iov_base);
+        BOOST_CHECK_EQUAL(segments[i].size, iovecs[i].iov_len);
+    }
+
+    //static segments reference the template, so are identical for each render
+    auto out2 = tpl.render_segments(model, true, 8);
+    BOOST_CHECK_EQUAL((const void*)segments[1].data, (const void*)out2.get_segments()[1].data);
+    BOOST_CHECK_NE((const void*)segments[2].data, (const void*)out2.get_segments()[2].data);
+}
+
+BOOST_AUTO_TEST_CASE(parallel_each)
+{
+    auto model = create_view_model();
+    std::vector<ObjectPtr> items;
+    std::string expected = "<!DOCTYPE html>\n<ul>";
+    for (int i = 0; i < 5000; ++i)
+    {
+        items.push_back(make_value((double)i));
+        expected += "<li>" + std::to_string(i * 2) + "</li>";
+    }
+    expected += "</ul>";
+    model->set_attr("items", make_value(std::move(items)));
+    model->set_attr("few", make_array({ make_value(1.0), make_value(2.0) }));
+
+    for (size_t threads : { 1, 3, 8 })
+    {
+        TemplateParallelEachExpr::set_max_threads(threads);
+        BOOST_CHECK_EQUAL(expected, render_tpl("ul\n  - @items.parallel_each do |i|\n    li = i * 2\n", model));
+    }
+    //locals are readable, and each element has its own scope
+    BOOST_CHECK_EQUAL("<!DOCTYPE html>\n<p>11x</p><p>12x</p>",
+        render_tpl("ruby: x = 'x'\n- @few.parallel_each do |i|\n  ruby: y = 10 + i\n  p #{y}#{x}\n", model));
+    //Hash elements are spread over the params
+    BOOST_CHECK_EQUAL("<!DOCTYPE html>\n<p>a=1</p><p>b=2</p>",
+        render_tpl("- {a: 1, b: 2}.parallel_each do |k, v|\n  p #{k}=#{v}\n", model));
+    //errors from worker threads are raised
+    BOOST_CHECK_THROW(render_tpl("- @items.parallel_each do |i|\n  = i.no_such_method\n", model), NoMethodError);
+    TemplateParallelEachExpr::set_max_threads(0);
+
+    BOOST_CHECK_THROW(render_tpl("ruby: x = 1\n- @items.parallel_each do |i|\n  ruby: x = i\n", model), TemplateSyntaxError);
+    BOOST_CHECK_THROW(render_tpl("- @items.parallel_each do |i|\n  = content_for :x do\n    p\n", model), TemplateSyntaxError);
+    BOOST_CHECK_THROW(render_tpl("- @items.parallel_each(2) do |i|\n  p\n", model), TemplateSyntaxError);
+}
+
+BOOST_AUTO_TEST_CASE(deferred)
+{
+    auto model = create_view_model();
+    model->set_attr("a", make_deferred([]{ return make_value("<a>"); }));
+    model->set_attr("b", make_deferred([]() -> ObjectPtr { return create_object<HtmlSafeString>("<b>safe</b>"); }));
+    model->set_attr("no", make_deferred([]{ return make_value(false); }));
+    model->set_attr("list", make_deferred([]{ return make_array({ make_value(1.0), make_value(2.0) }); }));
+    model->set_attr("error", make_deferred([]() -> ObjectPtr { throw std::runtime_error("failed"); }));
+
+    //placeholders are replaced in order, escaped unless HTML safe
+    BOOST_CHECK_EQUAL("<!DOCTYPE html>\n<p>&lt;a&gt;</p><p><b>safe</b></p><p>&lt;a&gt;</p>",
+        render_tpl("p = @a\np = @b\np = @a\n", model));
+    BOOST_CHECK_EQUAL("<!DOCTYPE html>\n<p title=\"&lt;a&gt;\">2</p>",
+        render_tpl("p title=@a\n  - if @no\n    | 1\n  - else\n    | 2\n", model));
+    //a loop over a Deferred is itself deferred, with the variables at that point
+    BOOST_CHECK_EQUAL("<!DOCTYPE html>\n<ul><li>1x</li><li>2x</li></ul><p>y</p>",
+        render_tpl("ruby: x = 'x'\nul\n  - @list.each do |i|\n    li #{i}#{x}\nruby: x = 'y'\np = x\n", model));
+    //within other loops the value is waited for
+    BOOST_CHECK_EQUAL("<!DOCTYPE html>\n<p>1&lt;a&gt;12</p><p>2&lt;a&gt;12</p>",
+        render_tpl("- [1, 2].each do |j|\n  p\n    = j\n    = @a\n    - @list.each do |i|\n      = i\n", model));
+    BOOST_CHECK_THROW(render_tpl("p = @error\n", model), std::runtime_error);
+
+    //segmented output waits for the value
+    const char *src = "p = @b\np = @a\n";
+    Lexer lexer(src, src + strlen(src));
+    Parser parser(lexer);
+    BOOST_CHECK_EQUAL("<!DOCTYPE html>\n<p><b>safe</b></p><p>&lt;a&gt;</p>",
+        parser.parse().render_segments(model).to_string());
+}
+
+BOOST_AUTO_TEST_CASE(incremental_render)
+{
+    const char *src =
+        "h1 = @title\n"
+        "p class=@cls = @text\n"
+        "- if @show\n"
+        "  p shown\n"
+        "- else\n"
+        "  p hidden\n"
+        "ul\n"
+        "  - @list.each do |i|\n"
+        "    li = i\n"
+        "ruby: x = @count * 2\n"
+        "p = x\n";
+    Lexer lexer(src, src + strlen(src));
+    Parser parser(lexer);
+    auto tpl = parser.parse();
+    auto model = create_view_model();
+    auto title = make_value("Title");
+    model->set_attr("title", title);
+    model->set_attr("cls", make_value("a"));
+    model->set_attr("text", make_value("<text>"));
+    model->set_attr("show", TRUE_VALUE);
+    model->set_attr("list", make_array({ make_value(1.0), make_value(2.0) }));
+    model->set_attr("count", make_value(5.0));
+
+    IncrementalRender inc(tpl, model);
+    auto expected = tpl.render(model);
+    BOOST_CHECK_EQUAL(expected, inc.render());
+    BOOST_CHECK(inc.render_changes().empty());
+
+    //only fragments reading changed attributes are rendered again
+    title->get_mutable_value() = "Not rendered";
+    model->set_attr("show", FALSE_VALUE);
+    auto changes = inc.render_changes();
+    BOOST_REQUIRE_EQUAL(1, changes.size());
+    BOOST_CHECK_EQUAL("<p>hidden</p>", changes[0].html);
+    BOOST_CHECK_EQUAL("<p>hidden</p>", inc.get_fragment(changes[0].id));
+    BOOST_CHECK_EQUAL("<!DOCTYPE html>\n<h1>Title</h1><p class=\"a\">&lt;text&gt;</p><p>hidden</p><ul><li>1</li><li>2</li></ul><p>10</p>",
+        inc.render());
+    title->get_mutable_value() = "Title";
+
+    //setting an unchanged value renders again, but is not a change
+    model->set_attr("cls", make_value("a"));
+    BOOST_CHECK(inc.render_changes().empty());
+
+    //fragments using locals depend on what the code read
+    model->set_attr("count", make_value(7.0));
+    model->set_attr("list", make_array({ make_value(3.0) }));
+    changes = inc.render_changes();
+    BOOST_REQUIRE_EQUAL(2, changes.size());
+    BOOST_CHECK_EQUAL("<li>3</li>", changes[0].html);
+    BOOST_CHECK_EQUAL("14", changes[1].html);
+    BOOST_CHECK(changes[0].id < changes[1].id);
+    BOOST_CHECK_EQUAL(tpl.render(model), inc.render());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -127,6 +127,26 @@ BOOST_AUTO_TEST_CASE(sub)
     BOOST_CHECK_EQUAL("[5, 10]", eval("b - a", scope));
     BOOST_CHECK_EQUAL("[7]", eval("c - b", scope));
     BOOST_CHECK_EQUAL("[]", eval("b - c", scope));
+    //large enough to use a hash table
+    BOOST_CHECK_EQUAL("[0, 2, 4, 6, 8, 10, 12, 14, 16, 18]",
+        eval("(0...20).to_a - (0...20).select{|x| x % 2 == 1}", scope));
+}
+
+BOOST_AUTO_TEST_CASE(set_ops)
+{
+    Scope scope(create_view_model());
+    scope.set("a", make_array({}));
+    scope.set("b", make_array2({ 5.0, 10.0 }));
+    scope.set("c", make_array2({ 7.0, 10.0, 5.0, 7.0 }));
+
+    BOOST_CHECK_EQUAL("[]", eval("a & b", scope));
+    BOOST_CHECK_EQUAL("[5, 10]", eval("b & c", scope));
+    BOOST_CHECK_EQUAL("[10, 5]", eval("c & b", scope));
+    BOOST_CHECK_EQUAL("[5, 10]", eval("b | a", scope));
+    BOOST_CHECK_EQUAL("[7, 10, 5]", eval("c | b", scope));
+    BOOST_CHECK_EQUAL("[5, 10, 7]", eval("b | c", scope));
+    BOOST_CHECK_EQUAL("[5, 6, 7]", eval("(0...8).to_a & (5...30).to_a", scope));
+    BOOST_CHECK_EQUAL("20", eval("((0...10).to_a | (5...20).to_a).size", scope));
 }
 
 BOOST_AUTO_TEST_CASE(basic_access)
@@ -268,6 +288,8 @@ BOOST_AUTO_TEST_CASE(join)
     Scope scope(create_view_model());
     scope.set("a", make_array2({ 1.0, 2.0, 3.0, 5.0, 8.0, 11.0 }));
     BOOST_CHECK_EQUAL("\"1, 2, 3, 5, 8, 11\"", eval("a.join(', ')", scope));
+    BOOST_CHECK_EQUAL("\"a1b\"", eval("['a', 1, nil, 'b'].join('')", scope));
+    BOOST_CHECK_EQUAL("\"\"", eval("[].join(', ')", scope));
 }
 BOOST_AUTO_TEST_CASE(rotate)
 {
@@ -296,6 +318,9 @@ BOOST_AUTO_TEST_CASE(uniq)
     Scope scope(create_view_model());
     scope.set("a", make_array({ make_value("5"), make_value(5.0), make_value(5.0), make_value("z") }));
     BOOST_CHECK_EQUAL("[\"5\", 5, \"z\"]", eval("a.uniq", scope));
+    BOOST_CHECK_EQUAL("[\"5\", \"z\"]", eval("a.uniq{|x| x.to_s}", scope));
+    BOOST_CHECK_EQUAL("[0, 1, 2]", eval("(0...50).map{|x| x % 3}.uniq", scope));
+    BOOST_CHECK_EQUAL("[0, 1]", eval("(0...50).to_a.uniq{|x| x % 7 == 0 ? 0 : 1}", scope));
 }
 
 BOOST_AUTO_TEST_CASE(enumerate)
@@ -324,6 +349,88 @@ BOOST_AUTO_TEST_CASE(enumerate)
     BOOST_CHECK_EQUAL("[3, 2, 1]", data->check());
 }
 
+BOOST_AUTO_TEST_CASE(packed_numbers)
+{
+    auto model = create_view_model();
+    model->set_attr("d", make_number_array(std::vector<double>{ 2.5, -1, 7.25, 3 }));
+    model->set_attr("i", make_number_array(std::vector<long long>{ 5, 9007199254740993LL, -3, 5 }));
+    model->set_attr("e", make_number_array(std::vector<long long>{}));
+
+    BOOST_CHECK_EQUAL("[2.5, -1, 7.25, 3]", eval(model, "@d"));
+    BOOST_CHECK_EQUAL("[5, 9007199254740993, -3, 5]", eval(model, "@i"));
+    BOOST_CHECK_EQUAL("4", eval(model, "@d.size"));
+    BOOST_CHECK_EQUAL("11.75", eval(model, "@d.sum"));
+    BOOST_CHECK_EQUAL("9007199254741000", eval(model, "@i.sum"));
+    BOOST_CHECK_EQUAL("0", eval(model, "@e.sum"));
+    BOOST_CHECK_EQUAL("-1", eval(model, "@d.min"));
+    BOOST_CHECK_EQUAL("7.25", eval(model, "@d.max"));
+    BOOST_CHECK_EQUAL("[-3, 9007199254740993]", eval(model, "@i.minmax"));
+    BOOST_CHECK_EQUAL("nil", eval(model, "@e.min"));
+    BOOST_CHECK_EQUAL("[-1, 2.5, 3, 7.25]", eval(model, "@d.sort"));
+    BOOST_CHECK_EQUAL("[-3, 5, 5, 9007199254740993]", eval(model, "@i.sort"));
+    BOOST_CHECK_EQUAL("true", eval(model, "@i.include? 9007199254740993"));
+    BOOST_CHECK_EQUAL("false", eval(model, "@i.include? 9007199254740992"));
+    BOOST_CHECK_EQUAL("true", eval(model, "@i.include? 5.0"));
+    BOOST_CHECK_EQUAL("false", eval(model, "@i.include? 5.5"));
+    BOOST_CHECK_EQUAL("true", eval(model, "@d.include? 3"));
+    BOOST_CHECK_EQUAL("false", eval(model, "@d.include? '3'"));
+    //read only methods create the elements as they go
+    BOOST_CHECK_EQUAL("\"2.5,-1,7.25,3\"", eval(model, "@d.join(',')"));
+    BOOST_CHECK_EQUAL("[5, -3]", eval(model, "@i.map{|x| x < 0 ? x : 5}.uniq"));
+    BOOST_CHECK_EQUAL("true", eval(model, "@d == [2.5, -1, 7.25, 3]"));
+    BOOST_CHECK_EQUAL("false", eval(model, "@d == @i"));
+    BOOST_CHECK_EQUAL("[2.5, -1, 7.25, 3, 5, 9007199254740993, -3, 5]", eval(model, "@d + @i"));
+    BOOST_CHECK_EQUAL("[5, -3, 9007199254740993, 5, 5]", eval(model, "@i.reverse + @i.first(1)"));
+    BOOST_CHECK_EQUAL("[9007199254740993]", eval(model, "@i - [5, -3]"));
+    BOOST_CHECK_EQUAL("[-3, 5]", eval(model, "@i.last(2)"));
+    auto packed = make_number_array(std::vector<long long>{ 1, 2 });
+    auto joined = coerce<Array>(packed->add(packed.get()));
+    BOOST_CHECK(joined->numbers() && joined->numbers()->kind == PackedNumbers::INTS);
+    BOOST_CHECK_EQUAL("[1, 2, 1, 2]", joined->inspect());
+
+    //found from the elements, including a mix of Integer and Number
+    BOOST_CHECK_EQUAL("10", eval("[1, 2, 3, 4].sum"));
+    BOOST_CHECK_EQUAL("6.5", eval("[1, 2.5, 3].sum"));
+    BOOST_CHECK_EQUAL("15.5", eval("[1, 2.5, 3].sum(9)"));
+    BOOST_CHECK_EQUAL("12", eval("[1, 2, 3].sum{|x| x * 2}"));
+    BOOST_CHECK_EQUAL("\"abc\"", eval("['b', 'c'].sum('a')"));
+    BOOST_CHECK_THROW(eval("['b', 'c'].sum"), TypeError);
+    BOOST_CHECK_EQUAL("9.22337e+18", eval("[9223372036854775807, 1].sum"));
+    BOOST_CHECK_EQUAL("[1, 2.5, 3]", eval("[3, 2.5, 1].sort"));
+    BOOST_CHECK_EQUAL("[1, 5.5]", eval("[5.5, 1, 3].minmax"));
+    BOOST_CHECK_EQUAL("true", eval("[5.5, 1, 3].include?(1.0)"));
+    BOOST_CHECK_EQUAL("true", eval("[1, 'x'].include?('x')"));
+    BOOST_CHECK_EQUAL("1", eval("[1, 0.0/0.0].min"));
+
+    //push_back stays packed until a value of another kind, then boxes once
+    auto arr = make_number_array(std::vector<long long>{ 1, 2 });
+    arr->push_back(make_value(5));
+    BOOST_CHECK(arr->is_packed());
+    BOOST_CHECK(arr->numbers() && arr->numbers()->kind == PackedNumbers::INTS);
+    arr->push_back(make_value(0.5));
+    BOOST_CHECK(!arr->is_packed());
+    BOOST_CHECK(arr->numbers() && arr->numbers()->kind == PackedNumbers::MIXED);
+    BOOST_CHECK_EQUAL("[1, 2, 5, 0.5]", arr->inspect());
+    arr->push_back(make_value("x"));
+    BOOST_CHECK(!arr->numbers());
+    BOOST_CHECK_EQUAL("[1, 2, 5, 0.5, \"x\"]", arr->inspect());
+    auto arr2 = create_object<Array>();
+    arr2->push_back(make_value(1.5));
+    arr2->push_back(make_value(-2.0));
+    BOOST_CHECK(arr2->is_packed());
+    BOOST_CHECK(arr2->numbers() && arr2->numbers()->kind == PackedNumbers::DOUBLES);
+    BOOST_CHECK_EQUAL("[1.5, -2]", arr2->inspect());
+    BOOST_CHECK_EQUAL("1.5--2", arr2->join(make_value("-").get())->get_value());
+    BOOST_CHECK(arr2->is_packed());
+    BOOST_CHECK_EQUAL(2U, arr2->get_value().size());
+    BOOST_CHECK(!arr2->is_packed());
+    BOOST_CHECK(arr2->numbers() && arr2->numbers()->kind == PackedNumbers::DOUBLES);
+    auto arr3 = create_object<Array>();
+    arr3->push_back(make_value("x"));
+    arr3->push_back(make_value(1));
+    BOOST_CHECK(!arr3->is_packed());
+    BOOST_CHECK(!arr3->numbers());
+}
 
 BOOST_AUTO_TEST_SUITE_END()
 
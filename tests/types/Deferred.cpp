@@ -0,0 +1,48 @@
+#include <boost/test/unit_test.hpp>
+#include "expression/Parser.hpp"
+#include "expression/Ast.hpp"
+#include "expression/Lexer.hpp"
+#include "expression/Scope.hpp"
+#include "types/Deferred.hpp"
+#include "types/ViewModel.hpp"
+#include "Error.hpp"
+#include "Value.hpp"
+#include <stdexcept>
+
+using namespace slim;
+using namespace slim::expr;
+BOOST_AUTO_TEST_SUITE(TestDeferred)
+
+std::string eval(const std::string &str, ObjectPtr deferred)
+{
+    auto model = create_view_model();
+    model->set_attr("x", deferred);
+    Scope scope(model);
+    Lexer lexer(str);
+    expr::LocalVarNames vars;
+    Parser parser(vars, lexer);
+    auto expr = parser.full_expression();
+    return expr->eval(scope)->inspect();
+}
+
+BOOST_AUTO_TEST_CASE(value)
+{
+    auto five = make_deferred([]{ return make_value(5.0); });
+    BOOST_CHECK_EQUAL("5", eval("@x", five));
+    BOOST_CHECK_EQUAL("5", eval("@x.value", five));
+    BOOST_CHECK_EQUAL("10", eval("@x.value * 2", five));
+    BOOST_CHECK_EQUAL("true", eval("@x.ready?", five));
+    BOOST_CHECK_EQUAL("\"5\"", eval("\"#{@x}\"", five));
+    BOOST_CHECK_EQUAL("Deferred", five->type_name());
+
+    auto nested = make_deferred([five]() -> ObjectPtr { return five; });
+    BOOST_CHECK_EQUAL("5", eval("@x.value", nested));
+
+    auto no = make_deferred([]{ return make_value(false); });
+    BOOST_CHECK_EQUAL("2", eval("@x ? 1 : 2", no));
+
+    auto fails = make_deferred([]() -> ObjectPtr { throw std::runtime_error("failed"); });
+    BOOST_CHECK_THROW(eval("@x.value", fails), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
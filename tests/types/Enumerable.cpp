@@ -52,6 +52,15 @@ BOOST_AUTO_TEST_CASE(any)
     BOOST_CHECK_EQUAL("false", eval("[5, 5].any? {|x| x != 5}"));
 }
 
+BOOST_AUTO_TEST_CASE(chunk_while)
+{
+    BOOST_CHECK_EQUAL("[]", eval("[].each.chunk_while{|a, b| b == a + 1}"));
+    BOOST_CHECK_EQUAL("[[1, 2], [4], [9, 10, 11, 12], [15, 16], [19, 20, 21]]",
+        eval("[1, 2, 4, 9, 10, 11, 12, 15, 16, 19, 20, 21].each.chunk_while{|a, b| b == a + 1}"));
+    BOOST_CHECK_EQUAL("[[1, 2, 4], [9, 10, 11, 12, 15, 16, 19, 20, 21]]",
+        eval("[1, 2, 4, 9, 10, 11, 12, 15, 16, 19, 20, 21].each.slice_when{|a, b| a + 3 < b}"));
+}
+
 BOOST_AUTO_TEST_CASE(count)
 {
     BOOST_CHECK_EQUAL("0", eval("[].count"));
@@ -84,6 +93,24 @@ BOOST_AUTO_TEST_CASE(drop_while)
     BOOST_CHECK_EQUAL("[5, 3, 2]", eval("[1,2,3,5,3,2].each.drop_while {|x| x < 5}"));
 }
 
+BOOST_AUTO_TEST_CASE(each_cons)
+{
+    BOOST_CHECK_EQUAL("[]", eval("[1, 2].each.each_cons(3).to_a"));
+    BOOST_CHECK_EQUAL("[[1, 2], [2, 3], [3, 4]]", eval("[1, 2, 3, 4].each.each_cons(2).to_a"));
+    BOOST_CHECK_EQUAL("[3, 5, 7]", eval("[1, 2, 3, 4].each.each_cons(2).map{|a| a.sum}"));
+    BOOST_CHECK_EQUAL("[1, 2, 3]", eval("[1, 2, 3].each_cons(2){|a| a}"));
+    BOOST_CHECK_THROW(eval("[1, 2].each_cons(0){|a| a}"), ArgumentError);
+}
+
+BOOST_AUTO_TEST_CASE(each_slice)
+{
+    BOOST_CHECK_EQUAL("[]", eval("[].each.each_slice(2).to_a"));
+    BOOST_CHECK_EQUAL("[[1, 2], [3, 4], [5]]", eval("[1, 2, 3, 4, 5].each.each_slice(2).to_a"));
+    BOOST_CHECK_EQUAL("[[1, 2, 3]]", eval("[1, 2, 3].each_slice(5).to_a"));
+    BOOST_CHECK_EQUAL("[3, 7, 5]", eval("[1, 2, 3, 4, 5].each_slice(2).map{|a| a.sum}"));
+    BOOST_CHECK_THROW(eval("[1, 2].each_slice(0){|a| a}"), ArgumentError);
+}
+
 BOOST_AUTO_TEST_CASE(each_with_index)
 {
     BOOST_CHECK_EQUAL("[]", eval("[].each_with_index.to_a"));
@@ -175,6 +202,8 @@ BOOST_AUTO_TEST_CASE(include_q)
     BOOST_CHECK_EQUAL("false", eval("[1, -5, 3].include? 5"));
     BOOST_CHECK_EQUAL("true", eval("[1, -5, 5, 3].include? 5"));
     BOOST_CHECK_EQUAL("true", eval("[1, -5, 5, 3].member? 5"));
+    BOOST_CHECK_EQUAL("true", eval("[1, -5, 5, 3].each.include? 5"));
+    BOOST_CHECK_EQUAL("false", eval("[1, -5, 5, 3].each.include? '5'"));
 }
 
 BOOST_AUTO_TEST_CASE(map)
@@ -204,6 +233,15 @@ BOOST_AUTO_TEST_CASE(max)
     BOOST_CHECK_EQUAL("[6, -5]", eval("[4, -5, 6, 3].max 2 {|a, b| a.abs <=> b.abs}"));
 }
 
+BOOST_AUTO_TEST_CASE(max_n)
+{
+    BOOST_CHECK_EQUAL("[19, 18, 17, 16]", eval("(0...20).map{|x| (x * 7) % 20}.each.max 4"));
+    BOOST_CHECK_EQUAL("[0, 1, 2, 3]", eval("(0...20).map{|x| (x * 7) % 20}.each.min 4"));
+    //equal elements keep their order
+    BOOST_CHECK_EQUAL("[-3, 3, -3, 2]", eval("[1, -3, 2, 3, 0, -3].max_by(4){|x| x.abs}"));
+    BOOST_CHECK_EQUAL("[0, 1, 2, -3]", eval("[1, -3, 2, 3, 0, -3].min_by(4){|x| x.abs}"));
+}
+
 BOOST_AUTO_TEST_CASE(max_by)
 {
     BOOST_CHECK_EQUAL("nil", eval("[].max_by{|x| x.abs}"));
@@ -329,6 +367,22 @@ BOOST_AUTO_TEST_CASE(select)
     BOOST_CHECK_EQUAL("[[3, 2], [7, 3]]", eval("[1, 5, 3, 7].each_with_index.select{|x, i| i > 1}"));
 }
 
+BOOST_AUTO_TEST_CASE(sum)
+{
+    BOOST_CHECK_EQUAL("0", eval("[].each.sum"));
+    BOOST_CHECK_EQUAL("10", eval("[1, 2, 3, 4].each.sum"));
+    BOOST_CHECK_EQUAL("12.5", eval("[1, 2, 3, 4].each.sum(2.5)"));
+    BOOST_CHECK_EQUAL("20", eval("[1, 2, 3, 4].each.sum{|x| x * 2}"));
+    BOOST_CHECK_EQUAL("\"abc\"", eval("['a', 'b', 'c'].each.sum('')"));
+    BOOST_CHECK_EQUAL("15", eval("(1..5).sum"));
+}
+
+BOOST_AUTO_TEST_CASE(tally)
+{
+    BOOST_CHECK_EQUAL("{}", eval("[].each.tally"));
+    BOOST_CHECK_EQUAL("{\"a\" => 2, \"b\" => 1, 1 => 3}", eval("['a', 'b', 1, 'a', 1, 1].each.tally"));
+}
+
 BOOST_AUTO_TEST_CASE(take)
 {
     //NOTE: Array overrides Enumerable::take implementation
@@ -378,5 +432,22 @@ BOOST_AUTO_TEST_CASE(to_h)
     BOOST_CHECK_THROW(eval("[[1, 2, 3]].to_h"), ArgumentError);
 }
 
+BOOST_AUTO_TEST_CASE(uniq)
+{
+    BOOST_CHECK_EQUAL("[]", eval("[].each.uniq"));
+    BOOST_CHECK_EQUAL("[1, 2, 3]", eval("[1, 2, 1, 3, 2].each.uniq"));
+    BOOST_CHECK_EQUAL("[1, -2, 3]", eval("[1, -2, -1, 3, 2].each.uniq{|x| x.abs}"));
+}
+
+BOOST_AUTO_TEST_CASE(zip)
+{
+    BOOST_CHECK_EQUAL("[]", eval("[].each.zip([1])"));
+    BOOST_CHECK_EQUAL("[[1], [2]]", eval("[1, 2].each.zip"));
+    BOOST_CHECK_EQUAL("[[1, 4, 7], [2, 5, nil], [3, nil, nil]]", eval("[1, 2, 3].zip([4, 5], [7])"));
+    BOOST_CHECK_EQUAL("[[1, 3], [2, 4]]", eval("[1, 2].zip(3..4)"));
+    BOOST_CHECK_EQUAL("nil", eval("[1, 2].zip([3, 4]){|a| a}"));
+    BOOST_CHECK_THROW(eval("[1, 2].zip(5)"), TypeError);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
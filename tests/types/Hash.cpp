@@ -8,6 +8,7 @@
 #include "types/Number.hpp"
 #include "types/String.hpp"
 #include "Error.hpp"
+#include <thread>
 
 using namespace slim;
 using namespace slim::expr;
@@ -161,5 +162,176 @@ BOOST_AUTO_TEST_CASE(each)
     BOOST_CHECK_EQUAL("[7, 2, 7]", eval("{5 => 7, 3 => 2, 1 => 7}.each_value.to_a"));
 }
 
+BOOST_AUTO_TEST_CASE(shapes)
+{
+    auto a = make_hash({ symbol("id"), make_value(1), symbol("name"), make_value("a") });
+    auto b = make_hash({ symbol("id"), make_value(2), symbol("name"), make_value("b") });
+    auto c = make_hash({ symbol("name"), make_value("c"), symbol("id"), make_value(3) });
+    BOOST_REQUIRE(a->get_shape());
+    BOOST_CHECK(a->get_shape() == b->get_shape());
+    BOOST_CHECK(a->get_shape() != c->get_shape());
+    BOOST_CHECK(a->dup()->get_shape() == a->get_shape());
+    BOOST_CHECK_EQUAL("true", eval("{id: 1, name: 'a'} == {name: 'a', id: 1}"));
+    BOOST_CHECK_EQUAL("true", eval("{id: 1, name: 'a'}.hash == {name: 'a', id: 1}.hash"));
+    BOOST_CHECK_EQUAL("false", eval("{id: 1, name: 'a'} == {id: 1, name: 'b'}"));
+
+    //non-symbol key switches to a table, keeping the order
+    b->set(make_value("id"), make_value(5));
+    BOOST_CHECK(!b->get_shape());
+    BOOST_CHECK_EQUAL("{:id => 2, :name => \"b\", \"id\" => 5}", b->inspect());
+    BOOST_CHECK_EQUAL("{:id => 1, \"name\" => \"a\", :x => 2}", eval("{id: 1, 'name' => 'a'}.merge({x: 2})"));
+    BOOST_CHECK_EQUAL("{:name => \"a\", :id => 1, \"name\" => \"a\"}", eval("{name: 'a', id: 1}.merge({'name' => 'a'})"));
+    BOOST_CHECK_EQUAL("nil", eval("{id: 1}['id']"));
+    BOOST_CHECK_EQUAL("true", eval("{id: 1}.key? :id"));
+    BOOST_CHECK_EQUAL("false", eval("{id: 1}.key? 'id'"));
+
+    //many keys
+    auto d = create_object<Hash>();
+    for (int i = 0; i < 100; ++i) d->set(symbol("shape_key_" + std::to_string(i)), make_value(i));
+    BOOST_CHECK(!d->get_shape());
+    BOOST_CHECK_EQUAL("99", d->get(symbol("shape_key_99"))->inspect());
+    BOOST_CHECK_EQUAL("0", d->get(symbol("shape_key_0"))->inspect());
+}
+
+BOOST_AUTO_TEST_CASE(shape_threads)
+{
+    //threads adding the same new transitions at once all get the same shapes
+    std::vector<SymPtr> keys;
+    for (int i = 0; i < 8; ++i) keys.push_back(symbol("shape_thread_" + std::to_string(i)));
+    const int THREADS = 4, ROUNDS = 200;
+    std::vector<std::vector<const HashShape*>> found(THREADS);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < THREADS; ++t)
+    {
+        threads.emplace_back([&keys, &found, t]()
+        {
+            for (int r = 0; r < ROUNDS; ++r)
+            {
+                auto hash = create_object<Hash>();
+                //the key order depends on the round, giving several branches from each shape
+                for (size_t k = 0; k < keys.size(); ++k)
+                    hash->set(keys[(k * (r % 3 + 1) + r) % keys.size()], make_value(r));
+                found[t].push_back(hash->get_shape());
+            }
+        });
+    }
+    for (auto &thread : threads) thread.join();
+    for (int t = 1; t < THREADS; ++t) BOOST_CHECK(found[t] == found[0]);
+}
+
+BOOST_AUTO_TEST_CASE(shape_inline_cache)
+{
+    //same call site seeing different shapes, a missing key and non-hash values
+    BOOST_CHECK_EQUAL("[1, 2, 3, nil, 5, 6]", eval(
+        "[{id: 1, name: 'a'}, {id: 2, name: 'b'}, {name: 'c', id: 3}, {name: 'd'}, {'id' => 4, id: 5}, {id: 6, name: 'f'}]"
+        ".map{|x| x[:id]}"));
+}
+
+BOOST_AUTO_TEST_CASE(shared)
+{
+    std::vector<ObjectPtr> kv;
+    for (int i = 0; i < 10; ++i)
+    {
+        kv.push_back(symbol("k" + std::to_string(i)));
+        kv.push_back(make_value(i));
+    }
+    auto a = make_hash(kv);
+    auto a_str = a->inspect();
+
+    auto b = a->dup();
+    BOOST_CHECK_EQUAL(a_str, b->inspect());
+    BOOST_CHECK(b->get_shape() && b->get_shape() == a->get_shape());
+    BOOST_CHECK(a->eq(b.get()));
+    BOOST_CHECK_EQUAL(a->hash(), b->hash());
+    b->set(symbol("k1"), make_value("x"));
+    b->set(make_value("new"), TRUE_VALUE);
+    BOOST_CHECK_EQUAL(a_str, a->inspect());
+    BOOST_CHECK_EQUAL(
+        "{:k0 => 0, :k1 => \"x\", :k2 => 2, :k3 => 3, :k4 => 4, :k5 => 5, :k6 => 6, :k7 => 7, :k8 => 8, :k9 => 9, \"new\" => true}",
+        b->inspect());
+    BOOST_CHECK_EQUAL("\"x\"", b->get(symbol("k1"))->inspect());
+    BOOST_CHECK_EQUAL("9", b->get(symbol("k9"))->inspect());
+    BOOST_CHECK_EQUAL("11", b->size()->inspect());
+    BOOST_CHECK(!a->eq(b.get()));
+    BOOST_CHECK(!b->get_shape());
+
+    //a dup of a dup shares the same base, and each side keeps its own writes
+    auto c = b->dup();
+    BOOST_CHECK(b->eq(c.get()));
+    a->set(symbol("k0"), NIL_VALUE);
+    c->set(symbol("k2"), make_value("c"));
+    BOOST_CHECK_EQUAL("nil", a->get(symbol("k0"))->inspect());
+    BOOST_CHECK_EQUAL("2", a->get(symbol("k2"))->inspect());
+    BOOST_CHECK_EQUAL("0", b->get(symbol("k0"))->inspect());
+    BOOST_CHECK_EQUAL("2", b->get(symbol("k2"))->inspect());
+    BOOST_CHECK_EQUAL("0", c->get(symbol("k0"))->inspect());
+    BOOST_CHECK_EQUAL("\"c\"", c->get(symbol("k2"))->inspect());
+    BOOST_CHECK_EQUAL("\"x\"", c->get(symbol("k1"))->inspect());
+    BOOST_CHECK_EQUAL("1", a->get(symbol("k1"))->inspect());
+    BOOST_CHECK_EQUAL("10", a->size()->inspect());
+    b.reset();
+    c.reset();
+    BOOST_CHECK_EQUAL("nil", a->get(symbol("k0"))->inspect());
+
+    //locals
+    auto d = a->merge(make_hash({ symbol("k3"), make_value(30), symbol("x"), make_value(40) }).get());
+    Scope scope(create_view_model());
+    scope.set(d.get());
+    BOOST_CHECK_EQUAL("[nil, 30, 9, 40]", eval("[k0, k3, k9, x]", scope));
+    BOOST_CHECK_EQUAL("11", d->size()->inspect());
+    BOOST_CHECK_EQUAL("[:k0, :k1, :k2, :k3, :k4, :k5, :k6, :k7, :k8, :k9, :x]", d->keys()->inspect());
+
+    //overlay larger than base is flattened
+    for (int i = 0; i < 20; ++i) d->set(symbol("d" + std::to_string(i)), make_value(i));
+    BOOST_CHECK_EQUAL("31", d->size()->inspect());
+    BOOST_CHECK_EQUAL("19", d->get(symbol("d19"))->inspect());
+    BOOST_CHECK_EQUAL("30", d->get(symbol("k3"))->inspect());
+    a->set(symbol("k0"), make_value(0));
+}
+
+BOOST_AUTO_TEST_CASE(shared_threads)
+{
+    //dup and merge only read the source, so threads can use one hash at once
+    std::vector<ObjectPtr> kv;
+    for (int i = 0; i < 20; ++i)
+    {
+        kv.push_back(symbol("k" + std::to_string(i)));
+        kv.push_back(make_value(i));
+    }
+    auto shared = make_hash(kv);
+    auto shared_str = shared->inspect();
+    const int THREADS = 4, ROUNDS = 500;
+    std::vector<int> failures(THREADS, 0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < THREADS; ++t)
+    {
+        threads.emplace_back([&shared, &failures, t]()
+        {
+            auto small = make_hash({ symbol("k3"), make_value(-t), symbol("row"), make_value(t) });
+            for (int r = 0; r < ROUNDS; ++r)
+            {
+                auto merged = shared->merge(small.get());
+                auto copy = shared->dup();
+                copy->set(symbol("k5"), make_value(r));
+                if (!merged->get(symbol("k3"))->eq(make_value(-t).get())) ++failures[t];
+                if (!merged->get(symbol("row"))->eq(make_value(t).get())) ++failures[t];
+                if (!merged->get(symbol("k19"))->eq(make_value(19).get())) ++failures[t];
+                if (!copy->get(symbol("k5"))->eq(make_value(r).get())) ++failures[t];
+                if (!shared->get(symbol("k5"))->eq(make_value(5).get())) ++failures[t];
+                if (as_number(shared->size()) != 20 || as_number(merged->size()) != 21) ++failures[t];
+            }
+        });
+    }
+    for (auto &thread : threads) thread.join();
+    for (int t = 0; t < THREADS; ++t) BOOST_CHECK_EQUAL(0, failures[t]);
+    BOOST_CHECK_EQUAL(shared_str, shared->inspect());
+
+    //the source copies its entries before its own next change
+    auto merged = shared->merge(make_hash({ symbol("x"), TRUE_VALUE }).get());
+    shared->set(symbol("k0"), make_value("changed"));
+    BOOST_CHECK_EQUAL("0", merged->get(symbol("k0"))->inspect());
+    BOOST_CHECK_EQUAL("\"changed\"", shared->get(symbol("k0"))->inspect());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
@@ -10,15 +10,24 @@ using namespace slim;
 using namespace slim::expr;
 BOOST_AUTO_TEST_SUITE(TestNumber)
 
-std::string eval(const std::string &str, Scope &scope)
+ObjectPtr eval_obj(const std::string &str, Scope &scope)
 {
     Lexer lexer(str);
     expr::LocalVarNames vars;
     for (auto x : scope) vars.add(x.first->str());
     Parser parser(vars, lexer);
     auto expr = parser.full_expression();
-    auto result = expr->eval(scope);
-    return result->inspect();
+    return expr->eval(scope);
+}
+std::string eval(const std::string &str, Scope &scope)
+{
+    return eval_obj(str, scope)->inspect();
+}
+std::string eval_type(const std::string &str)
+{
+    Scope scope(create_view_model());
+    scope.set("f", make_value(5.0));
+    return eval_obj(str, scope)->type_name();
 }
 std::string eval(const std::string &str)
 {
@@ -100,6 +109,65 @@ BOOST_AUTO_TEST_CASE(operators)
     BOOST_CHECK_EQUAL("-9", eval("~8"));
 }
 
+BOOST_AUTO_TEST_CASE(integer)
+{
+    Scope scope(create_view_model());
+    scope.set("f", make_value(5.0));
+    BOOST_CHECK_EQUAL("Integer", make_value(5)->type_name());
+    BOOST_CHECK_EQUAL("Integer", eval_type("5"));
+    BOOST_CHECK_EQUAL("Number", eval_type("5.0"));
+    BOOST_CHECK_EQUAL("Integer", eval_type("5.5.to_i"));
+    BOOST_CHECK_EQUAL("Number", eval_type("5.to_f"));
+
+    //exact above 2^53
+    BOOST_CHECK_EQUAL("9007199254740993", eval("9007199254740992 + 1"));
+    BOOST_CHECK_EQUAL("9223372036854775807", eval("9223372036854775807"));
+    BOOST_CHECK_EQUAL("1234567890123", eval("1234567890123"));
+    BOOST_CHECK_EQUAL("-9223372036854775807", eval("-9223372036854775807"));
+    BOOST_CHECK_EQUAL("4611686018427387904", eval("2 ** 62"));
+    BOOST_CHECK_EQUAL("1152921504606846976", eval("1 << 60"));
+    BOOST_CHECK_EQUAL("-1", eval("-1 >> 70"));
+    BOOST_CHECK_EQUAL("1125899906842623", eval("(1 << 50) - 1 & -1"));
+
+    //overflow gives a Number
+    BOOST_CHECK_EQUAL("Number", eval_type("9223372036854775807 + 1"));
+    BOOST_CHECK_EQUAL("9.22337e+18", eval("9223372036854775807 + 1"));
+    BOOST_CHECK_EQUAL("Number", eval_type("2 ** 64"));
+    BOOST_CHECK_EQUAL("Number", eval_type("3037000500 * 3037000500"));
+    BOOST_CHECK_EQUAL("Number", eval_type("1 << 64"));
+    BOOST_CHECK_EQUAL("1.84467e+19", eval("1 << 64"));
+    BOOST_CHECK_EQUAL("Number", eval_type("99999999999999999999"));
+
+    //division is only Integer if exact
+    BOOST_CHECK_EQUAL("Integer", eval_type("24 / 4"));
+    BOOST_CHECK_EQUAL("3.5", eval("7 / 2"));
+    BOOST_CHECK_EQUAL("inf", eval("1 / 0"));
+    BOOST_CHECK_EQUAL("-9007199254740993", eval("9007199254740993 / -1"));
+    BOOST_CHECK_EQUAL("Integer", eval_type("9007199254740993 / -1"));
+    BOOST_CHECK_EQUAL("Number", eval_type("(-9223372036854775807 - 1) / -1"));
+    BOOST_CHECK_EQUAL("9.22337e+18", eval("(-9223372036854775807 - 1) / -1"));
+    BOOST_CHECK_EQUAL("-1", eval("-7 % 3"));
+    BOOST_CHECK_EQUAL("0.5", eval("2 ** -1"));
+
+    //mixed with Number
+    BOOST_CHECK_EQUAL("7.5", eval("5 + 2.5"));
+    BOOST_CHECK_EQUAL("Number", eval_type("f + 1"));
+    BOOST_CHECK_EQUAL("true", eval("f == 5", scope));
+    BOOST_CHECK_EQUAL("true", eval("5 == f", scope));
+    BOOST_CHECK_EQUAL("true", eval("4 < f", scope));
+    BOOST_CHECK_EQUAL("true", eval("[5.0, 3, 4.5].sort == [3, 4.5, 5]"));
+    BOOST_CHECK_EQUAL("\"x\"", eval("{5 => 'x'}[5.0]"));
+
+    //sizes, counts and ranges
+    BOOST_CHECK_EQUAL("Integer", eval_type("[1, 2].size"));
+    BOOST_CHECK_EQUAL("Integer", eval_type("'abc'.index('c')"));
+    BOOST_CHECK_EQUAL("Integer", eval_type("(1..2).to_a[1]"));
+    BOOST_CHECK_EQUAL("Integer", eval_type("(1..2).first(2)[1]"));
+    BOOST_CHECK_EQUAL("Number", eval_type("(1.0..2.0).to_a[1]"));
+    BOOST_CHECK_EQUAL("Number", eval_type("(1...2).step(0.5).to_a[1]"));
+    BOOST_CHECK_EQUAL("1234567..1234568", eval("1234567..1234568"));
+}
+
 BOOST_AUTO_TEST_CASE(rounding)
 {
     BOOST_CHECK_EQUAL("0", eval("0.ceil"));
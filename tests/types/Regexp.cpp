@@ -71,6 +71,62 @@ BOOST_AUTO_TEST_CASE(misc)
 
 }
 
+BOOST_AUTO_TEST_CASE(options)
+{
+    BOOST_CHECK_EQUAL("true", eval("Regexp.new('a b # c', Regexp::EXTENDED).match('ab') != nil"));
+    BOOST_CHECK_EQUAL("false", eval("Regexp.new('a.b').match(\"a\\nb\") != nil"));
+    BOOST_CHECK_EQUAL("true", eval("Regexp.new('a.b', Regexp::MULTILINE).match(\"a\\nb\") != nil"));
+    //back references are not supported by the built in engine
+    BOOST_CHECK_EQUAL("\"aa\"", eval("Regexp.new('(a)\\\\1').match('xaa').to_s"));
+}
+
+BOOST_AUTO_TEST_CASE(anchors)
+{
+    //the same anchors with the built in engine, and with std::regex for lookahead
+    BOOST_CHECK_EQUAL("3", eval("\"ab\\ncd\".index(Regexp.new('^cd'))"));
+    BOOST_CHECK_EQUAL("3", eval("\"ab\\ncd\".index(Regexp.new('^(?=c)cd'))"));
+    BOOST_CHECK_EQUAL("1", eval("\"ab\\ncd\".index(Regexp.new('b$'))"));
+    BOOST_CHECK_EQUAL("1", eval("\"ab\\ncd\".index(Regexp.new('(?=b)b$'))"));
+    BOOST_CHECK_EQUAL("6", eval("\"ab\\ncd\\ncd\".rindex(Regexp.new('^cd'))"));
+    BOOST_CHECK_EQUAL("6", eval("\"ab\\ncd\\ncd\".rindex(Regexp.new('^(?=c)cd'))"));
+    BOOST_CHECK_EQUAL("nil", eval("\"ab\\ncd\".index(Regexp.new('^b'))"));
+    BOOST_CHECK_EQUAL("nil", eval("\"ab\\ncd\".index(Regexp.new('^(?=b)b'))"));
+}
+
+BOOST_AUTO_TEST_CASE(cache)
+{
+    RegexpCache cache(2);
+    auto a = cache.get("a");
+    BOOST_CHECK_EQUAL(0U, cache.hits());
+    BOOST_CHECK_EQUAL(1U, cache.misses());
+    BOOST_CHECK(a == cache.get("a"));
+    BOOST_CHECK(a != cache.get("a", Regexp::IGNORECASE));
+    BOOST_CHECK_EQUAL(1U, cache.hits());
+    BOOST_CHECK_EQUAL(2U, cache.misses());
+    BOOST_CHECK_EQUAL(2U, cache.size());
+
+    //"a" was used most recently, so adding "b" discards "a"/i
+    BOOST_CHECK(a == cache.get("a"));
+    cache.get("b");
+    BOOST_CHECK_EQUAL(2U, cache.size());
+    BOOST_CHECK(a == cache.get("a"));
+    BOOST_CHECK_EQUAL(3U, cache.misses());
+    cache.get("a", Regexp::IGNORECASE);
+    BOOST_CHECK_EQUAL(4U, cache.misses());
+
+    BOOST_CHECK_THROW(cache.get("(a)\\"), std::regex_error);
+    BOOST_CHECK_EQUAL(2U, cache.size());
+
+    cache.clear();
+    BOOST_CHECK_EQUAL(0U, cache.size());
+    BOOST_CHECK_EQUAL(0U, cache.hits());
+
+    //interpolated literals and string patterns use the shared cache
+    auto hits = RegexpCache::instance().hits();
+    BOOST_CHECK_EQUAL("\"ab\"", eval("/a#{'b'}/.match('xab').to_s"));
+    BOOST_CHECK_EQUAL("\"ab\"", eval("/a#{'b'}/.match('yab').to_s"));
+    BOOST_CHECK_EQUAL(hits + 1, RegexpCache::instance().hits());
+}
 
 BOOST_AUTO_TEST_CASE(data_eq)
 {
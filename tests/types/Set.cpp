@@ -0,0 +1,88 @@
+#include <boost/test/unit_test.hpp>
+#include "expression/Parser.hpp"
+#include "expression/Ast.hpp"
+#include "expression/Lexer.hpp"
+#include "expression/Scope.hpp"
+#include "types/Set.hpp"
+#include "Error.hpp"
+
+using namespace slim;
+using namespace slim::expr;
+BOOST_AUTO_TEST_SUITE(TestSet)
+
+std::string eval(const std::string &str)
+{
+    Lexer lexer(str);
+    expr::LocalVarNames vars;
+    Parser parser(vars, lexer);
+    auto expr = parser.full_expression();
+    auto model = create_view_model();
+    model->add_constant("Set", create_object<SetType>());
+    Scope scope(model);
+    return expr->eval(scope)->inspect();
+}
+
+BOOST_AUTO_TEST_CASE(create)
+{
+    BOOST_CHECK_EQUAL("#<Set: {}>", eval("Set.new"));
+    BOOST_CHECK_EQUAL("#<Set: {1, 2, 3}>", eval("Set.new([1, 2, 1, 3, 2])"));
+    BOOST_CHECK_EQUAL("#<Set: {1, 2, 3}>", eval("Set.new(1..3)"));
+    BOOST_CHECK_EQUAL("#<Set: {1, \"1\"}>", eval("Set[1, '1', 1]"));
+    BOOST_CHECK_EQUAL("#<Set: {1, 2}>", eval("[1, 2, 2, 1].to_set"));
+    BOOST_CHECK_EQUAL("#<Set: {1, 2}>", eval("Set[1, 2].to_set"));
+    BOOST_CHECK_EQUAL("[2, 1]", eval("Set[2, 1, 2].to_a"));
+    BOOST_CHECK_THROW(eval("Set.new 5"), TypeError);
+    BOOST_CHECK_THROW(eval("Set.new([], [])"), ArgumentCountError);
+}
+
+BOOST_AUTO_TEST_CASE(compare)
+{
+    BOOST_CHECK_EQUAL("true", eval("Set[1, 2] == Set[2, 1]"));
+    BOOST_CHECK_EQUAL("false", eval("Set[1, 2] == Set[1, 2, 3]"));
+    BOOST_CHECK_EQUAL("false", eval("Set[1, 2] == [1, 2]"));
+    BOOST_CHECK_EQUAL("true", eval("Set[1, 2].hash == Set[2, 1].hash"));
+    BOOST_CHECK_EQUAL("2", eval("{Set[1, 2] => 1, Set[2, 1] => 2}[Set[1, 2]]"));
+}
+
+BOOST_AUTO_TEST_CASE(query)
+{
+    BOOST_CHECK_EQUAL("3", eval("Set[1, 2, 3].size"));
+    BOOST_CHECK_EQUAL("3", eval("Set[1, 2, 3].length"));
+    BOOST_CHECK_EQUAL("true", eval("Set.new.empty?"));
+    BOOST_CHECK_EQUAL("false", eval("Set[1].empty?"));
+    BOOST_CHECK_EQUAL("true", eval("Set[1, 2, 3].include? 2"));
+    BOOST_CHECK_EQUAL("false", eval("Set[1, 2, 3].include? '2'"));
+    BOOST_CHECK_EQUAL("true", eval("Set[1, 2, 3].member? 3"));
+    BOOST_CHECK_EQUAL("[2, 4, 6]", eval("Set[1, 2, 3].map{|x| x * 2}"));
+    BOOST_CHECK_EQUAL("6", eval("Set[1, 2, 3].reduce{|a, b| a + b}"));
+}
+
+BOOST_AUTO_TEST_CASE(operators)
+{
+    BOOST_CHECK_EQUAL("#<Set: {1, 2, 3, 4}>", eval("Set[1, 2, 3] | Set[2, 4]"));
+    BOOST_CHECK_EQUAL("#<Set: {1, 2, 3, 4}>", eval("Set[1, 2, 3] + [2, 4]"));
+    BOOST_CHECK_EQUAL("#<Set: {1, 2, 3, 4}>", eval("Set[1, 2, 3].union([4])"));
+    BOOST_CHECK_EQUAL("#<Set: {2}>", eval("Set[1, 2, 3] & [2, 4]"));
+    BOOST_CHECK_EQUAL("#<Set: {2}>", eval("Set[1, 2, 3].intersection(Set[2, 4])"));
+    BOOST_CHECK_EQUAL("#<Set: {1, 3}>", eval("Set[1, 2, 3] - [2, 4]"));
+    BOOST_CHECK_EQUAL("#<Set: {1, 3}>", eval("Set[1, 2, 3].difference([2, 4])"));
+    BOOST_CHECK_EQUAL("#<Set: {1, 3, 4}>", eval("Set[1, 2, 3] ^ [2, 4]"));
+}
+
+BOOST_AUTO_TEST_CASE(subsets)
+{
+    BOOST_CHECK_EQUAL("true", eval("Set[1, 2].subset?(Set[1, 2, 3])"));
+    BOOST_CHECK_EQUAL("true", eval("Set[1, 2].subset?(Set[1, 2])"));
+    BOOST_CHECK_EQUAL("false", eval("Set[1, 4].subset?(Set[1, 2, 3])"));
+    BOOST_CHECK_EQUAL("true", eval("Set[1, 2].proper_subset?(Set[1, 2, 3])"));
+    BOOST_CHECK_EQUAL("false", eval("Set[1, 2].proper_subset?(Set[1, 2])"));
+    BOOST_CHECK_EQUAL("true", eval("Set[1, 2, 3].superset?(Set[1, 2])"));
+    BOOST_CHECK_EQUAL("true", eval("Set[1, 2, 3].proper_superset?(Set[1, 2])"));
+    BOOST_CHECK_EQUAL("false", eval("Set[1, 2].proper_superset?(Set[1, 2])"));
+    BOOST_CHECK_EQUAL("true", eval("Set[1, 2].intersect?([2, 3])"));
+    BOOST_CHECK_EQUAL("false", eval("Set[1, 2].intersect?([3])"));
+    BOOST_CHECK_EQUAL("true", eval("Set[1, 2].disjoint?([3])"));
+    BOOST_CHECK_EQUAL("false", eval("Set[1, 2].disjoint?([2, 3])"));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -148,10 +148,112 @@ BOOST_AUTO_TEST_CASE(scrub)
     BOOST_CHECK_EQUAL("\"a\xEF\xBF\xBD\"", eval("'a\xC2'.scrub"));
     BOOST_CHECK_EQUAL("\"a\xEF\xBF\xBD\xEF\xBF\xBD\"", eval("'a\xC2\xC2'.scrub"));
     BOOST_CHECK_EQUAL("\"a??\"", eval("'a\xC2\xC2'.scrub '?'"));
+    BOOST_CHECK_EQUAL("\"a??\"", eval("'a\xC0\xAF'.scrub '?'"));
+}
+BOOST_AUTO_TEST_CASE(valid_encoding)
+{
+    BOOST_CHECK_EQUAL("true", eval("''.valid_encoding?"));
+    BOOST_CHECK_EQUAL("true", eval("'a\xC2\xA3'.valid_encoding?"));
+    BOOST_CHECK_EQUAL("false", eval("'a\xC2'.valid_encoding?"));
+    BOOST_CHECK_EQUAL("false", eval("'a\xC0\xAF'.valid_encoding?"));
+}
+BOOST_AUTO_TEST_CASE(cached_text_info)
+{
+    auto str = make_value(std::string(100, 'a'));
+    BOOST_CHECK(str->is_ascii());
+    BOOST_CHECK_EQUAL(100U, str->char_length());
+    //slices of ASCII strings are known to be ASCII
+    BOOST_CHECK(str->substr(10, 50)->is_ascii());
+    BOOST_CHECK_EQUAL(50U, str->substr(10, 50)->char_length());
+    //modifying resets the cached values
+    str->get_mutable_value() += "\xC2\xA3";
+    BOOST_CHECK(!str->is_ascii());
+    BOOST_CHECK(str->is_valid_utf8());
+    BOOST_CHECK_EQUAL(101U, str->char_length());
+    str->get_mutable_value() += "\xC2";
+    BOOST_CHECK(!str->is_valid_utf8());
+    BOOST_CHECK_EQUAL(102U, str->char_length());
+}
+BOOST_AUTO_TEST_CASE(char_offset)
+{
+    //1, 2 and 3 byte code points
+    std::string text;
+    std::vector<size_t> offsets;
+    for (int i = 0; i < 300; ++i)
+    {
+        offsets.push_back(text.size());
+        text += i % 3 == 0 ? "a" : i % 3 == 1 ? "\xC2\xA3" : "\xE2\x82\xAC";
+    }
+    auto str = make_value(text);
+    for (size_t i = 0; i < offsets.size(); ++i)
+        BOOST_CHECK_EQUAL(offsets[i], str->char_offset(i));
+    BOOST_CHECK_EQUAL(text.size(), str->char_offset(300));
+    BOOST_CHECK_EQUAL(StringView::npos, str->char_offset(301));
+    BOOST_CHECK_EQUAL("\xC2\xA3\xE2\x82\xAC" "a", str->char_substr(199, 3)->get_value());
+    BOOST_CHECK_EQUAL("\xE2\x82\xAC", str->char_substr(299)->get_value());
+    BOOST_CHECK_EQUAL("", str->char_substr(300)->get_value());
+    BOOST_CHECK(!str->char_substr(301));
+    BOOST_CHECK(!str->char_substr(1000, 2));
+
+    //modifying drops the index
+    str->get_mutable_value().insert(0, "\xC2\xA3");
+    BOOST_CHECK_EQUAL(offsets[200] + 2, str->char_offset(201));
+    BOOST_CHECK_EQUAL(text.size() + 2, str->char_offset(301));
+
+    auto ascii = make_value(std::string(200, 'a'));
+    BOOST_CHECK_EQUAL(150U, ascii->char_offset(150));
+    BOOST_CHECK_EQUAL("aa", ascii->char_substr(198, 10)->get_value());
 }
 
 
 
+BOOST_AUTO_TEST_CASE(concat)
+{
+    BOOST_CHECK_EQUAL("\"ab\"", eval("'a' + 'b'"));
+    BOOST_CHECK_EQUAL("\"ab\"", eval("'a' << 'b'"));
+    BOOST_CHECK_EQUAL("\"abc\"", eval("'a'.concat('b', 'c')"));
+    BOOST_CHECK_EQUAL("\"a\"", eval("'a'.concat"));
+
+    //long results are ropes, extended in place by the latest string
+    std::string expected;
+    ObjectPtr out = make_value("");
+    std::vector<ObjectPtr> history;
+    for (int i = 0; i < 200; ++i)
+    {
+        auto part = make_value("part " + std::to_string(i) + ",");
+        out = out->add(part.get());
+        expected += part->get_value();
+        history.push_back(out);
+    }
+    BOOST_CHECK_EQUAL(expected.size(), coerce<String>(out)->byte_size());
+    BOOST_CHECK_EQUAL(expected, out->to_string());
+    //earlier strings are unchanged, and adding to them starts a new rope
+    auto earlier = history[100];
+    BOOST_CHECK_EQUAL(expected.substr(0, earlier->to_string().size()), earlier->to_string());
+    auto branch = earlier->add(make_value("!").get());
+    BOOST_CHECK_EQUAL(earlier->to_string() + "!", branch->to_string());
+    auto next = out->add(make_value("?").get());
+    BOOST_CHECK_EQUAL(expected + "?", next->to_string());
+    BOOST_CHECK_EQUAL(expected + "?" + expected + "?", next->add(next.get())->to_string());
+    //modifying flattens
+    auto str = coerce<String>(next);
+    str->get_mutable_value() += "x";
+    BOOST_CHECK_EQUAL(expected + "?x", str->to_string());
+    BOOST_CHECK_EQUAL(expected.size() + 2, str->byte_size());
+
+    //adding in front extends the rope the other way, and ropes are never nested
+    ObjectPtr front = make_value(std::string(300, 'L'));
+    auto back = front;
+    for (int i = 0; i < 100; ++i) front = make_value("ab")->add(front.get());
+    for (int i = 0; i < 100; ++i) back = back->add(make_value("ab").get());
+    BOOST_CHECK_EQUAL(expected + "?x" + expected + "?x" + (back->to_string() + front->to_string()),
+        next->add(next.get())->add(back->add(front.get()).get())->to_string());
+    BOOST_CHECK_EQUAL("200300", eval("(1..100000).reduce(''.ljust(300, 'L')){|acc, i| 'ab' + acc}.size"));
+    BOOST_CHECK_EQUAL("nil", eval("(1..100000).reduce(''.ljust(300, 'L')){|acc, i| 'ab' + acc}.index('x')"));
+    BOOST_CHECK_EQUAL("200300", eval("(1..100000).reduce(''.ljust(300, 'L')){|acc, i| acc + 'ab'}.size"));
+    BOOST_CHECK_EQUAL("200300", eval("(1..100000).reduce(''.ljust(300, 'L')){|acc, i| i % 2 == 0 ? acc + 'ab' : 'ab' + acc}.size"));
+}
+
 BOOST_AUTO_TEST_CASE(inspect_escape)
 {
     std::string escaped = "\"\\\\ \\' \\\" \\r \\n \\t\"";
@@ -557,10 +659,70 @@ BOOST_AUTO_TEST_CASE(gsub)
     //regex with block
     BOOST_CHECK_EQUAL("\"test\"", eval("'test'.gsub(/x/){|str| \"-#{str}-\"}"));
     BOOST_CHECK_EQUAL("\"test -x- -x-\"", eval("'test x x'.gsub(/x/){|str| \"-#{str}-\"}"));
+    //empty matches
+    BOOST_CHECK_EQUAL("\"-a--c-\"", eval("'abc'.gsub(/b*/, '-')"));
     //invalid args
     BOOST_CHECK_THROW(eval("'test x'.gsub 'x', 5"), ScriptError);
     BOOST_CHECK_THROW(eval("'test x'.gsub 5, '5'"), ScriptError);
 }
 
+BOOST_AUTO_TEST_CASE(shared_slices)
+{
+    std::string line = "first field value,second field value,third field value,\tfourth field value  \n";
+    auto str = make_value(line);
+    auto base = str->view().data();
+    auto in_buffer = [base, &line](const ObjectPtr &obj)
+    {
+        auto p = coerce<String>(obj)->view().data();
+        return p >= base && p < base + line.size();
+    };
+
+    auto model = create_view_model();
+    model->set_attr("line", str);
+    Scope scope(model);
+    auto run = [&scope](const std::string &src)
+    {
+        Lexer lexer(src);
+        expr::LocalVarNames vars;
+        Parser parser(vars, lexer);
+        return parser.full_expression()->eval(scope);
+    };
+
+    //longer substrings reference the original bytes
+    auto fields = coerce<Array>(run("@line.split(',')"));
+    BOOST_REQUIRE_EQUAL(4U, fields->get_value().size());
+    for (auto &field : fields->get_value()) BOOST_CHECK(in_buffer(field));
+    BOOST_CHECK_EQUAL("second field value", fields->get_value()[1]->to_string());
+    BOOST_CHECK(in_buffer(run("@line.strip")));
+    BOOST_CHECK(in_buffer(run("@line.chomp")));
+    BOOST_CHECK(in_buffer(run("@line[6, 30]")));
+    BOOST_CHECK(in_buffer(run("@line.byteslice(6..40)")));
+    BOOST_CHECK(in_buffer(run("@line.partition('second')[2]")));
+    BOOST_CHECK(in_buffer(run("@line.match(/(sec[a-z]+ field value),/)[1]")));
+    BOOST_CHECK_EQUAL("\"second field value\"", run("@line.match(/(sec[a-z]+ field value),/)[1]")->inspect());
+    //and may be sliced again
+    BOOST_CHECK(in_buffer(run("@line.split(',')[3].strip")));
+    BOOST_CHECK_EQUAL("\"fourth field value\"", run("@line.split(',')[3].strip")->inspect());
+    //short ones are copied
+    BOOST_CHECK(!in_buffer(run("@line[0, 5]")));
+    BOOST_CHECK_EQUAL("\"first\"", run("@line[0, 5]")->inspect());
+
+    //slices work as normal strings
+    BOOST_CHECK_EQUAL("true", run("@line.split(',').first == 'first field value'")->inspect());
+    BOOST_CHECK_EQUAL("\"value\"", run("{'first field value' => 'value'}[@line.split(',').first]")->inspect());
+    auto slice = coerce<String>(fields->get_value()[0]);
+    BOOST_CHECK_EQUAL("first field value", slice->get_value());
+    BOOST_CHECK_EQUAL(make_value("first field value")->hash(), slice->hash());
+
+    //modifying the original copies it first
+    str->get_mutable_value() += "extra";
+    BOOST_CHECK_EQUAL("first field value", slice->to_string());
+    BOOST_CHECK_EQUAL(line + "extra", str->to_string());
+    //as does modifying a slice
+    slice->get_mutable_value() += "!";
+    BOOST_CHECK_EQUAL("first field value!", slice->to_string());
+    BOOST_CHECK_EQUAL("second field value", fields->get_value()[1]->to_string());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
@@ -33,6 +33,7 @@ BOOST_AUTO_TEST_CASE(test)
     BOOST_CHECK_EQUAL("sym", symbol("sym")->c_str());
     BOOST_CHECK_EQUAL(":sym", eval(":sym"));
     BOOST_CHECK_EQUAL("\"sym\"", eval(":sym.to_s"));
+    BOOST_CHECK(symbol("sym")->str_obj() == eval2(":sym.to_s"));
     BOOST_CHECK_EQUAL("true", eval(":a == :a"));
     BOOST_CHECK_EQUAL("false", eval(":a == :b"));
     BOOST_CHECK_EQUAL("0", eval(":a <=> :a"));
@@ -296,6 +296,46 @@ BOOST_AUTO_TEST_CASE(format)
     BOOST_CHECK_EQUAL("\"      12:44:16\"", eval("Time.utc(2017, 'jan', 15, 12, 44, 16).strftime '%14T'"));
 }
 
+BOOST_AUTO_TEST_CASE(format_cache)
+{
+    TimeFormatCache cache(2);
+    auto t = create_object<Time>(1484484256);
+    BOOST_CHECK_EQUAL("at 12:44 on 2017-01-15%", cache.format("at %H:%M on %F%", t->get_value(), t->get_tm()));
+    BOOST_CHECK_EQUAL("%Q -", cache.format("%Q %-", t->get_value(), t->get_tm()));
+    BOOST_CHECK_EQUAL(2U, cache.size());
+    BOOST_CHECK(cache.get("%F") == cache.get("%F"));
+    BOOST_CHECK_EQUAL(2U, cache.size());
+    cache.clear();
+    BOOST_CHECK_EQUAL(0U, cache.size());
+
+    BOOST_CHECK_EQUAL("\"line\\n%Y 2017\"", eval("Time.utc(2017).strftime 'line%n%%Y %Y'"));
+}
+BOOST_AUTO_TEST_CASE(civil)
+{
+    //across leap years, centuries and before 1970
+    for (long long t = -4000000000LL; t < 8000000000LL; t += 86400 * 3 + 3607)
+    {
+        auto time = (time_t)t;
+        tm expected;
+        gmtime_s(&expected, &time);
+        auto &actual = create_object<Time>(time)->get_tm();
+        BOOST_REQUIRE_EQUAL(expected.tm_year, actual.tm_year);
+        BOOST_REQUIRE_EQUAL(expected.tm_mon, actual.tm_mon);
+        BOOST_REQUIRE_EQUAL(expected.tm_mday, actual.tm_mday);
+        BOOST_REQUIRE_EQUAL(expected.tm_hour, actual.tm_hour);
+        BOOST_REQUIRE_EQUAL(expected.tm_min, actual.tm_min);
+        BOOST_REQUIRE_EQUAL(expected.tm_sec, actual.tm_sec);
+        BOOST_REQUIRE_EQUAL(expected.tm_wday, actual.tm_wday);
+        BOOST_REQUIRE_EQUAL(expected.tm_yday, actual.tm_yday);
+        BOOST_REQUIRE_EQUAL(t / 86400 - (t % 86400 < 0 ? 1 : 0),
+            days_from_civil(actual.tm_year + 1900, actual.tm_mon + 1, actual.tm_mday));
+    }
+    //out of range fields carry over
+    BOOST_CHECK_EQUAL(days_from_civil(2016, 3, 2), days_from_civil(2016, 2, 31));
+    BOOST_CHECK_EQUAL(days_from_civil(2017, 1, 1), days_from_civil(2016, 13, 1));
+    BOOST_CHECK_EQUAL(days_from_civil(2015, 12, 1), days_from_civil(2016, 0, 1));
+}
+
 BOOST_AUTO_TEST_CASE(number_ext)
 {
     BOOST_CHECK_EQUAL(      1, eval_i("1.second"));